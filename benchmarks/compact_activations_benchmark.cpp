@@ -0,0 +1,46 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <benchmark/benchmark.h>
+#include <mountain_lake/neural_network/neural_network.h>
+
+#include <string>
+
+#include "random_data.h"
+
+/// @brief 不融合的卷积网络计算一个小批量的梯度，参数为是否使用紧凑模式
+///        （Gradients of a mini-batch of the unfused convolutional network,
+///        the argument is whether compact mode is used）
+/// @remark 计数器kept_bytes为正向传播后保存的层输出的字节数，不包括紧凑
+///         模式的掩码与位置。
+///         The counter kept_bytes is the bytes of the layer outputs kept
+///         after forward propagation, without the masks and positions of
+///         compact mode.
+static void BM_TrainStep(benchmark::State &state) {
+  RawData raw_data = RandomData(64);
+  NeuralNetwork nn;
+  string config = state.range(0) ? "tests/testdata/compact.toml"
+                                 : "tests/testdata/unfused.toml";
+  string err = nn.Init(config, raw_data);
+  if (!err.empty()) {
+    state.SkipWithError(err.c_str());
+    return;
+  }
+  nn.SetLearningRate(0.01f);
+  vector<int> batch;
+  for (int i = 0; i < 64; ++i) batch.push_back(i);
+  for (auto _ : state) {
+    nn.Gradient(batch);
+    nn.Update();
+  }
+  nn.Forward();
+  double bytes = 0;
+  for (int i = 0; i < nn.GetLayers(); ++i) {
+    bytes += nn.Output(i).size() * sizeof(float);
+  }
+  state.counters["kept_bytes"] = bytes;
+  state.SetItemsProcessed(state.iterations() * batch.size());
+}
+BENCHMARK(BM_TrainStep)->Arg(0)->Arg(1)->UseRealTime();
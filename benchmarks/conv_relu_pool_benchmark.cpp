@@ -0,0 +1,75 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <benchmark/benchmark.h>
+#include <mountain_lake/layers/conv_relu_pool.h>
+#include <mountain_lake/layers/relu.h>
+
+/// @brief 28x28输入、30个5x5卷积核与2x2最大值池化
+///        （28x28 input, 30 filters of 5x5 and 2x2 max pooling）
+static void MakeConfig(ConvConig &cc, PoolConfig &pc) {
+  cc.stride = 1;
+  cc.height = 5;
+  cc.width = 5;
+  cc.number = 30;
+  cc.channel_num = 1;
+  cc.i_height = 28;
+  cc.i_width = 28;
+  cc.o_height = 24;
+  cc.o_width = 24;
+  pc.height = 2;
+  pc.width = 2;
+  pc.stride = 2;
+  pc.filter_num = 30;
+  pc.i_height = 24;
+  pc.i_width = 24;
+  pc.o_height = 12;
+  pc.o_width = 12;
+}
+
+/// @brief 依次计算卷积、ReLU与池化，参数为批量大小
+///        （Convolution, ReLU and pooling one after another, the argument is
+///        the batch size）
+static void BM_ConvReluPoolSeparate(benchmark::State &state) {
+  ConvConig cc;
+  PoolConfig pc;
+  MakeConfig(cc, pc);
+  MatrixXf X = MatrixXf::Random(state.range(0), 784);
+  MatrixXf W = MatrixXf::Random(1, 30 * 25);
+  MatrixXf B = MatrixXf::Random(1, 30);
+  MatrixXf C, R, P;
+  Convolution conv;
+  ReLU relu;
+  Pooling pool;
+  for (auto _ : state) {
+    conv.Forward(X, W, B, C, cc);
+    relu.Forward(C, R);
+    pool.Forward(R, P, pc);
+    benchmark::DoNotOptimize(P.data());
+  }
+  state.SetItemsProcessed(state.iterations() * X.rows());
+}
+BENCHMARK(BM_ConvReluPoolSeparate)->Arg(1)->Arg(32);
+
+/// @brief 融合计算卷积、ReLU与池化，参数为批量大小
+///        （Fused convolution, ReLU and pooling, the argument is the batch
+///        size）
+static void BM_ConvReluPoolFused(benchmark::State &state) {
+  ConvConig cc;
+  PoolConfig pc;
+  MakeConfig(cc, pc);
+  MatrixXf X = MatrixXf::Random(state.range(0), 784);
+  MatrixXf W = MatrixXf::Random(1, 30 * 25);
+  MatrixXf B = MatrixXf::Random(1, 30);
+  MatrixXf P;
+  MatrixXb mask;
+  ConvReluPool fused;
+  for (auto _ : state) {
+    fused.Forward(X, W, B, P, cc, pc, &mask);
+    benchmark::DoNotOptimize(P.data());
+  }
+  state.SetItemsProcessed(state.iterations() * X.rows());
+}
+BENCHMARK(BM_ConvReluPoolFused)->Arg(1)->Arg(32);
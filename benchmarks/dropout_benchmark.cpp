@@ -0,0 +1,47 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <benchmark/benchmark.h>
+#include <mountain_lake/kernels/philox.h>
+#include <mountain_lake/layers/dropout.h>
+
+/// @brief 按位打包的掩码，包括正向与反向传播，参数为批量大小
+///        （Bit-packed mask with forward and backward propagation, the
+///        argument is the batch size）
+static void BM_DropoutBits(benchmark::State &state) {
+  MatrixXf X = MatrixXf::Random(state.range(0), 4320);
+  MatrixXf dZ = MatrixXf::Random(state.range(0), 4320);
+  MatrixXf Z, dX;
+  MatrixXb mask;
+  Dropout dropout;
+  uint64_t stream = 0;
+  for (auto _ : state) {
+    dropout.Forward(X, Z, mask, 0.5f, 1, stream++);
+    dropout.Backward(dZ, mask, dX, 0.5f);
+    benchmark::DoNotOptimize(dX.data());
+  }
+  state.SetItemsProcessed(state.iterations() * X.size());
+}
+BENCHMARK(BM_DropoutBits)->Arg(1)->Arg(32);
+
+/// @brief 同样的计算使用与输出一样大的浮点数掩码，参数为批量大小
+///        （The same computation with a float mask as large as the output,
+///        the argument is the batch size）
+static void BM_DropoutFloatMask(benchmark::State &state) {
+  MatrixXf X = MatrixXf::Random(state.range(0), 4320);
+  MatrixXf dZ = MatrixXf::Random(state.range(0), 4320);
+  MatrixXf M(X.rows(), X.cols());
+  MatrixXf Z, dX;
+  uint64_t stream = 0;
+  for (auto _ : state) {
+    PhiloxUniform(M.data(), M.size(), 0.0f, 1.0f, 1, stream++);
+    M = (M.array() < 0.5f).cast<float>() * 2.0f;
+    Z = X.cwiseProduct(M);
+    dX = dZ.cwiseProduct(M);
+    benchmark::DoNotOptimize(dX.data());
+  }
+  state.SetItemsProcessed(state.iterations() * X.size());
+}
+BENCHMARK(BM_DropoutFloatMask)->Arg(1)->Arg(32);
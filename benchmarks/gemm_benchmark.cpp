@@ -0,0 +1,116 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <benchmark/benchmark.h>
+#include <mountain_lake/kernels/gemm.h>
+
+/// @brief 神经网络中常见的乘法（products common in the network）
+/// @remark 第一个参数选择形状，第二个参数为批量大小B：
+///         0为[B x 784] * [784 x 100]，1为[B x 100] * [100 x 10]，
+///         2为反向传播的X^T * dA，即[784 x B] * [B x 100]，
+///         3为dA * W^T，即[B x 100] * [100 x 784]，
+///         4为卷积展开后的[576 x 25] * [25 x 30]，与B无关。
+///         The first argument selects the shape, the second is the batch size
+///         B: 0 is [B x 784] * [784 x 100], 1 is [B x 100] * [100 x 10],
+///         2 is the backward X^T * dA, [784 x B] * [B x 100],
+///         3 is dA * W^T, [B x 100] * [100 x 784],
+///         4 is the unfolded convolution [576 x 25] * [25 x 30], independent
+///         of B.
+struct Shape {
+  MatrixXf A;
+  MatrixXf B;
+  bool trans_a = false;
+  bool trans_b = false;
+};
+
+static Shape MakeShape(int shape, int batch) {
+  Shape s;
+  if (shape == 0) {
+    s.A = MatrixXf::Random(batch, 784);
+    s.B = MatrixXf::Random(784, 100);
+  } else if (shape == 1) {
+    s.A = MatrixXf::Random(batch, 100);
+    s.B = MatrixXf::Random(100, 10);
+  } else if (shape == 2) {
+    s.A = MatrixXf::Random(batch, 784);
+    s.B = MatrixXf::Random(batch, 100);
+    s.trans_a = true;
+  } else if (shape == 3) {
+    s.A = MatrixXf::Random(batch, 100);
+    s.B = MatrixXf::Random(784, 100);
+    s.trans_b = true;
+  } else {
+    s.A = MatrixXf::Random(576, 25);
+    s.B = MatrixXf::Random(25, 30);
+  }
+  return s;
+}
+
+static void SetFlops(benchmark::State &state, const Shape &s) {
+  double m = s.trans_a ? s.A.cols() : s.A.rows();
+  double k = s.trans_a ? s.A.rows() : s.A.cols();
+  double n = s.trans_b ? s.B.rows() : s.B.cols();
+  state.counters["GFLOPS"] = benchmark::Counter(
+      2.0 * m * n * k * state.iterations() / 1e9, benchmark::Counter::kIsRate);
+}
+
+/// @brief Eigen的乘法（Eigen products）
+static void BM_GemmEigen(benchmark::State &state) {
+  Shape s = MakeShape(state.range(0), state.range(1));
+  MatrixXf C;
+  for (auto _ : state) {
+    if (s.trans_a) {
+      C.noalias() = s.A.transpose() * s.B;
+    } else if (s.trans_b) {
+      C.noalias() = s.A * s.B.transpose();
+    } else {
+      C.noalias() = s.A * s.B;
+    }
+    benchmark::DoNotOptimize(C.data());
+  }
+  SetFlops(state, s);
+}
+
+/// @brief 这里的矩阵乘法，每次打包右操作数（the in-tree GEMM, packing the
+///        right operand every time）
+static void BM_Gemm(benchmark::State &state) {
+  Shape s = MakeShape(state.range(0), state.range(1));
+  MatrixXf C;
+  for (auto _ : state) {
+    Gemm(s.A, s.trans_a, s.B, s.trans_b, C);
+    benchmark::DoNotOptimize(C.data());
+  }
+  SetFlops(state, s);
+}
+
+/// @brief 使用预先打包的右操作数，对应正向传播的权重（with a pre-packed
+///        right operand, as for the weights in forward propagation）
+static void BM_GemmPacked(benchmark::State &state) {
+  Shape s = MakeShape(state.range(0), state.range(1));
+  PackedMatrix P;
+  PackMatrix(s.B, P);
+  MatrixXf C;
+  for (auto _ : state) {
+    Gemm(s.A, P, C);
+    benchmark::DoNotOptimize(C.data());
+  }
+  SetFlops(state, s);
+}
+
+static void Shapes(benchmark::internal::Benchmark *b) {
+  for (int shape = 0; shape < 4; ++shape) {
+    for (int batch : {1, 32, 100}) b->Args({shape, batch});
+  }
+  b->Args({4, 1});
+}
+static void ForwardShapes(benchmark::internal::Benchmark *b) {
+  for (int shape : {0, 1}) {
+    for (int batch : {1, 32, 100}) b->Args({shape, batch});
+  }
+  b->Args({4, 1});
+}
+BENCHMARK(BM_GemmEigen)->Apply(Shapes);
+BENCHMARK(BM_Gemm)->Apply(Shapes);
+BENCHMARK(BM_GemmPacked)->Apply(ForwardShapes);
@@ -0,0 +1,68 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <benchmark/benchmark.h>
+#include <mountain_lake/layers/affine.h>
+#include <mountain_lake/layers/global_pooling.h>
+#include <mountain_lake/layers/relu.h>
+
+/// @brief 池化后的30x12x12特征经过Affine:100、ReLU与Affine:10，包括反向
+///        传播，参数为批量大小
+///        （Pooled 30x12x12 features through Affine:100, ReLU and Affine:10
+///        with backpropagation, the argument is the batch size）
+static void BM_HeadAffine(benchmark::State &state) {
+  int batch = state.range(0);
+  MatrixXf X = MatrixXf::Random(batch, 4320);
+  MatrixXf W1 = MatrixXf::Random(4320, 100);
+  MatrixXf B1 = MatrixXf::Random(1, 100);
+  MatrixXf W2 = MatrixXf::Random(100, 10);
+  MatrixXf B2 = MatrixXf::Random(1, 10);
+  MatrixXf dO = MatrixXf::Random(batch, 10);
+  MatrixXf H, R, O, dR, dH, dX, dW1, dB1, dW2, dB2;
+  Affine affine;
+  ReLU relu;
+  for (auto _ : state) {
+    affine.Forward(X, W1, B1, H);
+    relu.Forward(H, R);
+    affine.Forward(R, W2, B2, O);
+    affine.Backward(R, W2, dO, dB2, dW2, dR, 2);
+    relu.Backward(dR, R, dH);
+    affine.Backward(X, W1, dH, dB1, dW1, dX, 2);
+    benchmark::DoNotOptimize(dX.data());
+  }
+  state.SetItemsProcessed(state.iterations() * batch);
+}
+BENCHMARK(BM_HeadAffine)->Arg(1)->Arg(32);
+
+/// @brief 同样的特征经过全局平均池化与Affine:10，包括反向传播，参数为批量
+///        大小
+///        （The same features through global average pooling and Affine:10
+///        with backpropagation, the argument is the batch size）
+static void BM_HeadGlobalAvgPool(benchmark::State &state) {
+  int batch = state.range(0);
+  PoolConfig pc;
+  pc.height = pc.i_height = 12;
+  pc.width = pc.i_width = 12;
+  pc.stride = 1;
+  pc.type = 1;
+  pc.filter_num = 30;
+  pc.o_height = pc.o_width = 1;
+  MatrixXf X = MatrixXf::Random(batch, 4320);
+  MatrixXf W = MatrixXf::Random(30, 10);
+  MatrixXf B = MatrixXf::Random(1, 10);
+  MatrixXf dO = MatrixXf::Random(batch, 10);
+  MatrixXf G, O, dG, dX, dW, dB;
+  GlobalPooling global_pool;
+  Affine affine;
+  for (auto _ : state) {
+    global_pool.Forward(X, G, pc);
+    affine.Forward(G, W, B, O);
+    affine.Backward(G, W, dO, dB, dW, dG, 2);
+    global_pool.Backward(dG, dX, X, pc);
+    benchmark::DoNotOptimize(dX.data());
+  }
+  state.SetItemsProcessed(state.iterations() * batch);
+}
+BENCHMARK(BM_HeadGlobalAvgPool)->Arg(1)->Arg(32);
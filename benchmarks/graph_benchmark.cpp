@@ -0,0 +1,50 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <benchmark/benchmark.h>
+#include <mountain_lake/neural_network/neural_network.h>
+
+#include "random_data.h"
+
+/// @brief 计算带分支网络的梯度，参数为0时按层号逐步计算，为1时同一层级的
+///        分支同时计算
+///        （Gradients of a branching network, the argument 0 steps in layer
+///        order and 1 runs the branches of one level at the same time）
+/// @remark 两个分支都是小批量较小的仿射变换层，单个分支用不满所有的核。
+///         Both branches are affine layers on a small mini-batch, so a single
+///         branch cannot keep every core busy.
+static void BM_Graph(benchmark::State &state) {
+  RawData raw_data = RandomData(64);
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/graph.toml", raw_data);
+  if (!err.empty()) {
+    state.SkipWithError(err.c_str());
+    return;
+  }
+  vector<int> batch;
+  for (int i = 0; i < 16; ++i) batch.push_back(i);
+  Workspace ws;
+  ws.dW.resize(nn.GetLayers() + 1);
+  ws.dB.resize(nn.GetLayers() + 1);
+  for (int i = 1; i <= nn.GetLayers(); ++i) {
+    ws.dW[i].resize(nn.GetWeightGradient(i).rows(),
+                    nn.GetWeightGradient(i).cols());
+    ws.dB[i].resize(nn.GetBiasGradient(i).rows(),
+                    nn.GetBiasGradient(i).cols());
+  }
+  for (auto _ : state) {
+    if (state.range(0) == 1) {
+      nn.Gradient(batch, ws);
+      continue;
+    }
+    nn.LoadBatch(batch, ws);
+    for (int i = 1; i <= nn.GetLayers(); ++i) i = nn.StepForward(i, ws);
+    for (int i = nn.GetLayers(); i >= 1; --i) {
+      i = nn.StepBackward(i, ws, ws.dW, ws.dB);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * batch.size());
+}
+BENCHMARK(BM_Graph)->Arg(0)->Arg(1)->UseRealTime();
@@ -0,0 +1,29 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <benchmark/benchmark.h>
+#include <mountain_lake/training/hogwild.h>
+
+#include "random_data.h"
+
+/// @brief Hogwild训练一轮的吞吐量，参数为线程数
+///        （Throughput of one Hogwild epoch, the argument is the thread count）
+static void BM_Hogwild(benchmark::State &state) {
+  // 约一半像素为0（about half of the pixels are 0）
+  RawData raw_data = RandomData(2000, true);
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/config.toml", raw_data);
+  if (!err.empty()) {
+    state.SkipWithError(err.c_str());
+    return;
+  }
+  Hogwild hogwild;
+  int threads = state.range(0);
+  for (auto _ : state) {
+    hogwild.Train(nn, threads, 1, 1, 0.01f, 1);
+  }
+  state.SetItemsProcessed(state.iterations() * raw_data.train_number);
+}
+BENCHMARK(BM_Hogwild)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
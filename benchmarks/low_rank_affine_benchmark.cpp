@@ -0,0 +1,61 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <benchmark/benchmark.h>
+#include <mountain_lake/layers/affine.h>
+#include <mountain_lake/layers/low_rank_affine.h>
+
+/// @brief 稠密的1024x1024仿射变换层正向传播，参数为批量大小
+///        （Forward propagation of a dense 1024x1024 affine layer, the
+///        argument is the batch size）
+static void BM_DenseAffine(benchmark::State &state) {
+  int batch = state.range(0);
+  MatrixXf X = MatrixXf::Random(batch, 1024);
+  MatrixXf W = MatrixXf::Random(1024, 1024);
+  MatrixXf B = MatrixXf::Random(1, 1024);
+  MatrixXf A;
+  Affine affine;
+  for (auto _ : state) {
+    affine.Forward(X, W, B, A);
+    benchmark::DoNotOptimize(A.data());
+  }
+  state.SetItemsProcessed(state.iterations() * batch);
+}
+BENCHMARK(BM_DenseAffine)->Arg(1)->Arg(64);
+
+/// @brief 同样大小分解为秩r的仿射变换层正向传播，参数为批量大小与秩
+///        （Forward propagation of the same layer factorized to rank r, the
+///        arguments are the batch size and the rank）
+static void BM_LowRankAffine(benchmark::State &state) {
+  int batch = state.range(0);
+  int rank = state.range(1);
+  MatrixXf X = MatrixXf::Random(batch, 1024);
+  MatrixXf W = MatrixXf::Random(2048, rank);
+  MatrixXf B = MatrixXf::Random(1, 1024);
+  MatrixXf A;
+  LowRankAffine layer;
+  for (auto _ : state) {
+    layer.Forward(X, W, B, A);
+    benchmark::DoNotOptimize(A.data());
+  }
+  state.SetItemsProcessed(state.iterations() * batch);
+}
+BENCHMARK(BM_LowRankAffine)
+    ->Args({1, 32})
+    ->Args({1, 128})
+    ->Args({64, 32})
+    ->Args({64, 128});
+
+/// @brief 1024x1024权重的截断奇异值分解，参数为秩
+///        （Truncated SVD of 1024x1024 weights, the argument is the rank）
+static void BM_TruncatedSvd(benchmark::State &state) {
+  MatrixXf W = MatrixXf::Random(1024, 1024);
+  MatrixXf F;
+  for (auto _ : state) {
+    LowRankAffine::Factorize(W, state.range(0), F, 0, 0);
+    benchmark::DoNotOptimize(F.data());
+  }
+}
+BENCHMARK(BM_TruncatedSvd)->Arg(32)->Arg(128)->Unit(benchmark::kMillisecond);
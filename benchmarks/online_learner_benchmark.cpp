@@ -0,0 +1,40 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <benchmark/benchmark.h>
+#include <mountain_lake/training/online_learner.h>
+
+#include "random_data.h"
+
+/// @brief 每个样本的在线更新延迟，参数为批量大小与回放样本数
+///        （Online update latency per sample, the arguments are the batch
+///        size and the replayed samples）
+static void BM_OnlineLearn(benchmark::State &state) {
+  RawData raw_data = RandomData(256);
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/config.toml", raw_data);
+  if (!err.empty()) {
+    state.SkipWithError(err.c_str());
+    return;
+  }
+  nn.SetLearningRate(0.01f);
+  OnlineLearner learner;
+  OnlineConfig config;
+  config.batch_size = state.range(0);
+  config.replay_capacity = 1024;
+  config.replay_samples = state.range(1);
+  learner.Init(nn, config);
+  int r = 0;
+  for (auto _ : state) {
+    learner.Learn(raw_data.train_data.row(r).data(), raw_data.train_labels(r));
+    r = (r + 1) % 256;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_OnlineLearn)
+    ->Args({1, 0})
+    ->Args({1, 3})
+    ->Args({4, 0})
+    ->Args({8, 8});
@@ -0,0 +1,75 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <benchmark/benchmark.h>
+#include <mountain_lake/training/pipeline.h>
+
+#include <string>
+
+#include "random_data.h"
+
+/// @brief 不使用流水线计算一个小批量的梯度，参数为批量大小
+///        （Gradients of a mini-batch without the pipeline, the argument is
+///        the batch size）
+static void BM_PipelineBaseline(benchmark::State &state) {
+  RawData raw_data = RandomData(256);
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/pipeline.toml", raw_data);
+  if (!err.empty()) {
+    state.SkipWithError(err.c_str());
+    return;
+  }
+  vector<int> batch;
+  for (int i = 0; i < state.range(0); ++i) batch.push_back(i);
+  for (auto _ : state) {
+    nn.Gradient(batch);
+  }
+  state.SetItemsProcessed(state.iterations() * batch.size());
+}
+BENCHMARK(BM_PipelineBaseline)->Arg(16)->UseRealTime();
+
+/// @brief 用流水线计算一个小批量的梯度，参数为段数、微批量数与调度方式
+///        （Gradients of a mini-batch through the pipeline, the arguments are
+///        the stages, the micro-batches and the schedule）
+/// @remark 计数器util_s为每段的利用率，util为平均利用率，理想的流水线中
+///         util约为m/(m+s-1)。
+///         The counters util_s are the utilization of each stage and util
+///         the mean, an ideal pipeline reaches about m/(m+s-1).
+static void BM_Pipeline(benchmark::State &state) {
+  RawData raw_data = RandomData(256);
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/pipeline.toml", raw_data);
+  if (!err.empty()) {
+    state.SkipWithError(err.c_str());
+    return;
+  }
+  Pipeline pipeline;
+  pipeline.Partition(nn, state.range(0));
+  vector<int> batch;
+  for (int i = 0; i < 16; ++i) batch.push_back(i);
+  int stages = pipeline.GetStages();
+  vector<double> busy(stages, 0.0);
+  double seconds = 0.0;
+  for (auto _ : state) {
+    PipelineStats stats =
+        pipeline.Gradient(nn, batch, state.range(1), state.range(2));
+    for (int s = 0; s < stages; ++s) busy[s] += stats.busy_seconds[s];
+    seconds += stats.seconds;
+  }
+  double total = 0.0;
+  for (int s = 0; s < stages; ++s) {
+    state.counters["util_s" + std::to_string(s)] = busy[s] / seconds;
+    total += busy[s] / seconds;
+  }
+  state.counters["util"] = total / stages;
+  state.SetItemsProcessed(state.iterations() * batch.size());
+}
+BENCHMARK(BM_Pipeline)
+    ->ArgNames({"stages", "micro", "schedule"})
+    ->Args({2, 4, kPipeline1F1B})
+    ->Args({4, 4, kPipeline1F1B})
+    ->Args({4, 8, kPipeline1F1B})
+    ->Args({4, 8, kPipelineGPipe})
+    ->UseRealTime();
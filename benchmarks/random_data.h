@@ -0,0 +1,32 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef BENCHMARKS_RANDOM_DATA_H_
+#define BENCHMARKS_RANDOM_DATA_H_
+
+#include <mountain_lake/neural_network/neural_network.h>
+
+/// @brief 生成28x28的随机训练数据（Generate random 28x28 training data）
+/// @param train_number 训练样本数（number of training samples）
+/// @param clamp_zero 为true时把负数置为0，约一半像素为0（set negative values
+///        to 0 when true, so about half of the pixels are 0）
+/// @return 原始数据，第i个样本的标签为i % 10（raw data, the label of sample i
+///         is i % 10）
+inline RawData RandomData(int train_number, bool clamp_zero = false) {
+  RawData raw_data;
+  raw_data.row = 28;
+  raw_data.col = 28;
+  raw_data.size = 784;
+  raw_data.train_number = train_number;
+  raw_data.train_data = MatrixXfr::Random(train_number, 784);
+  if (clamp_zero) {
+    raw_data.train_data = raw_data.train_data.cwiseMax(0.0f);
+  }
+  raw_data.train_labels = MatrixXb(train_number, 1);
+  for (int i = 0; i < train_number; ++i) raw_data.train_labels(i) = i % 10;
+  return raw_data;
+}
+
+#endif  // BENCHMARKS_RANDOM_DATA_H_
@@ -0,0 +1,102 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <benchmark/benchmark.h>
+#include <mountain_lake/layers/depthwise_convolution.h>
+#include <mountain_lake/layers/pointwise_convolution.h>
+
+/// @brief 28x28输入上的kxk卷积核，输出number个通道
+///        （k x k filters on a 28x28 input with number output channels）
+static ConvConig MakeConfig(int k, int number) {
+  ConvConig cc;
+  cc.stride = 1;
+  cc.height = k;
+  cc.width = k;
+  cc.number = number;
+  cc.channel_num = 1;
+  cc.i_height = 28;
+  cc.i_width = 28;
+  cc.o_height = 29 - k;
+  cc.o_width = 29 - k;
+  return cc;
+}
+
+/// @brief 30个5x5卷积核的卷积层，参数为批量大小
+///        （Convolution with 30 filters of 5x5, the argument is the batch
+///        size）
+static void BM_ConvolutionFull(benchmark::State &state) {
+  ConvConig cc = MakeConfig(5, 30);
+  MatrixXf X = MatrixXf::Random(state.range(0), 784);
+  MatrixXf W = MatrixXf::Random(1, 30 * 25);
+  MatrixXf B = MatrixXf::Random(1, 30);
+  MatrixXf O;
+  Convolution conv;
+  for (auto _ : state) {
+    conv.Forward(X, W, B, O, cc);
+    benchmark::DoNotOptimize(O.data());
+  }
+  state.SetItemsProcessed(state.iterations() * X.rows());
+}
+BENCHMARK(BM_ConvolutionFull)->Arg(1)->Arg(32);
+
+/// @brief 输出相同的5x5逐通道卷积加1到30通道的逐点卷积，参数为批量大小
+///        （5x5 depthwise plus 1 to 30 channel pointwise convolution with the
+///        same output, the argument is the batch size）
+static void BM_ConvolutionSeparable(benchmark::State &state) {
+  ConvConig dc = MakeConfig(5, 1);
+  ConvConig pc = MakeConfig(1, 30);
+  pc.i_height = pc.o_height = 24;
+  pc.i_width = pc.o_width = 24;
+  MatrixXf X = MatrixXf::Random(state.range(0), 784);
+  MatrixXf D = MatrixXf::Random(1, 25);
+  MatrixXf zero = MatrixXf::Zero(1, 1);
+  MatrixXf P = MatrixXf::Random(1, 30);
+  MatrixXf B = MatrixXf::Random(1, 30);
+  MatrixXf T, O;
+  DepthwiseConvolution depthwise;
+  PointwiseConvolution pointwise;
+  for (auto _ : state) {
+    depthwise.Forward(X, D, zero, T, dc);
+    pointwise.Forward(T, P, B, O, pc);
+    benchmark::DoNotOptimize(O.data());
+  }
+  state.SetItemsProcessed(state.iterations() * X.rows());
+}
+BENCHMARK(BM_ConvolutionSeparable)->Arg(1)->Arg(32);
+
+/// @brief 30个通道12x12输入上的3x3逐通道卷积与30到30通道的逐点卷积，第一个
+///        参数为批量大小，第二个参数为1时包括反向传播
+///        （3x3 depthwise and 30 to 30 channel pointwise convolution on a
+///        30 channel 12x12 input, the first argument is the batch size, the
+///        second one includes backpropagation when 1）
+static void BM_SeparableBlock(benchmark::State &state) {
+  ConvConig dc = MakeConfig(3, 30);
+  dc.pad = 1;
+  dc.channel_num = 30;
+  dc.i_height = dc.i_width = dc.o_height = dc.o_width = 12;
+  ConvConig pc = MakeConfig(1, 30);
+  pc.channel_num = 30;
+  pc.i_height = pc.i_width = pc.o_height = pc.o_width = 12;
+  int batch = state.range(0);
+  MatrixXf X = MatrixXf::Random(batch, 30 * 144);
+  MatrixXf D = MatrixXf::Random(1, 30 * 9);
+  MatrixXf P = MatrixXf::Random(30, 30);
+  MatrixXf B = MatrixXf::Random(1, 30);
+  MatrixXf dO = MatrixXf::Random(batch, 30 * 144);
+  MatrixXf T, O, dT, dX, dD, dP, dB;
+  DepthwiseConvolution depthwise;
+  PointwiseConvolution pointwise;
+  for (auto _ : state) {
+    depthwise.Forward(X, D, B, T, dc);
+    pointwise.Forward(T, P, B, O, pc);
+    if (state.range(1) == 1) {
+      pointwise.Backward(T, P, dO, dB, dP, dT, pc, 2);
+      depthwise.Backward(X, D, dT, dB, dD, dX, dc, 2);
+    }
+    benchmark::DoNotOptimize(O.data());
+  }
+  state.SetItemsProcessed(state.iterations() * batch);
+}
+BENCHMARK(BM_SeparableBlock)->Args({1, 0})->Args({32, 0})->Args({32, 1});
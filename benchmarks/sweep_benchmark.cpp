@@ -0,0 +1,27 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <benchmark/benchmark.h>
+#include <mountain_lake/training/sweep.h>
+
+#include "random_data.h"
+
+/// @brief 同时训练8个配置的用时，参数为同时训练的模型数
+///        （Time to train 8 configurations, the argument is the number of
+///        models trained at once）
+static void BM_Sweep(benchmark::State &state) {
+  RawData raw_data = RandomData(200);
+  vector<string> configs(8, "tests/testdata/sweep.toml");
+  vector<SweepResult> results;
+  for (auto _ : state) {
+    string err = Sweep::Run(configs, raw_data, state.range(0), results);
+    if (!err.empty()) {
+      state.SkipWithError(err.c_str());
+      return;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * configs.size());
+}
+BENCHMARK(BM_Sweep)->Arg(1)->Arg(2)->Arg(4)->UseRealTime();
@@ -0,0 +1,77 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "bit_mask.h"
+
+#include <mountain_lake/parallel/thread_pool.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/// @brief 把大于0的元素记为1（Mark the elements greater than 0 with 1）
+/// @param x 输入，连续的n个数（input, n contiguous numbers）
+/// @param n 个数（count）
+/// @param bits 输出，共(n+7)/8个字节（output of (n+7)/8 bytes）
+/// @remark AVX2一次比较8个数，比较结果的符号位正好组成一个字节。
+///         AVX2 compares 8 numbers at a time and the sign bits of the result
+///         form exactly one byte.
+void PackSignMask(const float *x, long n, uint8_t *bits) {
+  long bytes = (n + 7) / 8;
+  ThreadPool::Global().ParallelFor(0, bytes, 4096, [&](long first,
+                                                        long last) {
+    long b = first;
+#if defined(__AVX2__)
+    const __m256 zero = _mm256_setzero_ps();
+    for (; b < last && b * 8 + 8 <= n; ++b) {
+      __m256 gt = _mm256_cmp_ps(_mm256_loadu_ps(x + b * 8), zero, _CMP_GT_OQ);
+      bits[b] = static_cast<uint8_t>(_mm256_movemask_ps(gt));
+    }
+#endif
+    for (; b < last; ++b) {
+      uint8_t byte = 0;
+      for (long e = b * 8; e < b * 8 + 8 && e < n; ++e) {
+        byte |= static_cast<uint8_t>((x[e] > 0.0f) << (e - b * 8));
+      }
+      bits[b] = byte;
+    }
+  });
+}
+
+/// @brief 按位掩码与缩放相乘，z = x * bit * scale（Multiply by the bit mask
+///        and the scale, z = x * bit * scale）
+/// @param x 输入，连续的n个数（input, n contiguous numbers）
+/// @param bits 按位打包的掩码（bit-packed mask）
+/// @param n 个数（count）
+/// @param scale 保留的元素乘的系数（factor of the kept elements）
+/// @param z 输出，可以与x相同（output, may be the same as x）
+/// @remark 每个字节广播到8个通道后与各自的位比较，得到的掩码直接与缩放后
+///         的输入做与运算，不展开为浮点数的掩码。
+///         Each byte is broadcast to 8 lanes and compared with their own
+///         bits, and the resulting mask is ANDed with the scaled input
+///         directly, without expanding it into a float mask.
+void ApplyBitMask(const float *x, const uint8_t *bits, long n, float scale,
+                  float *z) {
+  long bytes = (n + 7) / 8;
+  ThreadPool::Global().ParallelFor(0, bytes, 2048, [&](long first,
+                                                        long last) {
+    long b = first;
+#if defined(__AVX2__)
+    const __m256i lanes = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    const __m256 s = _mm256_set1_ps(scale);
+    for (; b < last && b * 8 + 8 <= n; ++b) {
+      __m256i m = _mm256_and_si256(_mm256_set1_epi32(bits[b]), lanes);
+      __m256 keep = _mm256_castsi256_ps(_mm256_cmpeq_epi32(m, lanes));
+      __m256 v = _mm256_mul_ps(_mm256_loadu_ps(x + b * 8), s);
+      _mm256_storeu_ps(z + b * 8, _mm256_and_ps(v, keep));
+    }
+#endif
+    for (; b < last; ++b) {
+      for (long e = b * 8; e < b * 8 + 8 && e < n; ++e) {
+        z[e] = (bits[b] >> (e - b * 8)) & 1 ? x[e] * scale : 0.0f;
+      }
+    }
+  });
+}
@@ -0,0 +1,23 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_KERNELS_BIT_MASK_H_
+#define MOUNTAIN_LAKE_KERNELS_BIT_MASK_H_
+
+// 按位打包的掩码（Bit-packed masks）
+//
+// n个元素的掩码占(n+7)/8个字节，第e个元素是第e/8个字节的第e%8位。丢弃层的
+// 保留掩码与紧凑激活模式下ReLU层的符号掩码都使用这种格式。
+// A mask of n elements takes (n+7)/8 bytes, element e is bit e%8 of byte
+// e/8. Both the keep masks of dropout layers and the sign masks of ReLU
+// layers in compact activation mode use this format.
+
+#include <cstdint>
+
+void PackSignMask(const float *x, long n, uint8_t *bits);
+void ApplyBitMask(const float *x, const uint8_t *bits, long n, float scale,
+                  float *z);
+
+#endif  // MOUNTAIN_LAKE_KERNELS_BIT_MASK_H_
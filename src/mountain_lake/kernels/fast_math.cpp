@@ -0,0 +1,195 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "fast_math.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+// exp的参数范围：低于下限时结果已经小于最小的次正规数，高于上限时结果溢出为inf。
+// Argument range of exp: below the lower bound the result is already smaller
+// than the smallest subnormal, above the upper bound it overflows to inf.
+static const float kExpLo = -104.0f;
+static const float kExpHi = 89.0f;
+static const float kLog2e = 1.44269504088896341f;
+// ln2 拆成高低两部分，减少约简时的舍入误差（Cody-Waite）。
+// ln2 split into high and low parts to reduce rounding errors in the
+// reduction (Cody-Waite).
+static const float kLn2Hi = 0.693359375f;
+static const float kLn2Lo = -2.12194440e-4f;
+// e^r 在 [-ln2/2, ln2/2] 上的多项式系数（Cephes expf）。
+// Polynomial coefficients of e^r on [-ln2/2, ln2/2] (Cephes expf).
+static const float kExpP0 = 1.9875691500e-4f;
+static const float kExpP1 = 1.3981999507e-3f;
+static const float kExpP2 = 8.3334519073e-3f;
+static const float kExpP3 = 4.1665795894e-2f;
+static const float kExpP4 = 1.6666665459e-1f;
+static const float kExpP5 = 5.0000001201e-1f;
+// |x| < 0.625 时tanh的多项式系数（Cephes tanhf）。
+// Polynomial coefficients of tanh for |x| < 0.625 (Cephes tanhf).
+static const float kTanhSmall = 0.625f;
+static const float kTanhP0 = -5.70498872745e-3f;
+static const float kTanhP1 = 2.06390887954e-2f;
+static const float kTanhP2 = -5.37397155531e-2f;
+static const float kTanhP3 = 1.33314422036e-1f;
+static const float kTanhP4 = -3.33332819422e-1f;
+
+/// @brief 构造 2^n（Build 2^n）
+/// @param n 指数，范围 [-126, 127]（exponent in [-126, 127]）
+static inline float Pow2(int32_t n) {
+  int32_t bits = (n + 127) << 23;
+  float y;
+  memcpy(&y, &bits, sizeof(y));
+  return y;
+}
+
+/// @brief exp的标量版本，与向量版本的算法完全相同
+///        （Scalar exp, exactly the same algorithm as the vector version）
+static inline float ExpScalar(float x) {
+  // 这样写比较可以让NaN原样通过（Comparisons written this way let NaN through）
+  x = x < kExpLo ? kExpLo : x;
+  x = x > kExpHi ? kExpHi : x;
+  float fx = std::floor(std::fma(x, kLog2e, 0.5f));
+  float r = std::fma(-fx, kLn2Hi, x);
+  r = std::fma(-fx, kLn2Lo, r);
+  float p = kExpP0;
+  p = std::fma(p, r, kExpP1);
+  p = std::fma(p, r, kExpP2);
+  p = std::fma(p, r, kExpP3);
+  p = std::fma(p, r, kExpP4);
+  p = std::fma(p, r, kExpP5);
+  float y = std::fma(p, r * r, r) + 1.0f;
+  if (std::isnan(y)) return y;
+  // 2^n 拆成两个因子相乘，使 n = 128 和次正规结果都能正确表示。
+  // 2^n is split into two factors so that n = 128 and subnormal results are
+  // both represented correctly.
+  int32_t n = static_cast<int32_t>(fx);
+  int32_t n1 = n >> 1;
+  return y * Pow2(n1) * Pow2(n - n1);
+}
+
+/// @brief tanh的标量版本（Scalar tanh）
+static inline float TanhScalar(float x) {
+  float a = std::fabs(x);
+  if (a < kTanhSmall) {
+    float z = x * x;
+    float p = kTanhP0;
+    p = std::fma(p, z, kTanhP1);
+    p = std::fma(p, z, kTanhP2);
+    p = std::fma(p, z, kTanhP3);
+    p = std::fma(p, z, kTanhP4);
+    return std::fma(p * z, x, x);
+  }
+  float y = 1.0f - 2.0f / (ExpScalar(2.0f * a) + 1.0f);
+  return std::copysign(y, x);
+}
+
+#if defined(__AVX2__) && defined(__FMA__)
+/// @brief 8路向量exp（8-lane vector exp）
+static inline __m256 Exp8(__m256 x) {
+  // max/min在有NaN时返回第二个操作数，所以把x放在第二位以保留NaN。
+  // max/min return the second operand when NaN is involved, so x goes second
+  // to keep NaN.
+  x = _mm256_max_ps(_mm256_set1_ps(kExpLo), x);
+  x = _mm256_min_ps(_mm256_set1_ps(kExpHi), x);
+  __m256 fx = _mm256_fmadd_ps(x, _mm256_set1_ps(kLog2e), _mm256_set1_ps(0.5f));
+  fx = _mm256_floor_ps(fx);
+  __m256 r = _mm256_fnmadd_ps(fx, _mm256_set1_ps(kLn2Hi), x);
+  r = _mm256_fnmadd_ps(fx, _mm256_set1_ps(kLn2Lo), r);
+  __m256 p = _mm256_set1_ps(kExpP0);
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(kExpP1));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(kExpP2));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(kExpP3));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(kExpP4));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(kExpP5));
+  __m256 y = _mm256_fmadd_ps(p, _mm256_mul_ps(r, r), r);
+  y = _mm256_add_ps(y, _mm256_set1_ps(1.0f));
+  __m256i n = _mm256_cvttps_epi32(fx);
+  __m256i n1 = _mm256_srai_epi32(n, 1);
+  __m256i n2 = _mm256_sub_epi32(n, n1);
+  __m256i bias = _mm256_set1_epi32(127);
+  n1 = _mm256_slli_epi32(_mm256_add_epi32(n1, bias), 23);
+  n2 = _mm256_slli_epi32(_mm256_add_epi32(n2, bias), 23);
+  y = _mm256_mul_ps(y, _mm256_castsi256_ps(n1));
+  return _mm256_mul_ps(y, _mm256_castsi256_ps(n2));
+}
+#endif
+
+/// @brief 快速指数函数（Fast exponential function）
+/// @param x 输入（input）
+/// @param y 输出（output）
+/// @param n 元素个数（number of elements）
+void FastExp(const float *x, float *y, int n) {
+  int i = 0;
+#if defined(__AVX2__) && defined(__FMA__)
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(y + i, Exp8(_mm256_loadu_ps(x + i)));
+  }
+#endif
+  for (; i < n; ++i) {
+    y[i] = ExpScalar(x[i]);
+  }
+}
+
+/// @brief 快速sigmoid函数（Fast sigmoid function）
+/// @param x 输入（input）
+/// @param y 输出（output）
+/// @param n 元素个数（number of elements）
+void FastSigmoid(const float *x, float *y, int n) {
+  int i = 0;
+#if defined(__AVX2__) && defined(__FMA__)
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 sign = _mm256_set1_ps(-0.0f);
+  __m256 e;
+  for (; i + 8 <= n; i += 8) {
+    e = Exp8(_mm256_xor_ps(_mm256_loadu_ps(x + i), sign));
+    _mm256_storeu_ps(y + i, _mm256_div_ps(one, _mm256_add_ps(one, e)));
+  }
+#endif
+  for (; i < n; ++i) {
+    y[i] = 1.0f / (1.0f + ExpScalar(-x[i]));
+  }
+}
+
+/// @brief 快速双曲正切函数（Fast hyperbolic tangent function）
+/// @param x 输入（input）
+/// @param y 输出（output）
+/// @param n 元素个数（number of elements）
+/// @remark |x| < 0.625 时使用奇多项式，避免 1 - 2/(e^2x + 1) 的相消误差。
+///         An odd polynomial is used for |x| < 0.625 to avoid the
+///         cancellation error of 1 - 2/(e^2x + 1).
+void FastTanh(const float *x, float *y, int n) {
+  int i = 0;
+#if defined(__AVX2__) && defined(__FMA__)
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 two = _mm256_set1_ps(2.0f);
+  const __m256 sign = _mm256_set1_ps(-0.0f);
+  __m256 v, a, z, p, small, large, mask;
+  for (; i + 8 <= n; i += 8) {
+    v = _mm256_loadu_ps(x + i);
+    a = _mm256_andnot_ps(sign, v);
+    z = _mm256_mul_ps(v, v);
+    p = _mm256_set1_ps(kTanhP0);
+    p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(kTanhP1));
+    p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(kTanhP2));
+    p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(kTanhP3));
+    p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(kTanhP4));
+    small = _mm256_fmadd_ps(_mm256_mul_ps(p, z), v, v);
+    large = Exp8(_mm256_mul_ps(two, a));
+    large = _mm256_sub_ps(one, _mm256_div_ps(two, _mm256_add_ps(large, one)));
+    large = _mm256_or_ps(large, _mm256_and_ps(sign, v));
+    mask = _mm256_cmp_ps(a, _mm256_set1_ps(kTanhSmall), _CMP_LT_OQ);
+    _mm256_storeu_ps(y + i, _mm256_blendv_ps(large, small, mask));
+  }
+#endif
+  for (; i < n; ++i) {
+    y[i] = TanhScalar(x[i]);
+  }
+}
@@ -0,0 +1,35 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_KERNELS_FAST_MATH_H_
+#define MOUNTAIN_LAKE_KERNELS_FAST_MATH_H_
+
+// 快速数学函数（Fast math functions）
+//
+// 使用AVX2/FMA指令手工向量化的多项式近似，每次处理8个float，不足8个的尾部使用
+// 同样算法的标量版本，所以结果与数据长度无关。误差相对于双精度的精确值：
+// Hand-vectorized polynomial approximations using AVX2/FMA instructions, 8
+// floats at a time. The tail that does not fill 8 lanes uses a scalar version
+// of the same algorithm, so results do not depend on the data length. Errors
+// relative to the exact double-precision value:
+//
+//   FastExp      最大相对误差 < 1e-7（约1 ulp），结果为正规数时成立；
+//                结果小于FLT_MIN时逐渐下溢，x > 88.72返回inf。
+//                max relative error < 1e-7 (about 1 ulp) for normal results;
+//                results below FLT_MIN underflow gradually and x > 88.72
+//                returns inf.
+//   FastSigmoid  最大相对误差 < 2e-7（约2 ulp），结果为正规数时成立。
+//                max relative error < 2e-7 (about 2 ulp) for normal results.
+//   FastTanh     最大相对误差 < 2e-7（约2 ulp）。
+//                max relative error < 2e-7 (about 2 ulp).
+//
+// 输入与输出可以是同一个数组。NaN会原样传播。
+// Input and output may be the same array. NaN is propagated.
+
+void FastExp(const float *x, float *y, int n);
+void FastSigmoid(const float *x, float *y, int n);
+void FastTanh(const float *x, float *y, int n);
+
+#endif  // MOUNTAIN_LAKE_KERNELS_FAST_MATH_H_
@@ -0,0 +1,654 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "gemm.h"
+
+#include <mountain_lake/parallel/thread_pool.h>
+
+#include <algorithm>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+// 每次参与计算的k的长度与左操作数的行数，使左操作数的一块留在二级缓存中，
+// 右操作数的一条留在一级缓存中
+// Length of k and rows of the left operand per block, so a block of the left
+// operand stays in the L2 cache and a panel of the right operand in L1.
+static const int kGemmKC = 256;
+static const int kGemmMC = 128;
+// 右操作数不超过这么多列时左操作数不打包，微内核直接读取
+// With no more right operand columns than this, the left operand is not
+// packed and the microkernel reads it directly.
+static const int kGemmSmallN = 16;
+// 左操作数少于这么多行时不使用微内核，按行计算，避免补齐到kGemmMR行
+// With fewer left operand rows than this, rows are computed one by one
+// instead of by the microkernel, which would pad them to kGemmMR rows.
+static const int kGemmSmallM = 8;
+// 左操作数不超过这么多行时右操作数不打包，打包的开销大于重复使用的收益
+// With no more left operand rows than this, the right operand is not packed,
+// packing costs more than it saves over so few reuses.
+static const int kGemmDirectM = 48;
+
+/// @brief 微内核，计算kGemmMR x kGemmNR的输出块（Microkernel computing a
+///        kGemmMR x kGemmNR output tile）
+/// @param kc k的长度（length of k）
+/// @param a 左操作数，每个k有kGemmMR个连续的值（left operand, kGemmMR
+///        contiguous values per k）
+/// @param as 相邻两个k在a中的距离（distance between two k in a）
+/// @param b 打包后的右操作数竖条（packed right operand panel）
+/// @param c 输出块的左上角，列优先（top left of the output tile,
+///        column-major）
+/// @param ldc c的列距（column stride of c）
+/// @param mr 有效行数（valid rows）
+/// @param nr 有效列数（valid columns）
+/// @param accumulate 是否加到c上（whether to add to c）
+/// @remark 12个累加寄存器保存整个输出块，每个k读取2个向量、广播6个值，做12次
+///         FMA。块不完整时先写入临时数组再复制有效部分。
+///         Twelve accumulator registers hold the whole tile, every k loads 2
+///         vectors, broadcasts 6 values and does 12 FMAs. Partial tiles are
+///         written to a temporary array first and only the valid part is
+///         copied.
+static void Kernel(int kc, const float *a, long as, const float *b, long bs,
+                   long bc, float *c, long ldc, int mr, int nr,
+                   bool accumulate) {
+  alignas(32) float t[kGemmNR][kGemmMR];
+#if defined(__AVX2__) && defined(__FMA__)
+  // 累加器用单独的变量，放在数组中时编译器每一步都会写回内存
+  // Separate variables for the accumulators, in an array the compiler writes
+  // them back to memory at every step.
+  __m256 c00 = _mm256_setzero_ps(), c10 = _mm256_setzero_ps();
+  __m256 c01 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+  __m256 c02 = _mm256_setzero_ps(), c12 = _mm256_setzero_ps();
+  __m256 c03 = _mm256_setzero_ps(), c13 = _mm256_setzero_ps();
+  __m256 c04 = _mm256_setzero_ps(), c14 = _mm256_setzero_ps();
+  __m256 c05 = _mm256_setzero_ps(), c15 = _mm256_setzero_ps();
+  const float *b3 = b + 3 * bc;
+  for (int p = 0; p < kc; ++p) {
+    __m256 a0 = _mm256_loadu_ps(a);
+    __m256 a1 = _mm256_loadu_ps(a + 8);
+    __m256 bj = _mm256_broadcast_ss(b);
+    c00 = _mm256_fmadd_ps(a0, bj, c00);
+    c10 = _mm256_fmadd_ps(a1, bj, c10);
+    bj = _mm256_broadcast_ss(b + bc);
+    c01 = _mm256_fmadd_ps(a0, bj, c01);
+    c11 = _mm256_fmadd_ps(a1, bj, c11);
+    bj = _mm256_broadcast_ss(b + 2 * bc);
+    c02 = _mm256_fmadd_ps(a0, bj, c02);
+    c12 = _mm256_fmadd_ps(a1, bj, c12);
+    bj = _mm256_broadcast_ss(b3);
+    c03 = _mm256_fmadd_ps(a0, bj, c03);
+    c13 = _mm256_fmadd_ps(a1, bj, c13);
+    bj = _mm256_broadcast_ss(b3 + bc);
+    c04 = _mm256_fmadd_ps(a0, bj, c04);
+    c14 = _mm256_fmadd_ps(a1, bj, c14);
+    bj = _mm256_broadcast_ss(b3 + 2 * bc);
+    c05 = _mm256_fmadd_ps(a0, bj, c05);
+    c15 = _mm256_fmadd_ps(a1, bj, c15);
+    a += as;
+    b += bs;
+    b3 += bs;
+  }
+  _mm256_store_ps(t[0], c00);
+  _mm256_store_ps(t[0] + 8, c10);
+  _mm256_store_ps(t[1], c01);
+  _mm256_store_ps(t[1] + 8, c11);
+  _mm256_store_ps(t[2], c02);
+  _mm256_store_ps(t[2] + 8, c12);
+  _mm256_store_ps(t[3], c03);
+  _mm256_store_ps(t[3] + 8, c13);
+  _mm256_store_ps(t[4], c04);
+  _mm256_store_ps(t[4] + 8, c14);
+  _mm256_store_ps(t[5], c05);
+  _mm256_store_ps(t[5] + 8, c15);
+  if (mr == kGemmMR && nr == kGemmNR) {
+    for (int j = 0; j < kGemmNR; ++j) {
+      float *cj = c + j * ldc;
+      __m256 v0 = _mm256_load_ps(t[j]);
+      __m256 v1 = _mm256_load_ps(t[j] + 8);
+      if (accumulate) {
+        v0 = _mm256_add_ps(v0, _mm256_loadu_ps(cj));
+        v1 = _mm256_add_ps(v1, _mm256_loadu_ps(cj + 8));
+      }
+      _mm256_storeu_ps(cj, v0);
+      _mm256_storeu_ps(cj + 8, v1);
+    }
+    return;
+  }
+#else
+  for (int j = 0; j < kGemmNR; ++j) {
+    for (int i = 0; i < kGemmMR; ++i) t[j][i] = 0.0f;
+  }
+  for (int p = 0; p < kc; ++p) {
+    for (int j = 0; j < kGemmNR; ++j) {
+      for (int i = 0; i < kGemmMR; ++i) t[j][i] += a[i] * b[j * bc];
+    }
+    a += as;
+    b += bs;
+  }
+#endif
+  for (int j = 0; j < nr; ++j) {
+    float *cj = c + j * ldc;
+    for (int i = 0; i < mr; ++i) cj[i] = accumulate ? cj[i] + t[j][i] : t[j][i];
+  }
+}
+
+#if defined(__AVX2__) && defined(__FMA__)
+/// @brief 转置8x8的块（Transpose an 8x8 block）
+/// @param src 第r行从src + r * lds开始（row r starts at src + r * lds）
+/// @param dst 第r行写到dst + r * ldd（row r is written to dst + r * ldd）
+static inline void Transpose8x8(const float *src, long lds, float *dst,
+                                long ldd) {
+  __m256 r0 = _mm256_loadu_ps(src);
+  __m256 r1 = _mm256_loadu_ps(src + lds);
+  __m256 r2 = _mm256_loadu_ps(src + 2 * lds);
+  __m256 r3 = _mm256_loadu_ps(src + 3 * lds);
+  __m256 r4 = _mm256_loadu_ps(src + 4 * lds);
+  __m256 r5 = _mm256_loadu_ps(src + 5 * lds);
+  __m256 r6 = _mm256_loadu_ps(src + 6 * lds);
+  __m256 r7 = _mm256_loadu_ps(src + 7 * lds);
+  __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+  __m256 t1 = _mm256_unpackhi_ps(r0, r1);
+  __m256 t2 = _mm256_unpacklo_ps(r2, r3);
+  __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+  __m256 t4 = _mm256_unpacklo_ps(r4, r5);
+  __m256 t5 = _mm256_unpackhi_ps(r4, r5);
+  __m256 t6 = _mm256_unpacklo_ps(r6, r7);
+  __m256 t7 = _mm256_unpackhi_ps(r6, r7);
+  r0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+  r1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+  r2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+  r3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+  r4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+  r5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+  r6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+  r7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+  _mm256_storeu_ps(dst, _mm256_permute2f128_ps(r0, r4, 0x20));
+  _mm256_storeu_ps(dst + ldd, _mm256_permute2f128_ps(r1, r5, 0x20));
+  _mm256_storeu_ps(dst + 2 * ldd, _mm256_permute2f128_ps(r2, r6, 0x20));
+  _mm256_storeu_ps(dst + 3 * ldd, _mm256_permute2f128_ps(r3, r7, 0x20));
+  _mm256_storeu_ps(dst + 4 * ldd, _mm256_permute2f128_ps(r0, r4, 0x31));
+  _mm256_storeu_ps(dst + 5 * ldd, _mm256_permute2f128_ps(r1, r5, 0x31));
+  _mm256_storeu_ps(dst + 6 * ldd, _mm256_permute2f128_ps(r2, r6, 0x31));
+  _mm256_storeu_ps(dst + 7 * ldd, _mm256_permute2f128_ps(r3, r7, 0x31));
+}
+#endif
+
+/// @brief 打包右操作数的一块（Pack a block of the right operand）
+/// @param b 右操作数，元素(p, j)为b[p * rs + j * cs]（right operand, element
+///        (p, j) is b[p * rs + j * cs]）
+/// @param kc 行数（rows）
+/// @param n 列数（columns）
+/// @param out 打包结果，每条kc x kGemmNR（packed result, kc x kGemmNR per
+///        panel）
+/// @remark 不转置的右操作数每列的k是连续的，后面至少还有8列时按8x8的块转置。
+///         每行多写的2个值属于下一行，之后会被覆盖。
+///         An untransposed right operand has contiguous k within each
+///         column, so while at least 8 columns remain it is written through
+///         8x8 block transposes. The 2 extra values written per row belong
+///         to the next row and are overwritten later.
+static void PackB(const float *b, long rs, long cs, int kc, int n,
+                  float *out) {
+  for (int j0 = 0; j0 < n; j0 += kGemmNR) {
+    int nr = std::min(kGemmNR, n - j0);
+    int p = 0;
+#if defined(__AVX2__) && defined(__FMA__)
+    if (rs == 1 && j0 + 8 <= n) {
+      for (; p + 8 <= kc; p += 8) {
+        Transpose8x8(b + p + j0 * cs, cs, out + p * kGemmNR, kGemmNR);
+      }
+    }
+#endif
+    for (; p < kc; ++p) {
+      const float *bp = b + p * rs + j0 * cs;
+      float *op = out + p * kGemmNR;
+      int j = 0;
+      for (; j < nr; ++j) op[j] = bp[j * cs];
+      for (; j < kGemmNR; ++j) op[j] = 0.0f;
+    }
+    out += kc * kGemmNR;
+  }
+}
+
+/// @brief 打包左操作数的一块（Pack a block of the left operand）
+/// @param a 左操作数，元素(i, p)为a[i * rs + p * cs]（left operand, element
+///        (i, p) is a[i * rs + p * cs]）
+/// @param mc 行数（rows）
+/// @param kc 列数（columns）
+/// @param out 打包结果，每条kGemmMR x kc（packed result, kGemmMR x kc per
+///        panel）
+/// @remark 转置的左操作数每行的k是连续的，按8x8的块转置后写入，不再逐个收集。
+///         A transposed left operand has contiguous k within each row, so it
+///         is written through 8x8 block transposes instead of being gathered
+///         element by element.
+static void PackA(const float *a, long rs, long cs, int mc, int kc,
+                  float *out) {
+  for (int i0 = 0; i0 < mc; i0 += kGemmMR) {
+    int mr = std::min(kGemmMR, mc - i0);
+    const float *ai = a + i0 * rs;
+    int p = 0;
+#if defined(__AVX2__) && defined(__FMA__)
+    if (cs == 1 && mr == kGemmMR) {
+      for (; p + 8 <= kc; p += 8) {
+        Transpose8x8(ai + p, rs, out + p * kGemmMR, kGemmMR);
+        Transpose8x8(ai + 8 * rs + p, rs, out + p * kGemmMR + 8, kGemmMR);
+      }
+    }
+#endif
+    for (; p < kc; ++p) {
+      float *op = out + p * kGemmMR;
+      const float *ap = ai + p * cs;
+      int i = 0;
+      for (; i < mr; ++i) op[i] = ap[i * rs];
+      for (; i < kGemmMR; ++i) op[i] = 0.0f;
+    }
+    out += kc * kGemmMR;
+  }
+}
+
+#if defined(__AVX2__) && defined(__FMA__)
+/// @brief 向量中8个值之和（Sum of the 8 values of a vector）
+static inline float HorizontalSum(__m256 v) {
+  __m128 x = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  x = _mm_add_ps(x, _mm_movehl_ps(x, x));
+  x = _mm_add_ss(x, _mm_movehdup_ps(x));
+  return _mm_cvtss_f32(x);
+}
+#endif
+
+/// @brief 一行乘以连续的4列，B的列是连续的（One row times 4 contiguous
+///        columns, the columns of B are contiguous）
+/// @param a 连续的一行（one contiguous row）
+/// @param b 第一列（first column）
+/// @param ldb 列距（column stride）
+/// @param out 4个结果（4 results）
+static void DotRow4(int k, const float *a, const float *b, long ldb,
+                    float *out) {
+  const float *b0 = b;
+  const float *b1 = b + ldb;
+  const float *b2 = b + 2 * ldb;
+  const float *b3 = b + 3 * ldb;
+  int p = 0;
+#if defined(__AVX2__) && defined(__FMA__)
+  __m256 s0 = _mm256_setzero_ps();
+  __m256 s1 = _mm256_setzero_ps();
+  __m256 s2 = _mm256_setzero_ps();
+  __m256 s3 = _mm256_setzero_ps();
+  for (; p + 8 <= k; p += 8) {
+    __m256 ap = _mm256_loadu_ps(a + p);
+    s0 = _mm256_fmadd_ps(ap, _mm256_loadu_ps(b0 + p), s0);
+    s1 = _mm256_fmadd_ps(ap, _mm256_loadu_ps(b1 + p), s1);
+    s2 = _mm256_fmadd_ps(ap, _mm256_loadu_ps(b2 + p), s2);
+    s3 = _mm256_fmadd_ps(ap, _mm256_loadu_ps(b3 + p), s3);
+  }
+  out[0] = HorizontalSum(s0);
+  out[1] = HorizontalSum(s1);
+  out[2] = HorizontalSum(s2);
+  out[3] = HorizontalSum(s3);
+#else
+  out[0] = out[1] = out[2] = out[3] = 0.0f;
+#endif
+  for (; p < k; ++p) {
+    out[0] += a[p] * b0[p];
+    out[1] += a[p] * b1[p];
+    out[2] += a[p] * b2[p];
+    out[3] += a[p] * b3[p];
+  }
+}
+
+/// @brief 左操作数行数很少时的矩阵乘法（Matrix multiplication for a left
+///        operand with very few rows）
+/// @remark 左操作数的每一行先复制为连续的数据。右操作数已经打包时按条连续
+///         读取；列连续时每次算4列的点积；行连续时按行累加，每次算64列。
+///         Every row of the left operand is first made contiguous. A packed
+///         right operand is read panel by panel in order; with contiguous
+///         columns 4 dot products are computed at a time; with contiguous
+///         rows the rows are accumulated 64 columns at a time.
+static void GemmSmallM(int m, int n, int k, const float *a, long rs_a,
+                       long cs_a, const float *b, long rs_b, long cs_b,
+                       const PackedMatrix *packed, float *c, long ldc,
+                       bool accumulate) {
+  vector<float> rows;
+  const float *ar = a;
+  long lda = rs_a;
+  if (cs_a != 1) {
+    rows.resize(static_cast<size_t>(m) * k);
+    for (int i = 0; i < m; ++i) {
+      for (int p = 0; p < k; ++p) rows[i * k + p] = a[i * rs_a + p * cs_a];
+    }
+    ar = rows.data();
+    lda = k;
+  }
+  auto store = [&](int i, int j, float v) {
+    float &cij = c[i + j * ldc];
+    cij = accumulate ? cij + v : v;
+  };
+  if (packed != nullptr) {
+    int n_panels = (n + kGemmNR - 1) / kGemmNR;
+    ThreadPool::Global().ParallelFor(
+        0, n_panels, std::max(1L, 16384L / k), [&](long first, long last) {
+          for (long q = first; q < last; ++q) {
+            const float *panel = packed->data.data() + q * k * kGemmNR;
+            int nr = std::min(kGemmNR, n - (int)q * kGemmNR);
+            for (int i = 0; i < m; ++i) {
+              const float *ai = ar + i * lda;
+              float t[kGemmNR] = {};
+#if defined(__AVX2__) && defined(__FMA__)
+              // 4个k的一行连续占24个值，用3个向量乘以重复6次的a[p]，
+              // 最后把下标模6相同的值加在一起
+              // The rows of 4 k take 24 contiguous values, which are
+              // multiplied as 3 vectors by a[p] repeated 6 times, and values
+              // whose index is equal modulo 6 are summed at the end.
+              const __m256i i0 = _mm256_setr_epi32(0, 0, 0, 0, 0, 0, 1, 1);
+              const __m256i i1 = _mm256_setr_epi32(1, 1, 1, 1, 2, 2, 2, 2);
+              const __m256i i2 = _mm256_setr_epi32(2, 2, 3, 3, 3, 3, 3, 3);
+              __m256 s0 = _mm256_setzero_ps();
+              __m256 s1 = _mm256_setzero_ps();
+              __m256 s2 = _mm256_setzero_ps();
+              __m256 s3 = _mm256_setzero_ps();
+              __m256 s4 = _mm256_setzero_ps();
+              __m256 s5 = _mm256_setzero_ps();
+              int p = 0;
+              for (; p + 8 <= k; p += 8) {
+                const float *bp = panel + p * kGemmNR;
+                __m256 x = _mm256_broadcast_ps(
+                    reinterpret_cast<const __m128 *>(ai + p));
+                __m256 y = _mm256_broadcast_ps(
+                    reinterpret_cast<const __m128 *>(ai + p + 4));
+                s0 = _mm256_fmadd_ps(_mm256_permutevar8x32_ps(x, i0),
+                                     _mm256_loadu_ps(bp), s0);
+                s1 = _mm256_fmadd_ps(_mm256_permutevar8x32_ps(x, i1),
+                                     _mm256_loadu_ps(bp + 8), s1);
+                s2 = _mm256_fmadd_ps(_mm256_permutevar8x32_ps(x, i2),
+                                     _mm256_loadu_ps(bp + 16), s2);
+                s3 = _mm256_fmadd_ps(_mm256_permutevar8x32_ps(y, i0),
+                                     _mm256_loadu_ps(bp + 24), s3);
+                s4 = _mm256_fmadd_ps(_mm256_permutevar8x32_ps(y, i1),
+                                     _mm256_loadu_ps(bp + 32), s4);
+                s5 = _mm256_fmadd_ps(_mm256_permutevar8x32_ps(y, i2),
+                                     _mm256_loadu_ps(bp + 40), s5);
+              }
+              alignas(32) float u[24];
+              _mm256_store_ps(u, _mm256_add_ps(s0, s3));
+              _mm256_store_ps(u + 8, _mm256_add_ps(s1, s4));
+              _mm256_store_ps(u + 16, _mm256_add_ps(s2, s5));
+              for (int j = 0; j < kGemmNR; ++j) {
+                t[j] = (u[j] + u[j + 6]) + (u[j + 12] + u[j + 18]);
+              }
+              for (; p < k; ++p) {
+                for (int j = 0; j < kGemmNR; ++j) {
+                  t[j] += ai[p] * panel[p * kGemmNR + j];
+                }
+              }
+#else
+              for (int p = 0; p < k; ++p) {
+                for (int j = 0; j < kGemmNR; ++j) {
+                  t[j] += ai[p] * panel[p * kGemmNR + j];
+                }
+              }
+#endif
+              for (int j = 0; j < nr; ++j) store(i, q * kGemmNR + j, t[j]);
+            }
+          }
+        });
+    return;
+  }
+  if (rs_b == 1) {
+    // 列连续（contiguous columns）
+    int groups = (n + 3) / 4;
+    ThreadPool::Global().ParallelFor(
+        0, groups, std::max(1L, 16384L / k), [&](long first, long last) {
+          float t[4];
+          for (long g = first; g < last; ++g) {
+            int j = g * 4;
+            for (int i = 0; i < m; ++i) {
+              const float *ai = ar + i * lda;
+              if (j + 4 <= n) {
+                DotRow4(k, ai, b + j * cs_b, cs_b, t);
+                for (int v = 0; v < 4; ++v) store(i, j + v, t[v]);
+                continue;
+              }
+              for (int jj = j; jj < n; ++jj) {
+                float sum = 0.0f;
+                for (int p = 0; p < k; ++p) sum += ai[p] * b[p + jj * cs_b];
+                store(i, jj, sum);
+              }
+            }
+          }
+        });
+    return;
+  }
+  // 行连续（contiguous rows）
+  int groups = (n + 63) / 64;
+  ThreadPool::Global().ParallelFor(
+      0, groups, std::max(1L, 2048L / k), [&](long first, long last) {
+        alignas(32) float t[64];
+        for (long g = first; g < last; ++g) {
+          int j0 = g * 64;
+          int nc = std::min(64, n - j0);
+          for (int i = 0; i < m; ++i) {
+            const float *ai = ar + i * lda;
+            int j = 0;
+#if defined(__AVX2__) && defined(__FMA__)
+            if (nc == 64) {
+              // 8个累加器，每个k的8次FMA互不依赖
+              // Eight accumulators, so the 8 FMAs of every k are independent.
+              __m256 s0 = _mm256_setzero_ps(), s4 = _mm256_setzero_ps();
+              __m256 s1 = _mm256_setzero_ps(), s5 = _mm256_setzero_ps();
+              __m256 s2 = _mm256_setzero_ps(), s6 = _mm256_setzero_ps();
+              __m256 s3 = _mm256_setzero_ps(), s7 = _mm256_setzero_ps();
+              for (int p = 0; p < k; ++p) {
+                const float *bp = b + p * rs_b + j0;
+                __m256 ap = _mm256_broadcast_ss(ai + p);
+                s0 = _mm256_fmadd_ps(ap, _mm256_loadu_ps(bp), s0);
+                s1 = _mm256_fmadd_ps(ap, _mm256_loadu_ps(bp + 8), s1);
+                s2 = _mm256_fmadd_ps(ap, _mm256_loadu_ps(bp + 16), s2);
+                s3 = _mm256_fmadd_ps(ap, _mm256_loadu_ps(bp + 24), s3);
+                s4 = _mm256_fmadd_ps(ap, _mm256_loadu_ps(bp + 32), s4);
+                s5 = _mm256_fmadd_ps(ap, _mm256_loadu_ps(bp + 40), s5);
+                s6 = _mm256_fmadd_ps(ap, _mm256_loadu_ps(bp + 48), s6);
+                s7 = _mm256_fmadd_ps(ap, _mm256_loadu_ps(bp + 56), s7);
+              }
+              _mm256_store_ps(t, s0);
+              _mm256_store_ps(t + 8, s1);
+              _mm256_store_ps(t + 16, s2);
+              _mm256_store_ps(t + 24, s3);
+              _mm256_store_ps(t + 32, s4);
+              _mm256_store_ps(t + 40, s5);
+              _mm256_store_ps(t + 48, s6);
+              _mm256_store_ps(t + 56, s7);
+              j = 64;
+            }
+#endif
+            for (; j < nc; ++j) {
+              float sum = 0.0f;
+              for (int p = 0; p < k; ++p) sum += ai[p] * b[p * rs_b + j0 + j];
+              t[j] = sum;
+            }
+            for (j = 0; j < nc; ++j) store(i, j0 + j, t[j]);
+          }
+        }
+      });
+}
+
+/// @brief 通用矩阵乘法的主体（Body of the general matrix multiplication）
+/// @param packed 预先打包的右操作数，为空指针时在这里打包（pre-packed right
+///        operand, packed here when it is a null pointer）
+/// @remark 按k分块，每块中先打包右操作数，再按行分块打包左操作数，输出块由
+///         线程池并行计算。右操作数不超过kGemmSmallN列、左操作数不转置时，
+///         左操作数的完整行块不打包。
+///         Blocked over k, each block packs the right operand, then packs the
+///         left operand block by block of rows, and the output tiles are
+///         computed in parallel by the thread pool. With at most
+///         kGemmSmallN right operand columns and an untransposed left
+///         operand, full row blocks of the left operand are not packed.
+static void GemmCore(int m, int n, int k, const float *a, long rs_a,
+                     long cs_a, const float *b, long rs_b, long cs_b,
+                     const PackedMatrix *packed, float *c, long ldc,
+                     bool accumulate) {
+  if (m < kGemmSmallM) {
+    GemmSmallM(m, n, k, a, rs_a, cs_a, b, rs_b, cs_b, packed, c, ldc,
+               accumulate);
+    return;
+  }
+  int n_panels = (n + kGemmNR - 1) / kGemmNR;
+  bool direct = rs_a == 1 && n <= kGemmSmallN;
+  // 直接读取右操作数时只打包最后不完整的一条（only the last partial panel
+  // is packed when the right operand is read directly）
+  bool direct_b = packed == nullptr && m <= kGemmDirectM;
+  int n_full = direct_b ? n / kGemmNR * kGemmNR : 0;
+  vector<float> b_buffer;
+  vector<float> a_buffer;
+  if (packed == nullptr) {
+    int panels = direct_b ? (n_full < n ? 1 : 0) : n_panels;
+    b_buffer.resize(static_cast<size_t>(panels) * std::min(k, kGemmKC) *
+                    kGemmNR);
+  }
+  // 直接读取左操作数时最多打包一个不完整的行块
+  // At most one partial row block is packed when reading the left operand
+  // directly.
+  // 完整的行块大小是kGemmMR的倍数，只有最后一个行块可能不完整（full row
+  // blocks are multiples of kGemmMR, only the last one may be partial）
+  int a_rows = std::min(m, kGemmMC);
+  if (direct) a_rows = m % kGemmMR == 0 ? 0 : kGemmMR;
+  a_rows = (a_rows + kGemmMR - 1) / kGemmMR * kGemmMR;
+  a_buffer.resize(static_cast<size_t>(a_rows) * std::min(k, kGemmKC));
+  for (int pc = 0; pc < k; pc += kGemmKC) {
+    int kc = std::min(kGemmKC, k - pc);
+    bool acc = accumulate || pc > 0;
+    const float *pb = nullptr;
+    long panel = 0;  // 相邻两条的距离（distance between two panels）
+    if (packed != nullptr) {
+      pb = packed->data.data() + static_cast<long>(pc) * kGemmNR;
+      panel = static_cast<long>(k) * kGemmNR;
+    } else {
+      PackB(b + pc * rs_b + n_full * cs_b, rs_b, cs_b, kc, n - n_full,
+            b_buffer.data());
+      pb = b_buffer.data() - static_cast<long>(n_full) / kGemmNR * kc *
+                                 kGemmNR;
+      panel = static_cast<long>(kc) * kGemmNR;
+    }
+    for (int ic = 0; ic < m; ic += kGemmMC) {
+      int mc = std::min(kGemmMC, m - ic);
+      const float *block = a + ic * rs_a + pc * cs_a;
+      // 直接读取时只打包最后不完整的行块（only the last partial row block
+      // is packed when reading directly）
+      int full = direct ? mc / kGemmMR * kGemmMR : 0;
+      if (full < mc) {
+        PackA(block + full * rs_a, rs_a, cs_a, mc - full, kc,
+              a_buffer.data());
+      }
+      int m_panels = (mc + kGemmMR - 1) / kGemmMR;
+      long tasks = static_cast<long>(m_panels) * n_panels;
+      long work = static_cast<long>(kGemmMR) * kGemmNR * kc;
+      ThreadPool::Global().ParallelFor(
+          0, tasks, std::max(1L, 65536 / work), [&](long first, long last) {
+            for (long t = first; t < last; ++t) {
+              int qn = t / m_panels;
+              int qm = t % m_panels;
+              int i = qm * kGemmMR;
+              int j = qn * kGemmNR;
+              const float *pa = nullptr;
+              long as = kGemmMR;
+              if (i < full) {
+                pa = block + i;
+                as = cs_a;
+              } else {
+                pa = a_buffer.data() + static_cast<long>(i - full) / kGemmMR *
+                                           kc * kGemmMR;
+              }
+              const float *pj = pb + qn * panel;
+              long bs = kGemmNR;
+              long bc = 1;
+              if (j < n_full) {
+                pj = b + pc * rs_b + j * cs_b;
+                bs = rs_b;
+                bc = cs_b;
+              }
+              Kernel(kc, pa, as, pj, bs, bc, c + (ic + i) + j * ldc, ldc,
+                     std::min(kGemmMR, mc - i), std::min(kGemmNR, n - j),
+                     acc);
+            }
+          });
+    }
+  }
+}
+
+/// @brief 通用矩阵乘法，C = op(A) * op(B)（General matrix multiplication）
+/// @param m op(A)与C的行数（rows of op(A) and C）
+/// @param n op(B)与C的列数（columns of op(B) and C）
+/// @param k op(A)的列数（columns of op(A)）
+/// @param a 列优先的A（column-major A）
+/// @param lda A的列距（column stride of A）
+/// @param trans_a 是否转置A（whether A is transposed）
+/// @param b 列优先的B（column-major B）
+/// @param ldb B的列距（column stride of B）
+/// @param trans_b 是否转置B（whether B is transposed）
+/// @param c 列优先的C，不能与A或B重叠（column-major C, must not overlap A or
+///        B）
+/// @param ldc C的列距（column stride of C）
+/// @param accumulate 为true时计算C += op(A) * op(B)（computes C += op(A) *
+///        op(B) when true）
+void Gemm(int m, int n, int k, const float *a, long lda, bool trans_a,
+          const float *b, long ldb, bool trans_b, float *c, long ldc,
+          bool accumulate) {
+  if (m <= 0 || n <= 0) return;
+  if (k <= 0) {
+    if (accumulate) return;
+    for (int j = 0; j < n; ++j) std::fill(c + j * ldc, c + j * ldc + m, 0.0f);
+    return;
+  }
+  GemmCore(m, n, k, a, trans_a ? lda : 1, trans_a ? 1 : lda, b,
+           trans_b ? ldb : 1, trans_b ? 1 : ldb, nullptr, c, ldc, accumulate);
+}
+
+/// @brief 矩阵形式的通用矩阵乘法（General matrix multiplication on matrices）
+/// @param A 左操作数，可以是矩阵的一块或映射（left operand, may be a block
+///        of a matrix or a map）
+/// @param trans_a 是否转置A（whether A is transposed）
+/// @param B 右操作数（right operand）
+/// @param trans_b 是否转置B（whether B is transposed）
+/// @param C 结果，不累加时调整为需要的大小（result, resized unless
+///        accumulating）
+/// @param accumulate 为true时计算C += op(A) * op(B)（computes C += op(A) *
+///        op(B) when true）
+void Gemm(const Ref<const MatrixXf> &A, bool trans_a,
+          const Ref<const MatrixXf> &B, bool trans_b, MatrixXf &C,
+          bool accumulate) {
+  int m = trans_a ? A.cols() : A.rows();
+  int k = trans_a ? A.rows() : A.cols();
+  int n = trans_b ? B.rows() : B.cols();
+  if (!accumulate) C.resize(m, n);
+  Gemm(m, n, k, A.data(), A.outerStride(), trans_a, B.data(), B.outerStride(),
+       trans_b, C.data(), C.rows(), accumulate);
+}
+
+/// @brief 打包右操作数（Pack a right operand）
+/// @param B 右操作数（right operand）
+/// @param P 打包结果（packed result）
+void PackMatrix(const Ref<const MatrixXf> &B, PackedMatrix &P) {
+  P.rows = B.rows();
+  P.cols = B.cols();
+  int n_panels = (P.cols + kGemmNR - 1) / kGemmNR;
+  P.data.assign(static_cast<size_t>(n_panels) * P.rows * kGemmNR, 0.0f);
+  PackB(B.data(), 1, B.outerStride(), P.rows, P.cols, P.data.data());
+}
+
+/// @brief 乘以预先打包的右操作数，C = A * B（Multiply by a pre-packed right
+///        operand）
+/// @param A 左操作数，列数与B的行数相同（left operand with as many columns
+///        as B has rows）
+/// @param B 打包后的右操作数（packed right operand）
+/// @param C 结果（result）
+void Gemm(const Ref<const MatrixXf> &A, const PackedMatrix &B, MatrixXf &C) {
+  C.resize(A.rows(), B.cols);
+  if (C.size() == 0) return;
+  if (B.rows == 0) {
+    C.setZero();
+    return;
+  }
+  GemmCore(A.rows(), B.cols, B.rows, A.data(), 1, A.outerStride(), nullptr, 0,
+           0, &B, C.data(), C.rows(), false);
+}
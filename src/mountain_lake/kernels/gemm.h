@@ -0,0 +1,44 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_KERNELS_GEMM_H_
+#define MOUNTAIN_LAKE_KERNELS_GEMM_H_
+
+#include <eigen3/Eigen/Dense>
+#include <vector>
+
+using Eigen::MatrixXf;
+using Eigen::Ref;
+using std::vector;
+
+// 微内核每次计算的输出块为kGemmMR行kGemmNR列
+// The microkernel computes an output tile of kGemmMR rows by kGemmNR columns.
+const int kGemmMR = 16;
+const int kGemmNR = 6;
+
+/// @brief 预先打包的右操作数（pre-packed right operand）
+/// @remark 按kGemmNR列一组切成竖条，每条中按k的顺序连续保存kGemmNR个值，
+///         最后一条不足时用0补齐。仿射变换层在更新权重后打包一次，之后每次
+///         正向传播都不再打包。
+///         Cut into panels of kGemmNR columns, each panel stores kGemmNR
+///         values per k contiguously, the last panel is padded with zeros.
+///         Affine layers pack their weights once after each update, so
+///         forward propagation never packs them again.
+struct PackedMatrix {
+  int rows = 0;
+  int cols = 0;
+  vector<float> data;
+};
+
+void Gemm(int m, int n, int k, const float *a, long lda, bool trans_a,
+          const float *b, long ldb, bool trans_b, float *c, long ldc,
+          bool accumulate);
+void Gemm(const Ref<const MatrixXf> &A, bool trans_a,
+          const Ref<const MatrixXf> &B, bool trans_b, MatrixXf &C,
+          bool accumulate = false);
+void PackMatrix(const Ref<const MatrixXf> &B, PackedMatrix &P);
+void Gemm(const Ref<const MatrixXf> &A, const PackedMatrix &B, MatrixXf &C);
+
+#endif  // MOUNTAIN_LAKE_KERNELS_GEMM_H_
@@ -0,0 +1,65 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "low_rank.h"
+
+#include <mountain_lake/kernels/gemm.h>
+#include <mountain_lake/kernels/philox.h>
+
+#include <algorithm>
+
+/// @brief 列正交化，结果的列张成与Y相同的空间（Orthonormalize the columns,
+///        the result spans the same space as Y）
+/// @param Y 输入，行数不少于列数（input with no fewer rows than columns）
+/// @param Q 正交的列（orthonormal columns）
+static void Orthonormalize(const MatrixXf &Y, MatrixXf &Q) {
+  Eigen::HouseholderQR<MatrixXf> qr(Y);
+  Q = qr.householderQ() * MatrixXf::Identity(Y.rows(), Y.cols());
+}
+
+/// @brief 随机截断奇异值分解，A ≈ U * diag(S) * V^T（Randomized truncated
+///        singular value decomposition, A ≈ U * diag(S) * V^T）
+/// @param A 被分解的矩阵（matrix to factorize）
+/// @param rank 保留的秩，不超过A的行数与列数（rank kept, at most the rows and
+///        the columns of A）
+/// @param U 左奇异向量，rows x rank（left singular vectors, rows x rank）
+/// @param S 从大到小的奇异值（singular values in descending order）
+/// @param V 右奇异向量，cols x rank（right singular vectors, cols x rank）
+/// @param seed 随机投影的种子（seed of the random projection）
+/// @param stream 随机投影的流号（stream of the random projection）
+/// @remark 用rank+kSvdOversample列高斯随机矩阵投影出A的列空间，经过幂迭代
+///         后正交化为Q，再对小矩阵Q^T * A做完整的奇异值分解。大的乘法都用
+///         Gemm，只有小矩阵交给Eigen，不依赖LAPACK。多取的列数达到A的行数
+///         或列数时结果是精确的。
+///         The column space of A is sampled with a Gaussian random matrix of
+///         rank+kSvdOversample columns, refined by power iterations and
+///         orthonormalized into Q, and the small matrix Q^T * A gets a full
+///         singular value decomposition. The large products go through Gemm
+///         and only the small matrix is handed to Eigen, with no LAPACK. The
+///         result is exact once the sampled columns reach the rows or the
+///         columns of A.
+void TruncatedSvd(const Ref<const MatrixXf> &A, int rank, MatrixXf &U,
+                  VectorXf &S, MatrixXf &V, uint64_t seed, uint64_t stream) {
+  int m = A.rows();
+  int n = A.cols();
+  int l = std::min(rank + kSvdOversample, std::min(m, n));
+  MatrixXf omega(n, l);
+  PhiloxNormal(omega.data(), omega.size(), 0.0f, 1.0f, seed, stream);
+  MatrixXf Y, Z, Q;
+  Gemm(A, false, omega, false, Y);
+  Orthonormalize(Y, Q);
+  for (int q = 0; q < kSvdPowerIterations; ++q) {
+    Gemm(A, true, Q, false, Z);
+    Orthonormalize(Z, Q);
+    Gemm(A, false, Q, false, Y);
+    Orthonormalize(Y, Q);
+  }
+  MatrixXf B;
+  Gemm(Q, true, A, false, B);
+  Eigen::BDCSVD<MatrixXf> svd(B, Eigen::ComputeThinU | Eigen::ComputeThinV);
+  Gemm(Q, false, svd.matrixU().leftCols(rank), false, U);
+  S = svd.singularValues().head(rank);
+  V = svd.matrixV().leftCols(rank);
+}
@@ -0,0 +1,26 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_KERNELS_LOW_RANK_H_
+#define MOUNTAIN_LAKE_KERNELS_LOW_RANK_H_
+
+#include <cstdint>
+#include <eigen3/Eigen/Dense>
+
+using Eigen::MatrixXf;
+using Eigen::Ref;
+using Eigen::VectorXf;
+
+// 随机投影在秩之外多取的列数（columns sampled beyond the rank by the random
+// projection）
+const int kSvdOversample = 8;
+// 幂迭代的次数，奇异值衰减越慢需要越多（power iterations, more are needed
+// the slower the singular values decay）
+const int kSvdPowerIterations = 2;
+
+void TruncatedSvd(const Ref<const MatrixXf> &A, int rank, MatrixXf &U,
+                  VectorXf &S, MatrixXf &V, uint64_t seed, uint64_t stream);
+
+#endif  // MOUNTAIN_LAKE_KERNELS_LOW_RANK_H_
@@ -0,0 +1,239 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "philox.h"
+
+#include <cmath>
+
+#include <mountain_lake/parallel/thread_pool.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/// @brief Philox4x32的一轮（One round of Philox4x32）
+static inline void PhiloxRound(uint32_t c[4], const uint32_t k[2]) {
+  uint64_t p0 = static_cast<uint64_t>(0xD2511F53u) * c[0];
+  uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57u) * c[2];
+  uint32_t hi0 = p0 >> 32;
+  uint32_t lo0 = static_cast<uint32_t>(p0);
+  uint32_t hi1 = p1 >> 32;
+  uint32_t lo1 = static_cast<uint32_t>(p1);
+  c[0] = hi1 ^ c[1] ^ k[0];
+  c[1] = lo1;
+  c[2] = hi0 ^ c[3] ^ k[1];
+  c[3] = lo0;
+}
+
+/// @brief Philox4x32-10，由计数器和密钥生成4个32位随机数
+///        （Philox4x32-10, four 32-bit random numbers from a counter and a key）
+/// @param counter 计数器（counter）
+/// @param key 密钥（key）
+/// @param out 输出（output）
+void Philox4x32(const uint32_t counter[4], const uint32_t key[2],
+                uint32_t out[4]) {
+  uint32_t c[4] = {counter[0], counter[1], counter[2], counter[3]};
+  uint32_t k[2] = {key[0], key[1]};
+  for (int r = 0; r < 10; ++r) {
+    if (r > 0) {
+      k[0] += 0x9E3779B9u;
+      k[1] += 0xBB67AE85u;
+    }
+    PhiloxRound(c, k);
+  }
+  out[0] = c[0];
+  out[1] = c[1];
+  out[2] = c[2];
+  out[3] = c[3];
+}
+
+/// @brief 第block块的4个随机数（The four random numbers of block block）
+/// @remark 计数器的低64位为块号，高64位为流号，种子作为密钥。
+///         The low 64 bits of the counter are the block number, the high 64
+///         bits are the stream, and the seed is the key.
+static inline void PhiloxBlock(long block, uint64_t seed, uint64_t stream,
+                               uint32_t out[4]) {
+  uint32_t counter[4] = {static_cast<uint32_t>(block),
+                         static_cast<uint32_t>(static_cast<uint64_t>(block) >>
+                                               32),
+                         static_cast<uint32_t>(stream),
+                         static_cast<uint32_t>(stream >> 32)};
+  uint32_t key[2] = {static_cast<uint32_t>(seed),
+                     static_cast<uint32_t>(seed >> 32)};
+  Philox4x32(counter, key, out);
+}
+
+/// @brief 把32位随机数转换为(0, 1]之间的浮点数
+///        （Convert a 32-bit random number to a float in (0, 1]）
+static inline float ToUnit(uint32_t x) {
+  return (static_cast<float>(x >> 8) + 1.0f) * (1.0f / 16777216.0f);
+}
+
+/// @brief 并行生成均匀分布的随机数（Uniform random numbers in parallel）
+/// @param data 输出数组（output array）
+/// @param n 个数（count）
+/// @param low 下限（lower bound）
+/// @param high 上限（upper bound）
+/// @param seed 种子（seed）
+/// @param stream 流号，不同的流互不相关（stream, different streams are
+///        independent）
+void PhiloxUniform(float *data, long n, float low, float high, uint64_t seed,
+                   uint64_t stream) {
+  long blocks = (n + 3) / 4;
+  ThreadPool::Global().ParallelFor(0, blocks, 1024, [&](long first,
+                                                         long last) {
+    uint32_t out[4];
+    for (long b = first; b < last; ++b) {
+      PhiloxBlock(b, seed, stream, out);
+      for (int j = 0; j < 4 && b * 4 + j < n; ++j) {
+        data[b * 4 + j] = low + (high - low) * ToUnit(out[j]);
+      }
+    }
+  });
+}
+
+/// @brief 并行生成正态分布的随机数（Normal random numbers in parallel）
+/// @param data 输出数组（output array）
+/// @param n 个数（count）
+/// @param mean 均值（mean）
+/// @param stddev 标准差（standard deviation）
+/// @param seed 种子（seed）
+/// @param stream 流号，不同的流互不相关（stream, different streams are
+///        independent）
+/// @remark 每块的4个均匀随机数通过Box-Muller变换得到4个正态随机数。
+///         The four uniform numbers of each block give four normal numbers
+///         through the Box-Muller transform.
+void PhiloxNormal(float *data, long n, float mean, float stddev, uint64_t seed,
+                  uint64_t stream) {
+  const float two_pi = 6.283185307179586f;
+  long blocks = (n + 3) / 4;
+  ThreadPool::Global().ParallelFor(0, blocks, 1024, [&](long first,
+                                                         long last) {
+    uint32_t out[4];
+    float z[4];
+    for (long b = first; b < last; ++b) {
+      PhiloxBlock(b, seed, stream, out);
+      for (int j = 0; j < 4; j += 2) {
+        float r = std::sqrt(-2.0f * std::log(ToUnit(out[j])));
+        float t = two_pi * ToUnit(out[j + 1]);
+        z[j] = r * std::cos(t);
+        z[j + 1] = r * std::sin(t);
+      }
+      for (int j = 0; j < 4 && b * 4 + j < n; ++j) {
+        data[b * 4 + j] = mean + stddev * z[j];
+      }
+    }
+  });
+}
+
+/// @brief 32位随机数小于threshold的概率为p的阈值（Threshold below which a
+///        32-bit random number falls with probability p）
+/// @return 超过32位时表示总是为1（more than 32 bits means always 1）
+static inline uint64_t BernoulliThreshold(float p) {
+  if (p <= 0.0f) return 0;
+  if (p >= 1.0f) return 1ULL << 32;
+  return static_cast<uint64_t>(static_cast<double>(p) * 4294967296.0);
+}
+
+#if defined(__AVX2__)
+/// @brief 8个块同时计算Philox4x32-10，c[j]的第l个通道是第l块的第j个数
+///        （Philox4x32-10 of 8 blocks at once, lane l of c[j] is number j of
+///        block l）
+static inline void Philox8(__m256i c[4], uint32_t k0, uint32_t k1) {
+  const __m256i m0 = _mm256_set1_epi64x(0xD2511F53u);
+  const __m256i m1 = _mm256_set1_epi64x(0xCD9E8D57u);
+  for (int r = 0; r < 10; ++r) {
+    if (r > 0) {
+      k0 += 0x9E3779B9u;
+      k1 += 0xBB67AE85u;
+    }
+    // _mm256_mul_epu32只乘偶数通道，奇数通道先右移到偶数位置
+    // _mm256_mul_epu32 only multiplies the even lanes, so the odd lanes are
+    // shifted down first.
+    __m256i e0 = _mm256_mul_epu32(c[0], m0);
+    __m256i o0 = _mm256_mul_epu32(_mm256_srli_epi64(c[0], 32), m0);
+    __m256i e1 = _mm256_mul_epu32(c[2], m1);
+    __m256i o1 = _mm256_mul_epu32(_mm256_srli_epi64(c[2], 32), m1);
+    __m256i lo0 = _mm256_blend_epi32(e0, _mm256_slli_epi64(o0, 32), 0xAA);
+    __m256i hi0 = _mm256_blend_epi32(_mm256_srli_epi64(e0, 32), o0, 0xAA);
+    __m256i lo1 = _mm256_blend_epi32(e1, _mm256_slli_epi64(o1, 32), 0xAA);
+    __m256i hi1 = _mm256_blend_epi32(_mm256_srli_epi64(e1, 32), o1, 0xAA);
+    c[0] = _mm256_xor_si256(_mm256_xor_si256(hi1, c[1]),
+                            _mm256_set1_epi32(static_cast<int>(k0)));
+    c[1] = lo1;
+    c[2] = _mm256_xor_si256(_mm256_xor_si256(hi0, c[3]),
+                            _mm256_set1_epi32(static_cast<int>(k1)));
+    c[3] = lo0;
+  }
+}
+#endif
+
+/// @brief 并行生成按位打包的伯努利随机数
+///        （Bit-packed Bernoulli random numbers in parallel）
+/// @param bits 输出，共(n+7)/8个字节，第e个数是第e/8个字节的第e%8位
+///        （output of (n+7)/8 bytes, number e is bit e%8 of byte e/8）
+/// @param n 个数（count）
+/// @param p 每一位为1的概率（probability of each bit being 1）
+/// @param seed 种子（seed）
+/// @param stream 流号，不同的流互不相关（stream, different streams are
+///        independent）
+/// @remark 每32个数为一组，由连续的8块生成：第g组第j个字节的第l位来自第
+///         8g+l块的第j个随机数。这样AVX2一次计算8块，每个比较结果的符号位
+///         正好组成一个字节。最后不足一个字节的位为0。
+///         Every 32 numbers form a group generated by 8 consecutive blocks:
+///         bit l of byte j of group g comes from random number j of block
+///         8g+l. AVX2 thus computes 8 blocks at once and the sign bits of
+///         each comparison form exactly one byte. Bits past n in the last
+///         byte are 0.
+void PhiloxBernoulli(uint8_t *bits, long n, float p, uint64_t seed,
+                     uint64_t stream) {
+  long bytes = (n + 7) / 8;
+  long groups = (bytes + 3) / 4;
+  uint64_t threshold = BernoulliThreshold(p);
+  ThreadPool::Global().ParallelFor(0, groups, 256, [&](long first,
+                                                        long last) {
+    for (long g = first; g < last; ++g) {
+      uint8_t out[4];
+      if (threshold > 0xFFFFFFFFULL) {
+        out[0] = out[1] = out[2] = out[3] = 0xFF;
+      } else {
+#if defined(__AVX2__)
+        uint64_t block = static_cast<uint64_t>(g) * 8;
+        __m256i c[4];
+        c[0] = _mm256_add_epi32(
+            _mm256_set1_epi32(static_cast<int>(block)),
+            _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        c[1] = _mm256_set1_epi32(static_cast<int>(block >> 32));
+        c[2] = _mm256_set1_epi32(static_cast<int>(stream));
+        c[3] = _mm256_set1_epi32(static_cast<int>(stream >> 32));
+        Philox8(c, static_cast<uint32_t>(seed),
+                static_cast<uint32_t>(seed >> 32));
+        // 无符号比较x < t：两边都翻转符号位后做有符号比较
+        // Unsigned x < t: signed comparison after flipping both sign bits.
+        const __m256i sign = _mm256_set1_epi32(INT32_MIN);
+        __m256i t = _mm256_set1_epi32(static_cast<int>(threshold) ^ INT32_MIN);
+        for (int j = 0; j < 4; ++j) {
+          __m256i x = _mm256_xor_si256(c[j], sign);
+          __m256i lt = _mm256_cmpgt_epi32(t, x);
+          out[j] = static_cast<uint8_t>(
+              _mm256_movemask_ps(_mm256_castsi256_ps(lt)));
+        }
+#else
+        out[0] = out[1] = out[2] = out[3] = 0;
+        uint32_t r[4];
+        for (int l = 0; l < 8; ++l) {
+          PhiloxBlock(g * 8 + l, seed, stream, r);
+          for (int j = 0; j < 4; ++j) {
+            out[j] |= static_cast<uint8_t>((r[j] < threshold) << l);
+          }
+        }
+#endif
+      }
+      for (int j = 0; j < 4 && g * 4 + j < bytes; ++j) bits[g * 4 + j] = out[j];
+    }
+  });
+  // 最后不足一个字节的位（bits past n in the last byte）
+  if (n % 8 != 0) bits[bytes - 1] &= static_cast<uint8_t>((1 << (n % 8)) - 1);
+}
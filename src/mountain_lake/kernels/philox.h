@@ -0,0 +1,28 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_KERNELS_PHILOX_H_
+#define MOUNTAIN_LAKE_KERNELS_PHILOX_H_
+
+// 基于计数器的随机数生成器Philox4x32-10（Counter-based RNG Philox4x32-10）
+//
+// 第i个随机数只由种子、流号和i决定，不依赖生成的顺序，所以可以多线程并行地
+// 原地填充数组，并且结果与线程数无关。
+// The i-th random number depends only on the seed, the stream and i, not on
+// the order of generation, so arrays can be filled in place by many threads
+// and the result does not depend on the number of threads.
+
+#include <cstdint>
+
+void Philox4x32(const uint32_t counter[4], const uint32_t key[2],
+                uint32_t out[4]);
+void PhiloxUniform(float *data, long n, float low, float high, uint64_t seed,
+                   uint64_t stream);
+void PhiloxNormal(float *data, long n, float mean, float stddev, uint64_t seed,
+                  uint64_t stream);
+void PhiloxBernoulli(uint8_t *bits, long n, float p, uint64_t seed,
+                     uint64_t stream);
+
+#endif  // MOUNTAIN_LAKE_KERNELS_PHILOX_H_
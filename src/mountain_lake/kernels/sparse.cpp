@@ -0,0 +1,237 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "sparse.h"
+
+#include <algorithm>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+/// @brief 解析稀疏格式名称（Parse the name of a sparse format）
+/// @param name 格式名称："csr"、"1x8"或"4x4"（"csr", "1x8" or "4x4"）
+/// @return 稀疏格式，无法识别时返回-1（sparse format, -1 if unknown）
+int ParseSparseFormat(const string &name) {
+  if (name == "csr") return kSparseCSR;
+  if (name == "1x8") return kSparseBlock1x8;
+  if (name == "4x4") return kSparseBlock4x4;
+  return -1;
+}
+
+/// @brief 稀疏格式的块大小（Block shape of a sparse format）
+/// @param format 稀疏格式（sparse format）
+/// @param block_rows 块的行数（rows of a block）
+/// @param block_cols 块的列数（columns of a block）
+void SparseBlockShape(int format, int &block_rows, int &block_cols) {
+  block_rows = format == kSparseBlock4x4 ? 4 : 1;
+  block_cols = format == kSparseBlock1x8   ? 8
+               : format == kSparseBlock4x4 ? 4
+                                           : 1;
+}
+
+/// @brief 非零元素所占的比例（Fraction of non-zero elements）
+/// @param W 权重（weights）
+/// @return 密度（density）
+float Density(const MatrixXf &W) {
+  if (W.size() == 0) return 1.0f;
+  return static_cast<float>((W.array() != 0).count()) / W.size();
+}
+
+/// @brief 按幅值剪枝（Magnitude pruning）
+/// @param W 权重，被剪掉的部分置为0（weights, pruned entries are set to 0）
+/// @param M 掩码，保留为1，剪掉为0（mask, 1 to keep and 0 for pruned）
+/// @param sparsity 目标稀疏度（target sparsity）
+/// @param format 稀疏格式，决定剪枝的粒度（sparse format, sets the granularity）
+/// @remark 块格式按整块绝对值的平均值剪枝，这样剪掉的权重才能整块省去。
+///         边缘不完整的块按实际元素个数求平均。
+///         Block formats prune whole blocks by the mean of their absolute
+///         values, so that pruned weights can be skipped block by block.
+///         Incomplete blocks at the edges average over their actual
+///         elements.
+void PruneByMagnitude(MatrixXf &W, MatrixXf &M, float sparsity, int format) {
+  int br = 1;
+  int bc = 1;
+  SparseBlockShape(format, br, bc);
+  int nbr = (W.rows() + br - 1) / br;
+  int nbc = (W.cols() + bc - 1) / bc;
+  int nblocks = nbr * nbc;
+  int pruned = static_cast<int>(sparsity * nblocks);
+  M = MatrixXf::Ones(W.rows(), W.cols());
+  if (pruned <= 0) return;
+  if (pruned > nblocks) pruned = nblocks;
+  vector<float> score(nblocks, 0.0f);
+  for (int j = 0; j < W.cols(); ++j) {
+    for (int i = 0; i < W.rows(); ++i) {
+      score[(i / br) * nbc + j / bc] +=
+          std::abs(W(i, j)) / (std::min<int>(br, W.rows() - i / br * br) *
+                               std::min<int>(bc, W.cols() - j / bc * bc));
+    }
+  }
+  vector<int> order(nblocks);
+  for (int b = 0; b < nblocks; ++b) order[b] = b;
+  std::nth_element(order.begin(), order.begin() + pruned - 1, order.end(),
+                   [&score](int a, int b) { return score[a] < score[b]; });
+  int r = 0;
+  int c = 0;
+  for (int p = 0; p < pruned; ++p) {
+    r = order[p] / nbc * br;
+    c = order[p] % nbc * bc;
+    M.block(r, c, std::min<int>(br, W.rows() - r),
+            std::min<int>(bc, W.cols() - c))
+        .setZero();
+  }
+  W = W.cwiseProduct(M);
+}
+
+/// @brief 把稠密权重转换为稀疏格式（Convert dense weights to a sparse format）
+/// @param W 稠密权重（dense weights）
+/// @param format 稀疏格式（sparse format）
+/// @param S 稀疏权重（sparse weights）
+/// @remark 只要块内有一个非零元素，整个块就会被保存。
+///         A block is stored as soon as it holds one non-zero element.
+void DenseToSparse(const MatrixXf &W, int format, SparseMatrix &S) {
+  S.format = format;
+  S.rows = W.rows();
+  S.cols = W.cols();
+  SparseBlockShape(format, S.block_rows, S.block_cols);
+  int br = S.block_rows;
+  int bc = S.block_cols;
+  int nbr = (S.rows + br - 1) / br;
+  int nbc = (S.cols + bc - 1) / bc;
+  S.row_ptr.assign(1, 0);
+  S.col_idx.clear();
+  S.values.clear();
+  bool nonzero = false;
+  for (int rb = 0; rb < nbr; ++rb) {
+    for (int cb = 0; cb < nbc; ++cb) {
+      nonzero = false;
+      for (int i = rb * br; i < std::min(S.rows, rb * br + br) && !nonzero;
+           ++i) {
+        for (int j = cb * bc; j < std::min(S.cols, cb * bc + bc); ++j) {
+          if (W(i, j) != 0) {
+            nonzero = true;
+            break;
+          }
+        }
+      }
+      if (!nonzero) continue;
+      S.col_idx.push_back(cb);
+      for (int k = 0; k < br; ++k) {
+        for (int l = 0; l < bc; ++l) {
+          int i = rb * br + k;
+          int j = cb * bc + l;
+          S.values.push_back(i < S.rows && j < S.cols ? W(i, j) : 0.0f);
+        }
+      }
+    }
+    S.row_ptr.push_back(S.col_idx.size());
+  }
+}
+
+/// @brief 一行输入乘以CSR权重（One input row times CSR weights）
+static void MulCSR(const float *x, const SparseMatrix &S, float *y) {
+  for (int i = 0; i < S.rows; ++i) {
+    if (x[i] == 0) continue;
+    for (int p = S.row_ptr[i]; p < S.row_ptr[i + 1]; ++p) {
+      y[S.col_idx[p]] += x[i] * S.values[p];
+    }
+  }
+}
+
+/// @brief 一行输入乘以1x8块权重（One input row times 1x8 block weights）
+/// @remark 输入为0的行整行跳过，每个块是一次8路FMA。
+///         Rows whose input is 0 are skipped entirely, each block is one
+///         8-lane FMA.
+static void MulBlock1x8(const float *x, const SparseMatrix &S, float *y) {
+  const float *v = S.values.data();
+  for (int i = 0; i < S.rows; ++i) {
+    if (x[i] == 0) continue;
+#if defined(__AVX2__) && defined(__FMA__)
+    __m256 xi = _mm256_set1_ps(x[i]);
+    for (int p = S.row_ptr[i]; p < S.row_ptr[i + 1]; ++p) {
+      float *yp = y + S.col_idx[p] * 8;
+      __m256 w = _mm256_loadu_ps(v + p * 8);
+      _mm256_storeu_ps(yp, _mm256_fmadd_ps(xi, w, _mm256_loadu_ps(yp)));
+    }
+#else
+    for (int p = S.row_ptr[i]; p < S.row_ptr[i + 1]; ++p) {
+      float *yp = y + S.col_idx[p] * 8;
+      for (int l = 0; l < 8; ++l) yp[l] += x[i] * v[p * 8 + l];
+    }
+#endif
+  }
+}
+
+/// @brief 一行输入乘以4x4块权重（One input row times 4x4 block weights）
+/// @remark 每个块读取4个输入，做4次4路FMA。
+///         Each block reads 4 inputs and does four 4-lane FMAs.
+static void MulBlock4x4(const float *x, const SparseMatrix &S, float *y) {
+  const float *v = S.values.data();
+  int nbr = S.row_ptr.size() - 1;
+  for (int rb = 0; rb < nbr; ++rb) {
+    const float *xr = x + rb * 4;
+    if (xr[0] == 0 && xr[1] == 0 && xr[2] == 0 && xr[3] == 0) continue;
+#if defined(__AVX2__) && defined(__FMA__)
+    __m128 x0 = _mm_set1_ps(xr[0]);
+    __m128 x1 = _mm_set1_ps(xr[1]);
+    __m128 x2 = _mm_set1_ps(xr[2]);
+    __m128 x3 = _mm_set1_ps(xr[3]);
+    for (int p = S.row_ptr[rb]; p < S.row_ptr[rb + 1]; ++p) {
+      float *yp = y + S.col_idx[p] * 4;
+      const float *w = v + p * 16;
+      __m128 acc = _mm_loadu_ps(yp);
+      acc = _mm_fmadd_ps(x0, _mm_loadu_ps(w), acc);
+      acc = _mm_fmadd_ps(x1, _mm_loadu_ps(w + 4), acc);
+      acc = _mm_fmadd_ps(x2, _mm_loadu_ps(w + 8), acc);
+      acc = _mm_fmadd_ps(x3, _mm_loadu_ps(w + 12), acc);
+      _mm_storeu_ps(yp, acc);
+    }
+#else
+    for (int p = S.row_ptr[rb]; p < S.row_ptr[rb + 1]; ++p) {
+      float *yp = y + S.col_idx[p] * 4;
+      for (int k = 0; k < 4; ++k) {
+        for (int l = 0; l < 4; ++l) yp[l] += xr[k] * v[p * 16 + k * 4 + l];
+      }
+    }
+#endif
+  }
+}
+
+/// @brief 稠密输入乘以稀疏权重（Dense input times sparse weights）
+/// @param X 输入，每行一个样本（input, one sample per row）
+/// @param S 稀疏权重（sparse weights）
+/// @param A 输出（output）
+/// @remark 计算量与保存的块数成正比。每个线程保留一份补齐后的输入和输出行。
+///         The work is proportional to the number of stored blocks. Each
+///         thread keeps one padded input row and one padded output row.
+void SparseMatMul(const Ref<const MatrixXf> &X, const SparseMatrix &S,
+                  MatrixXf &A) {
+  thread_local vector<float> x;
+  thread_local vector<float> y;
+  int padded_rows = (S.rows + S.block_rows - 1) / S.block_rows * S.block_rows;
+  int padded_cols = (S.cols + S.block_cols - 1) / S.block_cols * S.block_cols;
+  x.assign(padded_rows, 0.0f);
+  y.resize(padded_cols);
+  A.resize(X.rows(), S.cols);
+  for (int b = 0; b < X.rows(); ++b) {
+    for (int i = 0; i < S.rows; ++i) x[i] = X(b, i);
+    std::fill(y.begin(), y.end(), 0.0f);
+    if (S.format == kSparseBlock1x8) {
+      MulBlock1x8(x.data(), S, y.data());
+    } else if (S.format == kSparseBlock4x4) {
+      MulBlock4x4(x.data(), S, y.data());
+    } else {
+      MulCSR(x.data(), S, y.data());
+    }
+    for (int j = 0; j < S.cols; ++j) A(b, j) = y[j];
+  }
+}
+
+/// @brief 稀疏权重占用的字节数（Bytes used by the sparse weights）
+size_t SparseBytes(const SparseMatrix &S) {
+  return S.row_ptr.size() * sizeof(int) + S.col_idx.size() * sizeof(int) +
+         S.values.size() * sizeof(float);
+}
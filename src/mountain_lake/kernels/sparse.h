@@ -0,0 +1,52 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_KERNELS_SPARSE_H_
+#define MOUNTAIN_LAKE_KERNELS_SPARSE_H_
+
+#include <eigen3/Eigen/Dense>
+#include <string>
+#include <vector>
+
+using Eigen::MatrixXf;
+using Eigen::Ref;
+using std::string;
+using std::vector;
+
+/// @brief 稀疏格式（sparse formats）
+enum SparseFormat {
+  kSparseCSR = 0,     // 逐元素的CSR（element-wise CSR）
+  kSparseBlock1x8 = 1,  // 1行8列的块（blocks of 1 row by 8 columns）
+  kSparseBlock4x4 = 2,  // 4行4列的块（blocks of 4 rows by 4 columns）
+};
+
+/// @brief 按块压缩的稀疏权重（Block-compressed sparse weights）
+/// @remark 权重的形状与仿射变换层相同：行为输入，列为输出。CSR可以看作1x1的块。
+///         每个块内的值按行优先保存，最后一列块不足时用0补齐。
+///         The weights have the same shape as in the affine layer: rows are
+///         inputs and columns are outputs. CSR is treated as 1x1 blocks.
+///         Values inside each block are stored row-major, the last column
+///         of blocks is padded with zeros.
+struct SparseMatrix {
+  int format = kSparseCSR;
+  int rows = 0;
+  int cols = 0;
+  int block_rows = 1;
+  int block_cols = 1;
+  vector<int> row_ptr;   // 每一行块的起始位置（start of each block row）
+  vector<int> col_idx;   // 块的列号（column index of each block）
+  vector<float> values;  // 块的值（values of the blocks）
+};
+
+int ParseSparseFormat(const string &name);
+void SparseBlockShape(int format, int &block_rows, int &block_cols);
+float Density(const MatrixXf &W);
+void PruneByMagnitude(MatrixXf &W, MatrixXf &M, float sparsity, int format);
+void DenseToSparse(const MatrixXf &W, int format, SparseMatrix &S);
+void SparseMatMul(const Ref<const MatrixXf> &X, const SparseMatrix &S,
+                  MatrixXf &A);
+size_t SparseBytes(const SparseMatrix &S);
+
+#endif  // MOUNTAIN_LAKE_KERNELS_SPARSE_H_
@@ -0,0 +1,29 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "add.h"
+
+/// @brief 相加层正向传播（Forward propagation of add layers）
+/// @param X 输入，大小相同（inputs of the same size）
+/// @param Z 输出（output）
+/// @remark 前两个输入在一次遍历中相加，不先复制第一个输入。
+///         The first two inputs are added in one pass instead of copying the
+///         first input first.
+void Add::Forward(const vector<MatrixXf *> &X, MatrixXf &Z) {
+  if (X.size() == 1) {
+    Z = *X[0];
+    return;
+  }
+  Z.noalias() = *X[0] + *X[1];
+  for (size_t k = 2; k < X.size(); ++k) Z.noalias() += *X[k];
+}
+
+/// @brief 相加层反向传播（Backpropagation of add layers）
+/// @param dZ 输出的导数（derivatives of the output）
+/// @param dX 每个输入的导数（derivatives of every input）
+void Add::Backward(const Ref<const MatrixXf> &dZ,
+                   const vector<MatrixXf *> &dX) {
+  for (MatrixXf *d : dX) *d = dZ;
+}
@@ -0,0 +1,30 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_LAYERS_ADD_H_
+#define MOUNTAIN_LAKE_LAYERS_ADD_H_
+
+#include <eigen3/Eigen/Dense>
+#include <vector>
+
+using Eigen::MatrixXf;
+using Eigen::Ref;
+using std::vector;
+
+/// @brief 相加层类（add layer class）
+/// @remark 把大小相同的几个输入逐元素相加，用于残差连接。没有参数，每个输入
+///         的导数都等于输出的导数。
+///         Adds several inputs of the same size element by element, as used
+///         by residual connections. It has no parameters, and the derivative
+///         of every input equals the derivative of the output.
+class Add {
+ public:
+  Add(){};
+  ~Add(){};
+  void Forward(const vector<MatrixXf *> &X, MatrixXf &Z);
+  void Backward(const Ref<const MatrixXf> &dZ, const vector<MatrixXf *> &dX);
+};
+
+#endif  // MOUNTAIN_LAKE_LAYERS_ADD_H_
@@ -11,8 +11,36 @@
 /// @param W 权重（weights）
 /// @param B 偏置（bias）
 /// @param A 输出信号（output signals）
-void Affine::Forward(MatrixXf &X, MatrixXf &W, MatrixXf &B, MatrixXf &A) {
-  A = X * W + B;
+/// @remark X的每一行是一个样本，偏置加到每一行上。
+///         Each row of X is one sample, the bias is added to every row.
+void Affine::Forward(const Ref<const MatrixXf> &X, MatrixXf &W, MatrixXf &B,
+                     MatrixXf &A) {
+  Gemm(X, false, W, false, A);
+  A.rowwise() += B.row(0);
+}
+
+/// @brief 使用打包权重的仿射变换层正向传播
+///        （Forward propagation of affine layers with packed weights）
+/// @param X 输入信号（input signals）
+/// @param W 打包的权重（packed weights）
+/// @param B 偏置（bias）
+/// @param A 输出信号（output signals）
+void Affine::ForwardPacked(const Ref<const MatrixXf> &X, PackedMatrix &W,
+                           MatrixXf &B, MatrixXf &A) {
+  Gemm(X, W, A);
+  A.rowwise() += B.row(0);
+}
+
+/// @brief 使用稀疏权重的仿射变换层正向传播
+///        （Forward propagation of affine layers with sparse weights）
+/// @param X 输入信号（input signals）
+/// @param W 稀疏权重（sparse weights）
+/// @param B 偏置（bias）
+/// @param A 输出信号（output signals）
+void Affine::ForwardSparse(const Ref<const MatrixXf> &X, SparseMatrix &W,
+                           MatrixXf &B, MatrixXf &A) {
+  SparseMatMul(X, W, A);
+  A.rowwise() += B.row(0);
 }
 
 /// @brief 仿射变换层反向传播
@@ -24,12 +52,16 @@ void Affine::Forward(MatrixXf &X, MatrixXf &W, MatrixXf &B, MatrixXf &A) {
 /// @param dW 权重的导数（derivative of weights)
 /// @param dX 输入信号的导数（derivative of the input signal）
 /// @param layer_num 所处层号（Layer number）
-void Affine::Backward(MatrixXf &X, MatrixXf &W, MatrixXf &dA, MatrixXf &dB,
-                      MatrixXf &dW, MatrixXf &dX, int layer_num) {
-  dB.noalias() = dA;
-  dW.noalias() = X.transpose() * dA;
+/// @remark 批量计算时，偏置与权重的导数是所有样本之和。
+///         For batches, the derivatives of bias and weights are summed over
+///         all samples.
+void Affine::Backward(const Ref<const MatrixXf> &X, MatrixXf &W, MatrixXf &dA,
+                      MatrixXf &dB, MatrixXf &dW, MatrixXf &dX,
+                      int layer_num) {
+  dB.noalias() = dA.colwise().sum();
+  Gemm(X, true, dA, false, dW);
   // 如果这个层被放在神经网络中的第一层，则不需要计算输入信号的导数。
   // If this layer is placed in the first layer in the neural network, there is
   // no need to calculate the derivative of the input signal.
-  if (layer_num >= 2) dX.noalias() = dA * W.transpose();
+  if (layer_num >= 2) Gemm(dA, false, W, true, dX);
 }
\ No newline at end of file
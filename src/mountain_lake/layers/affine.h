@@ -6,6 +6,8 @@
 #ifndef MOUNTAIN_LAKE_LAYERS_AFFINE_H_
 #define MOUNTAIN_LAKE_LAYERS_AFFINE_H_
 
+#include <mountain_lake/kernels/gemm.h>
+#include <mountain_lake/kernels/sparse.h>
 #include <mountain_town/math/random.h>
 
 #include <eigen3/Eigen/Dense>
@@ -13,15 +15,21 @@
 
 using std::string;
 using Eigen::MatrixXf;
+using Eigen::Ref;
 
 /// @brief 仿射变换层类（class of affine transformation layers）
 class Affine {
  public:
   Affine(){};
   ~Affine(){};
-  void Forward(MatrixXf &X, MatrixXf &W, MatrixXf &B, MatrixXf &A);
-  void Backward(MatrixXf &X, MatrixXf &W, MatrixXf &dA, MatrixXf &dB,
-                MatrixXf &dW, MatrixXf &dX, int layer_num);
+  void Forward(const Ref<const MatrixXf> &X, MatrixXf &W, MatrixXf &B,
+               MatrixXf &A);
+  void ForwardSparse(const Ref<const MatrixXf> &X, SparseMatrix &W,
+                     MatrixXf &B, MatrixXf &A);
+  void ForwardPacked(const Ref<const MatrixXf> &X, PackedMatrix &W,
+                     MatrixXf &B, MatrixXf &A);
+  void Backward(const Ref<const MatrixXf> &X, MatrixXf &W, MatrixXf &dA,
+                MatrixXf &dB, MatrixXf &dW, MatrixXf &dX, int layer_num);
 };
 
 #endif  // MOUNTAIN_LAKE_LAYERS_AFFINE_H_
\ No newline at end of file
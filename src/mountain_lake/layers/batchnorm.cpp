@@ -0,0 +1,150 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "batchnorm.h"
+
+#include <cmath>
+
+/// @brief 一个通道在小批量上的均值与方差（Mean and variance of one channel
+///        over the mini-batch）
+/// @param X 输入（input）
+/// @param c 通道号（channel number）
+/// @param bc 配置内容（Configuration contents）
+/// @param mean 均值（mean）
+/// @param var 有偏方差（biased variance）
+void BatchNorm::Statistics(MatrixXf &X, int c, BatchNormConfig &bc,
+                           float &mean, float &var) {
+  auto X_c = X.middleCols(c * bc.spatial, bc.spatial);
+  float m = X_c.size();
+  mean = X_c.sum() / m;
+  var = (X_c.array() - mean).square().sum() / m;
+}
+
+/// @brief 批量归一化层正向传播（Forward propagation of the batch
+///        normalization layer）
+/// @param X 输入（input）
+/// @param W 缩放系数（scales）
+/// @param B 平移与滑动统计（shifts and running statistics）
+/// @param O 输出（output）
+/// @param bc 配置内容（Configuration contents）
+/// @param training 为true时使用小批量的统计，否则使用滑动统计
+///        （use the statistics of the mini-batch when true, otherwise the
+///        running statistics）
+/// @remark 输出与输入可以是同一个矩阵。
+///         The output may be the same matrix as the input.
+void BatchNorm::Forward(MatrixXf &X, MatrixXf &W, MatrixXf &B, MatrixXf &O,
+                        BatchNormConfig &bc, bool training) {
+  O.resize(X.rows(), X.cols());
+  float mean = 0.0f;
+  float var = 0.0f;
+  for (int c = 0; c < bc.channels; ++c) {
+    if (training) {
+      this->Statistics(X, c, bc, mean, var);
+    } else {
+      mean = B(1, c);
+      var = B(2, c);
+    }
+    float scale = W(0, c) / std::sqrt(var + bc.epsilon);
+    float shift = B(0, c) - mean * scale;
+    O.middleCols(c * bc.spatial, bc.spatial).array() =
+        X.middleCols(c * bc.spatial, bc.spatial).array() * scale + shift;
+  }
+}
+
+/// @brief 批量归一化层反向传播（Backpropagation of the batch normalization
+///        layer）
+/// @param dO 输出的导数（derivative of the output）
+/// @param X 输入（input）
+/// @param W 缩放系数（scales）
+/// @param dW 缩放系数的导数（derivative of the scales）
+/// @param dB 偏置的导数，第1行与第2行为小批量的均值与无偏方差
+///        （derivative of the bias, rows 1 and 2 hold the mean and the
+///        unbiased variance of the mini-batch）
+/// @param dX 输入的导数（derivative of the input）
+/// @param bc 配置内容（Configuration contents）
+/// @param layer_num 层号（layer number）
+/// @remark 均值与方差由输入重新计算，不需要保存正向传播的中间结果。小批量的
+///         统计和梯度放在一起，由应用梯度的线程用Accumulate()并入滑动统计，
+///         这样多个线程可以同时反向传播，使用检查点重新计算正向传播时也不会
+///         重复更新。
+///         The mean and variance are computed again from the input, so
+///         nothing from forward propagation needs to be kept. The statistics
+///         of the mini-batch travel with the gradients and the thread that
+///         applies the gradients merges them into the running statistics with
+///         Accumulate(), so several threads can backpropagate at once and
+///         recomputing the forward pass for checkpointing does not update
+///         them twice.
+void BatchNorm::Backward(MatrixXf &dO, MatrixXf &X, MatrixXf &W, MatrixXf &dW,
+                         MatrixXf &dB, MatrixXf &dX, BatchNormConfig &bc,
+                         int layer_num) {
+  dW.resize(1, bc.channels);
+  dB.setZero(3, bc.channels);
+  if (layer_num >= 2) dX.resize(X.rows(), X.cols());
+  float mean = 0.0f;
+  float var = 0.0f;
+  for (int c = 0; c < bc.channels; ++c) {
+    this->Statistics(X, c, bc, mean, var);
+    float inv = 1.0f / std::sqrt(var + bc.epsilon);
+    auto dO_c = dO.middleCols(c * bc.spatial, bc.spatial).array();
+    Eigen::ArrayXXf X_hat =
+        (X.middleCols(c * bc.spatial, bc.spatial).array() - mean) * inv;
+    float m = dO_c.size();
+    float d_beta = dO_c.sum();
+    float d_gamma = (dO_c * X_hat).sum();
+    dW(0, c) = d_gamma;
+    dB(0, c) = d_beta;
+    // 如果这个层被放在神经网络中的第一层，则不需要计算输入信号的导数。
+    // If this layer is placed in the first layer in the neural network, there
+    // is no need to calculate the derivative of the input signal.
+    if (layer_num >= 2) {
+      dX.middleCols(c * bc.spatial, bc.spatial).array() =
+          W(0, c) * inv / m * (m * dO_c - d_beta - X_hat * d_gamma);
+    }
+    // 滑动方差使用无偏估计（the running variance is unbiased）
+    float unbiased = m > 1 ? var * m / (m - 1) : var;
+    dB(1, c) = mean;
+    dB(2, c) = unbiased;
+  }
+}
+
+/// @brief 把小批量的统计并入滑动统计（Merge the statistics of a mini-batch
+///        into the running statistics）
+/// @param dB 偏置的导数，第1行与第2行为小批量的统计（derivative of the bias,
+///        rows 1 and 2 hold the statistics of the mini-batch）
+/// @param B 平移与滑动统计，只更新第1行与第2行（shifts and running
+///        statistics, only rows 1 and 2 are updated）
+/// @param bc 配置内容（Configuration contents）
+void BatchNorm::Accumulate(const MatrixXf &dB, MatrixXf &B,
+                           BatchNormConfig &bc) {
+  B.middleRows(1, 2) = bc.momentum * B.middleRows(1, 2) +
+                       (1.0f - bc.momentum) * dB.middleRows(1, 2);
+}
+
+/// @brief 把批量归一化合并到前一层（Fold batch normalization into the
+///        previous layer）
+/// @param W 前一层的权重，第c个通道为第c*size到第c*size+size-1列
+///        （weights of the previous layer, channel c is columns c*size to
+///        c*size+size-1）
+/// @param B 前一层的偏置，每个通道一列（bias of the previous layer, one column
+///        per channel）
+/// @param size 每个通道的权重列数，仿射变换层为1，卷积层为卷积核大小
+///        （weight columns per channel, 1 for affine layers, the filter size
+///        for convolutional layers）
+/// @param gamma 缩放系数（scales）
+/// @param stats 平移与滑动统计（shifts and running statistics）
+/// @param bc 配置内容（Configuration contents）
+/// @remark 合并后前一层的输出就是批量归一化的推理结果：
+///         W' = W * s，b' = (b - mean) * s + beta，s = gamma / sqrt(var + eps)。
+///         After folding, the output of the previous layer is already the
+///         inference result of batch normalization:
+///         W' = W * s, b' = (b - mean) * s + beta, s = gamma / sqrt(var + eps).
+void BatchNorm::Fold(MatrixXf &W, MatrixXf &B, int size, MatrixXf &gamma,
+                     MatrixXf &stats, BatchNormConfig &bc) {
+  for (int c = 0; c < bc.channels; ++c) {
+    float scale = gamma(0, c) / std::sqrt(stats(2, c) + bc.epsilon);
+    W.middleCols(c * size, size) *= scale;
+    B(0, c) = (B(0, c) - stats(1, c)) * scale + stats(0, c);
+  }
+}
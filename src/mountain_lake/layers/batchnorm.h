@@ -0,0 +1,50 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_LAYERS_BATCHNORM_H_
+#define MOUNTAIN_LAKE_LAYERS_BATCHNORM_H_
+
+#include <eigen3/Eigen/Dense>
+
+using Eigen::MatrixXf;
+
+/// @brief 批量归一化层配置（Batch normalization layer configuration）
+struct BatchNormConfig {
+  int channels = 0;  // 通道数（number of channels）
+  // 每个样本中每个通道的元素数，卷积输出为高乘宽，其余为1
+  // Elements of each channel per sample, height times width for
+  // convolution outputs, 1 otherwise.
+  int spatial = 1;
+  float momentum = 0.9f;  // 滑动统计的动量（momentum of the running
+                          // statistics）
+  float epsilon = 1e-5f;
+};
+
+/// @brief 批量归一化层类（Batch normalization layer class）
+/// @remark 权重W为1行的缩放系数gamma，偏置B有3行：第0行为平移beta，第1行与
+///         第2行为滑动均值与滑动方差。滑动统计放在偏置中，保存和恢复参数时
+///         会一起保存和恢复。
+///         The weights W are one row of scales gamma, the bias B has 3 rows:
+///         row 0 is the shift beta, rows 1 and 2 are the running mean and the
+///         running variance. Keeping the running statistics in the bias means
+///         they are saved and restored together with the parameters.
+class BatchNorm {
+ public:
+  BatchNorm(){};
+  ~BatchNorm(){};
+  void Forward(MatrixXf &X, MatrixXf &W, MatrixXf &B, MatrixXf &O,
+               BatchNormConfig &bc, bool training);
+  void Backward(MatrixXf &dO, MatrixXf &X, MatrixXf &W, MatrixXf &dW,
+                MatrixXf &dB, MatrixXf &dX, BatchNormConfig &bc, int layer_num);
+  static void Accumulate(const MatrixXf &dB, MatrixXf &B, BatchNormConfig &bc);
+  static void Fold(MatrixXf &W, MatrixXf &B, int size, MatrixXf &gamma,
+                   MatrixXf &stats, BatchNormConfig &bc);
+
+ private:
+  static void Statistics(MatrixXf &X, int c, BatchNormConfig &bc, float &mean,
+                         float &var);
+};
+
+#endif  // MOUNTAIN_LAKE_LAYERS_BATCHNORM_H_
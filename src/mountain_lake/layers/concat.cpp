@@ -0,0 +1,36 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "concat.h"
+
+/// @brief 拼接层正向传播（Forward propagation of concatenation layers）
+/// @param X 输入，行数相同（inputs with the same number of rows）
+/// @param Z 输出（output）
+/// @remark 矩阵按列优先存放，每个输入在输出中是连续的一段，直接复制。
+///         Matrices are stored column-major, so every input is one
+///         contiguous range of the output and is copied as it is.
+void Concat::Forward(const vector<MatrixXf *> &X, MatrixXf &Z) {
+  long cols = 0;
+  for (MatrixXf *x : X) cols += x->cols();
+  Z.resize(X[0]->rows(), cols);
+  long first = 0;
+  for (MatrixXf *x : X) {
+    Z.middleCols(first, x->cols()) = *x;
+    first += x->cols();
+  }
+}
+
+/// @brief 拼接层反向传播（Backpropagation of concatenation layers）
+/// @param dZ 输出的导数（derivatives of the output）
+/// @param cols 每个输入的列数（columns of every input）
+/// @param dX 每个输入的导数（derivatives of every input）
+void Concat::Backward(const Ref<const MatrixXf> &dZ, const vector<int> &cols,
+                      const vector<MatrixXf *> &dX) {
+  long first = 0;
+  for (size_t k = 0; k < dX.size(); ++k) {
+    *dX[k] = dZ.middleCols(first, cols[k]);
+    first += cols[k];
+  }
+}
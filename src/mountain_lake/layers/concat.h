@@ -0,0 +1,32 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_LAYERS_CONCAT_H_
+#define MOUNTAIN_LAKE_LAYERS_CONCAT_H_
+
+#include <eigen3/Eigen/Dense>
+#include <vector>
+
+using Eigen::MatrixXf;
+using Eigen::Ref;
+using std::vector;
+
+/// @brief 拼接层类（concatenation layer class）
+/// @remark 每个样本占一行，输入按顺序拼接成输出的列。卷积层的输出中第c个
+///         通道在第c*高*宽列开始，所以高与宽相同的输入拼接后就是按通道拼接。
+///         Each sample takes one row and the inputs become consecutive
+///         columns of the output. In the output of a convolutional layer
+///         channel c starts at column c*height*width, so inputs of the same
+///         height and width are concatenated along the channels.
+class Concat {
+ public:
+  Concat(){};
+  ~Concat(){};
+  void Forward(const vector<MatrixXf *> &X, MatrixXf &Z);
+  void Backward(const Ref<const MatrixXf> &dZ, const vector<int> &cols,
+                const vector<MatrixXf *> &dX);
+};
+
+#endif  // MOUNTAIN_LAKE_LAYERS_CONCAT_H_
@@ -0,0 +1,163 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "conv_relu_pool.h"
+
+#include <mountain_lake/parallel/thread_pool.h>
+
+/// @brief 取出一个样本并补0（Take one sample and pad it with zeros）
+/// @param X 输入，每行一个样本（input, one sample per row）
+/// @param n 样本号（sample number）
+/// @param cc 卷积层配置（convolution configuration）
+/// @param X_2dp 补0后的二维输入（padded two-dimensional input）
+/// @remark X是列优先的，逐个元素复制，不对不连续的行调用.reshaped()。
+///         大小不变时X_2dp不重新分配。
+///         X is column-major, so the elements are copied one by one instead
+///         of calling .reshaped() on the strided row. X_2dp is not
+///         reallocated while its size stays the same.
+static void PadSample(const Ref<const MatrixXf> &X, int n, ConvConig &cc,
+                      MatrixXf &X_2dp) {
+  X_2dp.setZero(cc.i_height + 2 * cc.pad, cc.i_width + 2 * cc.pad);
+  for (int r = 0; r < cc.i_height; ++r) {
+    for (int c = 0; c < cc.i_width; ++c) {
+      X_2dp(cc.pad + r, cc.pad + c) = X(n, r * cc.i_width + c);
+    }
+  }
+}
+
+/// @brief 卷积层与池化层能否融合（Whether the layers can be fused）
+/// @param cc 卷积层配置（convolution configuration）
+/// @param pc 池化层配置（pooling configuration）
+/// @return 只有最大值池化、通道数一致且窗口小于255个元素时才能融合
+///         （only max pooling with matching channels and a window smaller than
+///         255 elements can be fused）
+bool ConvReluPool::CanFuse(ConvConig &cc, PoolConfig &pc) {
+  return pc.type == 0 && pc.filter_num == cc.number &&
+         pc.height * pc.width < kPoolMaskNone && pc.i_height == cc.o_height &&
+         pc.i_width == cc.o_width;
+}
+
+/// @brief 融合层正向传播（Forward propagation of the fused layer）
+/// @param X 输入，每行一个样本（input, one sample per row）
+/// @param W 卷积层权重（convolution weights）
+/// @param B 卷积层偏置（convolution bias）
+/// @param O 池化输出（pooled output）
+/// @param cc 卷积层配置（convolution configuration）
+/// @param pc 池化层配置（pooling configuration）
+/// @param mask 最大值位置的掩码，为空指针时不记录（mask of the maximum
+///        positions, not recorded when it is a null pointer）
+/// @remark 每个分块先把池化窗口覆盖的几行卷积输入展开，再与全部卷积核做一次
+///         矩阵乘法，得到的分块只有几KB。
+///         Each tile unfolds the rows of convolution input covered by the
+///         pooling window and multiplies them with every filter at once, the
+///         resulting tile is only a few KB.
+void ConvReluPool::Forward(const Ref<const MatrixXf> &X, MatrixXf &W,
+                           MatrixXf &B, MatrixXf &O, ConvConig &cc,
+                           PoolConfig &pc, MatrixXb *mask) {
+  int size1 = cc.height * cc.width;
+  int pooled = pc.o_height * pc.o_width;
+  int band = pc.height * cc.o_width;
+  O.resize(X.rows(), cc.number * pooled);
+  if (mask != nullptr) mask->resize(X.rows(), cc.number * pooled);
+  // 权重的第m列是第m个卷积核（column m of the weights is filter m）
+  Eigen::Map<MatrixXf> W_m(W.data(), size1, cc.number);
+  // 每个任务是一个样本的一行池化输出（each task is one pooled row of one
+  // sample）
+  ThreadPool::Global().ParallelFor(
+      0, X.rows() * pc.o_height, 1, [&](long first, long last) {
+        MatrixXf X_2dp;
+        MatrixXf X_tmp(band, size1);
+        MatrixXf T(band, cc.number);
+        long n = -1;
+        for (long t = first; t < last; ++t) {
+          if (t / pc.o_height != n) {
+            n = t / pc.o_height;
+            PadSample(X, n, cc, X_2dp);
+          }
+          int pi = t % pc.o_height;
+          int r0 = pi * pc.stride;
+          for (int k = 0; k < pc.height; ++k) {
+            int r = (r0 + k) * cc.stride;
+            for (int c = 0; c < cc.o_width; ++c) {
+              for (int i = 0; i < cc.height; ++i) {
+                for (int j = 0; j < cc.width; ++j) {
+                  X_tmp(k * cc.o_width + c, i * cc.width + j) =
+                      X_2dp(r + i, c * cc.stride + j);
+                }
+              }
+            }
+          }
+          T.noalias() = X_tmp * W_m;
+          T.rowwise() += B.row(0);
+          for (int m = 0; m < cc.number; ++m) {
+            for (int pj = 0; pj < pc.o_width; ++pj) {
+              // ReLU之后的最大值不小于0（the maximum after ReLU is at least 0）
+              float best = 0.0f;
+              uint8_t arg = kPoolMaskNone;
+              for (int k = 0; k < pc.height; ++k) {
+                for (int l = 0; l < pc.width; ++l) {
+                  float v = T(k * cc.o_width + pj * pc.stride + l, m);
+                  if (v > best) {
+                    best = v;
+                    arg = k * pc.width + l;
+                  }
+                }
+              }
+              int index = m * pooled + pi * pc.o_width + pj;
+              O(n, index) = best;
+              if (mask != nullptr) (*mask)(n, index) = arg;
+            }
+          }
+        }
+      });
+}
+
+/// @brief 融合层反向传播（Backpropagation of the fused layer）
+/// @param dO 池化输出的导数（derivative of the pooled output）
+/// @param mask 正向传播记录的掩码（mask recorded by forward propagation）
+/// @param X 输入（input）
+/// @param dW 卷积层权重的导数（derivative of the convolution weights）
+/// @param dB 卷积层偏置的导数（derivative of the convolution bias）
+/// @param cc 卷积层配置（convolution configuration）
+/// @param pc 池化层配置（pooling configuration）
+/// @remark 与卷积层一样，不计算输入的导数，所以融合层只能是第一层。
+///         Like the convolutional layer, the derivative of the input is not
+///         computed, so the fused layer can only be the first layer.
+void ConvReluPool::Backward(MatrixXf &dO, MatrixXb &mask,
+                            const Ref<const MatrixXf> &X, MatrixXf &dW,
+                            MatrixXf &dB, ConvConig &cc, PoolConfig &pc) {
+  int size1 = cc.height * cc.width;
+  int pooled = pc.o_height * pc.o_width;
+  dW.setZero();
+  dB.setZero();
+  // 每个卷积核只写自己的导数，线程池按卷积核分配
+  // Each filter only writes its own derivatives, so the pool splits the
+  // work over filters.
+  ThreadPool::Global().ParallelFor(0, cc.number, 1, [&](long first,
+                                                        long last) {
+    MatrixXf X_2dp;
+    for (int n = 0; n < X.rows(); ++n) {
+      PadSample(X, n, cc, X_2dp);
+      for (long m = first; m < last; ++m) {
+        for (int pi = 0; pi < pc.o_height; ++pi) {
+          for (int pj = 0; pj < pc.o_width; ++pj) {
+            int index = m * pooled + pi * pc.o_width + pj;
+            uint8_t arg = mask(n, index);
+            if (arg == kPoolMaskNone) continue;
+            float g = dO(n, index);
+            int r = (pi * pc.stride + arg / pc.width) * cc.stride;
+            int c = (pj * pc.stride + arg % pc.width) * cc.stride;
+            dB(0, m) += g;
+            for (int i = 0; i < cc.height; ++i) {
+              for (int j = 0; j < cc.width; ++j) {
+                dW(0, m * size1 + i * cc.width + j) += g * X_2dp(r + i, c + j);
+              }
+            }
+          }
+        }
+      }
+    }
+  });
+}
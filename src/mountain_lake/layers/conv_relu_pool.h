@@ -0,0 +1,50 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_LAYERS_CONV_RELU_POOL_H_
+#define MOUNTAIN_LAKE_LAYERS_CONV_RELU_POOL_H_
+
+#include <mountain_lake/layers/convolution.h>
+#include <mountain_lake/layers/matrix_types.h>
+#include <mountain_lake/layers/pooling.h>
+
+#include <cstdint>
+#include <eigen3/Eigen/Dense>
+
+using Eigen::MatrixXf;
+using Eigen::Ref;
+using Eigen::RowMajor;
+
+// 掩码中表示池化窗口全部被ReLU置0、没有梯度的值
+// Mask value of a pooling window zeroed by ReLU, which has no gradient.
+const uint8_t kPoolMaskNone = 255;
+
+/// @brief 卷积、ReLU与最大值池化的融合层
+///        （fused convolution, ReLU and max pooling layer）
+/// @remark 按池化输出逐行分块计算：一块卷积输出只有池化窗口那么高，算完后
+///         立即在缓存中做ReLU和池化，完整的卷积输出与ReLU输出不会写入内存。
+///         反向传播只需要池化输出的掩码，每个元素一个字节，记录最大值在窗口
+///         中的位置，窗口全部不大于0时为kPoolMaskNone。
+///         The work is tiled by pooled output rows: a tile of convolution
+///         output is only as tall as the pooling window and is rectified and
+///         pooled while still in cache, so the full convolution and ReLU
+///         outputs never reach memory. Backpropagation only needs a mask of
+///         the pooled output, one byte per element holding the position of
+///         the maximum in its window, or kPoolMaskNone when the whole window
+///         is not greater than 0.
+class ConvReluPool {
+ public:
+  ConvReluPool(){};
+  ~ConvReluPool(){};
+  static bool CanFuse(ConvConig &cc, PoolConfig &pc);
+  void Forward(const Ref<const MatrixXf> &X, MatrixXf &W, MatrixXf &B,
+               MatrixXf &O, ConvConig &cc, PoolConfig &pc, MatrixXb *mask);
+  void Backward(MatrixXf &dO, MatrixXb &mask, const Ref<const MatrixXf> &X,
+                MatrixXf &dW, MatrixXf &dB, ConvConig &cc, PoolConfig &pc);
+
+ private:
+};
+
+#endif  // MOUNTAIN_LAKE_LAYERS_CONV_RELU_POOL_H_
@@ -5,67 +5,80 @@
 // https://opensource.org/licenses/MIT.
 #include "convolution.h"
 
+#include <mountain_lake/parallel/thread_pool.h>
+
+/// @brief 把一个样本展开为矩阵，每行是一个输出位置对应的输入
+///        （Unfold one sample into a matrix, each row holds the input of one
+///        output position）
+/// @param X 输入（input）
+/// @param n 样本号（sample number）
+/// @param cc 配置内容（Configuration contents）
+/// @param X_tmp 展开后的矩阵，大小为输出位置数x卷积核大小
+///        （unfolded matrix, output positions x filter size）
+/// @remark 直接按下标读取X的第n行，填充的位置写0，不再把这一行复制、转换并
+///         填充为临时的矩阵。
+///         Row n of X is read directly by index and padded positions are
+///         written as 0, so the row is no longer copied, reshaped and padded
+///         into temporary matrices.
+static void Unfold(const Ref<const MatrixXf> &X, long n, ConvConig &cc,
+                   MatrixXf &X_tmp) {
+  // 这里for循环的速度比.block()形式的要快
+  // Here the for loop is faster than in .block() form
+  for (int i = 0; i < cc.o_height; ++i) {
+    int site2 = i * cc.o_width;
+    for (int j = 0; j < cc.o_width; ++j) {
+      for (int k = 0; k < cc.height; ++k) {
+        int r = i * cc.stride + k - cc.pad;
+        bool row_in = r >= 0 && r < cc.i_height;
+        for (int l = 0; l < cc.width; ++l) {
+          int c = j * cc.stride + l - cc.pad;
+          X_tmp(site2 + j, k * cc.width + l) =
+              row_in && c >= 0 && c < cc.i_width ? X(n, r * cc.i_width + c)
+                                                 : 0.0f;
+        }
+      }
+    }
+  }
+}
+
 /// @brief 卷积层正向传播（Forward propagation of convolutional layers）
 /// @param X 输入（input）
 /// @param W 权重（weights）
 /// @param B 偏置（bias）
 /// @param O 输出（output）
 /// @param cc 配置内容（Configuration contents）
-void Convolution::Forward(MatrixXf &X, MatrixXf &W, MatrixXf &B, MatrixXf &O,
-                          ConvConig &cc) {
-  // 1. 把图片数据转化为矩阵
-  // 1. Convert image data to matrix
-  // 如果使用.reshaped()函数来转换的话，X的数据会以列优先的形式转换为矩阵，即使X与X_2d在
-  // 定义时都使用了行优先也没有用。
-  // If you use the .reshaped() function to convert, the data for X will be
-  // converted to a matrix in column-first form, even though X and X_2d were
-  // both defined using row-first in the are defined with row-first will not
-  // help.
-  MatrixXf X_2d = X.reshaped<RowMajor>(cc.i_height, cc.i_width);
-
-  // 2. 实现填充功能
-  // 2. Implementation of the fill function
-  MatrixXf X_2dp;
-  if (cc.pad > 0) {
-    X_2dp = MatrixXf(X_2d.rows() + 2 * cc.pad, X_2d.cols() + 2 * cc.pad);
-    X_2dp.block(cc.pad, cc.pad, X_2d.rows(), X_2d.cols()) = X_2d;
-  } else {
-    X_2dp = X_2d;
-  }
+/// @remark 全部卷积核组成一个卷积核大小x卷积核数的矩阵，打包一次后，每个
+///         样本展开后的输入与它做一次矩阵乘法。线程池按样本并行计算。
+///         All filters form one filter size x filter count matrix that is
+///         packed once, then the unfolded input of every sample is multiplied
+///         by it in one matrix product. The thread pool splits the work over
+///         samples.
+void Convolution::Forward(const Ref<const MatrixXf> &X, MatrixXf &W,
+                          MatrixXf &B, MatrixXf &O, ConvConig &cc) {
+  O.resize(X.rows(), cc.number * cc.o_height * cc.o_width);
   int size1 = cc.height * cc.width;
   int size2 = cc.o_height * cc.o_width;
-  int site1 = 0;
-  int site2 = 0;
-  MatrixXf X_tmp = MatrixXf(size2, size1);
-  MatrixXf W_tmp = MatrixXf(size1, 1);
-  MatrixXf O_tmp = MatrixXf(size2, 1);
-  MatrixXf B_tmp = MatrixXf(size2, 1);
-  for (int m = 0; m < cc.number; ++m) {
-    // 这里for循环的速度比.block()形式的要快
-    // Here the for loop is faster than in .block() form
-    for (int i = 0; i < size1; ++i) {
-      W_tmp(i, 0) = W(0, m * size1 + i);
-    }
-    for (int i = 0; i < cc.o_height; ++i) {
-      site1 = i * cc.stride;
-      site2 = i * cc.o_width;
-      for (int j = 0; j < cc.o_width; ++j) {
-        for (int k = 0; k < cc.height; ++k) {
-          for (int l = 0; l < cc.width; ++l) {
-            X_tmp(site2 + j, k * cc.width + l) =
-                X_2dp(site1 + k, j * cc.stride + l);
+  // W的一行中卷积核依次排列，按列优先看就是size1 x number的矩阵，直接映射
+  // 后打包，不复制
+  // The filters lie one after another in the row of W, which read
+  // column-major is a size1 x number matrix, mapped and packed without a
+  // copy.
+  PackedMatrix W_packed;
+  PackMatrix(Map<const MatrixXf>(W.data(), size1, cc.number), W_packed);
+  ThreadPool::Global().ParallelFor(
+      0, X.rows(), 1, [&](long first, long last) {
+        MatrixXf X_tmp = MatrixXf(size2, size1);
+        MatrixXf O_tmp;
+        for (long n = first; n < last; ++n) {
+          Unfold(X, n, cc, X_tmp);
+          Gemm(X_tmp, W_packed, O_tmp);
+          for (int m = 0; m < cc.number; ++m) {
+            for (int i = 0; i < size2; ++i) {
+              O(n, i + m * size2) = O_tmp(i, m) + B(0, m);
+            }
           }
         }
-      }
-    }
-    O_tmp.noalias() = X_tmp * W_tmp;
-    for (int i = 0; i < size2; ++i) {
-      B_tmp(i, 0) = B(0, m);
-    }
-    for (int i = 0; i < size2; ++i) {
-      O(0, i + m * size2) = O_tmp(i, 0) + B_tmp(i, 0);
-    }
-  }
+      });
 }
 
 /// @brief 卷积层反向传播（Convolutional Layer Backpropagation）
@@ -74,43 +87,49 @@ void Convolution::Forward(MatrixXf &X, MatrixXf &W, MatrixXf &B, MatrixXf &O,
 /// @param dO 输出参数的导数（Derivatives of output parameters）
 /// @param dW 权重的导数（Derivative of the weights）
 /// @param cc 配置内容（Configuration contents）
-void Convolution::Backward(MatrixXf &X, MatrixXf &dB, MatrixXf &dO,
-                           MatrixXf &dW, ConvConig &cc, int layer_num) {
+/// @remark 线程池按样本并行，每个样本只展开一次，全部样本展开后的输入上下
+///         排列，输出导数也按同样的行排列，于是全部卷积核的导数是一次矩阵
+///         乘法，求和的顺序与线程数无关。
+///         The thread pool splits the work over samples and every sample is
+///         unfolded only once. The unfolded inputs of all samples are
+///         stacked, the output derivatives are laid out by the same rows, so
+///         the derivatives of all filters are one matrix product whose
+///         summation order does not depend on the thread count.
+void Convolution::Backward(const Ref<const MatrixXf> &X, MatrixXf &dB,
+                           MatrixXf &dO, MatrixXf &dW, ConvConig &cc,
+                           int layer_num) {
   int size1 = cc.height * cc.width;
   int size2 = cc.o_height * cc.o_width;
-  MatrixXf dO_tmp = dO.reshaped<RowMajor>(cc.number, size2);
-  for (int i = 0; i < cc.number; ++i) {
-    dB(0, i) = dO_tmp.row(i).sum();
-  }
-  // 1. 把输入数据转化为矩阵
-  // 1. Converting input data into matrices
-  MatrixXf X_2d = X.reshaped<RowMajor>(cc.i_height, cc.i_width);
-  // 2. 实现填充功能
-  // 2. Implementation of the fill function
-  MatrixXf X_2dp;
-  if (cc.pad > 0) {
-    X_2dp = MatrixXf(X_2d.rows() + 2 * cc.pad, X_2d.cols() + 2 * cc.pad);
-    X_2dp.block(cc.pad, cc.pad, X_2d.rows(), X_2d.cols()) = X_2d;
-  } else {
-    X_2dp = X_2d;
-  }
-  MatrixXf dX_tmp1 = MatrixXf::Zero(size2, 1);
-  for (int m = 0; m < cc.number; ++m) {
-    for (int i = 0; i < cc.height; ++i) {
-      for (int j = 0; j < cc.width; ++j) {
-        for (int k = 0; k < cc.o_height; ++k) {
-          for (int l = 0; l < cc.o_width; ++l) {
-            dX_tmp1(k * cc.o_width + l, 0) =
-                X_2dp(k * cc.stride + i, l * cc.stride + j);
+  long rows = X.rows() * size2;
+  MatrixXf X_all = MatrixXf(rows, size1);
+  MatrixXf dO_all = MatrixXf(rows, cc.number);
+  ThreadPool::Global().ParallelFor(
+      0, X.rows(), 1, [&](long first, long last) {
+        MatrixXf X_tmp = MatrixXf(size2, size1);
+        for (long n = first; n < last; ++n) {
+          Unfold(X, n, cc, X_tmp);
+          X_all.middleRows(n * size2, size2) = X_tmp;
+          for (int m = 0; m < cc.number; ++m) {
+            for (int i = 0; i < size2; ++i) {
+              dO_all(n * size2 + i, m) = dO(n, m * size2 + i);
+            }
           }
         }
-        // 这里使用.block()形式比for循环的速度快
-        // Here using the .block() form is faster than the for loop
-        dW(0, m * size1 + i * cc.width + j) =
-            (dO_tmp.block(m, 0, 1, size2) * dX_tmp1)(0, 0);
-      }
+      });
+  // 批量计算时，偏置与权重的导数是所有样本之和。
+  // For batches, the derivatives of bias and weights are summed over all
+  // samples.
+  dB.setZero();
+  for (long n = 0; n < X.rows(); ++n) {
+    for (int m = 0; m < cc.number; ++m) {
+      dB(0, m) += dO_all.col(m).segment(n * size2, size2).sum();
     }
   }
+  MatrixXf dW_tmp;
+  Gemm(X_all, true, dO_all, false, dW_tmp);
+  for (int m = 0; m < cc.number; ++m) {
+    dW.block(0, m * size1, 1, size1) = dW_tmp.col(m).transpose();
+  }
   // 如果这个层被放在神经网络中的第一层，则不需要计算输入信号的导数。
   // If this layer is placed in the first layer in the neural network, there is
   // no need to calculate the derivative of the input signal.
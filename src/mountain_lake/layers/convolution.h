@@ -6,11 +6,15 @@
 #ifndef MOUNTAIN_LAKE_LAYERS_CONVOLUTION_H_
 #define MOUNTAIN_LAKE_LAYERS_CONVOLUTION_H_
 
+#include <mountain_lake/kernels/gemm.h>
+
 #include <eigen3/Eigen/Dense>
 
 using Eigen::Dynamic;
+using Eigen::Map;
 using Eigen::Matrix;
 using Eigen::MatrixXf;
+using Eigen::Ref;
 using Eigen::RowMajor;
 
 /// @brief 卷积层配置结构（Convolutional Layer Configuration Structure）
@@ -32,10 +36,10 @@ class Convolution {
  public:
   Convolution(){};
   ~Convolution(){};
-  void Forward(MatrixXf &X, MatrixXf &W, MatrixXf &B, MatrixXf &O,
-               ConvConig &cc);
-  void Backward(MatrixXf &X, MatrixXf &dB, MatrixXf &dO, MatrixXf &dW,
-                ConvConig &cc, int layer_num);
+  void Forward(const Ref<const MatrixXf> &X, MatrixXf &W, MatrixXf &B,
+               MatrixXf &O, ConvConig &cc);
+  void Backward(const Ref<const MatrixXf> &X, MatrixXf &dB, MatrixXf &dO,
+                MatrixXf &dW, ConvConig &cc, int layer_num);
 
  private:
 };
@@ -0,0 +1,310 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "depthwise_convolution.h"
+
+#include <mountain_lake/parallel/thread_pool.h>
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+using std::vector;
+
+/// @brief 把样本n的通道c复制到填充后的连续平面中（Copy channel c of sample
+///        n into a padded contiguous plane）
+/// @param X 输入（input）
+/// @param n 样本号（sample number）
+/// @param c 通道号（channel number）
+/// @param cc 配置内容（Configuration contents）
+/// @param plane 平面，边缘保持为0（plane whose border stays 0）
+static void LoadPlane(const Ref<const MatrixXf> &X, long n, int c,
+                      const ConvConig &cc, float *plane) {
+  int pw = cc.i_width + 2 * cc.pad;
+  long base = static_cast<long>(c) * cc.i_height * cc.i_width;
+  for (int y = 0; y < cc.i_height; ++y) {
+    float *row = plane + (y + cc.pad) * pw + cc.pad;
+    for (int x = 0; x < cc.i_width; ++x) {
+      row[x] = X(n, base + y * cc.i_width + x);
+    }
+  }
+}
+
+/// @brief 步长为1的KxK卷积的一行输出（One output row of a KxK convolution
+///        with stride 1）
+/// @param in 输入平面中这一行对应的第一行（first input row of this output
+///        row）
+/// @param pw 输入平面的宽（width of the input plane）
+/// @param w 卷积核，按行连续（filter, row by row）
+/// @param bias 偏置（bias）
+/// @param out 输出行（output row）
+/// @param ow 输出的宽（output width）
+/// @remark 一次计算8个相邻的输出，每个卷积核的值广播一次，与输入平面中连续的
+///         8个值做FMA。
+///         Eight neighbouring outputs are computed at once, every filter
+///         value is broadcast once and multiplied with 8 contiguous values of
+///         the input plane in an FMA.
+template <int K>
+static void ForwardRow(const float *in, int pw, const float *w, float bias,
+                       float *out, int ow) {
+  int x = 0;
+#if defined(__AVX2__) && defined(__FMA__)
+  __m256 wv[K * K];
+  for (int t = 0; t < K * K; ++t) wv[t] = _mm256_set1_ps(w[t]);
+  for (; x + 8 <= ow; x += 8) {
+    __m256 acc = _mm256_set1_ps(bias);
+    for (int ky = 0; ky < K; ++ky) {
+      const float *p = in + ky * pw + x;
+      for (int kx = 0; kx < K; ++kx) {
+        acc = _mm256_fmadd_ps(wv[ky * K + kx], _mm256_loadu_ps(p + kx), acc);
+      }
+    }
+    _mm256_storeu_ps(out + x, acc);
+  }
+#endif
+  for (; x < ow; ++x) {
+    float sum = bias;
+    for (int ky = 0; ky < K; ++ky) {
+      for (int kx = 0; kx < K; ++kx) {
+        sum += w[ky * K + kx] * in[ky * pw + x + kx];
+      }
+    }
+    out[x] = sum;
+  }
+}
+
+/// @brief 一个通道的卷积（Convolution of one channel）
+/// @param plane 填充后的输入平面（padded input plane）
+/// @param pw 输入平面的宽（width of the input plane）
+/// @param w 卷积核（filter）
+/// @param bias 偏置（bias）
+/// @param out 输出平面（output plane）
+/// @param oh 输出的高（output height）
+/// @param ow 输出的宽（output width）
+/// @param stride 步长（stride）
+/// @param k_height 卷积核的高（filter height）
+/// @param k_width 卷积核的宽（filter width）
+/// @remark 步长为1的3x3与5x5卷积核使用向量化的直接卷积，其余逐个计算。
+///         3x3 and 5x5 filters with stride 1 use the vectorized direct
+///         convolution, everything else is computed one value at a time.
+static void ConvolvePlane(const float *plane, int pw, const float *w,
+                          float bias, float *out, int oh, int ow, int stride,
+                          int k_height, int k_width) {
+  if (stride == 1 && k_height == k_width && (k_height == 3 || k_height == 5)) {
+    for (int y = 0; y < oh; ++y) {
+      if (k_height == 3) {
+        ForwardRow<3>(plane + y * pw, pw, w, bias, out + y * ow, ow);
+      } else {
+        ForwardRow<5>(plane + y * pw, pw, w, bias, out + y * ow, ow);
+      }
+    }
+    return;
+  }
+  for (int y = 0; y < oh; ++y) {
+    for (int x = 0; x < ow; ++x) {
+      float sum = bias;
+      for (int ky = 0; ky < k_height; ++ky) {
+        const float *p = plane + (y * stride + ky) * pw + x * stride;
+        for (int kx = 0; kx < k_width; ++kx) {
+          sum += w[ky * k_width + kx] * p[kx];
+        }
+      }
+      out[y * ow + x] = sum;
+    }
+  }
+}
+
+/// @brief 步长为1的KxK卷积核的导数（Derivatives of a KxK filter with
+///        stride 1）
+/// @param plane 填充后的输入平面（padded input plane）
+/// @param pw 输入平面的宽（width of the input plane）
+/// @param g 输出的导数平面（plane of the output derivatives）
+/// @param oh 输出的高（output height）
+/// @param ow 输出的宽（output width）
+/// @param dw 卷积核的导数，累加（filter derivatives, accumulated）
+/// @remark 每个卷积核的值一个累加向量，整个平面算完后才水平求和。
+///         One accumulator vector per filter value, summed horizontally only
+///         after the whole plane.
+template <int K>
+static void FilterGradient(const float *plane, int pw, const float *g, int oh,
+                           int ow, float *dw) {
+  int vector_width = 0;
+#if defined(__AVX2__) && defined(__FMA__)
+  vector_width = ow / 8 * 8;
+  __m256 acc[K * K];
+  for (int t = 0; t < K * K; ++t) acc[t] = _mm256_setzero_ps();
+  for (int y = 0; y < oh; ++y) {
+    for (int x = 0; x < vector_width; x += 8) {
+      __m256 gv = _mm256_loadu_ps(g + y * ow + x);
+      for (int ky = 0; ky < K; ++ky) {
+        const float *p = plane + (y + ky) * pw + x;
+        for (int kx = 0; kx < K; ++kx) {
+          acc[ky * K + kx] =
+              _mm256_fmadd_ps(gv, _mm256_loadu_ps(p + kx), acc[ky * K + kx]);
+        }
+      }
+    }
+  }
+  for (int t = 0; t < K * K; ++t) {
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, acc[t]);
+    for (int l = 0; l < 8; ++l) dw[t] += lanes[l];
+  }
+#endif
+  for (int y = 0; y < oh; ++y) {
+    for (int x = vector_width; x < ow; ++x) {
+      float gv = g[y * ow + x];
+      for (int ky = 0; ky < K; ++ky) {
+        for (int kx = 0; kx < K; ++kx) {
+          dw[ky * K + kx] += gv * plane[(y + ky) * pw + x + kx];
+        }
+      }
+    }
+  }
+}
+
+/// @brief 逐通道卷积层正向传播（Forward propagation of depthwise
+///        convolutional layers）
+/// @param X 输入（input）
+/// @param W 权重（weights）
+/// @param B 偏置（bias）
+/// @param O 输出（output）
+/// @param cc 配置内容（Configuration contents）
+/// @remark 线程池按(样本, 通道)并行计算。每个通道先复制为填充后的连续平面，
+///         直接卷积在平面上按行向量化，结果再写回输出。
+///         The thread pool splits the work over (sample, channel) pairs.
+///         Each channel is first copied into a padded contiguous plane, the
+///         direct convolution is vectorized along the rows of the plane, and
+///         the result is written back to the output.
+void DepthwiseConvolution::Forward(const Ref<const MatrixXf> &X, MatrixXf &W,
+                                   MatrixXf &B, MatrixXf &O, ConvConig &cc) {
+  int channels = cc.number;
+  int size1 = cc.height * cc.width;
+  int size2 = cc.o_height * cc.o_width;
+  int ph = cc.i_height + 2 * cc.pad;
+  int pw = cc.i_width + 2 * cc.pad;
+  O.resize(X.rows(), channels * size2);
+  ThreadPool::Global().ParallelFor(
+      0, X.rows() * channels, 1, [&](long first, long last) {
+        vector<float> plane(static_cast<size_t>(ph) * pw, 0.0f);
+        vector<float> out(size2);
+        for (long t = first; t < last; ++t) {
+          long n = t / channels;
+          int c = t % channels;
+          LoadPlane(X, n, c, cc, plane.data());
+          ConvolvePlane(plane.data(), pw, W.data() + c * size1, B(0, c),
+                        out.data(), cc.o_height, cc.o_width, cc.stride,
+                        cc.height, cc.width);
+          for (int k = 0; k < size2; ++k) O(n, c * size2 + k) = out[k];
+        }
+      });
+}
+
+/// @brief 逐通道卷积层反向传播（Backpropagation of depthwise convolutional
+///        layers）
+/// @param X 输入（input）
+/// @param W 权重（weights）
+/// @param dO 输出的导数（derivatives of the output）
+/// @param dB 偏置的导数（derivatives of the bias）
+/// @param dW 权重的导数（derivatives of the weights）
+/// @param dX 输入的导数（derivatives of the input）
+/// @param cc 配置内容（Configuration contents）
+/// @param layer_num 所处层号（Layer number）
+/// @remark 线程池按通道并行计算，每个通道只写自己的导数。步长为1时，输入的
+///         导数就是把输出的导数填充K-1后，与翻转180度的卷积核做正向卷积，
+///         所以与正向传播共用向量化的直接卷积。
+///         The thread pool splits the work over channels, each channel only
+///         writes its own derivatives. With stride 1 the input derivatives
+///         are the output derivatives padded by K-1 and convolved forward with
+///         the filter rotated by 180 degrees, so they share the vectorized
+///         direct convolution with forward propagation.
+void DepthwiseConvolution::Backward(const Ref<const MatrixXf> &X, MatrixXf &W,
+                                    MatrixXf &dO, MatrixXf &dB, MatrixXf &dW,
+                                    MatrixXf &dX, ConvConig &cc,
+                                    int layer_num) {
+  int channels = cc.number;
+  int size1 = cc.height * cc.width;
+  int size2 = cc.o_height * cc.o_width;
+  int ph = cc.i_height + 2 * cc.pad;
+  int pw = cc.i_width + 2 * cc.pad;
+  bool input = layer_num >= 2;
+  bool direct = cc.stride == 1 && cc.height == cc.width &&
+                (cc.height == 3 || cc.height == 5);
+  // 填充后的输出导数平面（padded plane of the output derivatives）
+  int gh = cc.o_height + 2 * (cc.height - 1);
+  int gw = cc.o_width + 2 * (cc.width - 1);
+  dW.resize(1, channels * size1);
+  dB.resize(1, channels);
+  if (input) dX.resize(X.rows(), X.cols());
+  ThreadPool::Global().ParallelFor(0, channels, 1, [&](long first,
+                                                       long last) {
+    vector<float> plane(static_cast<size_t>(ph) * pw, 0.0f);
+    vector<float> g(size2);
+    vector<float> padded(direct ? static_cast<size_t>(gh) * gw : 0, 0.0f);
+    vector<float> d_plane(static_cast<size_t>(ph) * pw);
+    vector<float> flipped(size1);
+    for (int c = first; c < last; ++c) {
+      const float *w = W.data() + c * size1;
+      float *dw = dW.data() + c * size1;
+      std::fill(dw, dw + size1, 0.0f);
+      for (int k = 0; k < size1; ++k) flipped[k] = w[size1 - 1 - k];
+      float db = 0.0f;
+      for (long n = 0; n < X.rows(); ++n) {
+        LoadPlane(X, n, c, cc, plane.data());
+        for (int k = 0; k < size2; ++k) {
+          g[k] = dO(n, c * size2 + k);
+          db += g[k];
+        }
+        if (direct) {
+          if (cc.height == 3) {
+            FilterGradient<3>(plane.data(), pw, g.data(), cc.o_height,
+                              cc.o_width, dw);
+          } else {
+            FilterGradient<5>(plane.data(), pw, g.data(), cc.o_height,
+                              cc.o_width, dw);
+          }
+          if (!input) continue;
+          for (int y = 0; y < cc.o_height; ++y) {
+            std::copy(g.begin() + y * cc.o_width,
+                      g.begin() + (y + 1) * cc.o_width,
+                      padded.begin() + (y + cc.height - 1) * gw +
+                          cc.width - 1);
+          }
+          ConvolvePlane(padded.data(), gw, flipped.data(), 0.0f,
+                        d_plane.data(), ph, pw, 1, cc.height, cc.width);
+        } else {
+          std::fill(d_plane.begin(), d_plane.end(), 0.0f);
+          for (int y = 0; y < cc.o_height; ++y) {
+            for (int x = 0; x < cc.o_width; ++x) {
+              float gv = g[y * cc.o_width + x];
+              long offset = static_cast<long>(y) * cc.stride * pw +
+                            x * cc.stride;
+              for (int ky = 0; ky < cc.height; ++ky) {
+                for (int kx = 0; kx < cc.width; ++kx) {
+                  long p = offset + ky * pw + kx;
+                  dw[ky * cc.width + kx] += gv * plane[p];
+                  d_plane[p] += gv * w[ky * cc.width + kx];
+                }
+              }
+            }
+          }
+          if (!input) continue;
+        }
+        // 去掉填充后写回（written back without the padding）
+        long base = static_cast<long>(c) * cc.i_height * cc.i_width;
+        for (int y = 0; y < cc.i_height; ++y) {
+          const float *row = d_plane.data() + (y + cc.pad) * pw + cc.pad;
+          for (int x = 0; x < cc.i_width; ++x) {
+            dX(n, base + y * cc.i_width + x) = row[x];
+          }
+        }
+      }
+      dB(0, c) = db;
+    }
+  });
+}
@@ -0,0 +1,35 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_LAYERS_DEPTHWISE_CONVOLUTION_H_
+#define MOUNTAIN_LAKE_LAYERS_DEPTHWISE_CONVOLUTION_H_
+
+#include <mountain_lake/layers/convolution.h>
+
+#include <eigen3/Eigen/Dense>
+
+using Eigen::MatrixXf;
+using Eigen::Ref;
+
+/// @brief 逐通道卷积层类（depthwise convolutional layer class）
+/// @remark 每个输入通道只与自己的一个卷积核做卷积，输出通道数等于输入
+///         通道数，cc.number与cc.channel_num相同。W为1 x 通道数*卷积核大小，
+///         第c个卷积核在第c*height*width列开始。
+///         Every input channel is convolved with its own single filter, so
+///         there are as many output channels as input channels and cc.number
+///         equals cc.channel_num. W is 1 x channels*filter size, filter c
+///         starts at column c*height*width.
+class DepthwiseConvolution {
+ public:
+  DepthwiseConvolution(){};
+  ~DepthwiseConvolution(){};
+  void Forward(const Ref<const MatrixXf> &X, MatrixXf &W, MatrixXf &B,
+               MatrixXf &O, ConvConig &cc);
+  void Backward(const Ref<const MatrixXf> &X, MatrixXf &W, MatrixXf &dO,
+                MatrixXf &dB, MatrixXf &dW, MatrixXf &dX, ConvConig &cc,
+                int layer_num);
+};
+
+#endif  // MOUNTAIN_LAKE_LAYERS_DEPTHWISE_CONVOLUTION_H_
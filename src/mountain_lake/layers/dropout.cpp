@@ -0,0 +1,68 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "dropout.h"
+
+#include <mountain_lake/kernels/bit_mask.h>
+#include <mountain_lake/kernels/philox.h>
+
+/// @brief 用已有的掩码计算正向传播（Forward propagation with an existing
+///        mask）
+/// @param X 输入（input）
+/// @param mask 保留掩码（keep mask）
+/// @param Z 输出（output）
+/// @param rate 丢弃的概率（probability of dropping）
+/// @remark 激活检查点重新计算时使用，得到与第一次正向传播相同的输出。
+///         Used by activation checkpointing when recomputing, giving the same
+///         output as the first forward pass.
+void Dropout::Apply(const Ref<const MatrixXf> &X, const MatrixXb &mask,
+                    MatrixXf &Z, float rate) {
+  // 不连续的块先复制，再原地计算（a block that is not contiguous is copied
+  // first and then computed in place）
+  const float *x = X.data();
+  if (X.outerStride() != X.rows()) {
+    Z = X;
+    x = Z.data();
+  } else {
+    Z.resize(X.rows(), X.cols());
+  }
+  ApplyBitMask(x, mask.data(), X.size(), 1.0f / (1.0f - rate), Z.data());
+}
+
+/// @brief 丢弃层正向传播（Forward propagation of dropout layers）
+/// @param X 输入（input）
+/// @param Z 输出（output）
+/// @param mask 保留掩码，大小为(元素数+7)/8 x 1（keep mask of (elements+7)/8
+///        x 1）
+/// @param rate 丢弃的概率（probability of dropping）
+/// @param seed 种子（seed）
+/// @param stream 流号，每次正向传播不同（stream, different for every
+///        forward pass）
+/// @remark 掩码由Philox按种子与流号生成，同样的种子与流号总是得到同样的
+///         掩码，与线程数无关。
+///         The mask comes from Philox keyed by the seed and the stream, so
+///         the same seed and stream always give the same mask, regardless
+///         of the number of threads.
+void Dropout::Forward(const Ref<const MatrixXf> &X, MatrixXf &Z,
+                      MatrixXb &mask, float rate, uint64_t seed,
+                      uint64_t stream) {
+  long n = X.size();
+  mask.resize((n + 7) / 8, 1);
+  PhiloxBernoulli(mask.data(), n, 1.0f - rate, seed, stream);
+  this->Apply(X, mask, Z, rate);
+}
+
+/// @brief 丢弃层反向传播（Backpropagation of dropout layers）
+/// @param dZ 输出的导数（derivatives of the output）
+/// @param mask 正向传播生成的保留掩码（keep mask from forward propagation）
+/// @param dX 输入的导数（derivatives of the input）
+/// @param rate 丢弃的概率（probability of dropping）
+/// @remark 导数与正向传播一样只乘以掩码与缩放。
+///         Like forward propagation the derivatives are only multiplied by
+///         the mask and the scale.
+void Dropout::Backward(const Ref<const MatrixXf> &dZ, const MatrixXb &mask,
+                       MatrixXf &dX, float rate) {
+  this->Apply(dZ, mask, dX, rate);
+}
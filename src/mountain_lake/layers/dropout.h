@@ -0,0 +1,37 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_LAYERS_DROPOUT_H_
+#define MOUNTAIN_LAKE_LAYERS_DROPOUT_H_
+
+#include <mountain_lake/layers/matrix_types.h>
+
+#include <cstdint>
+#include <eigen3/Eigen/Dense>
+
+using Eigen::MatrixXf;
+using Eigen::Ref;
+
+/// @brief 丢弃层类（dropout layer class）
+/// @remark 训练时每个元素以rate的概率置0，保留的元素乘以1/(1-rate)，所以
+///         推理时直接传递输入。保留掩码按位打包，每个元素只占1位，第e个元素
+///         （按列优先的顺序）是第e/8个字节的第e%8位。
+///         In training every element is zeroed with probability rate and the
+///         kept elements are scaled by 1/(1-rate), so inference passes the
+///         input through unchanged. The keep mask is bit-packed at 1 bit per
+///         element, element e (in column-major order) is bit e%8 of byte e/8.
+class Dropout {
+ public:
+  Dropout(){};
+  ~Dropout(){};
+  void Forward(const Ref<const MatrixXf> &X, MatrixXf &Z, MatrixXb &mask,
+               float rate, uint64_t seed, uint64_t stream);
+  void Apply(const Ref<const MatrixXf> &X, const MatrixXb &mask, MatrixXf &Z,
+             float rate);
+  void Backward(const Ref<const MatrixXf> &dZ, const MatrixXb &mask,
+                MatrixXf &dX, float rate);
+};
+
+#endif  // MOUNTAIN_LAKE_LAYERS_DROPOUT_H_
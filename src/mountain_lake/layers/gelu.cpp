@@ -0,0 +1,44 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "gelu.h"
+
+static const float kSqrt2OverPi = 0.7978845608028654f;
+static const float kGeluCoeff = 0.044715f;
+
+/// @brief 计算 tanh(√(2/π)(x + 0.044715x³))
+/// @param A 输入（input）
+/// @param T 输出（output）
+void GELU::TanhOfInner(MatrixXf &A, MatrixXf &T) {
+  T = kSqrt2OverPi * (A.array() + kGeluCoeff * A.array().cube());
+  if (this->fast_math_) {
+    FastTanh(T.data(), T.data(), T.size());
+  } else {
+    T = T.array().tanh();
+  }
+}
+
+/// @brief GELU层正向传播（Forward propagation of the GELU layer）
+/// @param A 输入（input）
+/// @param Z 输出（output）
+void GELU::Forward(MatrixXf &A, MatrixXf &Z) {
+  this->TanhOfInner(A, Z);
+  Z = 0.5f * A.array() * (1 + Z.array());
+}
+
+/// @brief GELU层反向传播（Backpropagation of the GELU layer）
+/// @param dZ 输出信号的导数（Derivative of the output signal）
+/// @param A 输入（input）
+/// @param dA 输入信号的导数（Derivative of the input signal）
+/// @remark 导数需要输入而不是输出，tanh的值直接在dA中重新计算。
+///         The derivative needs the input rather than the output, the tanh
+///         values are recomputed directly in dA.
+void GELU::Backward(MatrixXf &dZ, MatrixXf &A, MatrixXf &dA) {
+  this->TanhOfInner(A, dA);
+  dA = dZ.array() *
+       (0.5f * (1 + dA.array()) +
+        0.5f * A.array() * (1 - dA.array().square()) * kSqrt2OverPi *
+            (1 + 3 * kGeluCoeff * A.array().square()));
+}
@@ -0,0 +1,33 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_LAYERS_GELU_H_
+#define MOUNTAIN_LAKE_LAYERS_GELU_H_
+
+#include <mountain_lake/kernels/fast_math.h>
+
+#include <eigen3/Eigen/Dense>
+
+using Eigen::MatrixXf;
+
+/// @brief 高斯误差线性单元类（Class of Gaussian error linear units）
+/// @remark 使用tanh近似：0.5x(1 + tanh(√(2/π)(x + 0.044715x³)))。
+///         Uses the tanh approximation:
+///         0.5x(1 + tanh(√(2/π)(x + 0.044715x³))).
+class GELU {
+ public:
+  GELU(){};
+  ~GELU(){};
+  void Forward(MatrixXf &A, MatrixXf &Z);
+  void Backward(MatrixXf &dZ, MatrixXf &A, MatrixXf &dA);
+  inline void SetFastMath(bool fast_math) { this->fast_math_ = fast_math; }
+
+ private:
+  void TanhOfInner(MatrixXf &A, MatrixXf &T);
+
+  bool fast_math_ = false;  // 是否使用快速数学函数（whether to use fast math）
+};
+
+#endif  // MOUNTAIN_LAKE_LAYERS_GELU_H_
@@ -0,0 +1,112 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "global_pooling.h"
+
+#include <mountain_lake/parallel/thread_pool.h>
+
+#include <algorithm>
+#include <vector>
+
+using Eigen::ArrayXf;
+using Eigen::Map;
+using std::vector;
+
+/// @brief 每个任务至少处理的元素数（minimum elements handled by a task）
+static const long kGlobalPoolGrain = 16384;
+
+/// @brief 全局池化层正向传播（Global pooling layer forward propagation）
+/// @param A 输入（input）
+/// @param O 输出，每行为一个样本的各通道（output, each row holds the
+///        channels of one sample）
+/// @param pc 配置内容（Configuration contents）
+/// @remark A按列优先存放，一个通道的一个位置是一列，所有样本的这个位置在
+///         列中连续，所以按列逐个累加或取最大值，一次处理整列的样本。只有
+///         一个连续的样本时，整个通道本身是连续的，直接归约。
+///         A is stored column-major, one position of a channel is one column
+///         holding that position of every sample contiguously, so the
+///         columns are summed or maxed one after another over whole columns
+///         of samples at once. With a single contiguous sample the whole
+///         channel itself is contiguous and is reduced directly.
+void GlobalPooling::Forward(const Ref<const MatrixXf> &A, MatrixXf &O,
+                            PoolConfig &pc) {
+  long size = static_cast<long>(pc.i_height) * pc.i_width;
+  long rows = A.rows();
+  float scale = 1.0f / size;
+  O.resize(rows, pc.filter_num);
+  if (rows == 0) return;
+  long grain = std::max(1L, kGlobalPoolGrain / (rows * size));
+  bool single = rows == 1 && A.outerStride() == 1;
+  ThreadPool::Global().ParallelFor(
+      0, pc.filter_num, grain, [&](long first, long last) {
+        for (long c = first; c < last; ++c) {
+          long base = c * size;
+          if (single) {
+            Map<const ArrayXf> channel(A.data() + base, size);
+            O(0, c) = pc.type == 0 ? channel.maxCoeff() : channel.sum() * scale;
+            continue;
+          }
+          auto o = O.col(c).array();
+          o = A.col(base).array();
+          // 0取最大值，1取平均值（0 takes the maximum value, 1 takes an
+          // average value）
+          if (pc.type == 0) {
+            for (long p = 1; p < size; ++p) o = o.max(A.col(base + p).array());
+          } else {
+            for (long p = 1; p < size; ++p) o += A.col(base + p).array();
+            o *= scale;
+          }
+        }
+      });
+}
+
+/// @brief 全局池化层反向传播（Global pooling layer backpropagation）
+/// @param dZ 输出参数的导数（Derivatives of output parameters）
+/// @param dA 输入参数的导数（Derivatives of input parameters）
+/// @param A 输入，取平均值时不读取（input, not read with the average）
+/// @param pc 配置内容（Configuration contents）
+/// @remark 取平均值时把每个通道的导数除以平面大小后广播到通道的每一列；
+///         取最大值时重新求出最大值，导数只传给每个样本第一个最大值的位置，
+///         与池化层相同。
+///         With the average the derivative of each channel is divided by the
+///         plane size and broadcast to every column of the channel; with the
+///         maximum the maximum is found again and the derivative only goes
+///         to the first maximum of each sample, as in the pooling layer.
+void GlobalPooling::Backward(const Ref<const MatrixXf> &dZ, MatrixXf &dA,
+                             const Ref<const MatrixXf> &A, PoolConfig &pc) {
+  long size = static_cast<long>(pc.i_height) * pc.i_width;
+  long rows = dZ.rows();
+  float scale = 1.0f / size;
+  dA.resize(rows, pc.filter_num * size);
+  if (rows == 0) return;
+  long grain = std::max(1L, kGlobalPoolGrain / (rows * size));
+  ThreadPool::Global().ParallelFor(
+      0, pc.filter_num, grain, [&](long first, long last) {
+        ArrayXf max(rows);
+        vector<uint8_t> found(rows);
+        for (long c = first; c < last; ++c) {
+          long base = c * size;
+          if (pc.type == 1) {
+            ArrayXf g = dZ.col(c).array() * scale;
+            for (long p = 0; p < size; ++p) dA.col(base + p).array() = g;
+            continue;
+          }
+          max = A.col(base).array();
+          for (long p = 1; p < size; ++p) {
+            max = max.max(A.col(base + p).array());
+          }
+          std::fill(found.begin(), found.end(), 0);
+          for (long p = 0; p < size; ++p) {
+            const float *a = A.data() + (base + p) * A.outerStride();
+            float *d = dA.data() + (base + p) * rows;
+            for (long n = 0; n < rows; ++n) {
+              bool hit = found[n] == 0 && a[n] == max[n];
+              found[n] |= hit;
+              d[n] = hit ? dZ(n, c) : 0.0f;
+            }
+          }
+        }
+      });
+}
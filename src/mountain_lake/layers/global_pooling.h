@@ -0,0 +1,32 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_LAYERS_GLOBAL_POOLING_H_
+#define MOUNTAIN_LAKE_LAYERS_GLOBAL_POOLING_H_
+
+#include <mountain_lake/layers/pooling.h>
+
+#include <eigen3/Eigen/Dense>
+
+using Eigen::MatrixXf;
+using Eigen::Ref;
+
+/// @brief 全局池化层类（global pooling layer class）
+/// @remark 窗口为整个输入平面的池化，每个通道输出一个值。配置与池化层相同，
+///         height与width等于i_height与i_width，o_height与o_width为1。
+///         Pooling whose window is the whole input plane, so every channel
+///         outputs one value. It is configured like a pooling layer with
+///         height and width equal to i_height and i_width and o_height and
+///         o_width equal to 1.
+class GlobalPooling {
+ public:
+  GlobalPooling(){};
+  ~GlobalPooling(){};
+  void Forward(const Ref<const MatrixXf> &A, MatrixXf &O, PoolConfig &pc);
+  void Backward(const Ref<const MatrixXf> &dZ, MatrixXf &dA,
+                const Ref<const MatrixXf> &A, PoolConfig &pc);
+};
+
+#endif  // MOUNTAIN_LAKE_LAYERS_GLOBAL_POOLING_H_
@@ -0,0 +1,28 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "leakyrelu.h"
+
+/// @brief 带泄露线性整流层正向传播
+///        （Forward propagation of the leaky linear rectifier）
+/// @param A 输入（input）
+/// @param Z 输出（output）
+/// @param alpha 负半轴的斜率（slope of the negative half-axis）
+void LeakyReLU::Forward(MatrixXf &A, MatrixXf &Z, float alpha) {
+  Z = (A.array() > 0).select(A, alpha * A);
+}
+
+/// @brief 带泄露线性整流层反向传播
+///        （Backpropagation of the leaky linear rectifier）
+/// @param dZ 输出信号的导数（Derivative of the output signal）
+/// @param Z 输出（output）
+/// @param dA 输入信号的导数（Derivative of the input signal）
+/// @param alpha 负半轴的斜率（slope of the negative half-axis）
+/// @remark alpha为正数，所以输出与输入的符号相同。
+///         alpha is positive, so the output has the same sign as the input.
+void LeakyReLU::Backward(MatrixXf &dZ, MatrixXf &Z, MatrixXf &dA,
+                         float alpha) {
+  dA = (Z.array() > 0).select(dZ, alpha * dZ);
+}
@@ -0,0 +1,22 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_LAYERS_LEAKYRELU_H_
+#define MOUNTAIN_LAKE_LAYERS_LEAKYRELU_H_
+
+#include <eigen3/Eigen/Dense>
+
+using Eigen::MatrixXf;
+
+/// @brief 带泄露线性整流函数类（Class of leaky linear rectifier functions）
+class LeakyReLU {
+ public:
+  LeakyReLU(){};
+  ~LeakyReLU(){};
+  void Forward(MatrixXf &A, MatrixXf &Z, float alpha);
+  void Backward(MatrixXf &dZ, MatrixXf &Z, MatrixXf &dA, float alpha);
+};
+
+#endif  // MOUNTAIN_LAKE_LAYERS_LEAKYRELU_H_
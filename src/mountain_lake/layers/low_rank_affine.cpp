@@ -0,0 +1,114 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "low_rank_affine.h"
+
+/// @brief 低秩仿射变换层正向传播（Forward propagation of low-rank affine
+///        layers）
+/// @param X 输入（input）
+/// @param W 按行堆叠的两个因子（the two factors stacked by rows）
+/// @param B 偏置（bias）
+/// @param A 输出（output）
+/// @remark 先算H = X * U，再算A = H * V^T，每个样本的计算量为
+///         2*秩*(输入数+输出数)，秩远小于输入数与输出数时少于稠密的
+///         2*输入数*输出数。
+///         H = X * U first and then A = H * V^T, which costs
+///         2*rank*(inputs+outputs) per sample, less than the dense
+///         2*inputs*outputs when the rank is far below both.
+void LowRankAffine::Forward(const Ref<const MatrixXf> &X, MatrixXf &W,
+                            MatrixXf &B, MatrixXf &A) {
+  int n = X.rows();
+  int inputs = X.cols();
+  int outputs = W.rows() - inputs;
+  int rank = W.cols();
+  MatrixXf H(n, rank);
+  Gemm(n, rank, inputs, X.data(), X.outerStride(), false, W.data(), W.rows(),
+       false, H.data(), n, false);
+  A.resize(n, outputs);
+  Gemm(n, outputs, rank, H.data(), n, false, W.data() + inputs, W.rows(),
+       true, A.data(), n, false);
+  A.rowwise() += B.row(0);
+}
+
+/// @brief 低秩仿射变换层反向传播（Backpropagation of low-rank affine
+///        layers）
+/// @param X 输入（input）
+/// @param W 按行堆叠的两个因子（the two factors stacked by rows）
+/// @param dA 输出的导数（derivatives of the output）
+/// @param dB 偏置的导数（derivatives of the bias）
+/// @param dW 两个因子的导数，形状与W相同（derivatives of the two factors,
+///        shaped like W）
+/// @param dX 输入的导数（derivatives of the input）
+/// @param layer_num 所处层号（Layer number）
+/// @remark H = X * U在反向传播时重新计算，不在层中保存状态。
+///         H = X * U is computed again during backpropagation so the layer
+///         keeps no state.
+void LowRankAffine::Backward(const Ref<const MatrixXf> &X, MatrixXf &W,
+                             MatrixXf &dA, MatrixXf &dB, MatrixXf &dW,
+                             MatrixXf &dX, int layer_num) {
+  int n = X.rows();
+  int inputs = X.cols();
+  int outputs = W.rows() - inputs;
+  int rank = W.cols();
+  long ld = W.rows();
+  dB.noalias() = dA.colwise().sum();
+  MatrixXf H(n, rank);
+  Gemm(n, rank, inputs, X.data(), X.outerStride(), false, W.data(), ld, false,
+       H.data(), n, false);
+  dW.resize(W.rows(), W.cols());
+  // dV = dA^T * H
+  Gemm(outputs, rank, n, dA.data(), n, true, H.data(), n, false,
+       dW.data() + inputs, ld, false);
+  // dH = dA * V，dU = X^T * dH
+  MatrixXf dH(n, rank);
+  Gemm(n, rank, outputs, dA.data(), n, false, W.data() + inputs, ld, false,
+       dH.data(), n, false);
+  Gemm(inputs, rank, n, X.data(), X.outerStride(), true, dH.data(), n, false,
+       dW.data(), ld, false);
+  // 如果这个层被放在神经网络中的第一层，则不需要计算输入信号的导数。
+  // If this layer is placed in the first layer in the neural network, there is
+  // no need to calculate the derivative of the input signal.
+  if (layer_num < 2) return;
+  dX.resize(n, inputs);
+  Gemm(n, inputs, rank, dH.data(), n, false, W.data(), ld, true, dX.data(), n,
+       false);
+}
+
+/// @brief 把稠密的权重分解为堆叠的两个因子（Factorize dense weights into the
+///        two stacked factors）
+/// @param W 稠密的权重，输入数 x 输出数（dense weights, inputs x outputs）
+/// @param rank 秩（rank）
+/// @param F 堆叠的因子，(输入数+输出数) x 秩（stacked factors,
+///        (inputs+outputs) x rank）
+/// @param seed 随机投影的种子（seed of the random projection）
+/// @param stream 随机投影的流号（stream of the random projection）
+/// @remark 截断奇异值分解W ≈ U_r * S_r * V_r^T后，两个因子各乘以sqrt(S_r)，
+///         使它们的尺度相同，之后微调时两边的梯度大小相近。
+///         After the truncated decomposition W ≈ U_r * S_r * V_r^T each
+///         factor is multiplied by sqrt(S_r) so both have the same scale,
+///         which keeps the gradients of the two sides alike when fine-tuning.
+void LowRankAffine::Factorize(const MatrixXf &W, int rank, MatrixXf &F,
+                              uint64_t seed, uint64_t stream) {
+  MatrixXf U;
+  VectorXf S;
+  MatrixXf V;
+  TruncatedSvd(W, rank, U, S, V, seed, stream);
+  VectorXf root = S.cwiseSqrt();
+  F.resize(W.rows() + W.cols(), rank);
+  F.topRows(W.rows()) = U * root.asDiagonal();
+  F.bottomRows(W.cols()) = V * root.asDiagonal();
+}
+
+/// @brief 把堆叠的两个因子乘回稠密的权重（Multiply the stacked factors back
+///        into dense weights）
+/// @param F 堆叠的因子（stacked factors）
+/// @param inputs 输入数（number of inputs）
+/// @param W 稠密的权重，输入数 x 输出数（dense weights, inputs x outputs）
+void LowRankAffine::Expand(const MatrixXf &F, int inputs, MatrixXf &W) {
+  int outputs = F.rows() - inputs;
+  W.resize(inputs, outputs);
+  Gemm(inputs, outputs, F.cols(), F.data(), F.rows(), false,
+       F.data() + inputs, F.rows(), true, W.data(), inputs, false);
+}
@@ -0,0 +1,39 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_LAYERS_LOW_RANK_AFFINE_H_
+#define MOUNTAIN_LAKE_LAYERS_LOW_RANK_AFFINE_H_
+
+#include <mountain_lake/kernels/gemm.h>
+#include <mountain_lake/kernels/low_rank.h>
+
+#include <cstdint>
+#include <eigen3/Eigen/Dense>
+
+using Eigen::MatrixXf;
+using Eigen::Ref;
+
+/// @brief 低秩仿射变换层类（class of low-rank affine transformation layers）
+/// @remark 权重W ≈ U * V^T按一个(输入数+输出数) x 秩的矩阵保存，前输入数行
+///         为U，其余行为V。两个因子放在同一个矩阵中，所以参数更新、梯度
+///         归约等按层处理权重的代码不需要改变。
+///         The weights W ≈ U * V^T are stored as one (inputs+outputs) x rank
+///         matrix, the first inputs rows are U and the rest are V. With both
+///         factors in one matrix, code that handles weights per layer, such
+///         as parameter updates and gradient reduction, needs no change.
+class LowRankAffine {
+ public:
+  LowRankAffine(){};
+  ~LowRankAffine(){};
+  void Forward(const Ref<const MatrixXf> &X, MatrixXf &W, MatrixXf &B,
+               MatrixXf &A);
+  void Backward(const Ref<const MatrixXf> &X, MatrixXf &W, MatrixXf &dA,
+                MatrixXf &dB, MatrixXf &dW, MatrixXf &dX, int layer_num);
+  static void Factorize(const MatrixXf &W, int rank, MatrixXf &F,
+                        uint64_t seed, uint64_t stream);
+  static void Expand(const MatrixXf &F, int inputs, MatrixXf &W);
+};
+
+#endif  // MOUNTAIN_LAKE_LAYERS_LOW_RANK_AFFINE_H_
@@ -10,7 +10,9 @@
 /// @param X 输入信号（input signals）
 /// @param W 权重（weights）
 /// @param A 输出信号（output signals）
-void MatMul::Forward(MatrixXf &X, MatrixXf &W, MatrixXf &A) { A = X * W; }
+void MatMul::Forward(const Ref<const MatrixXf> &X, MatrixXf &W, MatrixXf &A) {
+  Gemm(X, false, W, false, A);
+}
 
 /// @brief 仿射变换层反向传播
 ///        （Backpropagation of affine transformed layers）
@@ -20,11 +22,11 @@ void MatMul::Forward(MatrixXf &X, MatrixXf &W, MatrixXf &A) { A = X * W; }
 /// @param dW 权重的导数（derivative of weights)
 /// @param dX 输入信号的导数（derivative of the input signal）
 /// @param layer_num 所处层号（Layer number）
-void MatMul::Backward(MatrixXf &X, MatrixXf &W, MatrixXf &dA, MatrixXf &dW,
-                      MatrixXf &dX, int layer_num) {
-  dW.noalias() = X.transpose() * dA;
+void MatMul::Backward(const Ref<const MatrixXf> &X, MatrixXf &W, MatrixXf &dA,
+                      MatrixXf &dW, MatrixXf &dX, int layer_num) {
+  Gemm(X, true, dA, false, dW);
   // 如果这个层被放在神经网络中的第一层，则不需要计算输入信号的导数。
   // If this layer is placed in the first layer in the neural network, there is
   // no need to calculate the derivative of the input signal.
-  if (layer_num >= 2) dX.noalias() = dA * W.transpose();
+  if (layer_num >= 2) Gemm(dA, false, W, true, dX);
 }
\ No newline at end of file
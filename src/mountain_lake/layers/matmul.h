@@ -6,12 +6,14 @@
 #ifndef MOUNTAIN_LAKE_LAYERS_MATMUL_H_
 #define MOUNTAIN_LAKE_LAYERS_MATMUL_H_
 
+#include <mountain_lake/kernels/gemm.h>
 #include <mountain_town/math/random.h>
 
 #include <eigen3/Eigen/Dense>
 #include <string>
 
 using Eigen::MatrixXf;
+using Eigen::Ref;
 using std::string;
 
 /// @brief 仿射变换层类（class of affine transformation layers）
@@ -19,9 +21,9 @@ class MatMul {
  public:
   MatMul(){};
   ~MatMul(){};
-  void Forward(MatrixXf &X, MatrixXf &W, MatrixXf &A);
-  void Backward(MatrixXf &X, MatrixXf &W, MatrixXf &dA, MatrixXf &dW,
-                MatrixXf &dX, int layer_num);
+  void Forward(const Ref<const MatrixXf> &X, MatrixXf &W, MatrixXf &A);
+  void Backward(const Ref<const MatrixXf> &X, MatrixXf &W, MatrixXf &dA,
+                MatrixXf &dW, MatrixXf &dX, int layer_num);
 };
 
 #endif  // MOUNTAIN_LAKE_LAYERS_MATMUL_H_
\ No newline at end of file
@@ -0,0 +1,18 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_LAYERS_MATRIX_TYPES_H_
+#define MOUNTAIN_LAKE_LAYERS_MATRIX_TYPES_H_
+
+#include <cstdint>
+#include <eigen3/Eigen/Dense>
+
+using Eigen::Dynamic;
+using Eigen::Matrix;
+
+// 掩码、位置与标签的字节矩阵（byte matrix of masks, positions and labels）
+typedef Matrix<uint8_t, Dynamic, Dynamic> MatrixXb;
+
+#endif  // MOUNTAIN_LAKE_LAYERS_MATRIX_TYPES_H_
@@ -0,0 +1,81 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "pointwise_convolution.h"
+
+/// @brief 逐点卷积层正向传播（Forward propagation of pointwise
+///        convolutional layers）
+/// @param X 输入（input）
+/// @param W 权重（weights）
+/// @param B 偏置（bias）
+/// @param O 输出（output）
+/// @param cc 配置内容（Configuration contents）
+/// @remark X按列优先存放，第c个通道的位置p在第c*高*宽+p列，所以整个批量按
+///         列优先看就是(样本数*高*宽) x 输入通道数的矩阵，输出同理。整个批量
+///         只做一次矩阵乘法，不展开也不复制。
+///         X is stored column-major and position p of channel c is column
+///         c*height*width+p, so read column-major the whole batch is a
+///         (samples*height*width) x input channels matrix, and so is the
+///         output. The whole batch is one matrix product without unfolding
+///         or copying.
+void PointwiseConvolution::Forward(const Ref<const MatrixXf> &X, MatrixXf &W,
+                                   MatrixXf &B, MatrixXf &O, ConvConig &cc) {
+  long spatial = static_cast<long>(cc.o_height) * cc.o_width;
+  long rows = X.rows() * spatial;
+  O.resize(X.rows(), cc.number * spatial);
+  // 不连续的块先复制（a block that is not contiguous is copied first）
+  MatrixXf copy;
+  const float *x = X.data();
+  if (X.outerStride() != X.rows()) {
+    copy = X;
+    x = copy.data();
+  }
+  Gemm(rows, cc.number, cc.channel_num, x, rows, false, W.data(), W.rows(),
+       false, O.data(), rows, false);
+  for (int m = 0; m < cc.number; ++m) {
+    O.middleCols(m * spatial, spatial).array() += B(0, m);
+  }
+}
+
+/// @brief 逐点卷积层反向传播（Backpropagation of pointwise convolutional
+///        layers）
+/// @param X 输入（input）
+/// @param W 权重（weights）
+/// @param dO 输出的导数（derivatives of the output）
+/// @param dB 偏置的导数（derivatives of the bias）
+/// @param dW 权重的导数（derivatives of the weights）
+/// @param dX 输入的导数（derivatives of the input）
+/// @param cc 配置内容（Configuration contents）
+/// @param layer_num 所处层号（Layer number）
+/// @remark 与正向传播一样把批量看作一个矩阵，两个导数各是一次矩阵乘法。
+///         As in forward propagation the batch is seen as one matrix, and
+///         each of the two derivatives is one matrix product.
+void PointwiseConvolution::Backward(const Ref<const MatrixXf> &X, MatrixXf &W,
+                                    MatrixXf &dO, MatrixXf &dB, MatrixXf &dW,
+                                    MatrixXf &dX, ConvConig &cc,
+                                    int layer_num) {
+  long spatial = static_cast<long>(cc.o_height) * cc.o_width;
+  long rows = X.rows() * spatial;
+  MatrixXf copy;
+  const float *x = X.data();
+  if (X.outerStride() != X.rows()) {
+    copy = X;
+    x = copy.data();
+  }
+  dW.resize(cc.channel_num, cc.number);
+  Gemm(cc.channel_num, cc.number, rows, x, rows, true, dO.data(), rows, false,
+       dW.data(), cc.channel_num, false);
+  dB.resize(1, cc.number);
+  for (int m = 0; m < cc.number; ++m) {
+    dB(0, m) = dO.middleCols(m * spatial, spatial).sum();
+  }
+  // 如果这个层被放在神经网络中的第一层，则不需要计算输入信号的导数。
+  // If this layer is placed in the first layer in the neural network, there is
+  // no need to calculate the derivative of the input signal.
+  if (layer_num < 2) return;
+  dX.resize(X.rows(), cc.channel_num * spatial);
+  Gemm(rows, cc.channel_num, cc.number, dO.data(), rows, false, W.data(),
+       W.rows(), true, dX.data(), rows, false);
+}
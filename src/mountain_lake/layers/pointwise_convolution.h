@@ -0,0 +1,34 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_LAYERS_POINTWISE_CONVOLUTION_H_
+#define MOUNTAIN_LAKE_LAYERS_POINTWISE_CONVOLUTION_H_
+
+#include <mountain_lake/layers/convolution.h>
+
+#include <eigen3/Eigen/Dense>
+
+using Eigen::MatrixXf;
+using Eigen::Ref;
+
+/// @brief 逐点卷积层类，即1x1卷积（pointwise convolutional layer class,
+///        i.e. 1x1 convolution）
+/// @remark W为输入通道数 x 输出通道数，每个位置的输出是这个位置各输入通道的
+///         线性组合，高与宽不变。
+///         W is input channels x output channels, the output at every
+///         position is a linear combination of the input channels at that
+///         position, the height and width are unchanged.
+class PointwiseConvolution {
+ public:
+  PointwiseConvolution(){};
+  ~PointwiseConvolution(){};
+  void Forward(const Ref<const MatrixXf> &X, MatrixXf &W, MatrixXf &B,
+               MatrixXf &O, ConvConig &cc);
+  void Backward(const Ref<const MatrixXf> &X, MatrixXf &W, MatrixXf &dO,
+                MatrixXf &dB, MatrixXf &dW, MatrixXf &dX, ConvConig &cc,
+                int layer_num);
+};
+
+#endif  // MOUNTAIN_LAKE_LAYERS_POINTWISE_CONVOLUTION_H_
@@ -5,86 +5,155 @@
 // https://opensource.org/licenses/MIT.
 #include "pooling.h"
 
+#include <mountain_lake/parallel/thread_pool.h>
+
+#include <algorithm>
+
 /// @brief 池化层正向传播（Pooling layer forward propagation）
 /// @param A 输入（input）
 /// @param O 输出（output）
 /// @param pc 配置内容（Configuration contents）
-void Pooling::Forward(MatrixXf &A, MatrixXf &O, PoolConfig &pc) {
+/// @param index 取最大值时记录每个输出的第一个最大值在窗口中的位置，为空
+///        指针时不记录（position in the window of the first maximum of each
+///        output with the maximum, not recorded when it is a null pointer）
+/// @remark 直接按下标读取A中的窗口，不复制为临时的矩阵。
+///         Windows are read from A directly by index instead of being copied
+///         into temporary matrices.
+void Pooling::Forward(const Ref<const MatrixXf> &A, MatrixXf &O,
+                      PoolConfig &pc, MatrixXb *index) {
   int size1 = pc.height * pc.width;
   int size2 = pc.i_height * pc.i_width;
-  MatrixXf data1 = MatrixXf(pc.height, pc.width);
-  MatrixXf A_tmp = MatrixXf(pc.i_height, pc.i_width);
-  int k = -1;
-  for (int m = 0; m < pc.filter_num; ++m) {
-    for (int i = 0; i < size2; ++i) {
-      A_tmp(i / pc.i_width, i % pc.i_width) = A(0, m * size2 + i);
-    }
-    for (int i = 0; i < pc.i_height; i += pc.stride) {
-      for (int j = 0; j < pc.i_width; j += pc.stride) {
-        for (int k = 0; k < pc.height; ++k) {
-          for (int l = 0; l < pc.width; ++l) {
-            data1(k, l) = A_tmp(i + k, j + l);
+  int size3 = pc.o_height * pc.o_width;
+  O.resize(A.rows(), pc.filter_num * size3);
+  if (index != nullptr && pc.type == 0) index->resize(O.rows(), O.cols());
+  // A的每一行是一个样本，每个任务是一个样本的一个通道
+  // Each row of A is one sample, each task is one channel of one sample.
+  ThreadPool::Global().ParallelFor(
+      0, A.rows() * pc.filter_num, 1, [&](long first, long last) {
+        for (long t = first; t < last; ++t) {
+          int n = t / pc.filter_num;
+          int m = t % pc.filter_num;
+          for (int i = 0; i < pc.o_height; ++i) {
+            for (int j = 0; j < pc.o_width; ++j) {
+              int base = m * size2 + i * pc.stride * pc.i_width + j * pc.stride;
+              float max = A(n, base);
+              int arg = 0;
+              float sum = 0.0f;
+              for (int k = 0; k < pc.height; ++k) {
+                for (int l = 0; l < pc.width; ++l) {
+                  float v = A(n, base + k * pc.i_width + l);
+                  if (v > max) {
+                    max = v;
+                    arg = k * pc.width + l;
+                  }
+                  sum += v;
+                }
+              }
+              // 0取最大值，1取平均值（0 takes the maximum value, 1 takes an
+              // average value）
+              int o = m * size3 + i * pc.o_width + j;
+              O(n, o) = pc.type == 0 ? max : sum / size1;
+              if (index != nullptr && pc.type == 0) (*index)(n, o) = arg;
+            }
           }
         }
-        ++k;
-        if (pc.type == 0) {
-          // 取最大值（take the maximum value）
-          O(0, k) = data1.maxCoeff();
-          continue;
-        }
-        if (pc.type == 1) {
-          // 取平均值（take an average value）
-          O(0, k) = data1.sum() / size1;
-          continue;
-        }
-      }
-    }
-  }
+      });
 }
 
 /// @brief 池化层反向传播（Pooling layer backpropagation）
 /// @param dZ 输出参数的导数（Derivatives of output parameters）
-/// @param Z 输出（output）
 /// @param dA 输入参数的导数（Derivatives of input parameters）
 /// @param A 输入（input）
 /// @param pc 配置内容（Configuration contents）
-void Pooling::Backward(MatrixXf &dZ, MatrixXf &dA, MatrixXf &A,
-                       PoolConfig &pc) {
+/// @remark 取最大值时导数传给窗口中第一个最大值的位置，取平均值时平均分给
+///         窗口中的每个位置；窗口重叠时导数相加。
+///         With the maximum the derivative goes to the first maximum of the
+///         window, with the average it is shared evenly by every position of
+///         the window; overlapping windows add up their derivatives.
+void Pooling::Backward(const Ref<const MatrixXf> &dZ, MatrixXf &dA,
+                       const Ref<const MatrixXf> &A, PoolConfig &pc) {
+  int size1 = pc.height * pc.width;
   int size2 = pc.i_height * pc.i_width;
-  int max_row = 0;
-  int max_col = 0;
-  MatrixXf data1 = MatrixXf(pc.height, pc.width);
-  MatrixXf A_tmp = MatrixXf(pc.i_height, pc.i_width);
-  MatrixXf dA_tmp = MatrixXf(pc.i_height, pc.i_width);
-  for (int m = 0; m < pc.filter_num; ++m) {
-    A_tmp = A.block(0, m * size2, 1, size2)
-                .reshaped<RowMajor>(pc.i_height, pc.i_width);
-    for (int i = 0; i < pc.o_height; ++i) {
-      for (int j = 0; j < pc.o_width; ++j) {
-        data1 = A_tmp.block(i * pc.stride, j * pc.stride, pc.height, pc.width);
-        if (pc.type == 0) {
-          // 取最大值情况下的反向求导
-          // Backward derivation in the case of maxima
-          data1.maxCoeff(&max_row, &max_col);
-          for (int k = 0; k < pc.height; ++k) {
-            for (int l = 0; l < pc.width; ++l) {
-              data1(k, l) =
-                  k == max_row && l == max_col
-                      ? dZ(0, m * pc.o_height * pc.o_width + i * pc.o_width + j)
-                      : 0.0f;
+  int size3 = pc.o_height * pc.o_width;
+  dA.setZero(A.rows(), A.cols());
+  // 每个任务是一个样本的一个通道（each task is one channel of one sample）
+  ThreadPool::Global().ParallelFor(
+      0, A.rows() * pc.filter_num, 1, [&](long first, long last) {
+        for (long t = first; t < last; ++t) {
+          int n = t / pc.filter_num;
+          int m = t % pc.filter_num;
+          for (int i = 0; i < pc.o_height; ++i) {
+            for (int j = 0; j < pc.o_width; ++j) {
+              int base = m * size2 + i * pc.stride * pc.i_width + j * pc.stride;
+              float g = dZ(n, m * size3 + i * pc.o_width + j);
+              if (pc.type == 1) {
+                // 取平均值情况下的反向求导
+                // Backward derivation in the case of averages
+                for (int k = 0; k < pc.height; ++k) {
+                  for (int l = 0; l < pc.width; ++l) {
+                    dA(n, base + k * pc.i_width + l) += g / size1;
+                  }
+                }
+                continue;
+              }
+              // 取最大值情况下的反向求导
+              // Backward derivation in the case of maxima
+              int arg = base;
+              for (int k = 0; k < pc.height; ++k) {
+                for (int l = 0; l < pc.width; ++l) {
+                  int index = base + k * pc.i_width + l;
+                  if (A(n, index) > A(n, arg)) arg = index;
+                }
+              }
+              dA(n, arg) += g;
             }
           }
-          // 这里使用.block()形式比for循环的速度快
-          // Here using the .block() form is faster than the for loop
-          dA_tmp.block(i * pc.stride, j * pc.stride, pc.height, pc.width) =
-              data1;
         }
-        if (pc.type == 1) {
-          // 取平均值情况下的反向求导
-          // Backward derivation in the case of averages
+      });
+}
+
+/// @brief 使用记录的位置的池化层反向传播（Pooling layer backpropagation
+///        with the recorded positions）
+/// @param dZ 输出参数的导数（Derivatives of output parameters）
+/// @param index 正向传播记录的最大值位置，取平均值时不使用（positions of the
+///        maxima recorded by forward propagation, unused with the average）
+/// @param dA 输入参数的导数（Derivatives of input parameters）
+/// @param pc 配置内容（Configuration contents）
+/// @remark 不读取输入，结果与Backward(dZ, dA, A, pc)相同，所以正向传播后
+///         可以释放输入，只保留每个输出一个字节的位置。
+///         The input is not read and the result is the same as
+///         Backward(dZ, dA, A, pc), so the input can be freed after forward
+///         propagation, keeping only a one-byte position per output.
+void Pooling::BackwardCompact(const Ref<const MatrixXf> &dZ,
+                              const MatrixXb &index, MatrixXf &dA,
+                              PoolConfig &pc) {
+  int size1 = pc.height * pc.width;
+  int size2 = pc.i_height * pc.i_width;
+  int size3 = pc.o_height * pc.o_width;
+  dA.setZero(dZ.rows(), pc.filter_num * size2);
+  // 每个任务是一个样本的一个通道（each task is one channel of one sample）
+  ThreadPool::Global().ParallelFor(
+      0, dZ.rows() * pc.filter_num, 1, [&](long first, long last) {
+        for (long t = first; t < last; ++t) {
+          int n = t / pc.filter_num;
+          int m = t % pc.filter_num;
+          for (int i = 0; i < pc.o_height; ++i) {
+            for (int j = 0; j < pc.o_width; ++j) {
+              int base = m * size2 + i * pc.stride * pc.i_width + j * pc.stride;
+              int o = m * size3 + i * pc.o_width + j;
+              float g = dZ(n, o);
+              if (pc.type == 1) {
+                for (int k = 0; k < pc.height; ++k) {
+                  for (int l = 0; l < pc.width; ++l) {
+                    dA(n, base + k * pc.i_width + l) += g / size1;
+                  }
+                }
+                continue;
+              }
+              int arg = index(n, o);
+              dA(n, base + arg / pc.width * pc.i_width + arg % pc.width) += g;
+            }
+          }
         }
-      }
-    }
-    dA.block(0, m * size2, 1, size2) = dA_tmp.reshaped<RowMajor>(1, size2);
-  }
-}
\ No newline at end of file
+      });
+}
@@ -6,11 +6,13 @@
 #ifndef MOUNTAIN_LAKE_LAYERS_POOLING_H_
 #define MOUNTAIN_LAKE_LAYERS_POOLING_H_
 
+#include <mountain_lake/layers/matrix_types.h>
+
+#include <cstdint>
 #include <eigen3/Eigen/Dense>
 
-using Eigen::Dynamic;
-using Eigen::Matrix;
 using Eigen::MatrixXf;
+using Eigen::Ref;
 using Eigen::RowMajor;
 
 /// @brief 池化层配置结构（Pooling layer configuration structure）
@@ -33,8 +35,12 @@ class Pooling {
  public:
   Pooling(){};
   ~Pooling(){};
-  void Forward(MatrixXf &A, MatrixXf &O, PoolConfig &pc);
-  void Backward(MatrixXf &dZ, MatrixXf &dA, MatrixXf &A, PoolConfig &pc);
+  void Forward(const Ref<const MatrixXf> &A, MatrixXf &O, PoolConfig &pc,
+               MatrixXb *index = nullptr);
+  void Backward(const Ref<const MatrixXf> &dZ, MatrixXf &dA,
+                const Ref<const MatrixXf> &A, PoolConfig &pc);
+  void BackwardCompact(const Ref<const MatrixXf> &dZ, const MatrixXb &index,
+                       MatrixXf &dA, PoolConfig &pc);
 
  private:
 };
@@ -2,6 +2,8 @@
 // https://opensource.org/licenses/MIT.
 #include "relu.h"
 
+#include <mountain_lake/kernels/bit_mask.h>
+
 /// @brief 线性整流层正向传播（Linear rectifier forward propagation）
 /// @param A 输入（input）
 /// @param Z 输出（output）
@@ -15,4 +17,29 @@ void ReLU::Forward(MatrixXf &A, MatrixXf &Z) {
 /// @param dA 输入信号的导数（Derivative of the input signal）
 void ReLU::Backward(MatrixXf &dZ, MatrixXf &Z, MatrixXf &dA) {
   dA = (Z.array() > 0).select(dZ, 0);
-}
\ No newline at end of file
+}
+
+/// @brief 记录符号掩码的正向传播（Forward propagation recording the sign
+///        mask）
+/// @param A 输入（input）
+/// @param Z 输出（output）
+/// @param mask 按位打包的掩码，输出大于0的位置为1（bit-packed mask, 1
+///        where the output is greater than 0）
+/// @remark 反向传播只需要输出的符号，所以保存掩码后输出可以释放，每个元素
+///         只占1位。
+///         Backpropagation only needs the sign of the output, so the output
+///         can be freed once the mask is kept, at 1 bit per element.
+void ReLU::Forward(MatrixXf &A, MatrixXf &Z, MatrixXb &mask) {
+  this->Forward(A, Z);
+  mask.resize((Z.size() + 7) / 8, 1);
+  PackSignMask(Z.data(), Z.size(), mask.data());
+}
+
+/// @brief 使用符号掩码的反向传播（Backpropagation with the sign mask）
+/// @param dZ 输出信号的导数（Derivative of the output signal）
+/// @param mask 正向传播记录的掩码（mask recorded by forward propagation）
+/// @param dA 输入信号的导数（Derivative of the input signal）
+void ReLU::Backward(MatrixXf &dZ, MatrixXb &mask, MatrixXf &dA) {
+  dA.resize(dZ.rows(), dZ.cols());
+  ApplyBitMask(dZ.data(), mask.data(), dZ.size(), 1.0f, dA.data());
+}
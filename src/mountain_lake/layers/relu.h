@@ -3,6 +3,9 @@
 #ifndef MOUNTAIN_LAKE_LAYERS_RELU_H_
 #define MOUNTAIN_LAKE_LAYERS_RELU_H_
 
+#include <mountain_lake/layers/matrix_types.h>
+
+#include <cstdint>
 #include <eigen3/Eigen/Dense>
 
 using Eigen::MatrixXf;
@@ -13,7 +16,9 @@ class ReLU {
   ReLU(){};
   ~ReLU(){};
   void Forward(MatrixXf &A, MatrixXf &Z);
+  void Forward(MatrixXf &A, MatrixXf &Z, MatrixXb &mask);
   void Backward(MatrixXf &dZ, MatrixXf &Y, MatrixXf &dA);
+  void Backward(MatrixXf &dZ, MatrixXb &mask, MatrixXf &dA);
 };
 
 #endif  // MOUNTAIN_LAKE_LAYERS_RELU_H_
\ No newline at end of file
@@ -6,6 +6,11 @@
 /// @param A 输入（input）
 /// @param Z 输出（output）
 void Sigmoid::Forward(MatrixXf &A, MatrixXf &Z) {
+  if (this->fast_math_) {
+    Z.resize(A.rows(), A.cols());
+    FastSigmoid(A.data(), Z.data(), A.size());
+    return;
+  }
   Z = 1 / (1 + (-A).array().exp());
 }
 
@@ -3,6 +3,8 @@
 #ifndef MOUNTAIN_LAKE_LAYERS_SIGMOID_H_
 #define MOUNTAIN_LAKE_LAYERS_SIGMOID_H_
 
+#include <mountain_lake/kernels/fast_math.h>
+
 #include <eigen3/Eigen/Dense>
 
 using Eigen::MatrixXf;
@@ -14,6 +16,10 @@ class Sigmoid {
   ~Sigmoid(){};
   void Forward(MatrixXf &A, MatrixXf &Z);
   void Backward(MatrixXf &dZ, MatrixXf &Y, MatrixXf &dA);
+  inline void SetFastMath(bool fast_math) { this->fast_math_ = fast_math; }
+
+ private:
+  bool fast_math_ = false;  // 是否使用快速数学函数（whether to use fast math）
 };
 
 #endif  // MOUNTAIN_LAKE_LAYERS_SIGMOID_H_
\ No newline at end of file
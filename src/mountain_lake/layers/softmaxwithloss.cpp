@@ -2,12 +2,38 @@
 // https://opensource.org/licenses/MIT.
 #include "softmaxwithloss.h"
 
+/// @brief 对每一行输入做数值稳定的指数运算
+///        （Numerically stable exponentiation of every input row）
+/// @param A 输入（input）
+/// @param Y 输出，保存 e^(a - max)（output, holds e^(a - max)）
+/// @param max 每一行的最大值（maximum value of every row）
+/// @param sum 每一行 e^(a - max) 之和（sum of e^(a - max) of every row）
+/// @param fast_math 是否使用快速exp（whether to use the fast exp）
+/// @remark 按列优先的存储顺序处理整个矩阵，所以快速exp对批量与单行一样是
+///         一段连续的数据。
+///         The whole matrix is processed in its column-major storage order,
+///         so the fast exp sees one contiguous range for batches just as for
+///         a single row.
+static void ExpRows(MatrixXf &A, MatrixXf &Y, VectorXf &max, VectorXf &sum,
+                    bool fast_math = false) {
+  max = A.rowwise().maxCoeff();
+  if (fast_math) {
+    Y = A.colwise() - max;
+    FastExp(Y.data(), Y.data(), Y.size());
+  } else {
+    Y = (A.colwise() - max).array().exp();
+  }
+  sum = Y.rowwise().sum();
+}
+
 /// @brief Softmax函数（Softmax function）
 /// @param A 输入（input）
 /// @param Y 输出（output）
 void Softmax(Eigen::MatrixXf &A, Eigen::MatrixXf &Y) {
-  Eigen::MatrixXf X_exp = (A.array() - A.maxCoeff()).array().exp();
-  Y = X_exp / X_exp.sum();
+  VectorXf max;
+  VectorXf sum;
+  ExpRows(A, Y, max, sum);
+  Y.array().colwise() /= sum.array();
 }
 
 /// @brief 交叉熵函数（cross-entropy function）
@@ -25,8 +51,32 @@ float CrossEntropy(Eigen::MatrixXf &Y, int t) {
 /// @param Y 输出（output）
 /// @return 误差（errors）
 float SoftmaxWithLoss::Forward(int label, MatrixXf &A, MatrixXf &Y) {
-  Softmax(A, Y);
-  return CrossEntropy(Y, label);
+  uint8_t label_tmp = label;
+  return this->Forward(&label_tmp, A, Y);
+}
+
+/// @brief softmax与交叉熵误差合并层的批量正向传播
+/// Batched forward propagation of softmax and cross-entropy error merger layers
+/// @param labels 监督标签，每行一个（Supervisory labels, one per row）
+/// @param A 输入（input）
+/// @param Y 输出（output）
+/// @return 平均误差（mean error）
+/// @remark 误差由 log-sum-exp 直接得到：L = log(Σe^(a - max)) + max - a_t，
+///         不需要再对概率取对数。
+///         The error comes straight from log-sum-exp:
+///         L = log(Σe^(a - max)) + max - a_t, so there is no need to take
+///         the log of the probability again.
+float SoftmaxWithLoss::Forward(const uint8_t *labels, MatrixXf &A,
+                               MatrixXf &Y) {
+  VectorXf max;
+  VectorXf sum;
+  ExpRows(A, Y, max, sum, this->fast_math_);
+  float loss = 0.0f;
+  for (int r = 0; r < A.rows(); ++r) {
+    loss += std::log(sum(r)) + max(r) - A(r, labels[r]);
+  }
+  Y.array().colwise() /= sum.array();
+  return loss / A.rows();
 }
 
 /// @brief softmax与交叉熵误差合并层的反向传播
@@ -35,6 +85,101 @@ float SoftmaxWithLoss::Forward(int label, MatrixXf &A, MatrixXf &Y) {
 /// @param labels 监督标签（Supervisory label）
 /// @param dA 输入信号的导数（Derivative of the input signal）
 void SoftmaxWithLoss::Backward(MatrixXf &Y, uint8_t label, MatrixXf &dA) {
-  Y(0, label) -= 1;
+  this->Backward(Y, &label, dA);
+}
+
+/// @brief softmax与交叉熵误差合并层的批量反向传播
+/// Batched backpropagation of softmax and cross-entropy error merger layers
+/// @param Y 经过softmax函数处理过的信号（Signal processed by softmax function）
+/// @param labels 监督标签，每行一个（Supervisory labels, one per row）
+/// @param dA 输入信号的导数（Derivative of the input signal）
+/// @remark Y保持不变，可以继续用于统计准确率等指标。
+///         Y is left untouched so that it can still be used for metrics.
+void SoftmaxWithLoss::Backward(MatrixXf &Y, const uint8_t *labels,
+                               MatrixXf &dA) {
   dA = Y;
-}
\ No newline at end of file
+  for (int r = 0; r < Y.rows(); ++r) {
+    dA(r, labels[r]) -= 1;
+  }
+  if (Y.rows() > 1) dA /= Y.rows();
+}
+
+/// @brief 融合的正向与反向传播（Fused forward and backward propagation）
+/// @param labels 监督标签，每行一个（Supervisory labels, one per row）
+/// @param A 输入（input）
+/// @param dA 输入信号的导数（Derivative of the input signal）
+/// @return 平均误差（mean error）
+/// @remark 输入只读两遍：一遍求每一行的最大值，一遍减去最大值并求指数，
+///         写入dA。之后dA再经过两遍：求每一行的和、归一化，最后只修改标签
+///         处的一项。快速exp在减法之后对dA原地计算，多一遍。概率矩阵不会
+///         单独保存。
+///         The input is read only twice: once for the row maxima and once to
+///         subtract them and take the exponentials into dA. dA then takes two
+///         more passes, the row sums and the normalization, after which only
+///         the label entry of each row is touched. The fast exp runs in place
+///         on dA after the subtraction, one pass more. The probability matrix
+///         is never stored separately.
+float SoftmaxWithLoss::ForwardBackward(const uint8_t *labels, MatrixXf &A,
+                                       MatrixXf &dA) {
+  VectorXf max;
+  VectorXf sum;
+  ExpRows(A, dA, max, sum, this->fast_math_);
+  float loss = 0.0f;
+  float batch = A.rows();
+  for (int r = 0; r < A.rows(); ++r) {
+    loss += std::log(sum(r)) + max(r) - A(r, labels[r]);
+  }
+  dA.array().colwise() /= sum.array() * batch;
+  for (int r = 0; r < A.rows(); ++r) dA(r, labels[r]) -= 1 / batch;
+  return loss / batch;
+}
+
+/// @brief 求每一行的最大值索引（Index of the maximum of each row）
+/// @param A 输入（input）
+/// @param index 最大值索引（index of the maximum value）
+/// @remark 推理时使用，完全跳过归一化。
+///         Used for inference, normalization is skipped entirely.
+void SoftmaxWithLoss::Argmax(MatrixXf &A, MatrixXi &index) {
+  index.resize(A.rows(), 1);
+  for (int r = 0; r < A.rows(); ++r) {
+    A.row(r).maxCoeff(&index(r, 0));
+  }
+}
+
+/// @brief 求每一行概率最大的前k项（Top k probabilities of each row）
+/// @param A 输入（input）
+/// @param k 需要的项数（number of entries wanted）
+/// @param index 前k项的索引，按概率从大到小排列
+///        （indices of the top k entries, in descending probability）
+/// @param score 前k项经过softmax校准的概率
+///        （softmax-calibrated probabilities of the top k entries）
+/// @remark 只计算指数之和，不保存完整的概率矩阵。
+///         Only the sum of the exponentials is computed, the full probability
+///         matrix is never stored.
+void SoftmaxWithLoss::TopK(MatrixXf &A, int k, MatrixXi &index,
+                           MatrixXf &score) {
+  if (k > A.cols()) k = A.cols();
+  index.resize(A.rows(), k);
+  score.resize(A.rows(), k);
+  float max = 0.0f;
+  float sum = 0.0f;
+  int n = 0;
+  int j = 0;
+  for (int r = 0; r < A.rows(); ++r) {
+    max = A.row(r).maxCoeff();
+    sum = (A.row(r).array() - max).exp().sum();
+    // 插入排序维护前k项（Insertion sort keeps the top k entries）
+    n = 0;
+    for (int c = 0; c < A.cols(); ++c) {
+      if (n == k && A(r, c) <= A(r, index(r, k - 1))) continue;
+      j = n < k ? n++ : k - 1;
+      for (; j > 0 && A(r, index(r, j - 1)) < A(r, c); --j) {
+        index(r, j) = index(r, j - 1);
+      }
+      index(r, j) = c;
+    }
+    for (int i = 0; i < k; ++i) {
+      score(r, i) = std::exp(A(r, index(r, i)) - max) / sum;
+    }
+  }
+}
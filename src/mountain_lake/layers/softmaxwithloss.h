@@ -3,20 +3,35 @@
 #ifndef MOUNTAIN_LAKE_LAYERS_SOFTMAXWITHLOSS_H_
 #define MOUNTAIN_LAKE_LAYERS_SOFTMAXWITHLOSS_H_
 
+#include <mountain_lake/kernels/fast_math.h>
+
 #include <eigen3/Eigen/Dense>
 
 using Eigen::MatrixXf;
+using Eigen::MatrixXi;
+using Eigen::VectorXf;
 
 void Softmax(Eigen::MatrixXf &A, Eigen::MatrixXf &Y);
 float CrossEntropy(Eigen::MatrixXf &A, int t);
 
 /// @brief Softmax与Loss合并层类（Softmax and Loss Merge Layer Classes）
+/// @remark 输入的每一行是一个样本。
+///         Each row of the input is one sample.
 class SoftmaxWithLoss {
  public:
   explicit SoftmaxWithLoss(){};
   ~SoftmaxWithLoss(){};
   float Forward(int label, MatrixXf &A, MatrixXf &Y);
+  float Forward(const uint8_t *labels, MatrixXf &A, MatrixXf &Y);
   void Backward(MatrixXf &Y, uint8_t label, MatrixXf &dA);
+  void Backward(MatrixXf &Y, const uint8_t *labels, MatrixXf &dA);
+  float ForwardBackward(const uint8_t *labels, MatrixXf &A, MatrixXf &dA);
+  void Argmax(MatrixXf &A, MatrixXi &index);
+  void TopK(MatrixXf &A, int k, MatrixXi &index, MatrixXf &score);
+  inline void SetFastMath(bool fast_math) { this->fast_math_ = fast_math; }
+
+ private:
+  bool fast_math_ = false;  // 是否使用快速数学函数（whether to use fast math）
 };
 
 #endif  // MOUNTAIN_LAKE_LAYERS_SOFTMAXWITHLOSS_H_
@@ -0,0 +1,26 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "tanh.h"
+
+/// @brief 双曲正切层正向传播（Forward propagation of the tanh layer）
+/// @param A 输入（input）
+/// @param Z 输出（output）
+void Tanh::Forward(MatrixXf &A, MatrixXf &Z) {
+  if (this->fast_math_) {
+    Z.resize(A.rows(), A.cols());
+    FastTanh(A.data(), Z.data(), A.size());
+    return;
+  }
+  Z = A.array().tanh();
+}
+
+/// @brief 双曲正切层反向传播（Backpropagation of the tanh layer）
+/// @param dZ 输出信号的导数（Derivative of the output signal）
+/// @param Z 输出（output）
+/// @param dA 输入信号的导数（Derivative of the input signal）
+void Tanh::Backward(MatrixXf &dZ, MatrixXf &Z, MatrixXf &dA) {
+  dA = dZ.array() * (1 - Z.array().square());
+}
@@ -0,0 +1,28 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_LAYERS_TANH_H_
+#define MOUNTAIN_LAKE_LAYERS_TANH_H_
+
+#include <mountain_lake/kernels/fast_math.h>
+
+#include <eigen3/Eigen/Dense>
+
+using Eigen::MatrixXf;
+
+/// @brief 双曲正切函数类（Class of hyperbolic tangent functions）
+class Tanh {
+ public:
+  Tanh(){};
+  ~Tanh(){};
+  void Forward(MatrixXf &A, MatrixXf &Z);
+  void Backward(MatrixXf &dZ, MatrixXf &Z, MatrixXf &dA);
+  inline void SetFastMath(bool fast_math) { this->fast_math_ = fast_math; }
+
+ private:
+  bool fast_math_ = false;  // 是否使用快速数学函数（whether to use fast math）
+};
+
+#endif  // MOUNTAIN_LAKE_LAYERS_TANH_H_
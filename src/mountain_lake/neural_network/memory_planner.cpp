@@ -0,0 +1,53 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "memory_planner.h"
+
+/// @brief 按生存期为激活张量分配共享缓冲区
+///        （Assign activation tensors to shared buffers by liveness）
+/// @param tensors 按层号排列的张量，第i个张量由第i层产生
+///        （tensors in layer order, tensor i is produced by layer i）
+/// @return 内存规划（memory plan）
+/// @remark 张量i从第i层活到第last_use层。产生张量i时，已经不再被读取的张量
+///         所占的缓冲区可以复用；如果第i层能原地计算，它的输入所在的缓冲区也
+///         可以直接复用。为了避免重新分配内存，只有大小相同的张量才会共享缓冲区。
+///         Tensor i lives from layer i to layer last_use. When tensor i is
+///         produced, buffers of tensors that are no longer read can be reused;
+///         if layer i can run in place, the buffer of its input can be reused
+///         as well. To avoid reallocations, only tensors of the same size share
+///         a buffer.
+MemoryPlan PlanMemory(const vector<TensorInfo> &tensors) {
+  MemoryPlan plan;
+  int n = tensors.size();
+  plan.buffer_of.assign(n, -1);
+  // 每个缓冲区中张量的最后使用层（last use of the tensor in each buffer）
+  vector<int> busy_until;
+  for (int i = 0; i < n; ++i) {
+    plan.naive_bytes += tensors[i].size * sizeof(float);
+    int chosen = -1;
+    for (int b = 0; b < (int)plan.buffer_size.size(); ++b) {
+      if (plan.buffer_size[b] != tensors[i].size) continue;
+      // 在第i层之前就不再使用，或者是第i层的输入且第i层可以原地计算
+      // No longer used before layer i, or the input of layer i when layer i
+      // can run in place.
+      bool free = busy_until[b] < i ||
+                  (busy_until[b] == i && tensors[i].in_place && i > 0 &&
+                   plan.buffer_of[i - 1] == b);
+      if (free) {
+        chosen = b;
+        break;
+      }
+    }
+    if (chosen < 0) {
+      chosen = plan.buffer_size.size();
+      plan.buffer_size.push_back(tensors[i].size);
+      busy_until.push_back(0);
+      plan.planned_bytes += tensors[i].size * sizeof(float);
+    }
+    plan.buffer_of[i] = chosen;
+    busy_until[chosen] = tensors[i].last_use;
+  }
+  return plan;
+}
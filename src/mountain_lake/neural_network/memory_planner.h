@@ -0,0 +1,34 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_NEURAL_NETWORK_MEMORY_PLANNER_H_
+#define MOUNTAIN_LAKE_NEURAL_NETWORK_MEMORY_PLANNER_H_
+
+#include <vector>
+
+using std::vector;
+
+/// @brief 一个激活张量（one activation tensor）
+struct TensorInfo {
+  long size = 0;  // 每个样本的元素个数（elements per sample）
+  // 最后一次被读取的层号（number of the last layer that reads it）
+  int last_use = 0;
+  // 产生它的层能否在输入上原地计算（whether the layer producing it can run
+  // in place on its input）
+  bool in_place = false;
+};
+
+/// @brief 内存规划结果（memory plan）
+struct MemoryPlan {
+  vector<int> buffer_of;     // 每个张量使用的缓冲区（buffer of each tensor）
+  vector<long> buffer_size;  // 每个缓冲区的元素个数（elements per buffer）
+  long planned_bytes = 0;    // 规划后每个样本的字节数（bytes per sample）
+  long naive_bytes = 0;      // 不共享时每个样本的字节数（bytes per sample
+                             // without sharing）
+};
+
+MemoryPlan PlanMemory(const vector<TensorInfo> &tensors);
+
+#endif  // MOUNTAIN_LAKE_NEURAL_NETWORK_MEMORY_PLANNER_H_
@@ -5,6 +5,103 @@
 // https://opensource.org/licenses/MIT.
 #include "neural_network.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+
+/// @brief 数值不合法时的错误信息（error message for an invalid value）
+/// @param key 配置项（configuration key）
+/// @param text 配置的内容（configured text）
+/// @param kind 需要的数值类型（kind of number expected）
+static string BadValue(const string &key, const string &text,
+                       const string &kind) {
+  return "\"" + key + "\" must be " + kind + ", got \"" + text + "\".";
+}
+
+/// @brief 转换是否用完了整个字符串，允许末尾的空白（whether the conversion
+///        used up the whole string, trailing white space allowed）
+static bool ParsedAll(const char *begin, const char *end) {
+  if (end == begin) return false;
+  while (*end == ' ' || *end == '\t') ++end;
+  return *end == '\0' && errno != ERANGE;
+}
+
+/// @brief 读取整数配置项（Read an integer configuration item）
+/// @param conf 配置信息（configuration information）
+/// @param key 配置项（configuration key）
+/// @param value 读取的值，没有设置时不变（value read, unchanged when the item
+///        is not set）
+/// @return 错误信息（error message）
+/// @remark 用strtol转换并检查是否用完了整个字符串，配置写错时返回错误信息，
+///         而不是像std::stoi那样抛出异常。
+///         Converted with strtol and checked to use up the whole string, so a
+///         mistyped configuration returns an error message instead of
+///         throwing like std::stoi.
+string ReadConfigValue(unordered_map<string, string> &conf, const string &key,
+                       int &value) {
+  auto it = conf.find(key);
+  if (it == conf.end() || it->second.empty()) return "";
+  const char *begin = it->second.c_str();
+  char *end = nullptr;
+  errno = 0;
+  long v = strtol(begin, &end, 10);
+  if (!ParsedAll(begin, end) || v < INT_MIN || v > INT_MAX) {
+    return BadValue(key, it->second, "an integer");
+  }
+  value = v;
+  return "";
+}
+
+/// @brief 读取无符号整数配置项（Read an unsigned integer configuration item）
+/// @remark 参数与返回值同上，负数是错误。
+///         Parameters and return value as above, negative numbers are errors.
+string ReadConfigValue(unordered_map<string, string> &conf, const string &key,
+                       unsigned int &value) {
+  uint64_t v = value;
+  string err = ReadConfigValue(conf, key, v);
+  if (!err.empty()) return err;
+  if (v > UINT_MAX) return BadValue(key, conf[key], "an unsigned integer");
+  value = v;
+  return "";
+}
+
+/// @brief 读取64位无符号整数配置项（Read a 64-bit unsigned integer
+///        configuration item）
+/// @remark 参数与返回值同上，负数是错误。
+///         Parameters and return value as above, negative numbers are errors.
+string ReadConfigValue(unordered_map<string, string> &conf, const string &key,
+                       uint64_t &value) {
+  auto it = conf.find(key);
+  if (it == conf.end() || it->second.empty()) return "";
+  const char *begin = it->second.c_str();
+  char *end = nullptr;
+  errno = 0;
+  unsigned long long v = strtoull(begin, &end, 10);
+  if (!ParsedAll(begin, end) || it->second.find('-') != string::npos) {
+    return BadValue(key, it->second, "an unsigned integer");
+  }
+  value = v;
+  return "";
+}
+
+/// @brief 读取浮点数配置项（Read a floating-point configuration item）
+/// @remark 参数与返回值同上。
+///         Parameters and return value as above.
+string ReadConfigValue(unordered_map<string, string> &conf, const string &key,
+                       float &value) {
+  auto it = conf.find(key);
+  if (it == conf.end() || it->second.empty()) return "";
+  const char *begin = it->second.c_str();
+  char *end = nullptr;
+  errno = 0;
+  float v = strtof(begin, &end);
+  if (!ParsedAll(begin, end)) return BadValue(key, it->second, "a number");
+  value = v;
+  return "";
+}
+
 NeuralNetwork::NeuralNetwork() {}
 
 NeuralNetwork::~NeuralNetwork() {}
@@ -50,9 +147,183 @@ string NeuralNetwork::ReadConfig(string config_file) {
     }
   }
   this->layers_ = i;
+  this->fast_math_ = this->conf_["neural_network.fast_math"] == "true";
+  this->inference_ = this->conf_["neural_network.mode"] == "inference";
+  this->init_ = this->conf_["neural_network.init"];
+  if (this->init_.empty()) this->init_ = "normal";
+  this->seed_ = 0;
+  err = ReadConfigValue(this->conf_, "neural_network.seed", this->seed_);
+  if (!err.empty()) return err;
+  this->dropout_step_ = 0;
+  err = this->ReadCheckpointConfig();
+  if (!err.empty()) return err;
+  string activations = this->conf_["neural_network.activations"];
+  if (!activations.empty() && activations != "full" &&
+      activations != "compact") {
+    return "Unknown activations \"" + activations +
+           "\", use \"full\" or \"compact\".";
+  }
+  this->compact_ = activations == "compact" && !this->inference_;
+  if (this->compact_ && this->checkpointing_) {
+    return "Compact activations cannot be used with checkpointing.";
+  }
+  err = this->ReadGraph();
+  if (!err.empty()) {
+    return err;
+  }
+  if (this->dag_ && (this->checkpointing_ || this->compact_)) {
+    return "Checkpointing and compact activations need the layers to be a "
+           "chain.";
+  }
+  return this->ReadPruneConfig();
+}
+
+/// @brief 读取层之间的连接（Read the connections between layers）
+/// @return 错误信息（error message）
+/// @remark 与层同名的表中inputs列出这一层读取的层名，"input"为网络的输入，
+///         没有设置时读取前一层。读取的层必须在这一层之前并且名字唯一，所以
+///         struct的顺序就是拓扑顺序。Add与Concat层至少读取两层，其余层只读取
+///         一层；最后一层读取倒数第二层，其余每层的输出都必须被读取。一个层
+///         输出被多层读取时，每层把导数写到dO中自己的一项，反向传播到这个层
+///         时再相加，所以同时计算的分支不会写同一个矩阵。
+///         inputs in the table named after a layer lists the names of the
+///         layers it reads, "input" is the input of the network, and the
+///         previous layer is read when it is not set. A layer read must come
+///         before the reader and have a unique name, so the order of struct
+///         is a topological order. Add and Concat layers read at least two
+///         layers and every other layer exactly one; the last layer reads the
+///         one before it and the output of every other layer must be read.
+///         When an output is read by several layers, each of them writes the
+///         derivative to its own entry of dO and the entries are added up
+///         when backpropagation reaches that layer, so branches computed at
+///         the same time never write the same matrix.
+string NeuralNetwork::ReadGraph() {
+  this->dag_ = false;
+  vector<int> fanout(this->layers_ + 1, 0);
+  vector<string> names;
+  for (int i = 1; i <= this->layers_; ++i) {
+    const string &name = this->nnl_[i].name;
+    this->inputs_[i].assign(1, i - 1);
+    string value = this->conf_[name + ".inputs"];
+    if (!value.empty()) {
+      ReadSTOMLArr(value, names);
+      this->inputs_[i].clear();
+      for (auto &input : names) {
+        int k = input == "input" ? 0 : -1;
+        int count = k == 0 ? 1 : 0;
+        for (int j = 1; j < i; ++j) {
+          if (this->nnl_[j].name != input) continue;
+          k = j;
+          ++count;
+        }
+        if (count != 1) {
+          return "The input \"" + input + "\" of \"" + name +
+                 "\" must name exactly one layer before it.";
+        }
+        this->inputs_[i].push_back(k);
+      }
+    }
+    bool merge = this->nnl_[i].type == "Add" || this->nnl_[i].type == "Concat";
+    if (merge && this->inputs_[i].size() < 2) {
+      return "\"" + name + "\" must read at least two layers.";
+    }
+    if (!merge && this->inputs_[i].size() != 1) {
+      return "\"" + name + "\" must read exactly one layer.";
+    }
+    if (this->inputs_[i] != vector<int>(1, i - 1)) this->dag_ = true;
+    for (int k : this->inputs_[i]) ++fanout[k];
+  }
+  if (this->inputs_[this->layers_] != vector<int>(1, this->layers_ - 1)) {
+    return "The last layer must read the layer before it.";
+  }
+  for (int k = 0; k < this->layers_; ++k) {
+    if (fanout[k] == 0) {
+      return "The output of \"" + (k == 0 ? "input" : this->nnl_[k].name) +
+             "\" is never read.";
+    }
+  }
+  this->slot_count_ = this->layers_ + 1;
+  for (int k = 0; k <= this->layers_; ++k) this->grads_[k].clear();
+  for (int i = 1; i <= this->layers_; ++i) {
+    this->slots_[i].clear();
+    for (int k : this->inputs_[i]) {
+      int slot = k;
+      if (fanout[k] > 1) {
+        slot = this->slot_count_++;
+        this->grads_[k].push_back(slot);
+      }
+      this->slots_[i].push_back(slot);
+    }
+  }
+  if (this->slot_count_ > 100) {
+    return "Too many layer outputs are read by several layers.";
+  }
   return "";
 }
 
+/// @brief 读取检查点配置（Read the checkpointing configuration）
+/// @remark checkpointing表中的every为k时保留每第k层的输出，与层同名的表中
+///         checkpoint为true时保留该层的输出。输入和SoftmaxWithLoss层的输入
+///         总是保留。推理模式下不使用检查点。
+///         With every set to k in the checkpointing table the output of every
+///         k-th layer is kept, checkpoint set to true in the table named after
+///         a layer keeps the output of that layer. The input and the input of
+///         the SoftmaxWithLoss layer are always kept. Checkpointing is not
+///         used in inference mode.
+string NeuralNetwork::ReadCheckpointConfig() {
+  int k = 0;
+  string err = ReadConfigValue(this->conf_, "checkpointing.every", k);
+  if (!err.empty()) return err;
+  this->checkpointing_ = false;
+  for (int i = 0; i <= this->layers_; ++i) {
+    this->checkpoint_[i] =
+        i == 0 || i >= this->layers_ - 1 || (k > 0 && i % k == 0);
+    if (this->conf_[this->nnl_[i].name + ".checkpoint"] == "true") {
+      this->checkpoint_[i] = true;
+      this->checkpointing_ = true;
+    }
+  }
+  if (k > 0) this->checkpointing_ = true;
+  if (this->inference_) this->checkpointing_ = false;
+  return "";
+}
+
+/// @brief 读取剪枝配置（Read the pruning configuration）
+/// @return 错误信息（error message）
+/// @remark 配置在pruning表中，没有设置sparsity时不剪枝。
+///         The configuration lives in the pruning table, nothing is pruned
+///         when sparsity is not set.
+string NeuralNetwork::ReadPruneConfig() {
+  this->prune_ = PruneConfig();
+  if (this->conf_["pruning.sparsity"].empty()) return "";
+  this->prune_.enabled = true;
+  string err =
+      ReadConfigValue(this->conf_, "pruning.sparsity", this->prune_.sparsity);
+  if (!err.empty()) return err;
+  if (!this->conf_["pruning.format"].empty()) {
+    this->prune_.format = ParseSparseFormat(this->conf_["pruning.format"]);
+    if (this->prune_.format < 0) {
+      return "Unknown sparse format \"" + this->conf_["pruning.format"] +
+             "\", use \"csr\", \"1x8\" or \"4x4\".";
+    }
+  }
+  err = ReadConfigValue(this->conf_, "pruning.begin_step",
+                        this->prune_.begin_step);
+  if (err.empty()) {
+    err = ReadConfigValue(this->conf_, "pruning.end_step",
+                          this->prune_.end_step);
+  }
+  if (err.empty()) {
+    err = ReadConfigValue(this->conf_, "pruning.frequency",
+                          this->prune_.frequency);
+  }
+  if (err.empty()) {
+    err = ReadConfigValue(this->conf_, "pruning.density_threshold",
+                          this->prune_.density_threshold);
+  }
+  return err;
+}
+
 /// @brief 初始化神经网络（Initialize the neural network）
 /// @param config_file 配置文件名称（Configuration file name）
 /// @param raw_data 原始数据（raw data）
@@ -60,12 +331,37 @@ string NeuralNetwork::ReadConfig(string config_file) {
 ///         The configuration file requirement is a TOML file.
 /// @return 错误信息（error message）
 string NeuralNetwork::Init(string config_file, RawData &raw_data) {
+  this->raw_data_ = raw_data;
+  return this->InitShared(config_file, this->raw_data_);
+}
+
+/// @brief 不复制原始数据，初始化神经网络（Initialize the neural network
+///        without copying the raw data）
+/// @param config_file 配置文件名称（Configuration file name）
+/// @param raw_data 原始数据，在神经网络使用期间必须保留并且不被修改（raw
+///        data, it must stay alive and unchanged while the network uses it）
+/// @return 错误信息（error message）
+/// @remark 神经网络只读取原始数据，所以多个神经网络可以共享同一份数据，
+///         例如超参数搜索中同时训练的模型。
+///         The network only reads the raw data, so several networks may
+///         share one copy of it, for example the models trained at the same
+///         time by a hyperparameter sweep.
+string NeuralNetwork::InitShared(string config_file,
+                                 const RawData &raw_data) {
+  this->data_ = &raw_data;
   string err = this->ReadConfig(config_file);
   if (!err.empty()) {
     return err;
   }
+  err = NeuralNetwork::StartThreadPool(this->conf_);
+  if (!err.empty()) {
+    return err;
+  }
   // 逐层进行初始化（Layer-by-layer initialization）
-  this->raw_data_ = raw_data;
+  this->sigmoid_.SetFastMath(this->fast_math_);
+  this->tanh_.SetFastMath(this->fast_math_);
+  this->gelu_.SetFastMath(this->fast_math_);
+  this->softmax_loss_.SetFastMath(this->fast_math_);
   this->nnl_[0].output_height = raw_data.row;
   this->nnl_[0].output_width = raw_data.col;
   this->nnl_[0].output_size = raw_data.size;
@@ -78,6 +374,14 @@ string NeuralNetwork::Init(string config_file, RawData &raw_data) {
       }
       continue;
     }
+    // 初始化低秩仿射变换层（Initialize the low-rank affine layer）
+    if (this->nnl_[i].type == "LowRankAffine") {
+      err = this->InitLowRankAffine(i);
+      if (err.empty() == false) {
+        return err;
+      }
+      continue;
+    }
     // 初始化Sigmoid层参数
     if (this->nnl_[i].type == "Sigmoid") {
       this->InitSigmoid(i);
@@ -88,6 +392,35 @@ string NeuralNetwork::Init(string config_file, RawData &raw_data) {
       this->InitRelu(i);
       continue;
     }
+    // 初始化双曲正切层与GELU层参数
+    if (this->nnl_[i].type == "Tanh" || this->nnl_[i].type == "GELU") {
+      this->InitActivation(i);
+      continue;
+    }
+    // 初始化带泄露线性整流层参数
+    if (this->nnl_[i].type == "LeakyReLU") {
+      err = this->InitLeakyRelu(i);
+      if (err.empty() == false) {
+        return err;
+      }
+      continue;
+    }
+    // 初始化丢弃层参数
+    if (this->nnl_[i].type == "Dropout") {
+      err = this->InitDropout(i);
+      if (err.empty() == false) {
+        return err;
+      }
+      continue;
+    }
+    // 初始化批量归一化层参数
+    if (this->nnl_[i].type == "BatchNorm") {
+      err = this->InitBatchNorm(i);
+      if (err.empty() == false) {
+        return err;
+      }
+      continue;
+    }
     // 初始化SoftmaxWithLoss层参数
     if (this->nnl_[i].type == "SoftmaxWithLoss") {
       this->InitSoftmaxWithLoss(i);
@@ -102,6 +435,21 @@ string NeuralNetwork::Init(string config_file, RawData &raw_data) {
       }
       continue;
     }
+    // 初始化逐通道卷积层与逐点卷积层参数
+    if (this->nnl_[i].type == "DepthwiseConvolution") {
+      err = this->InitDepthwiseConv(i);
+      if (err.empty() == false) {
+        return err;
+      }
+      continue;
+    }
+    if (this->nnl_[i].type == "PointwiseConvolution") {
+      err = this->InitPointwiseConv(i);
+      if (err.empty() == false) {
+        return err;
+      }
+      continue;
+    }
     // 初始化池化层参数
     if (this->nnl_[i].type == "Pooling") {
       err = this->InitPool(i);
@@ -110,54 +458,539 @@ string NeuralNetwork::Init(string config_file, RawData &raw_data) {
       }
       continue;
     }
+    if (this->nnl_[i].type == "GlobalAvgPool" ||
+        this->nnl_[i].type == "GlobalMaxPool") {
+      err = this->InitGlobalPool(i);
+      if (err.empty() == false) {
+        return err;
+      }
+      continue;
+    }
+    // 初始化合并层参数
+    if (this->nnl_[i].type == "Add" || this->nnl_[i].type == "Concat") {
+      err = this->InitMerge(i);
+      if (err.empty() == false) {
+        return err;
+      }
+      continue;
+    }
+  }
+  this->FuseLayers();
+  if (this->dag_) this->ScheduleGraph();
+  if (this->compact_) this->PlanCompact();
+  if (this->inference_) {
+    this->FoldBatchNorm();
+    this->PlanMemory();
   }
+  this->PackWeights();
   return "";
 }
 
+/// @brief 按配置文件的thread_pool表配置全局线程池（Configure the global thread
+///        pool with the thread_pool table of a configuration file）
+/// @param config_file 配置文件名称（Configuration file name）
+/// @return 错误信息（error message）
+/// @remark 线程池是进程共享的，应用程序应当在创建任何神经网络之前调用一次。
+///         Init()也会应用thread_pool表，但线程池第一次使用之后只接受与当前
+///         相同的配置，不会在其他神经网络计算时重新启动。
+///         The pool is shared by the whole process, so the application
+///         should call this once before creating any network. Init() applies
+///         the thread_pool table as well, but after the pool's first use only
+///         the current configuration is accepted, and the pool is never
+///         restarted while other networks are computing.
+string NeuralNetwork::ConfigureThreadPool(string config_file) {
+  unordered_map<string, string> conf;
+  string err = ReadSTOML(config_file, conf);
+  if (!err.empty()) {
+    return err;
+  }
+  return NeuralNetwork::StartThreadPool(conf);
+}
+
+/// @brief 按thread_pool表配置全局线程池（Configure the global thread pool with
+///        the thread_pool table）
+/// @param conf 配置信息（configuration information）
+/// @return 错误信息（error message）
+/// @remark 没有thread_pool表时全局线程池使用全部可用的CPU。应用程序自己也有
+///         线程时，可以用reserved留出这些线程使用的CPU，避免超额订阅。
+///         Without a thread_pool table the global pool uses every available
+///         CPU. When the application has threads of its own, reserved leaves
+///         their CPUs free to avoid oversubscription.
+string NeuralNetwork::StartThreadPool(unordered_map<string, string> &conf) {
+  ThreadPoolConfig config;
+  string threads = conf["thread_pool.threads"];
+  string reserved = conf["thread_pool.reserved"];
+  string pin = conf["thread_pool.pin"];
+  string numa = conf["thread_pool.numa"];
+  if (threads.empty() && reserved.empty() && pin.empty() && numa.empty()) {
+    return "";
+  }
+  string err = ReadConfigValue(conf, "thread_pool.threads", config.threads);
+  if (err.empty()) {
+    err = ReadConfigValue(conf, "thread_pool.reserved", config.reserved);
+  }
+  if (!err.empty()) return err;
+  config.pin = pin == "true";
+  config.numa = numa == "true";
+  return ThreadPool::Global().Configure(config);
+}
+
+/// @brief 找出可以融合的卷积、ReLU与池化层（Find the convolution, ReLU and
+///        pooling layers that can be fused）
+/// @remark 依次为Convolution、ReLU和最大值Pooling的三层在正向与反向传播中
+///         作为一步计算，中间两层的输出不再分配。neural_network表中fuse为
+///         false时不融合。中间两层的输出只能被组内的下一层读取。
+///         Three consecutive Convolution, ReLU and max Pooling layers run as
+///         one step in forward and backward propagation, and the outputs of
+///         the two inner layers are no longer allocated. Nothing is fused when
+///         fuse is false in the neural_network table. The inner outputs must
+///         each be read only by the next layer of the group.
+void NeuralNetwork::FuseLayers() {
+  bool fuse = this->conf_["neural_network.fuse"] != "false";
+  for (int i = 0; i <= this->layers_; ++i) this->fused_[i] = false;
+  for (int i = 1; fuse && i + 2 < this->layers_; ++i) {
+    if (this->nnl_[i].type != "Convolution" ||
+        this->nnl_[i + 1].type != "ReLU" ||
+        this->nnl_[i + 2].type != "Pooling" ||
+        !ConvReluPool::CanFuse(this->cc_[i], this->pc_[i + 2])) {
+      continue;
+    }
+    // 中间的输出被其他层读取时不能融合（not fused when another layer reads
+    // an inner output）
+    if (this->inputs_[i + 1][0] != i || this->inputs_[i + 2][0] != i + 1 ||
+        !this->grads_[i].empty() || !this->grads_[i + 1].empty()) {
+      continue;
+    }
+    this->fused_[i] = true;
+    for (int k = i; k <= i + 1; ++k) {
+      this->O_[k] = MatrixXf();
+      this->dO_[k] = MatrixXf();
+      // 中间两层的输出不存在，不能作为检查点
+      // The inner outputs do not exist and cannot be checkpoints.
+      this->checkpoint_[k] = false;
+    }
+    i += 2;
+  }
+}
+
+/// @brief 按层级安排正向与反向传播的步（Schedule the forward and backward
+///        steps by level）
+/// @remark 输入的层级为0，每层的层级比它读取的层中最高的层级大1，所以同一
+///         层级的步互不依赖，可以在不同的核上同时计算。融合的三层作为一步，
+///         正向传播时放在第一层的层级，反向传播时放在最后一层的层级。
+///         The input is at level 0 and every layer is one level above the
+///         highest layer it reads, so the steps of one level do not depend
+///         on each other and can run on different cores at the same time. A
+///         fused group of three layers is one step, placed at the level of
+///         its first layer in forward propagation and of its last layer in
+///         backpropagation.
+void NeuralNetwork::ScheduleGraph() {
+  vector<int> level(this->layers_ + 1, 0);
+  for (int i = 1; i <= this->layers_; ++i) {
+    for (int k : this->inputs_[i]) level[i] = std::max(level[i], level[k] + 1);
+  }
+  // 每层都通向最后一层，所以最后一层的层级最高（every layer leads to the
+  // last one, so the last layer has the highest level）
+  int depth = level[this->layers_];
+  this->forward_levels_.assign(depth + 1, vector<int>());
+  this->backward_levels_.assign(depth + 1, vector<int>());
+  for (int i = 1; i <= this->layers_; ++i) {
+    bool inner = this->fused_[i - 1] || (i >= 2 && this->fused_[i - 2]);
+    if (!inner && i < this->layers_) {
+      this->forward_levels_[level[i]].push_back(i);
+    }
+    bool open = this->fused_[i] || this->fused_[i - 1];
+    if (!open) this->backward_levels_[level[i]].push_back(i);
+  }
+}
+
+/// @brief 第i层在紧凑模式下是否只保存掩码或位置（Whether layer i keeps only
+///        a mask or positions in compact mode）
+/// @param i 层号（layer number）
+/// @remark 池化窗口超过256个元素时位置放不进一个字节，仍然保存输入。
+///         A pooling window of more than 256 elements does not fit its
+///         positions in a byte, so the input is still kept.
+bool NeuralNetwork::CompactLayer(int i) {
+  if (this->nnl_[i].type == "ReLU") return true;
+  if (this->nnl_[i].type != "Pooling") return false;
+  if (this->pc_[i].type == 1) return true;
+  return this->pc_[i].height * this->pc_[i].width <= 256;
+}
+
+/// @brief 找出紧凑模式下反向传播需要的层输出（Find the layer outputs needed
+///        by backpropagation in compact mode）
+/// @remark ReLU层只需要输出的符号，池化层只需要最大值的位置，全局平均池化
+///         层与丢弃层什么都不需要，它们由正向传播记录在masks_中。其余层的
+///         反向传播读取自己的输出（Sigmoid、Tanh、LeakyReLU）或输入（其余
+///         带参数的层、GELU与全局最大池化层）。一个层输出既不被自己也不被
+///         下一步需要时，下一步读取后就释放。
+///         A ReLU layer only needs the sign of its output, a pooling layer
+///         only the positions of the maxima, and global average pooling and
+///         dropout layers need nothing; forward propagation records these in
+///         masks_. The backpropagation of every other layer reads its own
+///         output (Sigmoid, Tanh, LeakyReLU) or its input (the other layers
+///         with parameters, GELU and global max pooling). An output needed
+///         neither by its own layer nor by the next step is freed once the
+///         next step has read it.
+void NeuralNetwork::PlanCompact() {
+  for (int k = 0; k < this->layers_; ++k) {
+    const string &type = this->nnl_[k].type;
+    bool own = type == "Sigmoid" || type == "Tanh" || type == "LeakyReLU";
+    const string &next = this->nnl_[k + 1].type;
+    bool input = !this->CompactLayer(k + 1) && next != "GlobalAvgPool" &&
+                 next != "Dropout" && next != "SoftmaxWithLoss" &&
+                 next != "Sigmoid" && next != "Tanh" && next != "LeakyReLU";
+    // 融合层的中间输出不存在（the inner outputs of a fused group do not
+    // exist）
+    if (k >= 1 && (this->fused_[k] || (k >= 2 && this->fused_[k - 1]))) {
+      own = false;
+      input = false;
+    }
+    this->keep_[k] = k == 0 || k == this->layers_ - 1 || own || input;
+  }
+}
+
 /// @brief 初始化仿射变换层（Initialize the affine transformation layer）
 /// @param i 当前层号（current layer number）
 /// @return 错误信息（error message）
 string NeuralNetwork::InitAffine(int i) {
+  const NeuralNetworkLayer &input = this->nnl_[this->inputs_[i][0]];
   this->nnl_[i].output_height = 1;
   this->nnl_[i].output_width = this->nnl_[i].output_size;
-  int size = this->nnl_[i - 1].output_size * this->nnl_[i].output_size;
-  this->W_[i] =
-      MatrixXf(this->nnl_[i - 1].output_size, this->nnl_[i].output_size);
-  float *w_tmp = new float[size];
-  if (w_tmp == nullptr) {
-    return "Memory allocation failed when initializing the affine "
-           "transformation layer.";
-  }
-  NormalDistr(w_tmp, size, 0.0, 0.01);
-  memcpy(this->W_[i].data(), w_tmp, size * sizeof(float));
-  delete[] w_tmp;
-  this->dW_[i] =
-      MatrixXf::Zero(this->nnl_[i - 1].output_size, this->nnl_[i].output_size);
+  this->W_[i] = MatrixXf(input.output_size, this->nnl_[i].output_size);
+  string err =
+      this->InitWeights(i, input.output_size, this->nnl_[i].output_size);
+  if (!err.empty()) {
+    return err;
+  }
   this->B_[i] = MatrixXf::Zero(1, this->nnl_[i].output_size);
-  this->dB_[i] = MatrixXf::Zero(1, this->nnl_[i].output_size);
+  this->AllocateBuffers(i);
+  return "";
+}
+
+/// @brief 初始化低秩仿射变换层（Initialize the low-rank affine layer）
+/// @param i 当前层号（current layer number）
+/// @return 错误信息（error message）
+/// @remark 秩在与层同名的表中用rank设置，必须设置。两个因子按两个依次相连、
+///         中间宽度为秩的仿射变换层初始化，U的标准差按(输入数, 秩)计算，
+///         V的按(秩, 输出数)计算。
+///         The rank is set with rank in the table named after the layer and
+///         is required. The two factors are initialized like two chained
+///         affine layers with the rank as the width in between, U with the
+///         standard deviation of (inputs, rank) and V with that of
+///         (rank, outputs).
+string NeuralNetwork::InitLowRankAffine(int i) {
+  int r = 0;
+  string err = ReadConfigValue(this->conf_, this->nnl_[i].name + ".rank", r);
+  if (!err.empty()) return err;
+  if (r < 1) {
+    return "The \"rank\" of \"" + this->nnl_[i].name +
+           "\" must be set to at least 1.";
+  }
+  int inputs = this->nnl_[this->inputs_[i][0]].output_size;
+  int outputs = this->nnl_[i].output_size;
+  this->nnl_[i].output_height = 1;
+  this->nnl_[i].output_width = outputs;
+  float u = 0.0f;
+  float v = 0.0f;
+  err = this->WeightStddev(i, inputs, r, u);
+  if (!err.empty()) return err;
+  this->WeightStddev(i, r, outputs, v);
+  this->W_[i] = MatrixXf(inputs + outputs, r);
+  PhiloxNormal(this->W_[i].data(), this->W_[i].size(), 0.0f, 1.0f,
+               this->seed_, i);
+  this->W_[i].topRows(inputs) *= u;
+  this->W_[i].bottomRows(outputs) *= v;
+  this->B_[i] = MatrixXf::Zero(1, outputs);
+  this->AllocateBuffers(i);
+  return "";
+}
+
+/// @brief 分配层输出与导数（Allocate the layer output and derivatives）
+/// @param i 当前层号（current layer number）
+/// @remark 推理模式下层输出由内存规划统一分配，导数完全不分配。
+///         In inference mode the layer outputs are allocated by the memory
+///         plan and no derivatives are allocated at all.
+void NeuralNetwork::AllocateBuffers(int i) {
+  if (this->inference_) return;
   this->O_[i] = MatrixXf::Zero(1, this->nnl_[i].output_size);
   this->dO_[i] = MatrixXf::Zero(1, this->nnl_[i].output_size);
+  this->dW_[i] = MatrixXf::Zero(this->W_[i].rows(), this->W_[i].cols());
+  this->dB_[i] = MatrixXf::Zero(this->B_[i].rows(), this->B_[i].cols());
+}
+
+/// @brief 按生存期规划推理时的层输出（Plan the layer outputs of inference by
+///        liveness）
+/// @remark 第i个张量是第i层的输出，O[0]为输入，用到读取它的最后一层，最后
+///         一个张量保留到最后。读取前一层的逐元素激活函数层可以原地计算，GELU
+///         需要在写入输出后再读取输入，所以不能原地计算。
+///         Tensor i is the output of layer i and O[0] is the input, each is
+///         used until the last layer reading it and the last one is kept to
+///         the end. Element-wise activation layers reading the previous layer
+///         can run in place, GELU reads its input again after writing the
+///         output, so it cannot.
+void NeuralNetwork::PlanMemory() {
+  vector<TensorInfo> tensors(this->layers_);
+  for (int i = 0; i < this->layers_; ++i) {
+    tensors[i].size = this->nnl_[i].output_size;
+    const string &type = this->nnl_[i].type;
+    tensors[i].in_place = i > 0 && this->inputs_[i][0] == i - 1 &&
+                          (type == "Sigmoid" || type == "ReLU" ||
+                           type == "Tanh" || type == "LeakyReLU" ||
+                           type == "BatchNorm" || type == "Dropout");
+  }
+  for (int i = 1; i <= this->layers_; ++i) {
+    for (int k : this->inputs_[i]) {
+      tensors[k].last_use = std::max(tensors[k].last_use, i);
+    }
+  }
+  // 融合层的输入一直用到池化层，中间两层没有输出
+  // The input of a fused group is read until the pooling layer, and the two
+  // inner layers have no output.
+  for (int i = 1; i + 2 < this->layers_; ++i) {
+    if (!this->fused_[i]) continue;
+    int x = this->inputs_[i][0];
+    tensors[x].last_use = std::max(tensors[x].last_use, i + 2);
+    tensors[i].size = 0;
+    tensors[i + 1].size = 0;
+  }
+  this->plan_ = ::PlanMemory(tensors);
+  this->buffers_.assign(this->plan_.buffer_size.size(), MatrixXf());
+  for (int b = 0; b < (int)this->plan_.buffer_size.size(); ++b) {
+    this->buffers_[b] = MatrixXf::Zero(1, this->plan_.buffer_size[b]);
+  }
+}
+
+/// @brief 某一层的输出（Output of a layer）
+/// @param i 层号（layer number）
+/// @return 层输出，推理模式下为规划后的共享缓冲区（layer output, a shared
+///         buffer of the plan in inference mode）
+MatrixXf &NeuralNetwork::Output(int i) {
+  return this->inference_ ? this->buffers_[this->plan_.buffer_of[i]]
+                          : this->O_[i];
+}
+
+/// @brief 原地初始化权重（Initialize the weights in place）
+/// @param i 当前层号（current layer number）
+/// @param fan_in 每个输出连接的输入数（inputs connected to each output）
+/// @param fan_out 每个输入连接的输出数（outputs connected to each input）
+/// @return 错误信息（error message）
+/// @remark 初始化方式在与层同名的表中用init设置，没有设置时使用
+///         neural_network表中的init，默认为normal。可选的方式有：
+///         he，标准差为sqrt(2/fan_in)；xavier，标准差为sqrt(2/(fan_in+fan_out))；
+///         lecun，标准差为sqrt(1/fan_in)；normal，标准差由stddev设置，默认为0.01。
+///         随机数由Philox按种子和层号生成，并行填充，结果与线程数无关。
+///         The scheme is set with init in the table named after the layer,
+///         falling back to init in the neural_network table, the default is
+///         normal. The schemes are: he, stddev sqrt(2/fan_in); xavier, stddev
+///         sqrt(2/(fan_in+fan_out)); lecun, stddev sqrt(1/fan_in); normal,
+///         stddev set by stddev, 0.01 by default.
+///         The random numbers come from Philox keyed by the seed and the layer
+///         number and are filled in parallel, the result does not depend on
+///         the number of threads.
+string NeuralNetwork::InitWeights(int i, int fan_in, int fan_out) {
+  float stddev = 0.01f;
+  string err = this->WeightStddev(i, fan_in, fan_out, stddev);
+  if (!err.empty()) return err;
+  PhiloxNormal(this->W_[i].data(), this->W_[i].size(), 0.0f, stddev,
+               this->seed_, i);
+  return "";
+}
+
+/// @brief 按初始化方式计算权重的标准差（Standard deviation of the weights by
+///        the initialization scheme）
+/// @param i 当前层号（current layer number）
+/// @param fan_in 每个输出连接的输入数（inputs connected to each output）
+/// @param fan_out 每个输入连接的输出数（outputs connected to each input）
+/// @param stddev 标准差（standard deviation）
+/// @return 错误信息（error message）
+string NeuralNetwork::WeightStddev(int i, int fan_in, int fan_out,
+                                   float &stddev) {
+  string init = this->conf_[this->nnl_[i].name + ".init"];
+  if (init.empty()) init = this->init_;
+  stddev = 0.01f;
+  if (init == "he") {
+    stddev = std::sqrt(2.0f / fan_in);
+  } else if (init == "xavier") {
+    stddev = std::sqrt(2.0f / (fan_in + fan_out));
+  } else if (init == "lecun") {
+    stddev = std::sqrt(1.0f / fan_in);
+  } else if (init == "normal") {
+    return ReadConfigValue(this->conf_, this->nnl_[i].name + ".stddev",
+                           stddev);
+  } else {
+    return "Unknown initialization \"" + init + "\" of \"" +
+           this->nnl_[i].name +
+           "\", use \"he\", \"xavier\", \"lecun\" or \"normal\".";
+  }
   return "";
 }
 
 /// @brief 初始化sigmoid激活函数层
 /// @param i 序号
 void NeuralNetwork::InitSigmoid(int i) {
-  this->nnl_[i].output_height = this->nnl_[i - 1].output_height;
-  this->nnl_[i].output_width = this->nnl_[i - 1].output_width;
-  this->nnl_[i].output_size = this->nnl_[i - 1].output_size;
-  this->O_[i] = MatrixXf::Zero(1, this->nnl_[i].output_size);
-  this->dO_[i] = MatrixXf::Zero(1, this->nnl_[i].output_size);
+  const NeuralNetworkLayer &input = this->nnl_[this->inputs_[i][0]];
+  this->nnl_[i].output_height = input.output_height;
+  this->nnl_[i].output_width = input.output_width;
+  this->nnl_[i].output_size = input.output_size;
+  this->AllocateBuffers(i);
 }
 
 /// @brief 初始化线性整流激活函数层
 /// @param i 序号
 void NeuralNetwork::InitRelu(int i) {
-  this->nnl_[i].output_height = this->nnl_[i - 1].output_height;
-  this->nnl_[i].output_width = this->nnl_[i - 1].output_width;
-  this->nnl_[i].output_size = this->nnl_[i - 1].output_size;
-  this->O_[i] = MatrixXf::Zero(1, this->nnl_[i].output_size);
-  this->dO_[i] = MatrixXf::Zero(1, this->nnl_[i].output_size);
+  const NeuralNetworkLayer &input = this->nnl_[this->inputs_[i][0]];
+  this->nnl_[i].output_height = input.output_height;
+  this->nnl_[i].output_width = input.output_width;
+  this->nnl_[i].output_size = input.output_size;
+  this->AllocateBuffers(i);
+}
+
+/// @brief 初始化输出大小与输入相同的激活函数层
+///        （Initialize an activation layer whose output matches its input）
+/// @param i 序号
+void NeuralNetwork::InitActivation(int i) {
+  const NeuralNetworkLayer &input = this->nnl_[this->inputs_[i][0]];
+  this->nnl_[i].output_height = input.output_height;
+  this->nnl_[i].output_width = input.output_width;
+  this->nnl_[i].output_size = input.output_size;
+  this->AllocateBuffers(i);
+}
+
+/// @brief 初始化带泄露线性整流层
+/// @param i 序号
+/// @return 错误信息（error message）
+/// @remark 斜率可以在与层同名的表中用alpha设置，默认为0.01，必须大于0。
+///         The slope can be set with alpha in the table named after the
+///         layer, the default is 0.01, and it must be greater than 0.
+string NeuralNetwork::InitLeakyRelu(int i) {
+  this->InitActivation(i);
+  this->alpha_[i] = 0.01f;
+  string err = ReadConfigValue(this->conf_, this->nnl_[i].name + ".alpha",
+                               this->alpha_[i]);
+  if (!err.empty()) return err;
+  if (this->alpha_[i] <= 0.0f) {
+    return "The \"alpha\" of \"" + this->nnl_[i].name +
+           "\" must be greater than 0.";
+  }
+  return "";
+}
+
+/// @brief 初始化丢弃层（Initialize the dropout layer）
+/// @param i 序号
+/// @return 错误信息（error message）
+/// @remark 丢弃概率可以在与层同名的表中用rate设置，默认为0.5，必须在[0, 1)
+///         之间。
+///         The drop rate can be set with rate in the table named after the
+///         layer, the default is 0.5, and it must be in [0, 1).
+string NeuralNetwork::InitDropout(int i) {
+  this->InitActivation(i);
+  this->rate_[i] = 0.5f;
+  string err = ReadConfigValue(this->conf_, this->nnl_[i].name + ".rate",
+                               this->rate_[i]);
+  if (!err.empty()) return err;
+  if (this->rate_[i] < 0.0f || this->rate_[i] >= 1.0f) {
+    return "The \"rate\" of \"" + this->nnl_[i].name +
+           "\" must be at least 0 and less than 1.";
+  }
+  return "";
+}
+
+/// @brief 初始化批量归一化层（Initialize the batch normalization layer）
+/// @param i 序号
+/// @remark 卷积层或池化层之后（中间可以有激活函数层）按通道归一化，其余按
+///         每个特征归一化。动量与epsilon可以在与层同名的表中用momentum与
+///         epsilon设置，默认为0.9与1e-5。
+///         After a convolutional or pooling layer (with activation layers in
+///         between allowed) each channel is normalized, otherwise each
+///         feature. The momentum and epsilon can be set with momentum and
+///         epsilon in the table named after the layer, the defaults are 0.9
+///         and 1e-5.
+/// @return 错误信息（error message）
+string NeuralNetwork::InitBatchNorm(int i) {
+  this->InitActivation(i);
+  BatchNormConfig &bc = this->bc_[i];
+  bc = BatchNormConfig();
+  bc.channels = this->NormChannels(this->inputs_[i][0]);
+  bc.spatial = this->nnl_[i].output_size / bc.channels;
+  string err = ReadConfigValue(this->conf_, this->nnl_[i].name + ".momentum",
+                               bc.momentum);
+  if (err.empty()) {
+    err = ReadConfigValue(this->conf_, this->nnl_[i].name + ".epsilon",
+                          bc.epsilon);
+  }
+  if (!err.empty()) return err;
+  this->folded_[i] = false;
+  this->W_[i] = MatrixXf::Ones(1, bc.channels);
+  this->B_[i] = MatrixXf::Zero(3, bc.channels);
+  this->B_[i].row(2).setOnes();
+  this->AllocateBuffers(i);
+  return "";
+}
+
+/// @brief 第k层输出的通道数，用于批量归一化（Number of channels of the
+///        output of layer k, used by batch normalization）
+/// @param k 层号（layer number）
+/// @remark 沿输入向前找到最近的卷积层、池化层或仿射变换层，仿射变换层与
+///         网络的输入每个特征是一个通道。拼接层的通道数是各个输入的通道数
+///         之和，其余层沿第一个输入继续找。
+///         Walks back along the inputs to the nearest convolutional, pooling
+///         or affine layer, every feature of an affine layer or of the
+///         network input is a channel. The channels of a concatenation layer
+///         are the sum over its inputs, every other layer continues along its
+///         first input.
+int NeuralNetwork::NormChannels(int k) {
+  const string &type = this->nnl_[k].type;
+  if (type == "Convolution" || type == "FirstConvolution" ||
+      type == "DepthwiseConvolution" || type == "PointwiseConvolution") {
+    return this->cc_[k].number;
+  }
+  if (type == "Pooling" || type == "GlobalAvgPool" ||
+      type == "GlobalMaxPool") {
+    return this->pc_[k].filter_num;
+  }
+  if (k == 0 || type == "Affine" || type == "LowRankAffine") {
+    return this->nnl_[k].output_size;
+  }
+  if (type == "Concat") {
+    int channels = 0;
+    for (int input : this->inputs_[k]) channels += this->NormChannels(input);
+    return channels;
+  }
+  return this->NormChannels(this->inputs_[k][0]);
+}
+
+/// @brief 把紧跟在仿射变换层或卷积层之后的批量归一化层合并到前一层
+///        （Fold the batch normalization layers that directly follow an
+///        affine or convolutional layer into that layer）
+/// @remark 只在推理模式下调用，合并后批量归一化层不再计算。合并会修改前一层
+///         的权重，所以推理模式下保存的参数不能再用于训练。前一层的输出还被
+///         其他层读取时不合并。
+///         Only called in inference mode, a folded batch normalization layer
+///         no longer computes anything. Folding changes the weights of the
+///         previous layer, so parameters saved in inference mode cannot be
+///         used for training again. A previous layer whose output is also
+///         read by other layers is not folded into.
+void NeuralNetwork::FoldBatchNorm() {
+  for (int i = 2; i < this->layers_; ++i) {
+    this->folded_[i] = false;
+    if (this->nnl_[i].type != "BatchNorm") continue;
+    if (this->inputs_[i][0] != i - 1 || !this->grads_[i - 1].empty()) continue;
+    const string &type = this->nnl_[i - 1].type;
+    int size = 0;
+    if (type == "Affine" || type == "PointwiseConvolution") {
+      size = 1;
+    } else if (type == "Convolution" || type == "FirstConvolution" ||
+               type == "DepthwiseConvolution") {
+      size = this->cc_[i - 1].height * this->cc_[i - 1].width;
+    } else {
+      continue;
+    }
+    BatchNorm::Fold(this->W_[i - 1], this->B_[i - 1], size, this->W_[i],
+                    this->B_[i], this->bc_[i]);
+    this->folded_[i] = true;
+  }
+  this->sparse_ready_ = false;
 }
 
 /// @brief 初始化SoftmaxWithLoss层
@@ -166,9 +999,10 @@ void NeuralNetwork::InitSoftmaxWithLoss(int i) {
   this->nnl_[i].output_height = 1;
   this->nnl_[i].output_width = 1;
   this->nnl_[i].output_size = 1;
-  this->O_[i] = MatrixXf::Zero(1, 1);
-  this->dO_[i] = MatrixXf::Zero(1, 1);
-  this->Y_ = MatrixXf::Zero(1, this->nnl_[i - 1].output_size);
+  this->AllocateBuffers(i);
+  if (!this->inference_) {
+    this->Y_ = MatrixXf::Zero(1, this->nnl_[this->inputs_[i][0]].output_size);
+  }
 }
 
 /// @brief 初始化卷积层
@@ -176,6 +1010,7 @@ void NeuralNetwork::InitSoftmaxWithLoss(int i) {
 /// @param i 序号
 /// @return 错误信息
 string NeuralNetwork::InitConv(int i) {
+  const NeuralNetworkLayer &input = this->nnl_[this->inputs_[i][0]];
   if (this->conf_[this->nnl_[i].name + ".pad"].empty() == true ||
       this->conf_[this->nnl_[i].name + ".stride"].empty() == true ||
       this->conf_[this->nnl_[i].name + ".filter_num"].empty() == true ||
@@ -192,10 +1027,8 @@ string NeuralNetwork::InitConv(int i) {
   int f_width = atoi(this->conf_[this->nnl_[i].name + ".filter_width"].c_str());
   int channel_num =
       atoi(this->conf_[this->nnl_[i].name + ".channel_num"].c_str());
-  int o_height =
-      (this->nnl_[i - 1].output_height - f_height + 2 * pad) / stride + 1;
-  int o_width =
-      (this->nnl_[i - 1].output_width - f_width + 2 * pad) / stride + 1;
+  int o_height = (input.output_height - f_height + 2 * pad) / stride + 1;
+  int o_width = (input.output_width - f_width + 2 * pad) / stride + 1;
   this->nnl_[i].output_height = o_height;
   this->nnl_[i].output_width = o_width;
   this->nnl_[i].output_size = o_height * o_width * f_num;
@@ -205,29 +1038,149 @@ string NeuralNetwork::InitConv(int i) {
   this->cc_[i].height = f_height;
   this->cc_[i].width = f_width;
   this->cc_[i].channel_num = channel_num;
-  this->cc_[i].i_height = this->nnl_[i - 1].output_height;
-  this->cc_[i].i_width = this->nnl_[i - 1].output_width;
+  this->cc_[i].i_height = input.output_height;
+  this->cc_[i].i_width = input.output_width;
   this->cc_[i].o_height = o_height;
   this->cc_[i].o_width = o_width;
   // 初始化权重
   this->W_[i] = MatrixXf(1, f_num * f_height * f_width);
-  float *w_tmp = new float[f_num * f_height * f_width];
-  if (w_tmp == nullptr) {
-    return "初始化卷积层时内存分配失败。\n";
-  }
-  // 这里的初始化参数设置很重要
-  NormalDistr(w_tmp, f_num * f_height * f_width, 0.0, 0.01);
-  memcpy(this->W_[i].data(), w_tmp, f_num * f_height * f_width * sizeof(float));
-  delete[] w_tmp;
-  // 初始化权重的导数
-  this->dW_[i] = MatrixXf::Zero(1, f_num * f_height * f_width);
+  string err = this->InitWeights(i, channel_num * f_height * f_width,
+                                 f_num * f_height * f_width);
+  if (!err.empty()) {
+    return err;
+  }
   // 初始化偏置
   this->B_[i] = MatrixXf::Zero(1, f_num);
-  // 初始化偏置的导数
-  this->dB_[i] = MatrixXf::Zero(1, f_num);
-  // 初始化输出参数
-  this->O_[i] = MatrixXf::Zero(1, o_height * o_width * f_num);
-  this->dO_[i] = MatrixXf::Zero(1, o_height * o_width * f_num);
+  // 初始化输出参数与各个导数
+  this->AllocateBuffers(i);
+  return "";
+}
+
+/// @brief 第i层输入的通道数（number of channels of the input of layer i）
+/// @param i 序号
+/// @return 前一层的输出大小除以输出的高乘宽（output size of the previous
+///         layer over its output height times width）
+int NeuralNetwork::InputChannels(int i) {
+  const NeuralNetworkLayer &input = this->nnl_[this->inputs_[i][0]];
+  int spatial = input.output_height * input.output_width;
+  return spatial > 0 ? input.output_size / spatial : 0;
+}
+
+/// @brief 检查配置的通道数与推断的通道数是否相同（Check that a configured
+///        number of channels matches the inferred one）
+/// @param i 序号
+/// @param key 与层同名的表中的配置项（item in the table named after the
+///        layer）
+/// @param channels 推断的通道数（inferred number of channels）
+/// @return 错误信息，没有设置时为空（error message, empty when not set）
+string NeuralNetwork::CheckChannels(int i, const string &key, int channels) {
+  const string &name = this->nnl_[i].name;
+  int value = channels;
+  string err = ReadConfigValue(this->conf_, name + "." + key, value);
+  if (!err.empty()) return err;
+  if (value != channels) {
+    return "The \"" + key + "\" of \"" + name + "\" is " +
+           std::to_string(value) + " but its input has " +
+           std::to_string(channels) + " channels.";
+  }
+  return "";
+}
+
+/// @brief 初始化逐通道卷积层（Initialize the depthwise convolutional layer）
+/// @param i 序号
+/// @return 错误信息（error message）
+/// @remark 配置与卷积层相同，但不需要filter_num，通道数由前一层的输出推断，
+///         设置了channel_num时必须与之相同。
+///         Configured like a convolutional layer but without filter_num, the
+///         number of channels is inferred from the output of the previous
+///         layer and must match channel_num when that is set.
+string NeuralNetwork::InitDepthwiseConv(int i) {
+  const NeuralNetworkLayer &input = this->nnl_[this->inputs_[i][0]];
+  const string &name = this->nnl_[i].name;
+  if (this->conf_[name + ".pad"].empty() ||
+      this->conf_[name + ".stride"].empty() ||
+      this->conf_[name + ".filter_height"].empty() ||
+      this->conf_[name + ".filter_width"].empty()) {
+    return "错误：“" + name + "”内容不全，请检查配置文件。\n";
+  }
+  int channels = this->InputChannels(i);
+  string err = this->CheckChannels(i, "channel_num", channels);
+  if (!err.empty()) return err;
+  ConvConig &cc = this->cc_[i];
+  cc = ConvConig();
+  err = ReadConfigValue(this->conf_, name + ".pad", cc.pad);
+  if (err.empty()) {
+    err = ReadConfigValue(this->conf_, name + ".stride", cc.stride);
+  }
+  if (err.empty()) {
+    err = ReadConfigValue(this->conf_, name + ".filter_height", cc.height);
+  }
+  if (err.empty()) {
+    err = ReadConfigValue(this->conf_, name + ".filter_width", cc.width);
+  }
+  if (!err.empty()) return err;
+  cc.number = channels;
+  cc.channel_num = channels;
+  cc.i_height = input.output_height;
+  cc.i_width = input.output_width;
+  if (cc.stride <= 0 || cc.height > cc.i_height + 2 * cc.pad ||
+      cc.width > cc.i_width + 2 * cc.pad) {
+    return "The filter of \"" + name + "\" does not fit its input.";
+  }
+  cc.o_height = (cc.i_height - cc.height + 2 * cc.pad) / cc.stride + 1;
+  cc.o_width = (cc.i_width - cc.width + 2 * cc.pad) / cc.stride + 1;
+  this->nnl_[i].output_height = cc.o_height;
+  this->nnl_[i].output_width = cc.o_width;
+  this->nnl_[i].output_size = cc.o_height * cc.o_width * channels;
+  int size = cc.height * cc.width;
+  this->W_[i] = MatrixXf(1, channels * size);
+  err = this->InitWeights(i, size, size);
+  if (!err.empty()) {
+    return err;
+  }
+  this->B_[i] = MatrixXf::Zero(1, channels);
+  this->AllocateBuffers(i);
+  return "";
+}
+
+/// @brief 初始化逐点卷积层（Initialize the pointwise convolutional layer）
+/// @param i 序号
+/// @return 错误信息（error message）
+/// @remark 只需要filter_num，即输出通道数，输入通道数由前一层的输出推断。
+///         Only filter_num, the number of output channels, is needed, the
+///         number of input channels is inferred from the output of the
+///         previous layer.
+string NeuralNetwork::InitPointwiseConv(int i) {
+  const NeuralNetworkLayer &input = this->nnl_[this->inputs_[i][0]];
+  const string &name = this->nnl_[i].name;
+  if (this->conf_[name + ".filter_num"].empty()) {
+    return "错误：“" + name + "”内容不全，请检查配置文件。\n";
+  }
+  int channels = this->InputChannels(i);
+  string err = this->CheckChannels(i, "channel_num", channels);
+  if (!err.empty()) return err;
+  ConvConig &cc = this->cc_[i];
+  cc = ConvConig();
+  cc.stride = 1;
+  cc.height = 1;
+  cc.width = 1;
+  err = ReadConfigValue(this->conf_, name + ".filter_num", cc.number);
+  if (!err.empty()) return err;
+  cc.channel_num = channels;
+  cc.i_height = input.output_height;
+  cc.i_width = input.output_width;
+  cc.o_height = cc.i_height;
+  cc.o_width = cc.i_width;
+  this->nnl_[i].output_height = cc.o_height;
+  this->nnl_[i].output_width = cc.o_width;
+  this->nnl_[i].output_size = cc.o_height * cc.o_width * cc.number;
+  this->W_[i] = MatrixXf(channels, cc.number);
+  err = this->InitWeights(i, channels, cc.number);
+  if (!err.empty()) {
+    return err;
+  }
+  this->B_[i] = MatrixXf::Zero(1, cc.number);
+  this->AllocateBuffers(i);
   return "";
 }
 
@@ -236,6 +1189,7 @@ string NeuralNetwork::InitConv(int i) {
 /// @param i 序号
 /// @return 错误信息
 string NeuralNetwork::InitPool(int i) {
+  const NeuralNetworkLayer &input = this->nnl_[this->inputs_[i][0]];
   if (this->conf_[this->nnl_[i].name + ".pool_height"].empty() == true ||
       this->conf_[this->nnl_[i].name + ".pool_width"].empty() == true ||
       this->conf_[this->nnl_[i].name + ".stride"].empty() == true ||
@@ -243,13 +1197,23 @@ string NeuralNetwork::InitPool(int i) {
       this->conf_[this->nnl_[i].name + ".filter_num"].empty() == true) {
     return "错误：“" + this->nnl_[i].name + "”内容不全，请检查配置文件。\n";
   }
-  int pool_height = stoi(this->conf_[this->nnl_[i].name + ".pool_height"]);
-  int pool_width = stoi(this->conf_[this->nnl_[i].name + ".pool_width"]);
-  int stride = stoi(this->conf_[this->nnl_[i].name + ".stride"]);
-  string type = this->conf_[this->nnl_[i].name + ".type"];
-  int f_num = stoi(this->conf_[this->nnl_[i].name + ".filter_num"]);
-  int o_height = (this->nnl_[i - 1].output_height - pool_height) / stride + 1;
-  int o_width = (this->nnl_[i - 1].output_width - pool_width) / stride + 1;
+  const string &name = this->nnl_[i].name;
+  int pool_height = 0;
+  int pool_width = 0;
+  int stride = 0;
+  int f_num = 0;
+  string err = ReadConfigValue(this->conf_, name + ".pool_height", pool_height);
+  if (err.empty()) {
+    err = ReadConfigValue(this->conf_, name + ".pool_width", pool_width);
+  }
+  if (err.empty()) err = ReadConfigValue(this->conf_, name + ".stride", stride);
+  if (err.empty()) {
+    err = ReadConfigValue(this->conf_, name + ".filter_num", f_num);
+  }
+  if (!err.empty()) return err;
+  string type = this->conf_[name + ".type"];
+  int o_height = (input.output_height - pool_height) / stride + 1;
+  int o_width = (input.output_width - pool_width) / stride + 1;
   this->nnl_[i].output_height = o_height;
   this->nnl_[i].output_width = o_width;
   this->nnl_[i].output_size = o_height * o_width * f_num;
@@ -257,131 +1221,1104 @@ string NeuralNetwork::InitPool(int i) {
   this->pc_[i].width = pool_width;
   this->pc_[i].stride = stride;
   this->pc_[i].type = type == "Max" ? 0 : 1;  // 0为取最大值，1为取平均值
-  this->pc_[i].i_height = this->nnl_[i - 1].output_height;
-  this->pc_[i].i_width = this->nnl_[i - 1].output_width;
+  this->pc_[i].i_height = input.output_height;
+  this->pc_[i].i_width = input.output_width;
   this->pc_[i].o_height = o_height;
   this->pc_[i].o_width = o_width;
   this->pc_[i].filter_num = f_num;
-  this->O_[i] = MatrixXf::Zero(1, this->nnl_[i].output_size);
-  this->dO_[i] = MatrixXf::Zero(1, this->nnl_[i].output_size);
+  this->AllocateBuffers(i);
+  return "";
+}
+
+/// @brief 初始化全局池化层（Initialize the global pooling layer）
+/// @param i 序号
+/// @return 错误信息（error message）
+/// @remark 窗口为前一层输出的整个平面，通道数由前一层的输出推断，不需要
+///         配置表；表中设置了filter_num时必须与推断的通道数相同。
+///         The window is the whole plane output by the previous layer and
+///         the number of channels is inferred from that output, so no table
+///         is needed; filter_num must match the inferred number when set.
+string NeuralNetwork::InitGlobalPool(int i) {
+  const NeuralNetworkLayer &input = this->nnl_[this->inputs_[i][0]];
+  const string &name = this->nnl_[i].name;
+  int channels = this->InputChannels(i);
+  if (channels <= 0) {
+    return "The input of \"" + name + "\" has no height and width.";
+  }
+  string err = this->CheckChannels(i, "filter_num", channels);
+  if (!err.empty()) return err;
+  PoolConfig &pc = this->pc_[i];
+  pc = PoolConfig();
+  pc.i_height = input.output_height;
+  pc.i_width = input.output_width;
+  pc.height = pc.i_height;
+  pc.width = pc.i_width;
+  pc.stride = 1;
+  pc.type = this->nnl_[i].type == "GlobalMaxPool" ? 0 : 1;
+  pc.filter_num = channels;
+  pc.o_height = 1;
+  pc.o_width = 1;
+  this->nnl_[i].output_height = 1;
+  this->nnl_[i].output_width = 1;
+  this->nnl_[i].output_size = channels;
+  this->AllocateBuffers(i);
+  return "";
+}
+
+/// @brief 初始化相加层或拼接层（Initialize an add or concatenation layer）
+/// @param i 序号
+/// @return 错误信息（error message）
+/// @remark 相加层的输入大小必须相同，输出与第一个输入形状相同。拼接层的
+///         输入高与宽都相同时按通道拼接，输出保持这个高与宽，否则输出是高为
+///         1的特征向量。
+///         The inputs of an add layer must have the same size and the output
+///         takes the shape of the first input. Inputs of a concatenation
+///         layer with the same height and width are concatenated along the
+///         channels and the output keeps that height and width, otherwise the
+///         output is a feature vector of height 1.
+string NeuralNetwork::InitMerge(int i) {
+  NeuralNetworkLayer &layer = this->nnl_[i];
+  const NeuralNetworkLayer &first = this->nnl_[this->inputs_[i][0]];
+  bool same = true;
+  int size = 0;
+  for (int k : this->inputs_[i]) {
+    const NeuralNetworkLayer &input = this->nnl_[k];
+    if (layer.type == "Add" && input.output_size != first.output_size) {
+      return "The inputs of \"" + layer.name + "\" must have the same size.";
+    }
+    same = same && input.output_height == first.output_height &&
+           input.output_width == first.output_width;
+    size += input.output_size;
+  }
+  if (layer.type == "Add") size = first.output_size;
+  layer.output_height = same ? first.output_height : 1;
+  layer.output_width = same ? first.output_width : size;
+  layer.output_size = size;
+  this->AllocateBuffers(i);
   return "";
 }
 
 /// @brief 计算梯度（Calculating gradients）
 /// @param index 训练数据索引（Index value of the training data）
+/// @remark 样本仍然复制到O_[0]中，而不是用Map直接读取数据。O_[0]通过层输出
+///         数组被所有类型的层、检查点的重算、紧凑模式、相加与拼接层以及第1层
+///         反向传播中的权重导数读取，用Map需要在这些地方另加一条输入路径。
+///         行主序数据的一行与1行的MatrixXf都是连续的，复制只是一次memcpy，
+///         缓冲区在第一次之后不再分配，比第1层读取这一行的计算小得多。
+///         The sample is still copied into O_[0] instead of being read
+///         through a Map. O_[0] is read through the array of layer outputs by
+///         every layer type, the checkpoint recomputation, compact mode, the
+///         add and concatenation layers and the weight derivatives of layer
+///         1, so a Map would need a second input path in all of them. A row
+///         of the row-major data and a MatrixXf of one row are both
+///         contiguous, so the copy is a single memcpy into a buffer that is
+///         only allocated the first time, far less than the work layer 1
+///         does on that row.
 void NeuralNetwork::Gradient(int index) {
-  this->O_[0] = this->raw_data_.train_data.row(index);
-  this->label_ = this->raw_data_.train_labels(index);
+  this->O_[0] = this->data_->train_data.row(index);
+  this->labels_.assign(1, this->data_->train_labels(index));
   //  正向传播（forward propagation）
   this->Forward();
   // 反向传播（backward propagation）
   this->Backward();
 }
 
+/// @brief 计算一个小批量的梯度（Calculating gradients of a mini-batch）
+/// @param indices 训练数据索引（Index values of the training data）
+/// @remark 每个样本占输入的一行，得到的梯度是批量的平均值。
+///         Each sample takes one row of the input, the resulting gradients
+///         are averaged over the batch.
+void NeuralNetwork::Gradient(const vector<int> &indices) {
+  int n = indices.size();
+  this->O_[0].resize(n, this->data_->train_data.cols());
+  this->labels_.resize(n);
+  for (int r = 0; r < n; ++r) {
+    this->O_[0].row(r) = this->data_->train_data.row(indices[r]);
+    this->labels_[r] = this->data_->train_labels(indices[r]);
+  }
+  this->Forward();
+  this->Backward();
+}
+
+/// @brief 在工作区中计算一个小批量的梯度
+///        （Calculating gradients of a mini-batch in a workspace）
+/// @param indices 训练数据索引（Index values of the training data）
+/// @param ws 工作区，保存层输出与梯度（workspace holding the layer outputs
+///        and gradients）
+/// @remark 只读取权重，不修改神经网络本身，所以每个线程可以用自己的工作区
+///         同时计算梯度。
+///         Only the weights are read and the network itself is not modified,
+///         so every thread can compute gradients in its own workspace at the
+///         same time.
+void NeuralNetwork::Gradient(const vector<int> &indices, Workspace &ws) {
+  this->LoadBatch(indices, ws);
+  this->Gradient(ws);
+}
+
+/// @brief 计算工作区中已有样本的梯度（Calculating gradients of the samples
+///        already in a workspace）
+/// @param ws 输入与标签已经填好的工作区（workspace whose input and labels
+///        are filled in）
+/// @remark 输入不必来自训练数据，例如在线学习时直接写入的样本。工作区的
+///         大小不变时，第一次之后不再分配层输出与梯度。
+///         The input need not come from the training data, for example
+///         samples written directly by online learning. While the size of
+///         the workspace stays the same, the layer outputs and gradients are
+///         not allocated again after the first call.
+void NeuralNetwork::Gradient(Workspace &ws) {
+  ws.dW.resize(this->layers_ + 1);
+  ws.dB.resize(this->layers_ + 1);
+  for (int i = 1; i <= this->layers_; ++i) {
+    ws.dW[i].resize(this->dW_[i].rows(), this->dW_[i].cols());
+    ws.dB[i].resize(this->dB_[i].rows(), this->dB_[i].cols());
+  }
+  this->PredictLayers(this->W_, this->B_, ws.O.data(), false, nullptr,
+                      ws.masks.data());
+  ws.loss = this->softmax_loss_.Forward(ws.labels.data(),
+                                        ws.O[this->layers_ - 1], ws.Y);
+  this->CountMetrics(ws.Y, ws.labels.data(), ws.loss, ws.metrics);
+  this->BackwardLayers(this->W_, ws.O.data(), ws.dO.data(), ws.dW.data(),
+                       ws.dB.data(), ws.Y, ws.labels.data(), ws.masks.data());
+}
+
+/// @brief 把一个小批量读入工作区（Load a mini-batch into a workspace）
+/// @param indices 训练数据索引（Index values of the training data）
+/// @param ws 工作区（workspace）
+/// @remark 只准备输入、标签与层输出的位置，不分配梯度。
+///         Only the input, the labels and the slots of the layer outputs are
+///         prepared, no gradients are allocated.
+void NeuralNetwork::LoadBatch(const vector<int> &indices, Workspace &ws) {
+  int n = indices.size();
+  this->ResizeWorkspace(n, ws);
+  for (int r = 0; r < n; ++r) {
+    ws.O[0].row(r) = this->data_->train_data.row(indices[r]);
+    ws.labels[r] = this->data_->train_labels(indices[r]);
+  }
+}
+
+/// @brief 让工作区能够放下n个样本（Make a workspace hold n samples）
+/// @param n 样本数（number of samples）
+/// @param ws 工作区（workspace）
+/// @remark 输入与标签的内容不变，样本数与上次相同时不分配内存。
+///         The contents of the input and labels are left as they are, and
+///         nothing is allocated when n is the same as last time.
+void NeuralNetwork::ResizeWorkspace(int n, Workspace &ws) {
+  ws.O.resize(this->layers_ + 1);
+  ws.dO.resize(this->slot_count_);
+  ws.masks.resize(this->layers_ + 1);
+  ws.stats.resize(this->layers_ + 1);
+  ws.O[0].resize(n, this->nnl_[0].output_size);
+  ws.labels.resize(n);
+}
+
+/// @brief 在工作区中从第i层开始正向传播一步
+///        （One forward step in a workspace starting at layer i）
+/// @param i 层号，为最后一层时计算误差（layer number, the loss is computed
+///        at the last layer）
+/// @param ws 已经读入小批量的工作区（workspace holding a mini-batch）
+/// @return 这一步计算的最后一层（last layer computed by the step）
+/// @remark 与Gradient(indices, ws)一样只读取权重，所以不同的线程可以同时对
+///         不同的层或不同的工作区调用。
+///         Like Gradient(indices, ws) only the weights are read, so
+///         different threads may call it at the same time for different
+///         layers or workspaces.
+int NeuralNetwork::StepForward(int i, Workspace &ws) {
+  if (i == this->layers_) {
+    ws.loss = this->softmax_loss_.Forward(ws.labels.data(), ws.O[i - 1], ws.Y);
+    this->CountMetrics(ws.Y, ws.labels.data(), ws.loss, ws.metrics);
+    return i;
+  }
+  return this->ForwardStep(i, this->W_, this->B_, ws.O.data(), false, nullptr,
+                           ws.masks.data());
+}
+
+/// @brief 在工作区中从第i层开始反向传播一步
+///        （One backward step in a workspace starting at layer i）
+/// @param i 层号（layer number）
+/// @param ws 已经正向传播的工作区（workspace after forward propagation）
+/// @param dW 权重的导数，大小与神经网络的一致（derivatives of the weights,
+///        sized like those of the network）
+/// @param dB 偏置的导数（derivatives of the bias）
+/// @return 这一步处理的第一层（first layer handled by the step）
+int NeuralNetwork::StepBackward(int i, Workspace &ws, vector<MatrixXf> &dW,
+                                vector<MatrixXf> &dB) {
+  return this->BackwardStep(i, this->W_, ws.O.data(), ws.dO.data(), dW.data(),
+                            dB.data(), ws.Y, ws.labels.data(),
+                            ws.masks.data());
+}
+
 /// @brief 正向传播（forward propagation）
+/// @remark 使用检查点时，不是检查点的层输出在被下一层读取后立即释放。
+///         紧凑模式下，反向传播不需要的层输出同样在被下一层读取后立即释放，
+///         统计中的peak_bytes包括掩码与位置。
+///         With checkpointing, the output of a layer that is not a checkpoint
+///         is freed as soon as the next layer has read it. In compact mode an
+///         output that backpropagation does not need is freed the same way,
+///         and peak_bytes in the statistics includes the masks and positions.
 void NeuralNetwork::Forward() {
-  this->Predict();
+  if (this->checkpointing_ || this->compact_) {
+    CheckpointStats &stats = this->checkpoint_stats_;
+    stats = CheckpointStats();
+    stats.full_bytes = this->O_[0].size() * sizeof(float);
+    const bool *keep = this->compact_ ? this->keep_ : this->checkpoint_;
+    for (int i = 1; i < this->layers_; ++i) {
+      int last = this->ForwardStep(i, this->W_, this->B_, this->O_,
+                                   this->sparse_ready_, nullptr, this->masks_);
+      stats.forward_layers += last - i + 1;
+      stats.full_bytes += this->O_[last].size() * sizeof(float);
+      long bytes = this->ActivationBytes();
+      if (this->compact_) bytes += this->MaskBytes();
+      stats.peak_bytes = std::max(stats.peak_bytes, bytes);
+      if (!keep[i - 1]) this->O_[i - 1].resize(0, 0);
+      i = last;
+    }
+  } else {
+    this->PredictLayers(this->W_, this->B_, this->O_, this->sparse_ready_,
+                        nullptr, this->masks_);
+  }
   this->loss_ = this->softmax_loss_.Forward(
-      this->label_, this->O_[this->layers_ - 1], this->Y_);
+      this->labels_.data(), this->O_[this->layers_ - 1], this->Y_);
+  this->CountMetrics(this->Y_, this->labels_.data(), this->loss_,
+                     this->metrics_);
 }
 
 /// @brief 预测（predict）
 void NeuralNetwork::Predict() {
-  for (int i = 1; i < this->layers_; ++i) {
-    if (this->nnl_[i].type == "Convolution") {
-      this->conv_.Forward(this->O_[i - 1], this->W_[i], this->B_[i],
-                          this->O_[i], this->cc_[i]);
-      continue;
+  if (this->inference_) {
+    this->PredictLayers(this->W_, this->B_, this->buffers_.data(),
+                        this->sparse_ready_, this->plan_.buffer_of.data());
+    return;
+  }
+  this->PredictLayers(this->W_, this->B_, this->O_, this->sparse_ready_);
+}
+
+/// @brief 用给定的参数与层输出逐层预测
+///        （Layer-by-layer prediction with the given parameters and outputs）
+/// @param W 权重（weights）
+/// @param B 偏置（bias）
+/// @param O 层输出，O[0]为输入（outputs of layers, O[0] is the input）
+/// @param sparse 是否使用稀疏权重（whether to use the sparse weights）
+/// @param map 层输出所在的缓冲区，为空指针时第i层的输出为O[i]
+///        （buffer of each layer output, the output of layer i is O[i] when it
+///        is a null pointer）
+/// @param masks 融合层与丢弃层的掩码，为空指针时不记录，之后不能反向传播。
+///        不为空指针时是训练中的正向传播，批量归一化层使用小批量的统计，
+///        丢弃层生成新的掩码；否则使用滑动统计，丢弃层直接传递输入。
+///        （masks of fused and dropout layers, not recorded when it is a null
+///        pointer, in which case there can be no backpropagation afterwards.
+///        When it is not a null pointer this is forward propagation in
+///        training, batch normalization uses the statistics of the
+///        mini-batch and dropout draws new masks; otherwise the running
+///        statistics are used and dropout passes the input through）
+/// @remark 只读取网络结构与层配置，所以不同的线程可以用各自的参数与层输出
+///         同时预测。层不是一条链并且每层都有自己的输出时，同一层级的步在
+///         不同的核上同时计算；内存规划的共享缓冲区只在按层号的顺序下有效，
+///         所以有map时仍然逐步计算。
+///         Only the structure and the layer configuration of the network are
+///         read, so different threads can predict at the same time with their
+///         own parameters and outputs. When the layers are not a chain and
+///         every layer has its own output, the steps of one level run on
+///         different cores at the same time; the shared buffers of a memory
+///         plan are only valid in layer order, so a map keeps the steps in
+///         order.
+void NeuralNetwork::PredictLayers(MatrixXf *W, MatrixXf *B, MatrixXf *O,
+                                  bool sparse, const int *map,
+                                  MatrixXb *masks) {
+  if (this->dag_ && map == nullptr) {
+    for (auto &level : this->forward_levels_) {
+      if (level.size() <= 1) {
+        for (int i : level) this->ForwardStep(i, W, B, O, sparse, map, masks);
+        continue;
+      }
+      ThreadPool::Global().ParallelFor(
+          0, level.size(), 1, [&](long first, long last) {
+            for (long k = first; k < last; ++k) {
+              this->ForwardStep(level[k], W, B, O, sparse, map, masks);
+            }
+          });
     }
-    if (this->nnl_[i].type == "Pooling") {
-      this->pool_.Forward(this->O_[i - 1], this->O_[i], this->pc_[i]);
-      continue;
+    return;
+  }
+  for (int i = 1; i < this->layers_; ++i) {
+    i = this->ForwardStep(i, W, B, O, sparse, map, masks);
+  }
+}
+
+/// @brief 从第i层开始正向传播一步（One forward step starting at layer i）
+/// @param i 层号（layer number）
+/// @return 这一步计算的最后一层，融合的卷积、ReLU与池化层算作一步
+///         （last layer computed by the step, a fused convolution, ReLU and
+///         pooling group counts as one step）
+/// @remark 其余参数与PredictLayers相同。
+///         The other parameters are the same as in PredictLayers.
+int NeuralNetwork::ForwardStep(int i, MatrixXf *W, MatrixXf *B, MatrixXf *O,
+                               bool sparse, const int *map, MatrixXb *masks) {
+  int in = this->inputs_[i][0];
+  int x = map == nullptr ? in : map[in];
+  if (this->fused_[i]) {
+    int p = map == nullptr ? i + 2 : map[i + 2];
+    this->conv_relu_pool_.Forward(O[x], W[i], B[i], O[p], this->cc_[i],
+                                  this->pc_[i + 2],
+                                  masks == nullptr ? nullptr : &masks[i + 2]);
+    return i + 2;
+  }
+  int z = map == nullptr ? i : map[i];
+  if (this->nnl_[i].type == "Dropout") {
+    this->ForwardDropout(i, O[x], O[z], masks);
+    return i;
+  }
+  if (this->nnl_[i].type == "Add" || this->nnl_[i].type == "Concat") {
+    this->ForwardMerge(i, O, map, O[z]);
+    return i;
+  }
+  // 紧凑模式下记录反向传播需要的掩码或位置（the masks or positions needed
+  // by backpropagation are recorded in compact mode）
+  if (this->compact_ && masks != nullptr && this->CompactLayer(i)) {
+    if (this->nnl_[i].type == "ReLU") {
+      this->relu_.Forward(O[x], O[z], masks[i]);
+    } else {
+      this->pool_.Forward(O[x], O[z], this->pc_[i], &masks[i]);
     }
-    if (this->nnl_[i].type == "Sigmoid") {
-      this->sigmoid_.Forward(this->O_[i - 1], this->O_[i]);
-      continue;
+    return i;
+  }
+  this->ForwardLayer(i, W, B, O[x], O[z], sparse, masks != nullptr);
+  return i;
+}
+
+/// @brief 丢弃层的正向传播（Forward propagation of a dropout layer）
+/// @param i 层号（layer number）
+/// @param X 层输入（layer input）
+/// @param Z 层输出（layer output）
+/// @param masks 掩码，为空指针时不是训练，直接传递输入（masks, the input is
+///        passed through when it is a null pointer since this is not
+///        training）
+/// @remark 每次训练中的正向传播从dropout_step_取一个新的流号，所以同时在
+///         不同工作区中计算的小批量也使用不同的掩码。流号的最高位为1，不会
+///         与按层号初始化权重的流重合。推理模式下输出与输入共用缓冲区，
+///         不复制。
+///         Every forward pass in training takes a new stream from
+///         dropout_step_, so mini-batches computed in different workspaces at
+///         the same time use different masks too. The top bit of the stream
+///         is set so it never meets the streams of weight initialization,
+///         which are layer numbers. In inference mode the output shares the
+///         buffer of the input and nothing is copied.
+void NeuralNetwork::ForwardDropout(int i, MatrixXf &X, MatrixXf &Z,
+                                   MatrixXb *masks) {
+  if (masks == nullptr) {
+    if (&Z != &X) Z = X;
+    return;
+  }
+  if (this->recomputing_) {
+    this->dropout_.Apply(X, masks[i], Z, this->rate_[i]);
+    return;
+  }
+  uint64_t step = this->dropout_step_.fetch_add(1, std::memory_order_relaxed);
+  this->dropout_.Forward(X, Z, masks[i], this->rate_[i], this->seed_,
+                         (1ULL << 63) | step);
+}
+
+/// @brief 相加层或拼接层的正向传播（Forward propagation of an add or
+///        concatenation layer）
+/// @param i 层号（layer number）
+/// @param O 层输出（outputs of layers）
+/// @param map 层输出所在的缓冲区，可以为空指针（buffer of each layer output,
+///        may be a null pointer）
+/// @param Z 层输出（layer output）
+void NeuralNetwork::ForwardMerge(int i, MatrixXf *O, const int *map,
+                                 MatrixXf &Z) {
+  vector<MatrixXf *> X;
+  for (int k : this->inputs_[i]) X.push_back(&O[map == nullptr ? k : map[k]]);
+  if (this->nnl_[i].type == "Add") {
+    this->add_.Forward(X, Z);
+  } else {
+    this->concat_.Forward(X, Z);
+  }
+}
+
+/// @brief 一层的正向传播（Forward propagation of one layer）
+/// @param i 层号（layer number）
+/// @param W 权重（weights）
+/// @param B 偏置（bias）
+/// @param X 层输入（layer input）
+/// @param Z 层输出（layer output）
+/// @param sparse 是否使用稀疏权重（whether to use the sparse weights）
+/// @param training 是否为训练中的正向传播，批量归一化层据此选择统计
+///        （whether this is forward propagation in training, batch
+///        normalization picks its statistics by it）
+void NeuralNetwork::ForwardLayer(int i, MatrixXf *W, MatrixXf *B, MatrixXf &X,
+                                 MatrixXf &Z, bool sparse, bool training) {
+  if (this->nnl_[i].type == "Convolution") {
+    this->conv_.Forward(X, W[i], B[i], Z, this->cc_[i]);
+    return;
+  }
+  if (this->nnl_[i].type == "DepthwiseConvolution") {
+    this->depthwise_.Forward(X, W[i], B[i], Z, this->cc_[i]);
+    return;
+  }
+  if (this->nnl_[i].type == "PointwiseConvolution") {
+    this->pointwise_.Forward(X, W[i], B[i], Z, this->cc_[i]);
+    return;
+  }
+  if (this->nnl_[i].type == "Pooling") {
+    this->pool_.Forward(X, Z, this->pc_[i]);
+    return;
+  }
+  if (this->nnl_[i].type == "GlobalAvgPool" ||
+      this->nnl_[i].type == "GlobalMaxPool") {
+    this->global_pool_.Forward(X, Z, this->pc_[i]);
+    return;
+  }
+  if (this->nnl_[i].type == "Sigmoid") {
+    this->sigmoid_.Forward(X, Z);
+    return;
+  }
+  if (this->nnl_[i].type == "ReLU") {
+    this->relu_.Forward(X, Z);
+    return;
+  }
+  if (this->nnl_[i].type == "Tanh") {
+    this->tanh_.Forward(X, Z);
+    return;
+  }
+  if (this->nnl_[i].type == "GELU") {
+    this->gelu_.Forward(X, Z);
+    return;
+  }
+  if (this->nnl_[i].type == "LeakyReLU") {
+    this->leaky_relu_.Forward(X, Z, this->alpha_[i]);
+    return;
+  }
+  if (this->nnl_[i].type == "BatchNorm") {
+    // 已经合并到前一层时直接传递（passed through once folded into the
+    // previous layer）
+    if (this->folded_[i]) {
+      if (&Z != &X) Z = X;
+      return;
     }
-    if (this->nnl_[i].type == "ReLU") {
-      this->relu_.Forward(this->O_[i - 1], this->O_[i]);
-      continue;
+    this->batch_norm_.Forward(X, W[i], B[i], Z, this->bc_[i], training);
+    return;
+  }
+  if (this->nnl_[i].type == "LowRankAffine") {
+    this->low_rank_affine_.Forward(X, W[i], B[i], Z);
+    return;
+  }
+  if (this->nnl_[i].type == "Affine") {
+    if (sparse && this->SW_[i].rows > 0) {
+      this->affine_.ForwardSparse(X, this->SW_[i], B[i], Z);
+      return;
     }
-    if (this->nnl_[i].type == "Affine") {
-      this->affine_.Forward(this->O_[i - 1], this->W_[i], this->B_[i],
-                            this->O_[i]);
-      continue;
+    // 只有网络自己的权重有打包的副本（only the network's own weights have
+    // packed copies）
+    if (W == this->W_ && this->packed_ready_) {
+      this->affine_.ForwardPacked(X, this->packed_[i], B[i], Z);
+      return;
     }
+    this->affine_.Forward(X, W[i], B[i], Z);
+    return;
   }
 }
 
 /// @brief 反向传播（backward propagation）
+/// @remark 使用检查点时，需要的层输出已被释放的话，从最近的检查点重新计算
+///         到这一层为止的整段，每层反向传播完成后释放它的输出。紧凑模式下
+///         每层反向传播完成后也释放它的输出，只保留输入。
+///         With checkpointing, when a needed layer output has been freed, the
+///         whole segment from the nearest checkpoint up to it is computed
+///         again, and the output of each layer is freed once its
+///         backpropagation is done. In compact mode the output of each layer
+///         is freed once its backpropagation is done too, only the input is
+///         kept.
 void NeuralNetwork::Backward() {
-  for (int i = this->layers_; i >= 1; --i) {
-    if (this->nnl_[i].type == "Convolution") {
-      this->conv_.Backward(this->O_[i - 1], this->dB_[i], this->dO_[i],
-                           this->dW_[i], this->cc_[i], i);
-      continue;
+  if (this->compact_) {
+    for (int i = this->layers_; i >= 1; --i) {
+      int first = this->BackwardStep(i, this->W_, this->O_, this->dO_,
+                                     this->dW_, this->dB_, this->Y_,
+                                     this->labels_.data(), this->masks_);
+      this->O_[i].resize(0, 0);
+      i = first;
     }
-    if (this->nnl_[i].type == "Pooling") {
-      this->pool_.Backward(this->dO_[i], this->dO_[i - 1], this->O_[i - 1],
-                           this->pc_[i]);
-      continue;
-    }
-    if (this->nnl_[i].type == "SoftmaxWithLoss") {
-      this->softmax_loss_.Backward(this->Y_, this->label_, this->dO_[i - 1]);
-      continue;
+    return;
+  }
+  if (this->checkpointing_) {
+    CheckpointStats &stats = this->checkpoint_stats_;
+    for (int i = this->layers_; i >= 1; --i) {
+      // 这一步的输入（input of this step）
+      int in = i >= 3 && this->fused_[i - 2] ? i - 3 : i - 1;
+      if (this->O_[in].size() == 0) {
+        int c = in;
+        while (!this->checkpoint_[c]) --c;
+        this->recomputing_ = true;
+        for (int k = c + 1; k <= in; ++k) {
+          int last = this->ForwardStep(k, this->W_, this->B_, this->O_,
+                                       this->sparse_ready_, nullptr,
+                                       this->masks_);
+          stats.recomputed_layers += last - k + 1;
+          k = last;
+        }
+        this->recomputing_ = false;
+        stats.peak_bytes = std::max(stats.peak_bytes, this->ActivationBytes());
+      }
+      int first = this->BackwardStep(i, this->W_, this->O_, this->dO_,
+                                     this->dW_, this->dB_, this->Y_,
+                                     this->labels_.data(), this->masks_);
+      if (!this->checkpoint_[i]) this->O_[i].resize(0, 0);
+      i = first;
     }
-    if (this->nnl_[i].type == "Affine") {
-      this->affine_.Backward(this->O_[i - 1], this->W_[i], this->dO_[i],
-                             this->dB_[i], this->dW_[i], this->dO_[i - 1], i);
-      continue;
+    return;
+  }
+  this->BackwardLayers(this->W_, this->O_, this->dO_, this->dW_, this->dB_,
+                       this->Y_, this->labels_.data(), this->masks_);
+}
+
+/// @brief 用给定的缓冲区逐层反向传播
+///        （Layer-by-layer backpropagation with the given buffers）
+/// @param W 权重（weights）
+/// @param O 层输出（outputs of layers）
+/// @param dO 层输出的导数（derivatives of the outputs）
+/// @param dW 权重的导数（derivatives of the weights）
+/// @param dB 偏置的导数（derivatives of the bias）
+/// @param Y Softmax函数输出（Softmax function output）
+/// @param labels 监督标签（supervisory labels）
+/// @param masks 正向传播记录的融合层与丢弃层掩码（masks of fused and dropout
+///        layers recorded by forward propagation）
+/// @remark 层不是一条链时，同一层级的步从最高的层级开始在不同的核上同时
+///         计算，每层的导数在读取它的层都完成后才相加。
+///         When the layers are not a chain, the steps of one level run on
+///         different cores at the same time starting from the highest level,
+///         and the derivative of a layer is only summed once every layer
+///         reading it is done.
+void NeuralNetwork::BackwardLayers(MatrixXf *W, MatrixXf *O, MatrixXf *dO,
+                                   MatrixXf *dW, MatrixXf *dB, MatrixXf &Y,
+                                   const uint8_t *labels, MatrixXb *masks) {
+  if (this->dag_) {
+    for (int l = this->backward_levels_.size() - 1; l >= 1; --l) {
+      vector<int> &level = this->backward_levels_[l];
+      if (level.size() <= 1) {
+        for (int i : level) {
+          this->BackwardStep(i, W, O, dO, dW, dB, Y, labels, masks);
+        }
+        continue;
+      }
+      ThreadPool::Global().ParallelFor(
+          0, level.size(), 1, [&](long first, long last) {
+            for (long k = first; k < last; ++k) {
+              this->BackwardStep(level[k], W, O, dO, dW, dB, Y, labels,
+                                 masks);
+            }
+          });
     }
-    if (this->nnl_[i].type == "Sigmoid") {
-      this->sigmoid_.Backward(this->dO_[i], this->O_[i], this->dO_[i - 1]);
-      continue;
+    return;
+  }
+  for (int i = this->layers_; i >= 1; --i) {
+    i = this->BackwardStep(i, W, O, dO, dW, dB, Y, labels, masks);
+  }
+}
+
+/// @brief 从第i层开始反向传播一步（One backward step starting at layer i）
+/// @param i 层号（layer number）
+/// @return 这一步处理的第一层（first layer handled by the step）
+/// @remark 其余参数与BackwardLayers相同。
+///         The other parameters are the same as in BackwardLayers.
+int NeuralNetwork::BackwardStep(int i, MatrixXf *W, MatrixXf *O, MatrixXf *dO,
+                                MatrixXf *dW, MatrixXf *dB, MatrixXf &Y,
+                                const uint8_t *labels, MatrixXb *masks) {
+  // 被多层读取的输出，先把这些层写入的导数相加（for an output read by
+  // several layers, first add up the derivatives those layers wrote）
+  const vector<int> &grads = this->grads_[i];
+  if (!grads.empty()) {
+    dO[i] = dO[grads[0]];
+    for (size_t s = 1; s < grads.size(); ++s) dO[i] += dO[grads[s]];
+  }
+  if (i >= 3 && this->fused_[i - 2]) {
+    this->conv_relu_pool_.Backward(dO[i], masks[i],
+                                   O[this->inputs_[i - 2][0]], dW[i - 2],
+                                   dB[i - 2], this->cc_[i - 2], this->pc_[i]);
+    return i - 2;
+  }
+  MatrixXf &dX = dO[this->slots_[i][0]];
+  if (this->nnl_[i].type == "Dropout") {
+    // 读取输入的层不需要输入的导数（a layer reading the input needs no input
+    // derivatives）
+    if (this->inputs_[i][0] > 0) {
+      this->dropout_.Backward(dO[i], masks[i], dX, this->rate_[i]);
     }
+    return i;
+  }
+  if (this->compact_ && this->CompactLayer(i)) {
     if (this->nnl_[i].type == "ReLU") {
-      this->relu_.Backward(this->dO_[i], this->O_[i], this->dO_[i - 1]);
-      continue;
+      this->relu_.Backward(dO[i], masks[i], dX);
+    } else {
+      this->pool_.BackwardCompact(dO[i], masks[i], dX, this->pc_[i]);
     }
+    return i;
+  }
+  if (this->nnl_[i].type == "Add" || this->nnl_[i].type == "Concat") {
+    this->BackwardMerge(i, dO);
+    return i;
+  }
+  this->BackwardLayer(i, W, O, dO, dW, dB, Y, labels);
+  return i;
+}
+
+/// @brief 相加层或拼接层的反向传播（Backpropagation of an add or
+///        concatenation layer）
+/// @param i 层号（layer number）
+/// @param dO 层输出的导数（derivatives of the outputs）
+void NeuralNetwork::BackwardMerge(int i, MatrixXf *dO) {
+  vector<MatrixXf *> dX;
+  for (int slot : this->slots_[i]) dX.push_back(&dO[slot]);
+  if (this->nnl_[i].type == "Add") {
+    this->add_.Backward(dO[i], dX);
+    return;
   }
+  vector<int> cols;
+  for (int k : this->inputs_[i]) cols.push_back(this->nnl_[k].output_size);
+  this->concat_.Backward(dO[i], cols, dX);
+}
+
+/// @brief 一层的反向传播（Backpropagation of one layer）
+/// @param i 层号（layer number）
+/// @remark 输入的导数写到dO中这一层对应的一项。读取网络输入的层按第一层
+///         处理，不计算输入的导数。其余参数与BackwardLayers相同。
+///         The input derivatives go to the entry of dO that belongs to this
+///         layer. A layer reading the network input is handled as the first
+///         layer and computes no input derivatives. The other parameters are
+///         the same as in BackwardLayers.
+void NeuralNetwork::BackwardLayer(int i, MatrixXf *W, MatrixXf *O,
+                                  MatrixXf *dO, MatrixXf *dW, MatrixXf *dB,
+                                  MatrixXf &Y, const uint8_t *labels) {
+  int x = this->inputs_[i][0];
+  MatrixXf &dX = dO[this->slots_[i][0]];
+  // 层自己看到的层号（layer number as seen by the layer）
+  int n = x == 0 ? 1 : i;
+  if (this->nnl_[i].type == "Convolution") {
+    this->conv_.Backward(O[x], dB[i], dO[i], dW[i], this->cc_[i], n);
+    return;
+  }
+  if (this->nnl_[i].type == "DepthwiseConvolution") {
+    this->depthwise_.Backward(O[x], W[i], dO[i], dB[i], dW[i], dX,
+                              this->cc_[i], n);
+    return;
+  }
+  if (this->nnl_[i].type == "PointwiseConvolution") {
+    this->pointwise_.Backward(O[x], W[i], dO[i], dB[i], dW[i], dX,
+                              this->cc_[i], n);
+    return;
+  }
+  if (this->nnl_[i].type == "Pooling") {
+    this->pool_.Backward(dO[i], dX, O[x], this->pc_[i]);
+    return;
+  }
+  if (this->nnl_[i].type == "GlobalAvgPool" ||
+      this->nnl_[i].type == "GlobalMaxPool") {
+    this->global_pool_.Backward(dO[i], dX, O[x], this->pc_[i]);
+    return;
+  }
+  if (this->nnl_[i].type == "SoftmaxWithLoss") {
+    this->softmax_loss_.Backward(Y, labels, dX);
+    return;
+  }
+  if (this->nnl_[i].type == "Affine") {
+    this->affine_.Backward(O[x], W[i], dO[i], dB[i], dW[i], dX, n);
+    return;
+  }
+  if (this->nnl_[i].type == "LowRankAffine") {
+    this->low_rank_affine_.Backward(O[x], W[i], dO[i], dB[i], dW[i], dX, n);
+    return;
+  }
+  if (this->nnl_[i].type == "Sigmoid") {
+    this->sigmoid_.Backward(dO[i], O[i], dX);
+    return;
+  }
+  if (this->nnl_[i].type == "ReLU") {
+    this->relu_.Backward(dO[i], O[i], dX);
+    return;
+  }
+  if (this->nnl_[i].type == "Tanh") {
+    this->tanh_.Backward(dO[i], O[i], dX);
+    return;
+  }
+  if (this->nnl_[i].type == "GELU") {
+    this->gelu_.Backward(dO[i], O[x], dX);
+    return;
+  }
+  if (this->nnl_[i].type == "LeakyReLU") {
+    this->leaky_relu_.Backward(dO[i], O[i], dX, this->alpha_[i]);
+    return;
+  }
+  if (this->nnl_[i].type == "BatchNorm") {
+    this->batch_norm_.Backward(dO[i], O[x], W[i], dW[i], dB[i], dX,
+                               this->bc_[i], n);
+    return;
+  }
+}
+
+/// @brief 当前保存的层输出的字节数（Bytes of the layer outputs alive now）
+long NeuralNetwork::ActivationBytes() {
+  long bytes = 0;
+  for (int i = 0; i < this->layers_; ++i) {
+    bytes += this->O_[i].size() * sizeof(float);
+  }
+  return bytes;
+}
+
+/// @brief 当前保存的掩码与位置的字节数（Bytes of the masks and positions
+///        alive now）
+long NeuralNetwork::MaskBytes() {
+  long bytes = 0;
+  for (int i = 0; i < this->layers_; ++i) bytes += this->masks_[i].size();
+  return bytes;
 }
 
 /// @brief 更新参数（Update parameters）
+/// @remark 剪掉的权重在更新后重新置为0。
+///         Pruned weights are set back to 0 after the update.
 void NeuralNetwork::Update() {
+  this->ApplyGradients(this->dW_, this->dB_);
+  this->PackWeights();
+}
+
+/// @brief 用工作区中的梯度更新参数（Update parameters with the gradients of
+///        a workspace）
+/// @param ws 已经计算好梯度的工作区（workspace holding the gradients）
+/// @remark 与Update()不同，打包的权重不会重新生成，每次更新只需要读写一遍
+///         权重，适合每来几个样本就更新一次的在线学习。之后的正向传播直接
+///         使用权重，需要时可以调用PackWeights()。
+///         Unlike Update() the packed weights are not rebuilt, so every
+///         update reads and writes the weights only once, which suits online
+///         learning that updates every few samples. Later forward passes use
+///         the weights directly, PackWeights() can be called when needed.
+void NeuralNetwork::Update(Workspace &ws) {
+  this->ApplyGradients(ws.dW.data(), ws.dB.data());
+  this->packed_ready_ = false;
+}
+
+/// @brief 按学习率减去梯度（Subtract the gradients scaled by the learning
+///        rate）
+/// @param dW 权重的导数（derivatives of the weights）
+/// @param dB 偏置的导数（derivatives of the bias）
+/// @remark 批量归一化层的小批量统计在这里并入滑动统计，所以只有调用这个函数
+///         的线程会写入滑动统计。
+///         The mini-batch statistics of batch normalization layers are merged
+///         into the running statistics here, so only the thread calling this
+///         function writes the running statistics.
+void NeuralNetwork::ApplyGradients(MatrixXf *dW, MatrixXf *dB) {
   for (int i = 1; i < this->layers_; ++i) {
-    this->W_[i].noalias() -= this->learning_rate_ * this->dW_[i];
-    this->B_[i].noalias() -= this->learning_rate_ * this->dB_[i];
+    this->W_[i].noalias() -= this->learning_rate_ * dW[i];
+    if (this->nnl_[i].type == "BatchNorm") {
+      this->B_[i].row(0).noalias() -= this->learning_rate_ * dB[i].row(0);
+      BatchNorm::Accumulate(dB[i], this->B_[i], this->bc_[i]);
+    } else {
+      this->B_[i].noalias() -= this->learning_rate_ * dB[i];
+    }
+    if (this->M_[i].size() > 0) {
+      this->W_[i].array() *= this->M_[i].array();
+    }
+  }
+  ++this->step_;
+  this->sparse_ready_ = false;
+  if (this->prune_.enabled) this->GradualPrune();
+}
+
+/// @brief 逐步剪枝（Gradual pruning）
+/// @remark 稀疏度按三次曲线从0增加到目标值：
+///         s = s_f(1 - (1 - (t - t_0)/(t_1 - t_0))^3)。
+///         The sparsity rises from 0 to the target along a cubic curve:
+///         s = s_f(1 - (1 - (t - t_0)/(t_1 - t_0))^3).
+void NeuralNetwork::GradualPrune() {
+  int t = this->step_ - this->prune_.begin_step;
+  int n = this->prune_.end_step - this->prune_.begin_step;
+  if (t < 0) return;
+  if (n <= 0) {
+    if (t == 0) this->Prune(this->prune_.sparsity);
+    return;
   }
+  if (t > n || (t % this->prune_.frequency != 0 && t != n)) return;
+  float r = 1.0f - static_cast<float>(t) / n;
+  this->Prune(this->prune_.sparsity * (1.0f - r * r * r));
+}
+
+/// @brief 按幅值剪枝所有仿射变换层（Magnitude-prune all affine layers）
+/// @param sparsity 稀疏度（sparsity）
+void NeuralNetwork::Prune(float sparsity) {
+  for (int i = 1; i < this->layers_; ++i) {
+    if (this->nnl_[i].type != "Affine") continue;
+    PruneByMagnitude(this->W_[i], this->M_[i], sparsity, this->prune_.format);
+  }
+  this->sparse_ready_ = false;
+  this->packed_ready_ = false;
+}
+
+/// @brief 把训练好的仿射变换层分解为低秩仿射变换层（Factorize a trained
+///        affine layer into a low-rank affine layer）
+/// @param i 层号（layer number）
+/// @param rank 秩，小于输入数与输出数（rank, below both the inputs and the
+///        outputs）
+/// @return 错误信息（error message）
+/// @remark 分解后可以直接推理，也可以继续训练以微调两个因子。剪枝掩码与
+///         稀疏权重不再适用，会被清除。
+///         After factorizing, the network can predict right away or keep
+///         training to fine-tune the two factors. Pruning masks and sparse
+///         weights no longer apply and are cleared.
+string NeuralNetwork::Factorize(int i, int rank) {
+  if (i < 1 || i >= this->layers_ || this->nnl_[i].type != "Affine") {
+    return "Layer " + std::to_string(i) + " is not an affine layer.";
+  }
+  int inputs = this->W_[i].rows();
+  int outputs = this->W_[i].cols();
+  if (rank < 1 || rank >= std::min(inputs, outputs)) {
+    return "The rank of layer " + std::to_string(i) +
+           " must be at least 1 and less than " +
+           std::to_string(std::min(inputs, outputs)) + ".";
+  }
+  MatrixXf F;
+  LowRankAffine::Factorize(this->W_[i], rank, F, this->seed_, i);
+  this->W_[i] = F;
+  this->nnl_[i].type = "LowRankAffine";
+  this->M_[i] = MatrixXf();
+  this->SW_[i] = SparseMatrix();
+  this->packed_[i] = PackedMatrix();
+  if (!this->inference_) {
+    this->dW_[i] = MatrixXf::Zero(F.rows(), F.cols());
+  }
+  return "";
+}
+
+/// @brief 把低秩仿射变换层乘回稠密的仿射变换层（Multiply a low-rank affine
+///        layer back into a dense affine layer）
+/// @param i 层号（layer number）
+/// @remark 权重是两个因子之积，所以预测结果不变。
+///         The weights are the product of the two factors, so predictions
+///         do not change.
+void NeuralNetwork::Expand(int i) {
+  if (this->nnl_[i].type != "LowRankAffine") return;
+  MatrixXf W;
+  LowRankAffine::Expand(this->W_[i],
+                        this->nnl_[this->inputs_[i][0]].output_size, W);
+  this->W_[i] = W;
+  this->nnl_[i].type = "Affine";
+  if (!this->inference_) {
+    this->dW_[i] = MatrixXf::Zero(W.rows(), W.cols());
+  }
+  this->PackWeights();
+}
+
+/// @brief 为密度足够低的仿射变换层生成稀疏权重
+///        （Build sparse weights for affine layers that are sparse enough）
+/// @remark 训练时权重每一步都会变化，所以只在推理前生成一次。
+///         Weights change at every training step, so this is only done once
+///         before inference.
+void NeuralNetwork::BuildSparse() {
+  for (int i = 1; i < this->layers_; ++i) {
+    this->SW_[i] = SparseMatrix();
+    if (this->nnl_[i].type != "Affine") continue;
+    if (Density(this->W_[i]) >= this->prune_.density_threshold) continue;
+    DenseToSparse(this->W_[i], this->prune_.format, this->SW_[i]);
+  }
+  this->sparse_ready_ = true;
+}
+
+/// @brief 打包仿射变换层的权重（Pack the weights of affine layers）
+/// @remark 在初始化、更新参数和读取参数之后调用，之后的正向传播直接使用
+///         打包的权重，不需要每次再打包。通过GetWeights()取得权重后打包的
+///         权重就不再使用，直到再次调用这个函数。
+///         Called after initialization, parameter updates and parameter
+///         loading, so later forward passes use the packed weights without
+///         packing them every time. Once the weights have been taken through
+///         GetWeights() the packed weights are not used until this is called
+///         again.
+void NeuralNetwork::PackWeights() {
+  for (int i = 1; i < this->layers_; ++i) {
+    if (this->nnl_[i].type != "Affine") continue;
+    PackMatrix(this->W_[i], this->packed_[i]);
+  }
+  this->packed_ready_ = true;
+}
+
+/// @brief 合并另一份训练指标（Merge another set of training metrics）
+/// @param other 另一份训练指标（other training metrics）
+void TrainMetrics::Merge(const TrainMetrics &other) {
+  this->samples += other.samples;
+  this->loss += other.loss;
+  this->correct += other.correct;
+  if (this->class_samples.size() < other.class_samples.size()) {
+    this->class_samples.resize(other.class_samples.size(), 0);
+    this->class_correct.resize(other.class_correct.size(), 0);
+  }
+  for (size_t c = 0; c < other.class_samples.size(); ++c) {
+    this->class_samples[c] += other.class_samples[c];
+    this->class_correct[c] += other.class_correct[c];
+  }
+}
+
+/// @brief 累计一个小批量的训练指标（Gather the training metrics of a
+///        mini-batch）
+/// @param Y Softmax函数输出，每行一个样本（Softmax function output, one
+///        sample per row）
+/// @param labels 监督标签（supervisory labels）
+/// @param loss 小批量的平均误差（mean loss of the mini-batch）
+/// @param metrics 训练指标（training metrics）
+void NeuralNetwork::CountMetrics(MatrixXf &Y, const uint8_t *labels,
+                                 float loss, TrainMetrics &metrics) {
+  int n = Y.rows();
+  if (n == 0) return;
+  if ((int)metrics.class_samples.size() < Y.cols()) {
+    metrics.class_samples.resize(Y.cols(), 0);
+    metrics.class_correct.resize(Y.cols(), 0);
+  }
+  int predict = 0;
+  for (int r = 0; r < n; ++r) {
+    Y.row(r).maxCoeff(&predict);
+    ++metrics.class_samples[labels[r]];
+    if (predict == labels[r]) {
+      ++metrics.correct;
+      ++metrics.class_correct[labels[r]];
+    }
+  }
+  metrics.samples += n;
+  metrics.loss += static_cast<double>(loss) * n;
 }
 
 /// @brief 计算准确率（Calculate accuracy）
+/// @remark 自上次调用以来累计了训练指标时，训练数据的准确率直接取累计值，
+///         不再对训练数据预测一遍，之后清空累计值。
+///         When training metrics were gathered since the last call, the
+///         accuracy of the training data is taken from them instead of
+///         predicting the training data again, and they are cleared
+///         afterwards.
 void NeuralNetwork::Accuracy(string &csv) {
   // 计算训练数据的准确率（Calculate the accuracy of the training data）
-  int correct = 0;
-  int index = 0;
-  int temp = 0;
-  for (int i = 0; i < this->raw_data_.train_number; ++i) {
-    this->O_[0] = this->raw_data_.train_data.row(i);
-    this->Predict();
-    this->O_[this->layers_ - 1].maxCoeff(&temp, &index);
-    if (this->raw_data_.train_labels(i) == index) {
-      ++correct;
-    }
-  }
-  float acc1 = (float)correct / this->raw_data_.train_number;
+  float acc1 = this->metrics_.samples > 0
+                   ? this->metrics_.Accuracy()
+                   : this->Evaluate(false, vector<int>());
+  this->ResetTrainMetrics();
   cout.precision(4);
   cout << "  Accuracy of training data: " << acc1 * 100 << "%，";
   // 计算测试数据的准确率（Calculate the accuracy of test data）
-  correct = 0.0;
-  for (int i = 0; i < this->raw_data_.test_number; ++i) {
-    this->O_[0] = this->raw_data_.test_data.row(i);
-    this->Predict();
-    this->O_[this->layers_ - 1].maxCoeff(&temp, &index);
-    if (this->raw_data_.test_labels(i) == index) {
-      ++correct;
-    }
-  }
-  float acc2 = (float)correct / this->raw_data_.test_number;
+  float acc2 = this->Evaluate(true, vector<int>());
   cout << "Accuracy of test data: " << acc2 * 100 << "%" << endl;
   csv += std::to_string(acc1) + "," + std::to_string(acc2) + "\n";
+}
+
+/// @brief 计算部分数据的准确率（Calculate accuracy on part of the data）
+/// @param test 为true时使用测试数据，否则使用训练数据
+///        （use the test data when true, otherwise the training data）
+/// @param indices 参与计算的样本索引，为空时使用全部样本
+///        （indices of the samples to use, all samples when empty）
+/// @return 准确率（accuracy）
+float NeuralNetwork::Evaluate(bool test, const vector<int> &indices) {
+  if (!this->sparse_ready_) this->BuildSparse();
+  if (this->inference_) {
+    return this->EvaluateLayers(test, indices, this->W_, this->B_,
+                                this->buffers_.data(), true,
+                                this->plan_.buffer_of.data());
+  }
+  return this->EvaluateLayers(test, indices, this->W_, this->B_, this->O_,
+                              true);
+}
+
+/// @brief 用参数快照计算准确率（Calculate accuracy with a parameter snapshot）
+/// @param test 为true时使用测试数据，否则使用训练数据
+///        （use the test data when true, otherwise the training data）
+/// @param indices 参与计算的样本索引，为空时使用全部样本
+///        （indices of the samples to use, all samples when empty）
+/// @param params 参数快照（parameter snapshot）
+/// @param O 层输出，至少有GetLayers()+1个（outputs of layers, at least
+///        GetLayers()+1 of them）
+/// @return 准确率（accuracy）
+/// @remark 不修改神经网络本身，可以在其他线程中与训练同时进行。
+///         The network itself is not modified, so this can run on another
+///         thread while training continues.
+float NeuralNetwork::Evaluate(bool test, const vector<int> &indices,
+                              Parameters &params, vector<MatrixXf> &O) {
+  O.resize(this->layers_ + 1);
+  return this->EvaluateLayers(test, indices, params.W.data(),
+                              params.B.data(), O.data(), false);
+}
+
+/// @brief 按批量预测并统计准确率（Batched prediction and accuracy count）
+/// @param test 为true时使用测试数据，否则使用训练数据
+///        （use the test data when true, otherwise the training data）
+/// @param indices 参与计算的样本索引，为空时使用全部样本
+///        （indices of the samples to use, all samples when empty）
+/// @param W 权重（weights）
+/// @param B 偏置（bias）
+/// @param O 层输出（outputs of layers）
+/// @param sparse 是否使用稀疏权重（whether to use the sparse weights）
+/// @param map 层输出所在的缓冲区，可以为空指针（buffer of each layer output,
+///        may be a null pointer）
+/// @return 准确率（accuracy）
+/// @remark 样本按批量一次预测，每批最多256行，减少逐个样本调用的开销。
+///         Samples are predicted in batches of at most 256 rows, which avoids
+///         the overhead of one call per sample.
+float NeuralNetwork::EvaluateLayers(bool test, const vector<int> &indices,
+                                    MatrixXf *W, MatrixXf *B, MatrixXf *O,
+                                    bool sparse, const int *map) {
+  MatrixXf &input = O[map == nullptr ? 0 : map[0]];
+  int last = this->layers_ - 1;
+  MatrixXf &output = O[map == nullptr ? last : map[last]];
+  const MatrixXfr &data =
+      test ? this->data_->test_data : this->data_->train_data;
+  const MatrixXb &labels =
+      test ? this->data_->test_labels : this->data_->train_labels;
+  int total = indices.empty() ? (test ? this->data_->test_number
+                                      : this->data_->train_number)
+                              : indices.size();
+  if (total <= 0) return 0.0f;
+  const int batch = 256;
+  int correct = 0;
+  int n = 0;
+  int index = 0;
+  MatrixXi predict;
+  for (int begin = 0; begin < total; begin += batch) {
+    n = std::min(batch, total - begin);
+    input.resize(n, data.cols());
+    for (int r = 0; r < n; ++r) {
+      index = indices.empty() ? begin + r : indices[begin + r];
+      input.row(r) = data.row(index);
+    }
+    this->PredictLayers(W, B, O, sparse, map);
+    this->softmax_loss_.Argmax(output, predict);
+    for (int r = 0; r < n; ++r) {
+      index = indices.empty() ? begin + r : indices[begin + r];
+      if (labels(index) == predict(r, 0)) ++correct;
+    }
+  }
+  return static_cast<float>(correct) / total;
+}
+
+/// @brief 保存可训练参数（Save the trainable parameters）
+/// @param params 参数副本（copy of the parameters）
+void NeuralNetwork::SaveParameters(Parameters &params) {
+  params.W.resize(this->layers_ + 1);
+  params.B.resize(this->layers_ + 1);
+  for (int i = 1; i <= this->layers_; ++i) {
+    params.W[i] = this->W_[i];
+    params.B[i] = this->B_[i];
+  }
+}
+
+/// @brief 恢复可训练参数（Restore the trainable parameters）
+/// @param params 参数副本（copy of the parameters）
+void NeuralNetwork::LoadParameters(const Parameters &params) {
+  for (int i = 1; i <= this->layers_ && i < (int)params.W.size(); ++i) {
+    this->W_[i] = params.W[i];
+    this->B_[i] = params.B[i];
+  }
+  this->sparse_ready_ = false;
+  if (this->inference_) this->FoldBatchNorm();
+  this->PackWeights();
+}
+
+/// @brief 预测概率最大的前k个类别（Predict the top k classes）
+/// @param X 单个样本的输入（input of a single sample）
+/// @param k 需要的类别数（number of classes wanted）
+/// @param index 类别索引（class indices）
+/// @param score 校准后的概率（calibrated probabilities）
+void NeuralNetwork::TopK(MatrixXf &X, int k, MatrixXi &index,
+                         MatrixXf &score) {
+  if (!this->sparse_ready_) this->BuildSparse();
+  this->Output(0) = X;
+  this->Predict();
+  this->softmax_loss_.TopK(this->Output(this->layers_ - 1), k, index, score);
 }
\ No newline at end of file
@@ -6,28 +6,55 @@
 #ifndef MOUNTAIN_LAKE_NEURAL_NETWORK_NEURAL_NETWORK_H_
 #define MOUNTAIN_LAKE_NEURAL_NETWORK_NEURAL_NETWORK_H_
 
+#include <mountain_lake/kernels/philox.h>
+#include <mountain_lake/layers/add.h>
 #include <mountain_lake/layers/affine.h>
+#include <mountain_lake/layers/batchnorm.h>
+#include <mountain_lake/layers/concat.h>
+#include <mountain_lake/layers/conv_relu_pool.h>
 #include <mountain_lake/layers/convolution.h>
+#include <mountain_lake/layers/depthwise_convolution.h>
+#include <mountain_lake/layers/dropout.h>
+#include <mountain_lake/layers/gelu.h>
+#include <mountain_lake/layers/global_pooling.h>
+#include <mountain_lake/layers/leakyrelu.h>
+#include <mountain_lake/layers/low_rank_affine.h>
 #include <mountain_lake/layers/matmul.h>
+#include <mountain_lake/layers/matrix_types.h>
+#include <mountain_lake/layers/pointwise_convolution.h>
 #include <mountain_lake/layers/pooling.h>
 #include <mountain_lake/layers/relu.h>
 #include <mountain_lake/layers/sigmoid.h>
 #include <mountain_lake/layers/softmaxwithloss.h>
+#include <mountain_lake/layers/tanh.h>
+#include <mountain_lake/neural_network/memory_planner.h>
+#include <mountain_lake/parallel/thread_pool.h>
 #include <mountain_town/string/toml.h>
 
+#include <atomic>
 #include <eigen3/Eigen/Dense>
 #include <iostream>
 #include <unordered_map>
+#include <vector>
 
 using Eigen::Dynamic;
 using Eigen::Matrix;
 using Eigen::MatrixXf;
 using Eigen::RowMajor;
 using std::unordered_map;
+using std::vector;
 
-typedef Matrix<uint8_t, Dynamic, Dynamic> MatrixXb;
 typedef Matrix<float, Dynamic, Dynamic, RowMajor> MatrixXfr;
 
+string ReadConfigValue(unordered_map<string, string>& conf, const string& key,
+                       int& value);
+string ReadConfigValue(unordered_map<string, string>& conf, const string& key,
+                       unsigned int& value);
+string ReadConfigValue(unordered_map<string, string>& conf, const string& key,
+                       uint64_t& value);
+string ReadConfigValue(unordered_map<string, string>& conf, const string& key,
+                       float& value);
+
 /// @brief 层的结构（structure of layers）
 struct NeuralNetworkLayer {
   string type = "";
@@ -53,40 +80,303 @@ struct RawData {
   int test_number = 0;
 };
 
+/// @brief 剪枝配置（pruning configuration）
+struct PruneConfig {
+  bool enabled = false;
+  // 最终稀疏度（final sparsity）
+  float sparsity = 0.0f;
+  int format = kSparseBlock1x8;
+  // 逐步剪枝的开始与结束步数，结束步数为0时在开始步一次剪完
+  // First and last step of gradual pruning, a last step of 0 prunes
+  // everything at the first step.
+  int begin_step = 0;
+  int end_step = 0;
+  // 每隔多少步剪一次（prune every this many steps）
+  int frequency = 100;
+  // 密度低于此值时使用稀疏权重推理
+  // Sparse weights are used for inference below this density.
+  float density_threshold = 0.3f;
+};
+
+/// @brief 可训练参数的副本（copy of the trainable parameters）
+/// @remark 用于保存和恢复最佳检查点。
+///         Used to keep and restore the best checkpoint.
+struct Parameters {
+  vector<MatrixXf> W;  // 权重（weights）
+  vector<MatrixXf> B;  // 偏置（bias）
+};
+
+/// @brief 训练指标，由训练时的正向传播顺便累计（training metrics, gathered
+///        as a side effect of the training forward passes）
+/// @remark 每个样本的误差与预测在计算梯度时已经得到，累计它们几乎没有开销，
+///         不需要再对训练数据预测一遍。因为权重在累计期间不断更新，得到的是
+///         这段时间的平均值，而不是最终权重的指标。
+///         The loss and prediction of every sample are already known when the
+///         gradients are computed, so gathering them costs next to nothing
+///         and no extra prediction pass over the training data is needed.
+///         Since the weights keep changing while they are gathered, the result
+///         is the average over that period rather than the metrics of the
+///         final weights.
+struct TrainMetrics {
+  long samples = 0;   // 样本数（number of samples）
+  double loss = 0.0;  // 误差之和（sum of the losses）
+  long correct = 0;   // 预测正确的样本数（correctly predicted samples）
+  vector<long> class_samples;  // 每个类别的样本数（samples of each class）
+  vector<long> class_correct;  // 每个类别预测正确的样本数（correctly
+                               // predicted samples of each class）
+
+  /// @brief 平均误差（mean loss）
+  inline float Loss() const {
+    return this->samples > 0 ? this->loss / this->samples : 0.0f;
+  }
+  /// @brief 准确率（accuracy）
+  inline float Accuracy() const {
+    return this->samples > 0
+               ? static_cast<float>(this->correct) / this->samples
+               : 0.0f;
+  }
+  /// @brief 类别c的准确率，没有这个类别的样本时为0（accuracy of class c, 0
+  ///        when there is no sample of the class）
+  inline float ClassAccuracy(int c) const {
+    if (c < 0 || c >= (int)this->class_samples.size()) return 0.0f;
+    if (this->class_samples[c] == 0) return 0.0f;
+    return static_cast<float>(this->class_correct[c]) / this->class_samples[c];
+  }
+  void Merge(const TrainMetrics& other);
+};
+
+/// @brief 工作区，一次正向与反向传播用到的全部缓冲区
+///        （workspace, every buffer used by one forward and backward pass）
+/// @remark 每个线程使用自己的工作区，就可以共享同一份权重同时计算梯度。
+///         With one workspace per thread, threads can compute gradients on
+///         the same shared weights at the same time.
+struct Workspace {
+  vector<MatrixXf> O;   // 层输出（outputs of layers）
+  vector<MatrixXf> dO;  // 层输出的导数，之后是被多层读取的层输出的各份
+                        // 导数（derivatives of the outputs, followed by the
+                        // parts of the derivatives of outputs read by several
+                        // layers）
+  vector<MatrixXf> dW;  // 权重的导数（derivatives of the weights）
+  vector<MatrixXf> dB;  // 偏置的导数（derivatives of the bias）
+  vector<MatrixXb> masks;  // 融合层与丢弃层的掩码（masks of fused and
+                           // dropout layers）
+  MatrixXf Y;              // Softmax函数输出（Softmax function output）
+  vector<uint8_t> labels;  // 监督标签（supervisory labels）
+  float loss = 0.0f;       // 误差（error）
+  TrainMetrics metrics;    // 累计的训练指标（gathered training metrics）
+  // 批量归一化层的滑动统计，不立即应用梯度的线程在这里累计，之后由拥有
+  // 神经网络的线程并入（running statistics of batch normalization layers,
+  // gathered here by threads that do not apply their gradients through the
+  // network and merged later by the thread owning the network）
+  vector<MatrixXf> stats;
+};
+
+/// @brief 激活检查点的统计，记录最近一次正向与反向传播
+///        （statistics of activation checkpointing for the last forward and
+///        backward pass）
+/// @remark peak_bytes与full_bytes之比是节省的内存，recomputed_layers与
+///         forward_layers之比是多出的正向计算量。
+///         peak_bytes over full_bytes is the memory kept, recomputed_layers
+///         over forward_layers is the extra forward compute.
+struct CheckpointStats {
+  // 不使用检查点时全部层输出的字节数（bytes of every layer output without
+  // checkpointing）
+  long full_bytes = 0;
+  // 同时保存的层输出的最大字节数（most bytes of layer outputs alive at once）
+  long peak_bytes = 0;
+  int forward_layers = 0;     // 正向传播计算的层数（layers run forward）
+  int recomputed_layers = 0;  // 反向传播时重新计算的层数（layers run again
+                              // during backpropagation）
+};
+
 /// @brief 神经网络类（neural network class）
 class NeuralNetwork {
  public:
   NeuralNetwork();
   ~NeuralNetwork();
+  // data_可能指向自己的raw_data_，复制或移动后会指向原来的对象，所以不允许
+  // data_ may point at the network's own raw_data_ and would still point at
+  // the source after a copy or move, so neither is allowed.
+  NeuralNetwork(const NeuralNetwork&) = delete;
+  NeuralNetwork& operator=(const NeuralNetwork&) = delete;
   string ReadConfig(string config_file);
   string Init(string config_file, RawData& train_data);
+  string InitShared(string config_file, const RawData& raw_data);
+  static string ConfigureThreadPool(string config_file);
   inline int GetLayers() { return this->layers_; }
   inline NeuralNetworkLayer& GetLayer(int index) { return this->nnl_[index]; }
+  inline const vector<int>& GetInputs(int i) { return this->inputs_[i]; }
+  inline bool IsGraph() { return this->dag_; }
   inline float GetLearningRate() { return this->learning_rate_; }
   inline void SetLearningRate(float rate) { this->learning_rate_ = rate; }
-  inline RawData& GetTrainData() { return this->raw_data_; }
+  inline bool GetFastMath() { return this->fast_math_; }
+  inline const RawData& GetTrainData() { return *this->data_; }
+  // 神经网络自己的原始数据，用Init初始化时就是使用的数据（the network's own
+  // raw data, which is the data in use after Init）
+  inline RawData& GetOwnTrainData() { return this->raw_data_; }
+  inline float GetLoss() { return this->loss_; }
+  inline TrainMetrics& GetTrainMetrics() { return this->metrics_; }
+  inline void ResetTrainMetrics() { this->metrics_ = TrainMetrics(); }
   void Gradient(int index);
+  void Gradient(const vector<int>& indices);
+  void Gradient(const vector<int>& indices, Workspace& ws);
+  void Gradient(Workspace& ws);
+  void LoadBatch(const vector<int>& indices, Workspace& ws);
+  void ResizeWorkspace(int n, Workspace& ws);
+  int StepForward(int i, Workspace& ws);
+  int StepBackward(int i, Workspace& ws, vector<MatrixXf>& dW,
+                   vector<MatrixXf>& dB);
   void Forward();
   void Predict();
   void Backward();
   void Update();
+  void Update(Workspace& ws);
   void Accuracy(string& csv);
+  float Evaluate(bool test, const vector<int>& indices);
+  float Evaluate(bool test, const vector<int>& indices, Parameters& params,
+                 vector<MatrixXf>& O);
+  void SaveParameters(Parameters& params);
+  void LoadParameters(const Parameters& params);
+  void TopK(MatrixXf& X, int k, MatrixXi& index, MatrixXf& score);
+  void Prune(float sparsity);
+  string Factorize(int i, int rank);
+  void Expand(int i);
+  void BuildSparse();
+  void PackWeights();
+  inline void DropPackedWeights() { this->packed_ready_ = false; }
+  inline bool IsPacked() { return this->packed_ready_; }
+  inline float GetDensity(int i) { return Density(this->W_[i]); }
+  inline bool IsSparse(int i) { return this->SW_[i].rows > 0; }
+  inline PruneConfig& GetPruneConfig() { return this->prune_; }
+  inline bool IsInference() { return this->inference_; }
+  inline MemoryPlan& GetMemoryPlan() { return this->plan_; }
+  MatrixXf& Output(int i);
+  inline bool IsCheckpointing() { return this->checkpointing_; }
+  inline bool IsCheckpoint(int i) { return this->checkpoint_[i]; }
+  inline bool IsFused(int i) { return this->fused_[i]; }
+  inline bool IsFolded(int i) { return this->folded_[i]; }
+  inline CheckpointStats& GetCheckpointStats() {
+    return this->checkpoint_stats_;
+  }
+  // 调用者可能修改权重，所以打包的权重不再可信（the caller may change the
+  // weights, so the packed weights are no longer trusted）
+  inline MatrixXf& GetWeights(int i) {
+    this->packed_ready_ = false;
+    return this->W_[i];
+  }
+  // 不改变打包状态的权重，调用者先调用DropPackedWeights()，之后不再使用
+  // 打包的权重，多个线程可以同时取得（weights without touching the packed
+  // state; the caller first calls DropPackedWeights() so the packed weights
+  // are no longer used, then several threads may get them at once）
+  inline MatrixXf& GetRawWeights(int i) { return this->W_[i]; }
+  inline MatrixXf& GetBias(int i) { return this->B_[i]; }
+  inline BatchNormConfig& GetBatchNormConfig(int i) { return this->bc_[i]; }
+  inline MatrixXf& GetWeightGradient(int i) { return this->dW_[i]; }
+  inline MatrixXf& GetBiasGradient(int i) { return this->dB_[i]; }
 
  private:
+  string InitWeights(int i, int fan_in, int fan_out);
+  string WeightStddev(int i, int fan_in, int fan_out, float& stddev);
   string InitAffine(int i);
+  string InitLowRankAffine(int i);
   void InitSigmoid(int i);
   void InitRelu(int i);
+  void InitActivation(int i);
+  string InitLeakyRelu(int i);
+  string InitDropout(int i);
   void InitSoftmaxWithLoss(int i);
+  string InitBatchNorm(int i);
+  void FoldBatchNorm();
   string InitConv(int i);
+  string InitDepthwiseConv(int i);
+  string InitPointwiseConv(int i);
+  int InputChannels(int i);
+  string CheckChannels(int i, const string& key, int channels);
   string InitPool(int i);
+  string InitGlobalPool(int i);
+  string ReadPruneConfig();
+  string ReadGraph();
+  void ScheduleGraph();
+  string InitMerge(int i);
+  int NormChannels(int k);
+  string ReadCheckpointConfig();
+  static string StartThreadPool(unordered_map<string, string>& conf);
+  void AllocateBuffers(int i);
+  void PlanMemory();
+  void FuseLayers();
+  bool CompactLayer(int i);
+  void PlanCompact();
+  void PredictLayers(MatrixXf* W, MatrixXf* B, MatrixXf* O, bool sparse,
+                     const int* map = nullptr, MatrixXb* masks = nullptr);
+  int ForwardStep(int i, MatrixXf* W, MatrixXf* B, MatrixXf* O, bool sparse,
+                  const int* map, MatrixXb* masks);
+  void ForwardDropout(int i, MatrixXf& X, MatrixXf& Z, MatrixXb* masks);
+  void ForwardMerge(int i, MatrixXf* O, const int* map, MatrixXf& Z);
+  void ForwardLayer(int i, MatrixXf* W, MatrixXf* B, MatrixXf& X, MatrixXf& Z,
+                    bool sparse, bool training);
+  void BackwardLayers(MatrixXf* W, MatrixXf* O, MatrixXf* dO, MatrixXf* dW,
+                      MatrixXf* dB, MatrixXf& Y, const uint8_t* labels,
+                      MatrixXb* masks);
+  int BackwardStep(int i, MatrixXf* W, MatrixXf* O, MatrixXf* dO, MatrixXf* dW,
+                   MatrixXf* dB, MatrixXf& Y, const uint8_t* labels,
+                   MatrixXb* masks);
+  void BackwardMerge(int i, MatrixXf* dO);
+  void BackwardLayer(int i, MatrixXf* W, MatrixXf* O, MatrixXf* dO,
+                     MatrixXf* dW, MatrixXf* dB, MatrixXf& Y,
+                     const uint8_t* labels);
+  void CountMetrics(MatrixXf& Y, const uint8_t* labels, float loss,
+                    TrainMetrics& metrics);
+  long ActivationBytes();
+  long MaskBytes();
+  void ApplyGradients(MatrixXf* dW, MatrixXf* dB);
+  float EvaluateLayers(bool test, const vector<int>& indices, MatrixXf* W,
+                       MatrixXf* B, MatrixXf* O, bool sparse,
+                       const int* map = nullptr);
+  void GradualPrune();
 
   unordered_map<string, string> conf_;  // 配置信息（configuration information）
   NeuralNetworkLayer nnl_[100];         // 层（layers）
   int layers_;                          // 层的数量（number of layers）
+  // 每层读取的层，默认为前一层（layers read by each layer, the previous
+  // layer by default）
+  vector<int> inputs_[100];
+  // 每层把各个输入的导数写到dO的哪一项（entry of dO where each layer writes
+  // the derivative of each of its inputs）
+  vector<int> slots_[100];
+  // 被多层读取的层输出，其导数为dO中这些项之和（for a layer output read by
+  // several layers, its derivative is the sum of these entries of dO）
+  vector<int> grads_[100];
+  int slot_count_ = 0;  // dO的项数（number of entries of dO）
+  // 是否不是一条链（whether the layers are not a chain）
+  bool dag_ = false;
+  // 按层级排列的正向与反向传播的步，同一层级的步互不依赖（forward and
+  // backward steps by level, steps of one level do not depend on each
+  // other）
+  vector<vector<int>> forward_levels_;
+  vector<vector<int>> backward_levels_;
   float learning_rate_;                 // 学习率（learning rate）
-  uint8_t label_;                       // 监督标签
+  vector<uint8_t> labels_;  // 监督标签，每个样本一个（one label per sample）
+  bool fast_math_ = false;  // 是否使用快速数学函数（whether to use fast math）
+  // 只做推理，不分配导数（inference only, no derivatives are allocated）
+  bool inference_ = false;
+  MemoryPlan plan_;         // 推理时的内存规划（memory plan of inference）
+  vector<MatrixXf> buffers_;  // 推理时共享的层输出（shared layer outputs）
+  string init_ = "normal";  // 默认的权重初始化方式（default weight init）
+  uint64_t seed_ = 0;       // 权重初始化的种子（seed of weight init）
+  // 是否使用激活检查点（whether activation checkpointing is used）
+  bool checkpointing_ = false;
+  bool checkpoint_[100];  // 训练时保留哪些层输出（outputs kept in training）
+  CheckpointStats checkpoint_stats_;  // 检查点的统计（checkpoint statistics）
+  // 是否只保存ReLU层的掩码与池化层的位置（whether ReLU layers keep only masks
+  // and pooling layers only positions）
+  bool compact_ = false;
+  bool keep_[100];  // 紧凑模式下反向传播需要的层输出（outputs needed by
+                    // backpropagation in compact mode）
 
   RawData raw_data_;  // 原始数据（raw data）
+  // 使用的原始数据，为raw_data_或共享的数据（raw data in use, either
+  // raw_data_ or shared data）
+  const RawData* data_ = &this->raw_data_;
   MatrixXf W_[100];   // 权重（weights）
   MatrixXf B_[100];   // 偏置（bias）
   MatrixXf O_[100];   // 层输出（output of layers）
@@ -96,17 +386,58 @@ class NeuralNetwork {
                       // parameter of the layer）
   MatrixXf Y_;        // Softmax函数输出（Softmax function output）
   float loss_;        // 误差（error）
+  TrainMetrics metrics_;  // 累计的训练指标（gathered training metrics）
 
   ConvConig cc_[100];  // 卷积层配置（Convolutional Layer Configuration）
   PoolConfig pc_[100];  // 池化层配置（Pooling layer configuration）
+  float alpha_[100];    // LeakyReLU层负半轴的斜率（slope of LeakyReLU layers）
+  float rate_[100];     // 丢弃层的丢弃概率（drop rate of dropout layers）
+  // 丢弃层已经生成的掩码数，作为下一个掩码的流号（masks generated by dropout
+  // layers, the stream of the next mask）
+  std::atomic<uint64_t> dropout_step_{0};
+  // 是否在为激活检查点重新计算，此时丢弃层使用已有的掩码（whether
+  // recomputing for checkpointing, dropout layers reuse their masks then）
+  bool recomputing_ = false;
+  // 第i层是否与后两层融合（whether layer i is fused with the next two）
+  bool fused_[100];
+  MatrixXb masks_[100];  // 融合层与丢弃层的掩码，紧凑模式下还有ReLU层的
+                         // 掩码与池化层的位置（masks of fused and dropout
+                         // layers, plus ReLU masks and pooling positions in
+                         // compact mode）
+  BatchNormConfig bc_[100];  // 批量归一化层配置（batch normalization
+                             // configuration）
+  // 批量归一化层是否已经合并到前一层（whether a batch normalization layer is
+  // folded into the previous layer）
+  bool folded_[100] = {};
+
+  PruneConfig prune_;         // 剪枝配置（pruning configuration）
+  MatrixXf M_[100];           // 剪枝掩码（pruning masks）
+  SparseMatrix SW_[100];      // 稀疏权重（sparse weights）
+  bool sparse_ready_ = false;  // 稀疏权重是否与W_一致（sparse weights match W_）
+  PackedMatrix packed_[100];   // 打包的仿射变换层权重（packed affine weights）
+  bool packed_ready_ = false;  // 打包的权重是否与W_一致（packed weights match
+                               // W_）
+  int step_ = 0;              // 已更新的步数（number of update steps）
 
+  Add add_;
   Affine affine_;
+  LowRankAffine low_rank_affine_;
   Sigmoid sigmoid_;
   ReLU relu_;
   SoftmaxWithLoss softmax_loss_;
   Convolution conv_;
+  DepthwiseConvolution depthwise_;
+  PointwiseConvolution pointwise_;
+  ConvReluPool conv_relu_pool_;
   Pooling pool_;
+  GlobalPooling global_pool_;
   MatMul matmul_;
+  Tanh tanh_;
+  GELU gelu_;
+  LeakyReLU leaky_relu_;
+  BatchNorm batch_norm_;
+  Concat concat_;
+  Dropout dropout_;
 };
 
 #endif  // MOUNTAIN_LAKE_NEURAL_NETWORK_NEURAL_NETWORK_H_
\ No newline at end of file
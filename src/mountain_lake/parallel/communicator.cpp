@@ -0,0 +1,446 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "communicator.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+// 共享内存中每个方向的环形缓冲区大小
+// Size of the ring buffer of every direction in shared memory.
+static const size_t kShmCapacity = 1 << 20;
+
+/// @brief 从rank到rank+1的共享内存通道（shared memory channel from rank to
+///        rank+1）
+/// @remark head与tail是写入与读取的总字节数，分别只由发送者与接收者修改。
+///         新建的共享内存全部为0，即空的通道。
+///         head and tail are the total bytes written and read, modified only
+///         by the sender and the receiver respectively. A newly created
+///         shared memory object is all zeros, which is an empty channel.
+struct ShmChannel {
+  alignas(64) std::atomic<uint64_t> head;
+  alignas(64) std::atomic<uint64_t> tail;
+  alignas(64) char data[kShmCapacity];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "Channels in shared memory need lock-free atomics.");
+
+/// @brief 距离截止时间的剩余秒数（seconds left until the deadline）
+static double SecondsLeft(std::chrono::steady_clock::time_point deadline) {
+  return std::chrono::duration<double>(deadline -
+                                       std::chrono::steady_clock::now())
+      .count();
+}
+
+/// @brief 套接字的路径（path of a socket）
+static string SocketPath(const string &name, int rank) {
+  return "/tmp/" + name + "." + std::to_string(rank) + ".sock";
+}
+
+/// @brief POSIX共享内存传输（POSIX shared memory transport）
+/// @remark 一个共享内存对象中为每个进程保存一个通往下一个进程的通道，数据
+///         直接复制进出环形缓冲区，不经过内核。等待时先空转，再让出CPU。
+///         One shared memory object holds a channel to the next process for
+///         every process, data is copied straight into and out of the ring
+///         buffers without going through the kernel. Waiting spins first and
+///         then yields the CPU.
+class ShmTransport : public Transport {
+ public:
+  ShmTransport(){};
+  ~ShmTransport();
+  string Open(const string &name, int rank, int size, double timeout);
+  string SendRecv(const void *send, size_t send_bytes, void *recv,
+                  size_t recv_bytes) override;
+
+ private:
+  ShmChannel *channels_ = nullptr;
+  size_t bytes_ = 0;
+  int rank_ = 0;
+  int size_ = 1;
+  double timeout_ = 0.0;
+};
+
+ShmTransport::~ShmTransport() {
+  if (this->channels_ != nullptr) munmap(this->channels_, this->bytes_);
+}
+
+/// @brief 打开共享内存（Open the shared memory）
+/// @param name 名字，同一组的进程相同（name, the same for a group）
+/// @param rank 进程号（rank）
+/// @param size 进程数（number of processes）
+/// @param timeout 等待其他进程的秒数（seconds to wait for other processes）
+/// @return 错误信息（error message）
+string ShmTransport::Open(const string &name, int rank, int size,
+                          double timeout) {
+  this->rank_ = rank;
+  this->size_ = size;
+  this->timeout_ = timeout;
+  this->bytes_ = sizeof(ShmChannel) * size;
+  string path = "/" + name;
+  int fd = shm_open(path.c_str(), O_RDWR | O_CREAT, 0600);
+  if (fd < 0) return "Cannot open the shared memory \"" + path + "\".";
+  // 所有进程设置相同的大小，已经写入的数据不受影响
+  // Every process sets the same size, data already written is unaffected.
+  if (ftruncate(fd, this->bytes_) != 0) {
+    close(fd);
+    return "Cannot resize the shared memory \"" + path + "\".";
+  }
+  void *p = mmap(nullptr, this->bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                 0);
+  close(fd);
+  if (p == MAP_FAILED) return "Cannot map the shared memory \"" + path + "\".";
+  this->channels_ = static_cast<ShmChannel *>(p);
+  return "";
+}
+
+/// @brief 向下一个进程发送，同时从上一个进程接收（Send to the next process
+///        while receiving from the previous one）
+/// @param send 发送的数据（data to send）
+/// @param send_bytes 发送的字节数（bytes to send）
+/// @param recv 接收的位置（where to receive）
+/// @param recv_bytes 接收的字节数（bytes to receive）
+/// @return 错误信息（error message）
+string ShmTransport::SendRecv(const void *send, size_t send_bytes, void *recv,
+                              size_t recv_bytes) {
+  ShmChannel &out = this->channels_[this->rank_];
+  ShmChannel &in = this->channels_[(this->rank_ + this->size_ - 1) %
+                                   this->size_];
+  const char *s = static_cast<const char *>(send);
+  char *r = static_cast<char *>(recv);
+  size_t sent = 0;
+  size_t received = 0;
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::duration<double>(this->timeout_));
+  long idle = 0;
+  while (sent < send_bytes || received < recv_bytes) {
+    bool progress = false;
+    if (sent < send_bytes) {
+      uint64_t head = out.head.load(std::memory_order_relaxed);
+      uint64_t used = head - out.tail.load(std::memory_order_acquire);
+      size_t count = std::min<size_t>(kShmCapacity - used, send_bytes - sent);
+      if (count > 0) {
+        size_t pos = head % kShmCapacity;
+        size_t first = std::min(count, kShmCapacity - pos);
+        std::memcpy(out.data + pos, s + sent, first);
+        std::memcpy(out.data, s + sent + first, count - first);
+        out.head.store(head + count, std::memory_order_release);
+        sent += count;
+        progress = true;
+      }
+    }
+    if (received < recv_bytes) {
+      uint64_t tail = in.tail.load(std::memory_order_relaxed);
+      uint64_t ready = in.head.load(std::memory_order_acquire) - tail;
+      size_t count = std::min<size_t>(ready, recv_bytes - received);
+      if (count > 0) {
+        size_t pos = tail % kShmCapacity;
+        size_t first = std::min(count, kShmCapacity - pos);
+        std::memcpy(r + received, in.data + pos, first);
+        std::memcpy(r + received + first, in.data, count - first);
+        in.tail.store(tail + count, std::memory_order_release);
+        received += count;
+        progress = true;
+      }
+    }
+    if (progress) {
+      idle = 0;
+      continue;
+    }
+    // 先空转一会儿，再让出CPU（spin for a while, then yield the CPU）
+    if (++idle < 1024) continue;
+    std::this_thread::yield();
+    if (idle % 1024 == 0 && SecondsLeft(deadline) < 0) {
+      return "Timed out waiting for process " +
+             std::to_string(received < recv_bytes
+                                ? (this->rank_ + this->size_ - 1) % this->size_
+                                : (this->rank_ + 1) % this->size_) +
+             ".";
+    }
+  }
+  return "";
+}
+
+/// @brief Unix域套接字传输（Unix domain socket transport）
+/// @remark 每个进程在/tmp/name.rank.sock上监听，连接下一个进程，接受上一个
+///         进程的连接，连上后删除监听的路径。换成TCP套接字就可以跨节点。
+///         Every process listens on /tmp/name.rank.sock, connects to the next
+///         process and accepts the connection of the previous one, and
+///         removes the listening path once connected. Swapping in TCP sockets
+///         would let it span nodes.
+class SocketTransport : public Transport {
+ public:
+  SocketTransport(){};
+  ~SocketTransport();
+  string Open(const string &name, int rank, int size, double timeout);
+  string SendRecv(const void *send, size_t send_bytes, void *recv,
+                  size_t recv_bytes) override;
+
+ private:
+  int next_ = -1;  // 连接下一个进程（connection to the next process）
+  int prev_ = -1;  // 来自上一个进程的连接（connection from the previous one）
+  double timeout_ = 0.0;
+};
+
+SocketTransport::~SocketTransport() {
+  if (this->next_ >= 0) close(this->next_);
+  if (this->prev_ >= 0) close(this->prev_);
+}
+
+/// @brief 与前后两个进程建立连接（Connect to the next and previous
+///        processes）
+/// @param name 名字，同一组的进程相同（name, the same for a group）
+/// @param rank 进程号（rank）
+/// @param size 进程数（number of processes）
+/// @param timeout 等待其他进程的秒数（seconds to wait for other processes）
+/// @return 错误信息（error message）
+/// @remark 先监听再连接，连接只需要对方已经监听，所以各进程不会互相等待。
+///         Listening comes before connecting, and connecting only needs the
+///         other side to listen, so the processes never wait on each other.
+string SocketTransport::Open(const string &name, int rank, int size,
+                             double timeout) {
+  this->timeout_ = timeout;
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::duration<double>(timeout));
+  string path = SocketPath(name, rank);
+  string next_path = SocketPath(name, (rank + 1) % size);
+  sockaddr_un addr;
+  if (path.size() >= sizeof(addr.sun_path) ||
+      next_path.size() >= sizeof(addr.sun_path)) {
+    return "The socket path \"" + path + "\" is too long.";
+  }
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0) return "Cannot create a socket.";
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  std::strcpy(addr.sun_path, path.c_str());
+  unlink(path.c_str());
+  if (bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+      listen(listener, 1) != 0) {
+    close(listener);
+    return "Cannot listen on \"" + path + "\".";
+  }
+  string err;
+  this->next_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  std::strcpy(addr.sun_path, next_path.c_str());
+  while (connect(this->next_, reinterpret_cast<sockaddr *>(&addr),
+                 sizeof(addr)) != 0) {
+    if (SecondsLeft(deadline) < 0) {
+      err = "Timed out connecting to \"" + next_path + "\".";
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  if (err.empty()) {
+    pollfd p = {listener, POLLIN, 0};
+    int ms = std::max(0, static_cast<int>(SecondsLeft(deadline) * 1000));
+    if (poll(&p, 1, ms) == 1) this->prev_ = accept(listener, nullptr, nullptr);
+    if (this->prev_ < 0) err = "Timed out waiting for process " +
+                               std::to_string((rank + size - 1) % size) + ".";
+  }
+  close(listener);
+  unlink(path.c_str());
+  if (!err.empty()) return err;
+  fcntl(this->next_, F_SETFL, fcntl(this->next_, F_GETFL) | O_NONBLOCK);
+  fcntl(this->prev_, F_SETFL, fcntl(this->prev_, F_GETFL) | O_NONBLOCK);
+  return "";
+}
+
+/// @brief 向下一个进程发送，同时从上一个进程接收（Send to the next process
+///        while receiving from the previous one）
+/// @param send 发送的数据（data to send）
+/// @param send_bytes 发送的字节数（bytes to send）
+/// @param recv 接收的位置（where to receive）
+/// @param recv_bytes 接收的字节数（bytes to receive）
+/// @return 错误信息（error message）
+string SocketTransport::SendRecv(const void *send, size_t send_bytes,
+                                 void *recv, size_t recv_bytes) {
+  const char *s = static_cast<const char *>(send);
+  char *r = static_cast<char *>(recv);
+  size_t sent = 0;
+  size_t received = 0;
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::duration<double>(this->timeout_));
+  while (sent < send_bytes || received < recv_bytes) {
+    bool progress = false;
+    if (sent < send_bytes) {
+      ssize_t count =
+          ::send(this->next_, s + sent, send_bytes - sent, MSG_NOSIGNAL);
+      if (count > 0) {
+        sent += count;
+        progress = true;
+      } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        return "Cannot send to the next process.";
+      }
+    }
+    if (received < recv_bytes) {
+      ssize_t count = ::recv(this->prev_, r + received, recv_bytes - received,
+                             0);
+      if (count > 0) {
+        received += count;
+        progress = true;
+      } else if (count == 0) {
+        return "The previous process closed the connection.";
+      } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        return "Cannot receive from the previous process.";
+      }
+    }
+    if (progress) continue;
+    pollfd p[2] = {{this->next_, 0, 0}, {this->prev_, 0, 0}};
+    if (sent < send_bytes) p[0].events = POLLOUT;
+    if (received < recv_bytes) p[1].events = POLLIN;
+    int ms = std::max(0, static_cast<int>(SecondsLeft(deadline) * 1000));
+    if (poll(p, 2, ms) == 0) return "Timed out waiting for another process.";
+  }
+  return "";
+}
+
+/// @brief 加入一组进程（Join a group of processes）
+/// @param transport 传输方式，kTransportShm或kTransportSocket（transport）
+/// @param name 名字，同一组的进程相同，同时运行的组之间不能相同（name, the
+///        same within a group and unique among concurrent groups）
+/// @param rank 进程号，0到size-1（rank, 0 to size-1）
+/// @param size 进程数（number of processes）
+/// @param timeout 等待其他进程的秒数（seconds to wait for other processes）
+/// @return 错误信息（error message）
+/// @remark 所有进程都打开后做一次同步，然后0号进程删除共享内存的名字，之后
+///         进程退出时共享内存会自动释放。
+///         Once every process has opened it they synchronize, then rank 0
+///         removes the name of the shared memory, so it is freed
+///         automatically when the processes exit.
+string Communicator::Open(int transport, const string &name, int rank,
+                          int size, double timeout) {
+  this->Close();
+  if (size <= 0 || rank < 0 || rank >= size) {
+    return "The rank must be between 0 and the number of processes.";
+  }
+  if (name.empty() || name.find('/') != string::npos) {
+    return "The communicator name must be non-empty and contain no '/'.";
+  }
+  this->rank_ = rank;
+  this->size_ = size;
+  if (size == 1) return "";
+  string err;
+  if (transport == kTransportShm) {
+    ShmTransport *shm = new ShmTransport();
+    this->transport_.reset(shm);
+    err = shm->Open(name, rank, size, timeout);
+  } else if (transport == kTransportSocket) {
+    SocketTransport *socket = new SocketTransport();
+    this->transport_.reset(socket);
+    err = socket->Open(name, rank, size, timeout);
+  } else {
+    err = "Unknown transport " + std::to_string(transport) + ".";
+  }
+  if (err.empty()) err = this->Barrier();
+  if (transport == kTransportShm && rank == 0) shm_unlink(("/" + name).c_str());
+  if (!err.empty()) this->Close();
+  return err;
+}
+
+/// @brief 离开这组进程（Leave the group）
+void Communicator::Close() {
+  this->transport_.reset();
+  this->rank_ = 0;
+  this->size_ = 1;
+}
+
+/// @brief 所有进程的数据按元素求和（Sum the data of every process element
+///        by element）
+/// @param data 数据，结束时为所有进程之和（data, the sum over every process
+///        when done）
+/// @param n 元素个数，所有进程相同（number of elements, the same for every
+///        process）
+/// @return 错误信息（error message）
+string Communicator::Allreduce(float *data, long n) {
+  int p = this->size_;
+  if (p == 1 || n <= 0) return "";
+  if (!this->transport_) return "The communicator is not open.";
+  int r = this->rank_;
+  auto begin = [n, p](int c) { return n * c / p; };
+  string err;
+  // reduce-scatter：第s步发送第r-s块，接收第r-s-1块并累加，结束时第r+1块
+  // 已经是所有进程之和
+  // reduce-scatter: step s sends chunk r-s and receives and adds chunk
+  // r-s-1, after which chunk r+1 holds the sum over every process.
+  for (int s = 0; s + 1 < p; ++s) {
+    int sc = ((r - s) % p + p) % p;
+    int rc = ((r - s - 1) % p + p) % p;
+    long count = begin(rc + 1) - begin(rc);
+    this->buffer_.resize(count);
+    err = this->transport_->SendRecv(
+        data + begin(sc), (begin(sc + 1) - begin(sc)) * sizeof(float),
+        this->buffer_.data(), count * sizeof(float));
+    if (!err.empty()) return err;
+    float *target = data + begin(rc);
+    for (long k = 0; k < count; ++k) target[k] += this->buffer_[k];
+  }
+  // allgather：第s步发送第r+1-s块，接收第r-s块
+  // allgather: step s sends chunk r+1-s and receives chunk r-s.
+  for (int s = 0; s + 1 < p; ++s) {
+    int sc = ((r + 1 - s) % p + p) % p;
+    int rc = ((r - s) % p + p) % p;
+    err = this->transport_->SendRecv(
+        data + begin(sc), (begin(sc + 1) - begin(sc)) * sizeof(float),
+        data + begin(rc), (begin(rc + 1) - begin(rc)) * sizeof(float));
+    if (!err.empty()) return err;
+  }
+  return "";
+}
+
+/// @brief 把root进程的数据复制到所有进程（Copy the data of the root process
+///        to every process）
+/// @param data 数据（data）
+/// @param n 元素个数（number of elements）
+/// @param root 数据来源的进程号（rank holding the data）
+/// @return 错误信息（error message）
+/// @remark 其他进程先清零再求和，加0不改变任何值。
+///         The other processes zero their data before summing, adding 0
+///         changes no value.
+string Communicator::Broadcast(float *data, long n, int root) {
+  if (this->rank_ != root) std::fill(data, data + n, 0.0f);
+  return this->Allreduce(data, n);
+}
+
+/// @brief 等待所有进程到达这里（Wait until every process gets here）
+/// @return 错误信息（error message）
+/// @remark 每个进程一个元素的Allreduce，每一块都要经过所有进程。
+///         An Allreduce of one element per process, every chunk has to pass
+///         through every process.
+string Communicator::Barrier() {
+  vector<float> token(this->size_, 0.0f);
+  return this->Allreduce(token.data(), token.size());
+}
+
+/// @brief 删除一组进程留下的共享内存与套接字（Remove the shared memory and
+///        sockets left by a group）
+/// @param transport 传输方式（transport）
+/// @param name 名字（name）
+/// @param size 进程数（number of processes）
+/// @remark 正常结束时它们已经被删除，只在进程异常退出后需要。
+///         They are already removed after a normal run, this is only needed
+///         after processes exit abnormally.
+void Communicator::Unlink(int transport, const string &name, int size) {
+  if (transport == kTransportShm) {
+    shm_unlink(("/" + name).c_str());
+    return;
+  }
+  for (int r = 0; r < size; ++r) unlink(SocketPath(name, r).c_str());
+}
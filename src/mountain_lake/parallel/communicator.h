@@ -0,0 +1,71 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_PARALLEL_COMMUNICATOR_H_
+#define MOUNTAIN_LAKE_PARALLEL_COMMUNICATOR_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+/// @brief 进程之间的传输方式（transports between processes）
+enum CommTransport {
+  kTransportShm = 0,     // POSIX共享内存（POSIX shared memory）
+  kTransportSocket = 1,  // Unix域套接字（Unix domain sockets）
+};
+
+/// @brief 环上的传输（transport around a ring）
+/// @remark 每个进程只与环上的下一个进程和上一个进程通信。SendRecv同时向下一
+///         个进程发送、从上一个进程接收，两个方向交替推进，缓冲区再小也不会
+///         因为所有进程都在发送而死锁。
+///         Every process only talks to the next and the previous process on
+///         the ring. SendRecv sends to the next process while receiving from
+///         the previous one and makes progress in both directions in turn,
+///         so however small the buffers are, all processes sending at once
+///         cannot deadlock.
+class Transport {
+ public:
+  virtual ~Transport(){};
+  virtual string SendRecv(const void* send, size_t send_bytes, void* recv,
+                          size_t recv_bytes) = 0;
+};
+
+/// @brief 多进程的集合通信（collective communication between processes）
+/// @remark 同一组的进程用相同的名字、不同的进程号打开。Allreduce使用环形
+///         算法：先把数据切成进程数块做reduce-scatter，再做allgather，每个
+///         进程收发的数据量约为数据大小的2倍，与进程数无关。相加的顺序对所有
+///         进程相同，所以结果完全一致。
+///         Processes of one group open it with the same name and different
+///         ranks. Allreduce uses the ring algorithm: the data is cut into as
+///         many chunks as processes for a reduce-scatter followed by an
+///         allgather, so every process sends and receives about twice the
+///         data size regardless of the number of processes. Every process
+///         adds in the same order, so the results are identical.
+class Communicator {
+ public:
+  Communicator(){};
+  ~Communicator() { this->Close(); };
+  string Open(int transport, const string& name, int rank, int size,
+              double timeout = 60.0);
+  void Close();
+  string Allreduce(float* data, long n);
+  string Broadcast(float* data, long n, int root);
+  string Barrier();
+  inline int GetRank() { return this->rank_; }
+  inline int GetSize() { return this->size_; }
+  static void Unlink(int transport, const string& name, int size);
+
+ private:
+  std::unique_ptr<Transport> transport_;
+  int rank_ = 0;
+  int size_ = 1;
+  vector<float> buffer_;  // 接收的一块（received chunk）
+};
+
+#endif  // MOUNTAIN_LAKE_PARALLEL_COMMUNICATOR_H_
@@ -0,0 +1,79 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_PARALLEL_SPSC_QUEUE_H_
+#define MOUNTAIN_LAKE_PARALLEL_SPSC_QUEUE_H_
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/// @brief 单生产者单消费者的无锁环形队列（lock-free single-producer
+///        single-consumer ring queue）
+/// @remark 只有一个线程调用Push，只有一个线程调用Pop。容量取为2的幂，写入与
+///         读取的位置分别只由一个线程修改，用acquire与release保证元素在
+///         位置更新之前写好。
+///         Only one thread calls Push and only one thread calls Pop. The
+///         capacity is rounded up to a power of 2, the write and read
+///         positions are each modified by one thread only, and
+///         acquire/release ordering makes sure an element is written before
+///         its position is published.
+template <typename T>
+class SpscQueue {
+ public:
+  explicit SpscQueue(int capacity) {
+    size_t size = 1;
+    while (size < static_cast<size_t>(capacity)) size <<= 1;
+    this->items_.resize(size);
+    this->mask_ = size - 1;
+  }
+
+  /// @brief 放入一个元素，队列满时返回false（Push an element, false when
+  ///        the queue is full）
+  bool Push(const T& item) {
+    size_t tail = this->tail_.load(std::memory_order_relaxed);
+    if (tail - this->head_.load(std::memory_order_acquire) > this->mask_) {
+      return false;
+    }
+    this->items_[tail & this->mask_] = item;
+    this->tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// @brief 取出一个元素，队列空时返回false（Pop an element, false when the
+  ///        queue is empty）
+  bool Pop(T& item) {
+    size_t head = this->head_.load(std::memory_order_relaxed);
+    if (head == this->tail_.load(std::memory_order_acquire)) return false;
+    item = this->items_[head & this->mask_];
+    this->head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// @brief 放入一个元素，队列满时让出CPU等待（Push an element, yielding
+  ///        while the queue is full）
+  void PushWait(const T& item) {
+    while (!this->Push(item)) std::this_thread::yield();
+  }
+
+  /// @brief 取出一个元素，队列空时让出CPU等待（Pop an element, yielding
+  ///        while the queue is empty）
+  T PopWait() {
+    T item;
+    while (!this->Pop(item)) std::this_thread::yield();
+    return item;
+  }
+
+ private:
+  std::vector<T> items_;
+  size_t mask_ = 0;
+  // 读写位置放在不同的缓存行，避免两个线程互相使对方的缓存失效
+  // The positions live on different cache lines, so the two threads do not
+  // keep invalidating each other's cache.
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+};
+
+#endif  // MOUNTAIN_LAKE_PARALLEL_SPSC_QUEUE_H_
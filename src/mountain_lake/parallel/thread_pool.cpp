@@ -0,0 +1,336 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "thread_pool.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <fstream>
+#include <new>
+#include <sstream>
+
+// 当前线程所属的线程池与工作线程号，不是工作线程时为空指针与-1
+// Pool and worker number of the current thread, a null pointer and -1 when
+// it is not a worker.
+static thread_local ThreadPool *t_pool = nullptr;
+static thread_local int t_worker = -1;
+
+/// @brief 解析Linux的CPU列表，例如“0-3,8”（Parse a Linux CPU list such as
+///        "0-3,8"）
+/// @param text CPU列表（CPU list）
+/// @return CPU号（CPU numbers）
+static vector<int> ParseCpuList(const string &text) {
+  vector<int> cpus;
+  std::stringstream ss(text);
+  string item;
+  while (std::getline(ss, item, ',')) {
+    if (item.empty() || item == "\n") continue;
+    size_t dash = item.find('-');
+    int first = std::stoi(item.substr(0, dash));
+    int last = dash == string::npos ? first : std::stoi(item.substr(dash + 1));
+    for (int c = first; c <= last; ++c) cpus.push_back(c);
+  }
+  return cpus;
+}
+
+ThreadPool::~ThreadPool() { this->Stop(); }
+
+/// @brief 进程可以使用的CPU（CPUs the process may run on）
+/// @param numa 为true时按NUMA节点排序（sort by NUMA node when true）
+/// @param nodes 每个CPU所在的节点，可以为空指针（node of every CPU, may be a
+///        null pointer）
+/// @return CPU号（CPU numbers）
+/// @remark 节点信息读取自/sys/devices/system/node，读不到时都视为节点0。
+///         The nodes are read from /sys/devices/system/node, every CPU is on
+///         node 0 when they cannot be read.
+vector<int> ThreadPool::CpuOrder(bool numa, vector<int> *nodes) {
+  vector<int> cpus;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int c = 0; c < CPU_SETSIZE; ++c) {
+      if (CPU_ISSET(c, &set)) cpus.push_back(c);
+    }
+  }
+  if (cpus.empty()) {
+    int n = std::max(1u, std::thread::hardware_concurrency());
+    for (int c = 0; c < n; ++c) cpus.push_back(c);
+  }
+  vector<int> node_of(CPU_SETSIZE, 0);
+  for (int k = 0;; ++k) {
+    std::ifstream file("/sys/devices/system/node/node" + std::to_string(k) +
+                       "/cpulist");
+    if (!file) break;
+    string text;
+    std::getline(file, text);
+    for (int c : ParseCpuList(text)) {
+      if (c >= 0 && c < CPU_SETSIZE) node_of[c] = k;
+    }
+  }
+  if (numa) {
+    std::stable_sort(cpus.begin(), cpus.end(), [&node_of](int a, int b) {
+      return node_of[a] < node_of[b];
+    });
+  }
+  if (nodes != nullptr) {
+    nodes->clear();
+    for (int c : cpus) nodes->push_back(node_of[c]);
+  }
+  return cpus;
+}
+
+/// @brief 按配置启动工作线程（Start the workers with a configuration）
+/// @param config 线程池配置（thread pool configuration）
+/// @return 错误信息（error message）
+/// @remark 已经启动的线程池会先停止，不能在有任务执行时调用，多个使用者共享
+///         的线程池应当使用Configure()。第0个保留CPU之后的位置留给调用
+///         ParallelFor的线程，第w个工作线程使用之后的第w个CPU。
+///         A running pool is stopped first, so this must not be called while
+///         tasks are running; a pool shared by several users should be
+///         configured with Configure(). The slot after the reserved CPUs
+///         belongs to the thread calling ParallelFor, and worker w uses the
+///         w-th CPU after it.
+string ThreadPool::Start(const ThreadPoolConfig &config) {
+  this->Stop();
+  if (config.threads < 0 || config.reserved < 0) {
+    return "\"threads\" and \"reserved\" of the thread pool must not be "
+           "negative.";
+  }
+  this->config_ = config;
+  vector<int> nodes;
+  vector<int> order = ThreadPool::CpuOrder(config.numa, &nodes);
+  int available = std::max(1, (int)order.size() - config.reserved);
+  int threads = config.threads > 0 ? config.threads : available;
+  int workers = threads - 1;
+  this->cpus_.assign(workers, -1);
+  this->queues_.clear();
+  for (int w = 0; w < workers; ++w) {
+    int slot = (config.reserved + 1 + w) % order.size();
+    this->queues_.emplace_back(new Queue());
+    this->queues_[w]->node = nodes[slot];
+    if (config.pin) this->cpus_[w] = order[slot];
+  }
+  // 先窃取同一节点的线程，再按距离由近到远
+  // Steal from the same node first, then by distance.
+  this->victims_.assign(workers, vector<int>());
+  for (int w = 0; w < workers; ++w) {
+    for (int d = 1; d < workers; ++d) {
+      this->victims_[w].push_back((w + d) % workers);
+    }
+    std::stable_sort(this->victims_[w].begin(), this->victims_[w].end(),
+                     [this, w](int a, int b) {
+                       int node = this->queues_[w]->node;
+                       return (this->queues_[a]->node != node) <
+                              (this->queues_[b]->node != node);
+                     });
+  }
+  string err;
+  for (int w = 0; w < workers; ++w) {
+    this->workers_.emplace_back(&ThreadPool::Run, this, w);
+    if (this->cpus_[w] < 0) continue;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(this->cpus_[w], &set);
+    if (pthread_setaffinity_np(this->workers_[w].native_handle(), sizeof(set),
+                               &set) != 0 &&
+        err.empty()) {
+      err = "Cannot pin the thread pool worker to CPU " +
+            std::to_string(this->cpus_[w]) + ".";
+    }
+  }
+  return err;
+}
+
+/// @brief 在第一次使用之前按配置重新启动（Restart with a configuration before
+///        the first use）
+/// @param config 线程池配置（thread pool configuration）
+/// @return 错误信息（error message）
+/// @remark 调用过ParallelFor之后，其他线程可能正在使用队列，不能再重新启动，
+///         此时配置与当前的相同时什么也不做，不同时返回错误。
+///         Once ParallelFor has been called other threads may be using the
+///         queues, so the pool is no longer restarted: a configuration equal
+///         to the current one does nothing, a different one is an error.
+string ThreadPool::Configure(const ThreadPoolConfig &config) {
+  if (this->used_.load(std::memory_order_acquire)) {
+    if (config.threads == this->config_.threads &&
+        config.reserved == this->config_.reserved &&
+        config.pin == this->config_.pin && config.numa == this->config_.numa) {
+      return "";
+    }
+    return "The thread pool is already in use and can only be configured "
+           "before its first use.";
+  }
+  return this->Start(config);
+}
+
+/// @brief 执行完队列中的任务后停止工作线程
+///        （Stop the workers after the queued tasks）
+void ThreadPool::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->stop_ = true;
+  }
+  this->cv_.notify_all();
+  for (auto &worker : this->workers_) worker.join();
+  this->workers_.clear();
+  this->queues_.clear();
+  this->victims_.clear();
+  this->stop_ = false;
+}
+
+/// @brief 并行处理[begin, end)（Process [begin, end) in parallel）
+/// @param begin 起点（begin）
+/// @param end 终点，不包括（end, exclusive）
+/// @param grain 每个任务至少处理的个数（minimum count per task）
+/// @param fn 处理[b, e)的函数，不同的任务同时调用（function processing
+///        [b, e), called by different tasks at the same time）
+/// @remark 范围被切成最多为线程数4倍的连续小段，依次放入各个队列，相邻的
+///         小段在相邻的线程上，处理快的线程再从其他线程窃取。
+///         The range is cut into at most four times as many contiguous
+///         pieces as there are threads and dealt to the queues in turn, so
+///         neighbouring pieces land on neighbouring workers, and the faster
+///         workers steal from the others.
+void ThreadPool::ParallelFor(long begin, long end, long grain,
+                             const std::function<void(long, long)> &fn) {
+  if (end <= begin) return;
+  if (!this->used_.load(std::memory_order_relaxed)) {
+    this->used_.store(true, std::memory_order_release);
+  }
+  grain = std::max(1L, grain);
+  long n = end - begin;
+  int queues = this->queues_.size();
+  if (queues == 0 || n <= grain) {
+    fn(begin, end);
+    return;
+  }
+  long chunks = std::min((n + grain - 1) / grain, (long)(queues + 1) * 4);
+  long size = (n + chunks - 1) / chunks;
+  chunks = (n + size - 1) / size;
+  std::atomic<long> pending(chunks);
+  unsigned first = this->next_.fetch_add(1);
+  Task task;
+  task.fn = &fn;
+  task.pending = &pending;
+  for (long c = 0; c < chunks; ++c) {
+    task.begin = begin + c * size;
+    task.end = std::min(end, task.begin + size);
+    Queue &queue = *this->queues_[(first + c) % queues];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back(task);
+  }
+  this->queued_ += chunks;
+  {
+    // 加锁后再通知，避免工作线程检查完条件但还没有等待时错过通知
+    // Notify under the lock, so a worker that has checked the condition but
+    // not yet waited cannot miss it.
+    std::lock_guard<std::mutex> lock(this->mutex_);
+  }
+  this->cv_.notify_all();
+  // 调用者一起执行任务（the caller executes tasks as well）
+  int id = t_pool == this ? t_worker : -1;
+  while (pending.load(std::memory_order_acquire) > 0) {
+    if ((id >= 0 && this->Pop(id, task)) || this->Steal(id, task)) {
+      this->Execute(task);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+}
+
+/// @brief 全局线程池（global thread pool）
+/// @return 第一次使用时按默认配置启动的线程池（the pool, started with the
+///         default configuration on first use）
+/// @remark fork得到的子进程中全局线程池没有工作线程，ParallelFor直接在调用者
+///         的线程上执行，需要时可以再调用Start()。
+///         In a child process created by fork the global pool has no
+///         workers and ParallelFor runs on the calling thread, Start() may
+///         be called again when needed.
+ThreadPool &ThreadPool::Global() {
+  static ThreadPool pool;
+  std::call_once(pool.started_, [] {
+    pool.Start(ThreadPoolConfig());
+    pthread_atfork(nullptr, nullptr, [] { pool.AfterFork(); });
+  });
+  return pool;
+}
+
+/// @brief fork之后在子进程中重置（Reset in the child process after fork）
+/// @remark 子进程只有调用fork的线程，工作线程、它们持有的锁和等待中的条件
+///         变量都只剩下父进程时的状态，无法再join或销毁，所以直接放弃旧的
+///         对象，重新构造空的线程池。
+///         The child only has the thread that called fork, so the workers,
+///         the locks they held and the waits on the condition variable are
+///         frozen in the parent's state and can no longer be joined or
+///         destroyed. The old objects are abandoned and an empty pool is
+///         constructed in their place.
+void ThreadPool::AfterFork() {
+  new (&this->workers_) vector<std::thread>();
+  new (&this->queues_) vector<std::unique_ptr<Queue>>();
+  new (&this->victims_) vector<vector<int>>();
+  new (&this->mutex_) std::mutex();
+  new (&this->cv_) std::condition_variable();
+  this->cpus_.clear();
+  this->queued_ = 0;
+  this->used_ = false;
+  this->stop_ = false;
+}
+
+/// @brief 工作线程（worker thread）
+/// @param id 工作线程号（worker number）
+void ThreadPool::Run(int id) {
+  t_pool = this;
+  t_worker = id;
+  Task task;
+  while (true) {
+    if (this->Pop(id, task) || this->Steal(id, task)) {
+      this->Execute(task);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(this->mutex_);
+    this->cv_.wait(lock,
+                   [this] { return this->stop_ || this->queued_ > 0; });
+    if (this->stop_ && this->queued_ == 0) return;
+  }
+}
+
+/// @brief 从自己的队尾取任务（Take a task from the back of the own queue）
+bool ThreadPool::Pop(int id, Task &task) {
+  Queue &queue = *this->queues_[id];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.tasks.empty()) return false;
+  task = queue.tasks.back();
+  queue.tasks.pop_back();
+  --this->queued_;
+  return true;
+}
+
+/// @brief 从其他队列的队首窃取任务（Steal a task from the front of another
+///        queue）
+/// @param id 工作线程号，-1表示不是工作线程（worker number, -1 when it is not
+///        a worker）
+bool ThreadPool::Steal(int id, Task &task) {
+  int queues = this->queues_.size();
+  int count = id >= 0 ? this->victims_[id].size() : queues;
+  for (int k = 0; k < count; ++k) {
+    int v = id >= 0 ? this->victims_[id][k] : k;
+    Queue &queue = *this->queues_[v];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) continue;
+    task = queue.tasks.front();
+    queue.tasks.pop_front();
+    --this->queued_;
+    ++this->steals_;
+    return true;
+  }
+  return false;
+}
+
+/// @brief 执行一个任务（Execute one task）
+void ThreadPool::Execute(Task &task) {
+  (*task.fn)(task.begin, task.end);
+  task.pending->fetch_sub(1, std::memory_order_release);
+}
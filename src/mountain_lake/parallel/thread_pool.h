@@ -0,0 +1,101 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_PARALLEL_THREAD_POOL_H_
+#define MOUNTAIN_LAKE_PARALLEL_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+/// @brief 线程池配置（thread pool configuration）
+struct ThreadPoolConfig {
+  // 线程数，包括调用ParallelFor的线程，0表示可用的CPU数减去reserved
+  // Number of threads including the one calling ParallelFor, 0 uses the
+  // available CPUs minus reserved.
+  int threads = 0;
+  // 留给应用程序自己的线程的CPU数（CPUs left to the application's own
+  // threads）
+  int reserved = 0;
+  bool pin = false;   // 是否把工作线程绑定到CPU（pin workers to CPUs）
+  bool numa = false;  // 是否按NUMA节点安排线程（place workers by NUMA node）
+};
+
+/// @brief 工作窃取线程池（work-stealing thread pool）
+/// @remark 每个工作线程有自己的任务队列，从队尾取任务，自己的队列为空时从
+///         其他线程的队首窃取，优先窃取同一NUMA节点的线程。调用ParallelFor
+///         的线程也会一起执行任务，直到全部完成，所以在任务中再次调用
+///         ParallelFor不会死锁。
+///         Every worker has its own task queue and takes tasks from its
+///         back, when the queue is empty it steals from the front of other
+///         queues, workers on the same NUMA node first. The thread calling
+///         ParallelFor executes tasks as well until all of them are done, so
+///         calling ParallelFor again inside a task does not deadlock.
+class ThreadPool {
+ public:
+  ThreadPool(){};
+  ~ThreadPool();
+  string Start(const ThreadPoolConfig& config);
+  string Configure(const ThreadPoolConfig& config);
+  void Stop();
+  void ParallelFor(long begin, long end, long grain,
+                   const std::function<void(long, long)>& fn);
+  inline int GetThreads() { return this->workers_.size() + 1; }
+  inline ThreadPoolConfig& GetConfig() { return this->config_; }
+  inline long GetSteals() { return this->steals_; }
+  inline const vector<int>& GetCpus() { return this->cpus_; }
+  static ThreadPool& Global();
+  static vector<int> CpuOrder(bool numa, vector<int>* nodes = nullptr);
+
+ private:
+  /// @brief 任务，处理[begin, end)范围（task over [begin, end)）
+  struct Task {
+    const std::function<void(long, long)>* fn = nullptr;
+    long begin = 0;
+    long end = 0;
+    std::atomic<long>* pending = nullptr;  // 剩余的任务数（tasks left）
+  };
+  /// @brief 一个工作线程的任务队列（task queue of one worker）
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+    int node = 0;  // 所在的NUMA节点（NUMA node）
+  };
+
+  void Run(int id);
+  bool Pop(int id, Task& task);
+  bool Steal(int id, Task& task);
+  void Execute(Task& task);
+  void AfterFork();
+
+  ThreadPoolConfig config_;
+  vector<std::thread> workers_;
+  vector<std::unique_ptr<Queue>> queues_;
+  // 每个队列的窃取顺序，同一节点的在前（steal order of every queue, the
+  // same node first）
+  vector<vector<int>> victims_;
+  vector<int> cpus_;  // 工作线程绑定的CPU（CPUs the workers are pinned to）
+  std::atomic<long> queued_{0};  // 队列中的任务数（tasks in the queues）
+  std::atomic<long> steals_{0};  // 窃取的次数（number of steals）
+  std::atomic<unsigned> next_{0};  // 下一次分发的起始队列（first queue of
+                                   // the next dispatch）
+  // 是否已经调用过ParallelFor（whether ParallelFor has been called）
+  std::atomic<bool> used_{false};
+  bool stop_ = false;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::once_flag started_;  // Global()的默认启动（default start of Global()）
+};
+
+#endif  // MOUNTAIN_LAKE_PARALLEL_THREAD_POOL_H_
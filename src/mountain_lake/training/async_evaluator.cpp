@@ -0,0 +1,121 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "async_evaluator.h"
+
+/// @brief 把评估结果格式化为CSV的一行（Format an evaluation as one CSV line）
+/// @param report 评估结果（evaluation result）
+/// @return “步数,轮数,学习率,准确率,秒数,训练误差,训练准确率”
+///         （"step,epoch,lr,accuracy,seconds,train_loss,train_accuracy"）
+string FormatEvalReport(const EvalReport &report) {
+  return std::to_string(report.step) + "," + std::to_string(report.epoch) +
+         "," + std::to_string(report.learning_rate) + "," +
+         std::to_string(report.accuracy) + "," +
+         std::to_string(report.seconds) + "," +
+         std::to_string(report.train_loss) + "," +
+         std::to_string(report.train_accuracy) + "\n";
+}
+
+/// @brief 启动后台评估线程（Start the background evaluation thread）
+/// @param nn 神经网络，只读取其结构与数据（neural network, only its
+///        structure and data are read）
+/// @param test 为true时使用测试数据（use the test data when true）
+/// @param indices 评估样本，为空时使用全部样本（evaluation samples, all
+///        samples when empty）
+/// @param csv CSV日志，可以为空指针，在Wait()之前只能由后台线程写入
+///        （CSV log, may be a null pointer, only the background thread writes
+///        it until Wait()）
+/// @param callback 每次评估后调用，可以为空（called after each evaluation,
+///        may be empty）
+void AsyncEvaluator::Start(NeuralNetwork *nn, bool test,
+                           const vector<int> &indices, string *csv,
+                           Callback callback) {
+  this->Stop();
+  this->nn_ = nn;
+  this->test_ = test;
+  this->indices_ = indices;
+  this->csv_ = csv;
+  this->callback_ = callback;
+  this->pending_ = -1;
+  this->evaluating_ = -1;
+  this->evaluated_ = 0;
+  this->dropped_ = 0;
+  this->stop_ = false;
+  this->thread_ = std::thread(&AsyncEvaluator::Run, this);
+}
+
+/// @brief 提交当前权重的快照（Submit a snapshot of the current weights）
+/// @param report 快照对应的步数等信息，准确率由后台线程填写
+///        （step and other information of the snapshot, the accuracy is
+///        filled in by the background thread）
+/// @remark 必须在训练线程中调用，调用时权重不能被修改。
+///         Must be called from the training thread, the weights must not
+///         change during the call.
+void AsyncEvaluator::Submit(const EvalReport &report) {
+  int slot = 0;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    slot = this->evaluating_ == 0 ? 1 : 0;
+    if (this->pending_ >= 0) ++this->dropped_;
+    this->pending_ = -1;
+  }
+  // 后台线程只读取evaluating_指向的快照，所以可以不加锁复制
+  // The background thread only reads the snapshot at evaluating_, so the copy
+  // needs no lock.
+  this->nn_->SaveParameters(this->snapshot_[slot]);
+  this->report_[slot] = report;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->pending_ = slot;
+  }
+  this->cv_.notify_all();
+}
+
+/// @brief 等待所有已提交的快照评估完成（Wait for every submitted snapshot）
+void AsyncEvaluator::Wait() {
+  std::unique_lock<std::mutex> lock(this->mutex_);
+  this->cv_.wait(lock, [this] {
+    return this->pending_ < 0 && this->evaluating_ < 0;
+  });
+}
+
+/// @brief 评估完剩余的快照后停止后台线程
+///        （Stop the background thread after the remaining snapshots）
+void AsyncEvaluator::Stop() {
+  if (!this->thread_.joinable()) return;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->stop_ = true;
+  }
+  this->cv_.notify_all();
+  this->thread_.join();
+}
+
+/// @brief 后台线程（background thread）
+void AsyncEvaluator::Run() {
+  int slot = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(this->mutex_);
+      this->cv_.wait(lock,
+                     [this] { return this->pending_ >= 0 || this->stop_; });
+      if (this->pending_ < 0) return;
+      slot = this->pending_;
+      this->pending_ = -1;
+      this->evaluating_ = slot;
+    }
+    EvalReport &report = this->report_[slot];
+    report.accuracy = this->nn_->Evaluate(this->test_, this->indices_,
+                                          this->snapshot_[slot], this->O_);
+    if (this->csv_ != nullptr) *this->csv_ += FormatEvalReport(report);
+    if (this->callback_) this->callback_(report, this->snapshot_[slot]);
+    {
+      std::lock_guard<std::mutex> lock(this->mutex_);
+      this->evaluating_ = -1;
+      ++this->evaluated_;
+    }
+    this->cv_.notify_all();
+  }
+}
@@ -0,0 +1,84 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_TRAINING_ASYNC_EVALUATOR_H_
+#define MOUNTAIN_LAKE_TRAINING_ASYNC_EVALUATOR_H_
+
+#include <mountain_lake/neural_network/neural_network.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+/// @brief 一次评估的结果（result of one evaluation）
+struct EvalReport {
+  int step = 0;
+  int epoch = 0;
+  float learning_rate = 0.0f;
+  float accuracy = 0.0f;
+  // 提交快照时已经训练的秒数（seconds of training when the snapshot was taken）
+  double seconds = 0.0;
+  // 本轮到目前为止的训练误差与训练准确率，由正向传播顺便累计
+  // Training loss and accuracy of the epoch so far, gathered by the forward
+  // passes.
+  float train_loss = 0.0f;
+  float train_accuracy = 0.0f;
+};
+
+string FormatEvalReport(const EvalReport& report);
+
+/// @brief 异步评估器类（asynchronous evaluator class）
+/// @remark 提交时把权重与偏置复制到双缓冲快照中，后台线程评估快照，
+///         主线程继续在实时权重上训练。后台线程正忙时，新的快照会替换还没有
+///         开始评估的旧快照，所以提交从不等待评估。
+///         Submitting copies the weights and bias into a double-buffered
+///         snapshot, a background thread evaluates the snapshot while the main
+///         thread keeps training on the live weights. When the background
+///         thread is busy, a new snapshot replaces an older one that has not
+///         started yet, so submitting never waits for an evaluation.
+class AsyncEvaluator {
+ public:
+  // 回调在后台线程中调用（the callback runs on the background thread）
+  typedef std::function<void(const EvalReport&, Parameters&)> Callback;
+
+  AsyncEvaluator(){};
+  ~AsyncEvaluator() { this->Stop(); };
+  void Start(NeuralNetwork* nn, bool test, const vector<int>& indices,
+             string* csv, Callback callback);
+  void Submit(const EvalReport& report);
+  void Wait();
+  void Stop();
+  inline int GetEvaluated() { return this->evaluated_; }
+  inline int GetDropped() { return this->dropped_; }
+
+ private:
+  void Run();
+
+  NeuralNetwork* nn_ = nullptr;
+  bool test_ = false;
+  vector<int> indices_;       // 评估样本（evaluation samples）
+  string* csv_ = nullptr;     // CSV日志（CSV log）
+  Callback callback_;
+  Parameters snapshot_[2];    // 双缓冲快照（double-buffered snapshots）
+  EvalReport report_[2];
+  vector<MatrixXf> O_;        // 后台线程的层输出（outputs of the thread）
+  int pending_ = -1;          // 等待评估的快照（snapshot waiting）
+  int evaluating_ = -1;       // 正在评估的快照（snapshot being evaluated）
+  int evaluated_ = 0;         // 已评估的快照数（snapshots evaluated）
+  int dropped_ = 0;           // 被替换的快照数（snapshots replaced）
+  bool stop_ = false;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread thread_;
+};
+
+#endif  // MOUNTAIN_LAKE_TRAINING_ASYNC_EVALUATOR_H_
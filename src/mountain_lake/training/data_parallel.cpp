@@ -0,0 +1,301 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "data_parallel.h"
+
+#include <mountain_lake/parallel/spsc_queue.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+
+/// @brief 启动多个进程（Launch several processes）
+/// @param processes 进程数（number of processes）
+/// @param fn 每个进程执行的函数，参数为进程号，返回退出码（function run by
+///        every process, given the rank and returning the exit code）
+/// @return 错误信息，任何一个进程失败时不为空（error message, non-empty when
+///         any process fails）
+/// @remark 子进程由fork创建，共享调用者已经读入的数据而不复制。子进程中Eigen
+///         只用一个线程，全局线程池没有工作线程，并行来自进程本身。
+///         The children are created by fork and share the data the caller
+///         has already read without copying it. Eigen uses a single thread
+///         in the children and the global thread pool has no workers, the
+///         parallelism comes from the processes themselves.
+string DataParallel::Launch(int processes, const std::function<int(int)> &fn) {
+  if (processes <= 0) return "The number of processes must be positive.";
+  // 避免缓冲区中的输出在子进程中重复（keep buffered output from being
+  // repeated by the children）
+  std::fflush(nullptr);
+  vector<pid_t> pids;
+  string err;
+  for (int r = 0; r < processes; ++r) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      Eigen::setNbThreads(1);
+      int code = fn(r);
+      std::fflush(nullptr);
+      _exit(code);
+    }
+    if (pid < 0) {
+      err = "Cannot start process " + std::to_string(r) + ".";
+      break;
+    }
+    pids.push_back(pid);
+  }
+  for (int r = 0; r < (int)pids.size(); ++r) {
+    int status = 0;
+    waitpid(pids[r], &status, 0);
+    if (err.empty() && (!WIFEXITED(status) || WEXITSTATUS(status) != 0)) {
+      err = "Process " + std::to_string(r) + " failed.";
+    }
+  }
+  return err;
+}
+
+/// @brief 只保留这个进程的一份训练数据（Keep only this process's shard of
+///        the training data）
+/// @param raw_data 原始数据（raw data）
+/// @param rank 进程号（rank）
+/// @param size 进程数（number of processes）
+/// @remark 进程r保留第r、r+size、……个样本，测试数据不变。
+///         Process r keeps samples r, r+size, ..., the test data is kept
+///         as is.
+void DataParallel::Shard(RawData &raw_data, int rank, int size) {
+  int n = raw_data.train_number;
+  int count = n > rank ? (n - rank + size - 1) / size : 0;
+  MatrixXfr data(count, raw_data.train_data.cols());
+  MatrixXb labels(count, 1);
+  for (int k = 0; k < count; ++k) {
+    data.row(k) = raw_data.train_data.row(rank + k * size);
+    labels(k) = raw_data.train_labels(rank + k * size);
+  }
+  raw_data.train_data.swap(data);
+  raw_data.train_labels.swap(labels);
+  raw_data.train_number = count;
+}
+
+/// @brief 把0号进程的参数复制到所有进程（Copy the parameters of rank 0 to
+///        every process）
+/// @param nn 神经网络（neural network）
+/// @param comm 通信器（communicator）
+/// @return 错误信息（error message）
+string DataParallel::Synchronize(NeuralNetwork &nn, Communicator &comm) {
+  for (int i = 1; i < nn.GetLayers(); ++i) {
+    MatrixXf &W = nn.GetWeights(i);
+    MatrixXf &B = nn.GetBias(i);
+    string err = comm.Broadcast(W.data(), W.size(), 0);
+    if (err.empty()) err = comm.Broadcast(B.data(), B.size(), 0);
+    if (!err.empty()) return err;
+  }
+  nn.BuildSparse();
+  nn.PackWeights();
+  return "";
+}
+
+/// @brief 安排梯度在连续缓冲区中的位置与桶（Lay out the gradients in the
+///        contiguous buffer and cut the buckets）
+/// @param nn 神经网络（neural network）
+/// @remark 梯度按反向传播的顺序存放，从最后一层开始，所以桶也按完成的先后
+///         排列。桶只在层之间切开，所有进程的层相同，切法也相同。
+///         The gradients are stored in backpropagation order starting from
+///         the last layer, so the buckets are ordered by completion as well.
+///         Buckets are only cut between layers, and since every process has
+///         the same layers they cut them the same way.
+void DataParallel::PlanBuckets(NeuralNetwork &nn) {
+  int layers = nn.GetLayers();
+  this->weight_offset_.assign(layers + 1, -1);
+  this->bias_offset_.assign(layers + 1, -1);
+  this->bucket_begin_.assign(1, 0);
+  this->bucket_layer_.clear();
+  long limit = this->bucket_bytes_ / sizeof(float);
+  long pos = 2;
+  int lowest = 0;
+  for (int i = layers - 1; i >= 1; --i) {
+    long weights = nn.GetWeightGradient(i).size();
+    if (weights == 0) continue;
+    this->weight_offset_[i] = pos;
+    pos += weights;
+    this->bias_offset_[i] = pos;
+    pos += nn.GetBiasGradient(i).size();
+    lowest = i;
+    if (limit > 0 && pos - this->bucket_begin_.back() >= limit) {
+      this->bucket_begin_.push_back(pos);
+      this->bucket_layer_.push_back(i);
+      lowest = 0;
+    }
+  }
+  if (pos > this->bucket_begin_.back()) {
+    this->bucket_begin_.push_back(pos);
+    this->bucket_layer_.push_back(lowest);
+  }
+  this->flat_.resize(pos);
+}
+
+/// @brief 计算所有进程的一个小批量的平均梯度（Compute the mean gradients of
+///        one mini-batch over all processes）
+/// @param nn 神经网络，所有进程的权重相同（neural network, with the same
+///        weights in every process）
+/// @param comm 通信器（communicator）
+/// @param indices 这个进程的训练数据索引，可以为空（Index values of this
+///        process's training data, may be empty）
+/// @return 错误信息（error message）
+/// @remark 梯度写入神经网络自己的梯度，之后可以直接调用Update()。每个进程的
+///         梯度先乘以自己的样本数，归约后再除以总样本数，所以结果与所有进程
+///         的样本放在一个小批量中计算的相同。所有进程必须同时调用。
+///         The gradients are written to the network's own gradients, so
+///         Update() can be called right after. The gradients of every
+///         process are first scaled by its own sample count and divided by
+///         the total count after the reduction, so the result is the same as
+///         computing the samples of all processes in a single mini-batch.
+///         Every process must call it at the same time.
+string DataParallel::Gradient(NeuralNetwork &nn, Communicator &comm,
+                              const vector<int> &indices) {
+  int layers = nn.GetLayers();
+  int n = indices.size();
+  this->PlanBuckets(nn);
+  this->dW_.resize(layers + 1);
+  this->dB_.resize(layers + 1);
+  for (int i = 1; i < layers; ++i) {
+    MatrixXf &dW = nn.GetWeightGradient(i);
+    MatrixXf &dB = nn.GetBiasGradient(i);
+    this->dW_[i].resize(dW.rows(), dW.cols());
+    this->dB_[i].resize(dB.rows(), dB.cols());
+  }
+  int buckets = this->bucket_layer_.size();
+  this->stats_.buckets = buckets;
+  Workspace &ws = this->ws_;
+  ws.metrics = TrainMetrics();
+  std::fill(this->flat_.begin(), this->flat_.end(), 0.0f);
+  if (n > 0) {
+    nn.LoadBatch(indices, ws);
+    for (int i = 1; i <= layers; ++i) i = nn.StepForward(i, ws);
+    this->flat_[0] = n;
+    this->flat_[1] = n * ws.loss;
+  }
+  // 通信线程按顺序归约已经完整的桶（the communication thread reduces the
+  // complete buckets in order）
+  SpscQueue<int> ready(buckets);
+  string comm_err;
+  double comm_seconds = 0.0;
+  std::thread communicator([&] {
+    for (int k = 0; k < buckets; ++k) {
+      int b = ready.PopWait();
+      if (!comm_err.empty()) continue;
+      auto begin = std::chrono::steady_clock::now();
+      long first = this->bucket_begin_[b];
+      comm_err = comm.Allreduce(this->flat_.data() + first,
+                                this->bucket_begin_[b + 1] - first);
+      comm_seconds += std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - begin)
+                          .count();
+    }
+  });
+  int next = 0;
+  if (n > 0) {
+    for (int i = layers; i >= 1; --i) {
+      int f = nn.StepBackward(i, ws, this->dW_, this->dB_);
+      for (int j = f; j <= i; ++j) {
+        if (this->weight_offset_[j] < 0) continue;
+        Eigen::Map<MatrixXf>(this->flat_.data() + this->weight_offset_[j],
+                             this->dW_[j].rows(), this->dW_[j].cols()) =
+            n * this->dW_[j];
+        Eigen::Map<MatrixXf>(this->flat_.data() + this->bias_offset_[j],
+                             this->dB_[j].rows(), this->dB_[j].cols()) =
+            n * this->dB_[j];
+      }
+      while (next < buckets && this->bucket_layer_[next] >= f) {
+        ready.PushWait(next++);
+      }
+      i = f;
+    }
+  }
+  while (next < buckets) ready.PushWait(next++);
+  auto wait = std::chrono::steady_clock::now();
+  communicator.join();
+  this->stats_.exposed_seconds += std::chrono::duration<double>(
+                                      std::chrono::steady_clock::now() - wait)
+                                      .count();
+  this->stats_.comm_seconds += comm_seconds;
+  if (!comm_err.empty()) return comm_err;
+  float total = this->flat_[0];
+  float scale = total > 0 ? 1.0f / total : 0.0f;
+  for (int i = 1; i < layers; ++i) {
+    if (this->weight_offset_[i] < 0) continue;
+    MatrixXf &dW = nn.GetWeightGradient(i);
+    MatrixXf &dB = nn.GetBiasGradient(i);
+    dW = scale * Eigen::Map<MatrixXf>(
+                     this->flat_.data() + this->weight_offset_[i], dW.rows(),
+                     dW.cols());
+    dB = scale * Eigen::Map<MatrixXf>(
+                     this->flat_.data() + this->bias_offset_[i], dB.rows(),
+                     dB.cols());
+  }
+  this->stats_.samples += static_cast<long>(total);
+  this->stats_.loss = this->flat_[1] * scale;
+  if (n > 0) nn.GetTrainMetrics().Merge(ws.metrics);
+  return "";
+}
+
+/// @brief 多进程数据并行训练（Multi-process data-parallel training）
+/// @param nn 用自己的一份数据初始化的神经网络（neural network initialized
+///        with this process's shard of the data）
+/// @param comm 通信器（communicator）
+/// @param epochs 训练轮数（number of epochs）
+/// @param batch_size 每个进程的小批量大小（mini-batch size of each process）
+/// @param learning_rate 学习率（learning rate）
+/// @param seed 随机数种子（random seed）
+/// @return 错误信息（error message）
+/// @remark 训练前先复制0号进程的参数。每轮的步数由样本最多的进程决定，样本
+///         较少的进程在最后几步用较小或空的小批量，所以所有进程调用Allreduce
+///         的次数相同。
+///         The parameters of rank 0 are copied first. The number of steps
+///         per epoch is set by the process with the most samples, processes
+///         with fewer samples use smaller or empty mini-batches in the last
+///         steps, so every process calls Allreduce the same number of times.
+string DataParallel::Train(NeuralNetwork &nn, Communicator &comm, int epochs,
+                           int batch_size, float learning_rate,
+                           unsigned int seed) {
+  this->stats_ = DataParallelStats();
+  if (batch_size <= 0) return "The mini-batch size must be positive.";
+  auto start = std::chrono::steady_clock::now();
+  nn.SetLearningRate(learning_rate);
+  string err = this->Synchronize(nn, comm);
+  if (!err.empty()) return err;
+  int n = nn.GetTrainData().train_number;
+  // 交换各进程的样本数（exchange the sample counts of the processes）
+  vector<float> counts(comm.GetSize(), 0.0f);
+  counts[comm.GetRank()] = n;
+  err = comm.Allreduce(counts.data(), counts.size());
+  if (!err.empty()) return err;
+  int most = *std::max_element(counts.begin(), counts.end());
+  int steps = (most + batch_size - 1) / batch_size;
+  std::mt19937 rng(seed + comm.GetRank());
+  vector<int> order(n);
+  for (int k = 0; k < n; ++k) order[k] = k;
+  vector<int> batch;
+  for (int epoch = 0; epoch < epochs; ++epoch) {
+    std::shuffle(order.begin(), order.end(), rng);
+    for (int s = 0; s < steps; ++s) {
+      int first = std::min(n, s * batch_size);
+      int last = std::min(n, first + batch_size);
+      batch.assign(order.begin() + first, order.begin() + last);
+      err = this->Gradient(nn, comm, batch);
+      if (!err.empty()) return err;
+      nn.Update();
+      ++this->stats_.steps;
+    }
+  }
+  this->stats_.seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+  this->stats_.samples_per_second =
+      this->stats_.seconds > 0 ? this->stats_.samples / this->stats_.seconds
+                               : 0.0;
+  return "";
+}
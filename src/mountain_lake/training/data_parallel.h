@@ -0,0 +1,94 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_TRAINING_DATA_PARALLEL_H_
+#define MOUNTAIN_LAKE_TRAINING_DATA_PARALLEL_H_
+
+#include <mountain_lake/neural_network/neural_network.h>
+#include <mountain_lake/parallel/communicator.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+/// @brief 多进程数据并行训练的统计（statistics of multi-process data-parallel
+///        training）
+struct DataParallelStats {
+  int steps = 0;      // 更新次数（number of updates）
+  long samples = 0;   // 所有进程处理的样本数（samples over all processes）
+  int buckets = 0;    // 每步归约的桶数（buckets reduced per step）
+  float loss = 0.0f;  // 最后一步所有进程的平均误差（mean loss of the last
+                      // step over all processes）
+  double seconds = 0.0;
+  // 通信线程做Allreduce的时间（time the communication thread spent in
+  // Allreduce）
+  double comm_seconds = 0.0;
+  // 反向传播结束后等待归约的时间，即没有被计算掩盖的通信（time waiting for
+  // the reduction after backpropagation, the communication not hidden by
+  // compute）
+  double exposed_seconds = 0.0;
+  double samples_per_second = 0.0;
+};
+
+/// @brief 多进程数据并行训练（multi-process data-parallel training）
+/// @remark 每个进程持有训练数据的一份，用相同的权重计算自己的小批量的梯度，
+///         再通过Communicator的环形Allreduce求所有进程的平均梯度，所以每个
+///         进程更新后的权重完全相同。梯度按反向传播的顺序分成桶，一个桶的层
+///         全部算完就交给通信线程归约，与更前面的层的反向传播同时进行。
+///         Every process holds a shard of the training data and computes the
+///         gradients of its own mini-batch with the same weights, then the
+///         mean gradients over all processes are formed with the ring
+///         Allreduce of Communicator, so every process ends up with exactly
+///         the same weights after the update. The gradients are cut into
+///         buckets in backpropagation order, and as soon as every layer of a
+///         bucket is done the bucket is handed to the communication thread,
+///         overlapping its reduction with the backpropagation of the earlier
+///         layers.
+class DataParallel {
+ public:
+  DataParallel(){};
+  ~DataParallel(){};
+  static string Launch(int processes, const std::function<int(int)>& fn);
+  static void Shard(RawData& raw_data, int rank, int size);
+  string Synchronize(NeuralNetwork& nn, Communicator& comm);
+  string Gradient(NeuralNetwork& nn, Communicator& comm,
+                  const vector<int>& indices);
+  string Train(NeuralNetwork& nn, Communicator& comm, int epochs,
+               int batch_size, float learning_rate, unsigned int seed);
+  inline void SetBucketBytes(long bytes) { this->bucket_bytes_ = bytes; }
+  inline long GetBucketBytes() { return this->bucket_bytes_; }
+  inline DataParallelStats& GetStats() { return this->stats_; }
+
+ private:
+  void PlanBuckets(NeuralNetwork& nn);
+
+  // 每个桶的字节数上限，0表示所有梯度一个桶（upper bound of the bytes of a
+  // bucket, 0 puts every gradient in one bucket）
+  long bucket_bytes_ = 1 << 20;
+  // 所有梯度连续存放，前两个元素是样本数与样本数乘误差（every gradient
+  // stored contiguously, the first two elements are the sample count and
+  // the count times the loss）
+  vector<float> flat_;
+  vector<long> weight_offset_;  // 每层权重梯度的位置（offset of the weight
+                                // gradients of every layer）
+  vector<long> bias_offset_;    // 每层偏置梯度的位置（offset of the bias
+                                // gradients of every layer）
+  // 每个桶的起点，最后一个元素为总长度（start of every bucket, the last
+  // element is the total length）
+  vector<long> bucket_begin_;
+  // 每个桶包含的最小层号，反向传播到这一层后桶就完整了（lowest layer of
+  // every bucket, the bucket is complete once backpropagation reaches it）
+  vector<int> bucket_layer_;
+  // 反向传播一步得到的梯度（gradients of one backward step）
+  vector<MatrixXf> dW_;
+  vector<MatrixXf> dB_;
+  Workspace ws_;
+  DataParallelStats stats_;
+};
+
+#endif  // MOUNTAIN_LAKE_TRAINING_DATA_PARALLEL_H_
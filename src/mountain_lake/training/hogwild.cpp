@@ -0,0 +1,168 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "hogwild.h"
+
+#include <mountain_lake/parallel/thread_pool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+
+/// @brief 以relaxed原子操作执行 w -= lr * g（w -= lr * g with relaxed atomics）
+static inline void RelaxedSub(float *w, float lr, float g) {
+  float v = 0.0f;
+  __atomic_load(w, &v, __ATOMIC_RELAXED);
+  v -= lr * g;
+  __atomic_store(w, &v, __ATOMIC_RELAXED);
+}
+
+/// @brief 把工作区中的梯度直接写回共享参数
+///        （Write the gradients of a workspace straight to the shared
+///        parameters）
+/// @param nn 神经网络（neural network）
+/// @param ws 已经计算好梯度的工作区（workspace holding the gradients）
+/// @param learning_rate 学习率（learning rate）
+/// @remark 仿射变换层只更新输入不为0的权重行。批量归一化层的小批量统计不写
+///         入共享参数，而是累计到工作区自己的滑动统计中。调用之前需要先调用
+///         nn.DropPackedWeights()，这里不修改打包状态，多个线程可以同时调用。
+///         Affine layers only update the weight rows whose input is not 0.
+///         The mini-batch statistics of batch normalization layers are not
+///         written to the shared parameters but gathered in the workspace's
+///         own running statistics. nn.DropPackedWeights() must be called
+///         first; the packed state is not touched here, so several threads
+///         may call this at once.
+void Hogwild::ApplyUpdate(NeuralNetwork &nn, Workspace &ws,
+                          float learning_rate) {
+  for (int i = 1; i < nn.GetLayers(); ++i) {
+    // 训练开始前已经丢弃打包的权重（the packed weights were dropped before
+    // training started）
+    MatrixXf &W = nn.GetRawWeights(i);
+    MatrixXf &B = nn.GetBias(i);
+    if (W.size() == 0) continue;
+    MatrixXf &dW = ws.dW[i];
+    if (nn.GetLayer(i).type == "Affine") {
+      MatrixXf &X = ws.O[nn.GetInputs(i)[0]];
+      for (int r = 0; r < W.rows(); ++r) {
+        if ((X.col(r).array() == 0).all()) continue;
+        for (int c = 0; c < W.cols(); ++c) {
+          RelaxedSub(&W(r, c), learning_rate, dW(r, c));
+        }
+      }
+    } else {
+      for (int k = 0; k < W.size(); ++k) {
+        RelaxedSub(W.data() + k, learning_rate, dW.data()[k]);
+      }
+    }
+    if (nn.GetLayer(i).type == "BatchNorm") {
+      // 训练期间没有线程写入滑动统计，可以直接读取
+      // No thread writes the running statistics during training, so they
+      // are read directly.
+      if (ws.stats[i].size() == 0) ws.stats[i] = B;
+      BatchNorm::Accumulate(ws.dB[i], ws.stats[i], nn.GetBatchNormConfig(i));
+      for (int c = 0; c < B.cols(); ++c) {
+        RelaxedSub(&B(0, c), learning_rate, ws.dB[i](0, c));
+      }
+      continue;
+    }
+    for (int k = 0; k < B.size(); ++k) {
+      RelaxedSub(B.data() + k, learning_rate, ws.dB[i].data()[k]);
+    }
+  }
+}
+
+/// @brief 多线程Hogwild训练（Multi-threaded Hogwild training）
+/// @param nn 已经初始化的神经网络（initialized neural network）
+/// @param threads 线程数（number of threads）
+/// @param epochs 训练轮数（number of epochs）
+/// @param batch_size 每个线程的小批量大小（mini-batch size of each thread）
+/// @param learning_rate 学习率（learning rate）
+/// @param seed 随机数种子（random seed）
+/// @return 统计信息（statistics）
+/// @remark 线程t负责第t、t+threads、……个样本，每轮打乱自己的样本，整个训练
+///         过程中线程之间没有任何同步。各线程是全局线程池中的任务，层内的
+///         ParallelFor也由同一个线程池执行，所以CPU不会被超额使用；线程数
+///         多于线程池时，多出的线程在前面的线程结束后才开始。训练结束后，
+///         调用线程把各线程的滑动统计的平均值写入神经网络。
+///         Thread t owns samples t, t+threads, ... and shuffles them every
+///         epoch, the threads never synchronize during training. The threads
+///         are tasks of the global thread pool and the ParallelFor calls
+///         inside the layers run on the same pool, so the CPUs are not
+///         oversubscribed; with more threads than the pool has, the extra
+///         ones start after earlier ones finish. After training the calling
+///         thread writes the average of the running statistics of all
+///         threads to the network.
+HogwildStats Hogwild::Train(NeuralNetwork &nn, int threads, int epochs,
+                            int batch_size, float learning_rate,
+                            unsigned int seed) {
+  HogwildStats stats;
+  int n = nn.GetTrainData().train_number;
+  if (n <= 0 || threads <= 0 || batch_size <= 0) return stats;
+  threads = std::min(threads, n);
+  auto start = std::chrono::steady_clock::now();
+  std::atomic<int> steps(0);
+  // 权重会被直接修改，训练期间不使用打包的权重
+  // The weights are changed directly, so the packed weights are not used
+  // during training.
+  nn.DropPackedWeights();
+  // 各线程的滑动统计之和与线程数（sum of the running statistics of the
+  // threads and the number of threads）
+  vector<MatrixXf> running(nn.GetLayers());
+  vector<int> counts(nn.GetLayers(), 0);
+  std::mutex mutex;
+  auto worker = [&](int t) {
+    std::mt19937 rng(seed + t);
+    Workspace ws;
+    vector<int> order;
+    for (int k = t; k < n; k += threads) order.push_back(k);
+    vector<int> batch;
+    int size = order.size();
+    for (int epoch = 0; epoch < epochs; ++epoch) {
+      std::shuffle(order.begin(), order.end(), rng);
+      for (int b = 0; b < size; b += batch_size) {
+        batch.assign(order.begin() + b,
+                     order.begin() + std::min(size, b + batch_size));
+        nn.Gradient(batch, ws);
+        Hogwild::ApplyUpdate(nn, ws, learning_rate);
+        steps.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    nn.GetTrainMetrics().Merge(ws.metrics);
+    // 没有训练过的线程没有滑动统计（threads that never trained have no
+    // running statistics）
+    int layers = std::min<int>(nn.GetLayers(), ws.stats.size());
+    for (int i = 1; i < layers; ++i) {
+      if (ws.stats[i].size() == 0) continue;
+      if (running[i].size() == 0) {
+        running[i] = ws.stats[i];
+      } else {
+        running[i] += ws.stats[i];
+      }
+      ++counts[i];
+    }
+  };
+  ThreadPool::Global().ParallelFor(0, threads, 1, [&](long b, long e) {
+    for (long t = b; t < e; ++t) worker(t);
+  });
+  for (int i = 1; i < nn.GetLayers(); ++i) {
+    if (counts[i] == 0) continue;
+    nn.GetBias(i).middleRows(1, 2) = running[i].middleRows(1, 2) / counts[i];
+  }
+  // 权重已经改变，重新生成稀疏权重与打包的权重
+  // The weights have changed, rebuild the sparse and packed weights.
+  nn.BuildSparse();
+  nn.PackWeights();
+  stats.steps = steps;
+  stats.samples = static_cast<long>(n) * epochs;
+  stats.seconds = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+  stats.samples_per_second =
+      stats.seconds > 0 ? stats.samples / stats.seconds : 0.0;
+  return stats;
+}
@@ -0,0 +1,43 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_TRAINING_HOGWILD_H_
+#define MOUNTAIN_LAKE_TRAINING_HOGWILD_H_
+
+#include <mountain_lake/neural_network/neural_network.h>
+
+/// @brief Hogwild训练的统计（statistics of Hogwild training）
+struct HogwildStats {
+  int steps = 0;       // 所有线程的更新次数之和（updates over all threads）
+  long samples = 0;    // 处理的样本数（samples processed）
+  double seconds = 0.0;
+  double samples_per_second = 0.0;
+};
+
+/// @brief Hogwild无锁异步随机梯度下降（Hogwild lock-free asynchronous SGD）
+/// @remark 每个线程用自己的工作区在共享权重上计算梯度，然后不加锁、不等待其他
+///         线程，直接把更新写回共享权重。写入使用relaxed原子操作，单个元素不会
+///         被写坏，但不同线程的更新可能互相覆盖。输入为0的特征对应的权重行梯度
+///         为0，会被跳过，所以输入越稀疏，线程之间的冲突越少。
+///         剪枝掩码不会在这里应用。
+///         Each thread computes gradients on the shared weights in its own
+///         workspace, then writes the update straight back to the shared
+///         weights without locks and without waiting for other threads. The
+///         writes use relaxed atomics, so no single element is torn, but the
+///         updates of different threads may overwrite each other. Weight rows
+///         of features whose input is 0 have a zero gradient and are skipped,
+///         so the sparser the input, the fewer the conflicts between threads.
+///         Pruning masks are not applied here.
+class Hogwild {
+ public:
+  Hogwild(){};
+  ~Hogwild(){};
+  HogwildStats Train(NeuralNetwork& nn, int threads, int epochs,
+                     int batch_size, float learning_rate, unsigned int seed);
+  static void ApplyUpdate(NeuralNetwork& nn, Workspace& ws,
+                          float learning_rate);
+};
+
+#endif  // MOUNTAIN_LAKE_TRAINING_HOGWILD_H_
@@ -0,0 +1,58 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "low_rank_sweep.h"
+
+#include <chrono>
+
+/// @brief 评估一次并记录这一层的大小（Evaluate once and record the size of
+///        the layer）
+/// @param nn 神经网络（neural network）
+/// @param layer 层号（layer number）
+/// @param rank 秩，0为稠密层（rank, 0 for the dense layer）
+/// @param test 是否使用测试数据（whether to use the test data）
+static RankReport Measure(NeuralNetwork &nn, int layer, int rank, bool test) {
+  RankReport report;
+  report.rank = rank;
+  report.params = nn.GetWeights(layer).size();
+  report.flops = 2 * report.params;
+  vector<int> indices;
+  auto begin = std::chrono::steady_clock::now();
+  report.accuracy = nn.Evaluate(test, indices);
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - begin;
+  report.seconds = elapsed.count();
+  return report;
+}
+
+/// @brief 依次用每个秩分解一层并评估（Factorize one layer with each rank in
+///        turn and evaluate）
+/// @param nn 神经网络（neural network）
+/// @param layer 仿射变换层的层号（layer number of an affine layer）
+/// @param ranks 要比较的秩（ranks to compare）
+/// @param test 是否使用测试数据（whether to use the test data）
+/// @param reports 第一项为原来的稠密层，之后每个秩一项（the dense layer
+///        first, then one entry per rank）
+/// @return 错误信息（error message）
+string LowRankSweep::Run(NeuralNetwork &nn, int layer,
+                         const vector<int> &ranks, bool test,
+                         vector<RankReport> &reports) {
+  reports.clear();
+  if (layer < 1 || layer >= nn.GetLayers() ||
+      nn.GetLayer(layer).type != "Affine") {
+    return "Layer " + std::to_string(layer) + " is not an affine layer.";
+  }
+  Parameters saved;
+  nn.SaveParameters(saved);
+  reports.push_back(Measure(nn, layer, 0, test));
+  for (int rank : ranks) {
+    string err = nn.Factorize(layer, rank);
+    if (!err.empty()) return err;
+    reports.push_back(Measure(nn, layer, rank, test));
+    nn.Expand(layer);
+    nn.LoadParameters(saved);
+  }
+  return "";
+}
@@ -0,0 +1,39 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_TRAINING_LOW_RANK_SWEEP_H_
+#define MOUNTAIN_LAKE_TRAINING_LOW_RANK_SWEEP_H_
+
+#include <mountain_lake/neural_network/neural_network.h>
+
+/// @brief 一个秩的压缩效果（effect of compressing with one rank）
+struct RankReport {
+  int rank = 0;          // 秩，0为原来的稠密层（rank, 0 is the dense layer）
+  long params = 0;       // 这一层的权重数（weights of the layer）
+  long flops = 0;        // 这一层每个样本的浮点运算数（flops of the layer
+                         // per sample）
+  float accuracy = 0.0f;  // 整个网络的准确率（accuracy of the network）
+  double seconds = 0.0;   // 评估用时（evaluation time）
+};
+
+/// @brief 按秩比较低秩分解的准确率与速度（Compare the accuracy and speed of
+///        low-rank factorization by rank）
+/// @remark 每个秩都从原来的权重分解，评估后恢复原来的权重，所以网络在结束
+///         后不变。选定秩后用NeuralNetwork::Factorize分解，再训练几轮就可以
+///         微调两个因子。
+///         Every rank is factorized from the original weights, which are
+///         restored after evaluating, so the network is unchanged at the end.
+///         Once a rank is chosen, NeuralNetwork::Factorize does the
+///         factorization and a few more epochs of training fine-tune the two
+///         factors.
+class LowRankSweep {
+ public:
+  LowRankSweep(){};
+  ~LowRankSweep(){};
+  static string Run(NeuralNetwork& nn, int layer, const vector<int>& ranks,
+                    bool test, vector<RankReport>& reports);
+};
+
+#endif  // MOUNTAIN_LAKE_TRAINING_LOW_RANK_SWEEP_H_
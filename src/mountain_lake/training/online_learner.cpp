@@ -0,0 +1,123 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "online_learner.h"
+
+#include <algorithm>
+
+/// @brief 初始化在线学习器（Initialize the online learner）
+/// @param nn 已经初始化的神经网络，使用它的学习率（initialized neural
+///        network, its learning rate is used）
+/// @param config 在线学习配置（online learning configuration）
+/// @return 错误信息（error message）
+/// @remark 新样本与回放缓冲区在这里一次分配，之后不再改变大小。
+///         The buffers of new samples and of replay are allocated once here
+///         and never change size afterwards.
+string OnlineLearner::Init(NeuralNetwork &nn, const OnlineConfig &config) {
+  if (nn.GetLayers() <= 0) return "The network is not initialized.";
+  if (nn.IsInference()) return "A network in inference mode cannot be trained.";
+  if (config.batch_size <= 0) {
+    return "The online batch size must be positive.";
+  }
+  if (config.replay_capacity < 0 || config.replay_samples < 0) {
+    return "The replay capacity and samples must not be negative.";
+  }
+  if (config.replay_samples > 0 && config.replay_capacity == 0) {
+    return "Replay samples need a replay capacity.";
+  }
+  int size = nn.GetLayer(0).output_size;
+  this->nn_ = &nn;
+  this->config_ = config;
+  this->stats_ = OnlineStats();
+  this->pending_.resize(config.batch_size, size);
+  this->pending_labels_.assign(config.batch_size, 0);
+  this->pending_count_ = 0;
+  this->replay_.resize(config.replay_capacity, size);
+  this->replay_labels_.assign(config.replay_capacity, 0);
+  this->replay_next_ = 0;
+  this->replay_size_ = 0;
+  this->rng_.seed(config.seed);
+  return "";
+}
+
+/// @brief 学习一个样本（Learn one sample）
+/// @param x 样本，长度为输入的大小（sample as long as the input）
+/// @param label 标签（label）
+/// @return 是否更新了权重（whether the weights were updated）
+bool OnlineLearner::Learn(const float *x, uint8_t label) {
+  this->pending_.row(this->pending_count_) =
+      Eigen::Map<const Eigen::RowVectorXf>(x, this->pending_.cols());
+  this->pending_labels_[this->pending_count_] = label;
+  ++this->pending_count_;
+  ++this->stats_.samples;
+  if (this->pending_count_ < this->config_.batch_size) return false;
+  this->Step(this->pending_count_);
+  return true;
+}
+
+/// @brief 依次学习一小批样本（Learn a small batch of samples in turn）
+/// @param X 样本，每行一个（samples, one per row）
+/// @param labels 标签，每个样本一个（one label per sample）
+/// @return 更新的次数（number of updates）
+/// @remark 与逐个调用Learn相同，小批量与batch_size不必一致。
+///         The same as calling Learn for each sample, the batch does not
+///         have to match batch_size.
+int OnlineLearner::Learn(const Ref<const MatrixXfr> &X,
+                         const uint8_t *labels) {
+  int updates = 0;
+  for (int r = 0; r < X.rows(); ++r) {
+    if (this->Learn(X.row(r).data(), labels[r])) ++updates;
+  }
+  return updates;
+}
+
+/// @brief 用还不够一个批量的新样本更新（Update with the new samples that do
+///        not fill a batch yet）
+/// @return 是否更新了权重（whether the weights were updated）
+/// @remark 样本数与平时不同，工作区会重新分配一次。
+///         The number of samples differs from usual, so the workspace is
+///         allocated again once.
+bool OnlineLearner::Flush() {
+  if (this->pending_count_ == 0) return false;
+  this->Step(this->pending_count_);
+  return true;
+}
+
+/// @brief 用n个新样本与抽取的回放样本更新一次（One update with n new
+///        samples and the drawn replay samples）
+/// @param n 新样本数（number of new samples）
+void OnlineLearner::Step(int n) {
+  NeuralNetwork &nn = *this->nn_;
+  Workspace &ws = this->ws_;
+  // 回放缓冲区为空时只用新样本（only the new samples while the replay buffer
+  // is empty）
+  int replay = this->replay_size_ > 0 ? this->config_.replay_samples : 0;
+  nn.ResizeWorkspace(n + replay, ws);
+  ws.O[0].topRows(n) = this->pending_.topRows(n);
+  std::copy(this->pending_labels_.begin(), this->pending_labels_.begin() + n,
+            ws.labels.begin());
+  std::uniform_int_distribution<int> pick(
+      0, std::max(0, this->replay_size_ - 1));
+  for (int r = 0; r < replay; ++r) {
+    int k = pick(this->rng_);
+    ws.O[0].row(n + r) = this->replay_.row(k);
+    ws.labels[n + r] = this->replay_labels_[k];
+  }
+  nn.Gradient(ws);
+  nn.Update(ws);
+  // 新样本覆盖最旧的回放样本（new samples overwrite the oldest replay
+  // samples）
+  int capacity = this->config_.replay_capacity;
+  for (int r = 0; r < n && capacity > 0; ++r) {
+    this->replay_.row(this->replay_next_) = this->pending_.row(r);
+    this->replay_labels_[this->replay_next_] = this->pending_labels_[r];
+    this->replay_next_ = (this->replay_next_ + 1) % capacity;
+    this->replay_size_ = std::min(this->replay_size_ + 1, capacity);
+  }
+  this->pending_count_ = 0;
+  this->stats_.replayed += replay;
+  ++this->stats_.updates;
+  this->stats_.loss = ws.loss;
+}
@@ -0,0 +1,84 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_TRAINING_ONLINE_LEARNER_H_
+#define MOUNTAIN_LAKE_TRAINING_ONLINE_LEARNER_H_
+
+#include <mountain_lake/neural_network/neural_network.h>
+
+#include <random>
+
+/// @brief 在线学习配置（online learning configuration）
+struct OnlineConfig {
+  // 攒够多少个新样本更新一次，1表示每个样本都更新
+  // Update once this many new samples have arrived, 1 updates on every
+  // sample.
+  int batch_size = 1;
+  // 回放缓冲区能保存的最近样本数，0表示不回放
+  // Number of recent samples the replay buffer keeps, 0 disables replay.
+  int replay_capacity = 0;
+  // 每次更新从回放缓冲区抽取的样本数（samples drawn from the replay buffer
+  // for every update）
+  int replay_samples = 0;
+  unsigned int seed = 0;
+};
+
+/// @brief 在线学习的统计（statistics of online learning）
+struct OnlineStats {
+  long samples = 0;    // 收到的新样本数（new samples received）
+  long replayed = 0;   // 参与更新的回放样本数（replayed samples used）
+  int updates = 0;     // 更新次数（number of updates）
+  float loss = 0.0f;   // 最近一次更新的平均误差（mean loss of the last
+                       // update）
+};
+
+/// @brief 在线学习器，逐个接收样本并立即更新权重（online learner that takes
+///        samples one at a time and updates the weights right away）
+/// @remark 样本直接写入预先分配的缓冲区，不经过RawData，所以不需要扩大训练
+///         数据矩阵。新样本攒够batch_size个后，再从回放缓冲区有放回地抽取
+///         replay_samples个较早的样本一起计算梯度并更新，然后新样本覆盖环形
+///         回放缓冲区中最旧的样本。每次更新的样本数不变，工作区在第一次更新
+///         之后不再分配内存。
+///         Samples are written straight into preallocated buffers instead
+///         of RawData, so the training data matrices never have to grow.
+///         Once batch_size new samples have arrived, replay_samples earlier
+///         samples are drawn with replacement from the replay buffer, the
+///         gradients of all of them are computed and the weights updated, and
+///         the new samples then overwrite the oldest ones in the replay ring.
+///         Every update uses the same number of samples, so the workspace
+///         allocates nothing after the first update.
+class OnlineLearner {
+ public:
+  OnlineLearner(){};
+  ~OnlineLearner(){};
+  string Init(NeuralNetwork& nn, const OnlineConfig& config);
+  bool Learn(const float* x, uint8_t label);
+  int Learn(const Ref<const MatrixXfr>& X, const uint8_t* labels);
+  bool Flush();
+  inline OnlineConfig& GetConfig() { return this->config_; }
+  inline OnlineStats& GetStats() { return this->stats_; }
+  inline Workspace& GetWorkspace() { return this->ws_; }
+  inline int GetReplaySize() { return this->replay_size_; }
+
+ private:
+  void Step(int n);
+
+  NeuralNetwork* nn_ = nullptr;  // 正在学习的神经网络（network learning）
+  OnlineConfig config_;          // 在线学习配置（online configuration）
+  OnlineStats stats_;            // 统计（statistics）
+  Workspace ws_;                 // 工作区（workspace）
+  MatrixXfr pending_;  // 等待更新的新样本，每行一个（new samples waiting for
+                       // the update, one per row）
+  vector<uint8_t> pending_labels_;  // 新样本的标签（labels of new samples）
+  int pending_count_ = 0;           // 新样本数（number of new samples）
+  MatrixXfr replay_;  // 环形回放缓冲区（ring replay buffer）
+  vector<uint8_t> replay_labels_;  // 回放样本的标签（labels of replay
+                                   // samples）
+  int replay_next_ = 0;  // 下一个写入的位置（next slot to write）
+  int replay_size_ = 0;  // 已保存的样本数（samples kept）
+  std::mt19937 rng_;     // 抽取回放样本的随机数（random numbers for replay）
+};
+
+#endif  // MOUNTAIN_LAKE_TRAINING_ONLINE_LEARNER_H_
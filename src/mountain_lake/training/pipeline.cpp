@@ -0,0 +1,216 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "pipeline.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <thread>
+
+/// @brief 估计一层的计算量（Estimate the compute of one layer）
+/// @param nn 神经网络（neural network）
+/// @param i 层号（layer number）
+/// @return 有权重的层为乘加次数，其余为输出的大小
+///         （multiply-adds for layers with weights, the output size for the
+///         others）
+/// @remark 输出大小除以偏置个数就是每个权重被使用的次数，仿射变换层为1，
+///         卷积层为输出的高乘宽。
+///         The output size over the number of biases is how often each weight
+///         is used, 1 for affine layers and the output height times width for
+///         convolutional layers.
+double Pipeline::LayerCost(NeuralNetwork &nn, int i) {
+  double output = nn.GetLayer(i).output_size;
+  MatrixXf &W = nn.GetWeights(i);
+  MatrixXf &B = nn.GetBias(i);
+  if (W.size() == 0 || B.size() == 0) return std::max(1.0, output);
+  return static_cast<double>(W.size()) * output / B.size();
+}
+
+/// @brief 把层切分为若干段（Partition the layers into stages）
+/// @param nn 已经初始化的神经网络（initialized neural network）
+/// @param stages 段数（number of stages）
+/// @return 错误信息（error message）
+/// @remark 使各段中最大的计算量最小。融合的卷积、ReLU与池化层不会被切开，
+///         段数多于可以切分的步数时减少段数。
+///         Minimizes the largest compute of any stage. A fused convolution,
+///         ReLU and pooling group is never split, and the number of stages
+///         is reduced when there are fewer steps than stages.
+string Pipeline::Partition(NeuralNetwork &nn, int stages) {
+  if (stages <= 0) return "The number of pipeline stages must be positive.";
+  if (nn.IsInference()) return "A network in inference mode cannot be trained.";
+  int layers = nn.GetLayers();
+  // 每一步的第一层与前缀计算量（first layer and prefix cost of every step）
+  vector<int> starts;
+  vector<double> prefix(1, 0.0);
+  for (int i = 1; i <= layers; ++i) {
+    int last = nn.IsFused(i) ? i + 2 : i;
+    double cost = 0.0;
+    for (int k = i; k <= last; ++k) cost += Pipeline::LayerCost(nn, k);
+    starts.push_back(i);
+    prefix.push_back(prefix.back() + cost);
+    i = last;
+  }
+  int steps = starts.size();
+  stages = std::min(stages, steps);
+  // best[s][j]为前j步分成s段时最大的段计算量
+  // best[s][j] is the largest stage cost of the first j steps in s stages.
+  const double inf = std::numeric_limits<double>::infinity();
+  vector<vector<double>> best(stages + 1, vector<double>(steps + 1, inf));
+  vector<vector<int>> cut(stages + 1, vector<int>(steps + 1, 0));
+  best[0][0] = 0.0;
+  for (int s = 1; s <= stages; ++s) {
+    for (int j = s; j <= steps; ++j) {
+      for (int k = s - 1; k < j; ++k) {
+        double cost = std::max(best[s - 1][k], prefix[j] - prefix[k]);
+        if (cost < best[s][j]) {
+          best[s][j] = cost;
+          cut[s][j] = k;
+        }
+      }
+    }
+  }
+  this->first_.assign(stages + 1, layers + 1);
+  int j = steps;
+  for (int s = stages; s >= 1; --s) {
+    j = cut[s][j];
+    this->first_[s - 1] = starts[j];
+  }
+  return "";
+}
+
+/// @brief 用流水线计算一个小批量的梯度（Compute the gradients of a mini-batch
+///        through the pipeline）
+/// @param nn 已经切分的神经网络（partitioned neural network）
+/// @param indices 训练数据索引（Index values of the training data）
+/// @param micro_batches 微批量的个数（number of micro-batches）
+/// @param schedule 调度方式（schedule）
+/// @return 统计信息（statistics）
+/// @remark 梯度写入神经网络自己的梯度，之后可以直接调用Update()。最后一段在
+///         调用者的线程上计算。
+///         The gradients are written to the network's own gradients, so
+///         Update() can be called right after. The last stage runs on the
+///         calling thread.
+PipelineStats Pipeline::Gradient(NeuralNetwork &nn, const vector<int> &indices,
+                                 int micro_batches, int schedule) {
+  int n = indices.size();
+  int stages = this->GetStages();
+  this->stats_ = PipelineStats();
+  if (n == 0 || stages <= 0) return this->stats_;
+  int m = std::max(1, std::min(micro_batches, n));
+  auto start = std::chrono::steady_clock::now();
+  this->ws_.resize(m);
+  this->weight_.resize(m);
+  vector<int> batch;
+  for (int k = 0; k < m; ++k) {
+    int first = static_cast<long>(n) * k / m;
+    int last = static_cast<long>(n) * (k + 1) / m;
+    batch.assign(indices.begin() + first, indices.begin() + last);
+    nn.LoadBatch(batch, this->ws_[k]);
+    this->ws_[k].metrics = TrainMetrics();
+    this->weight_[k] = static_cast<float>(last - first) / n;
+  }
+  this->forward_.clear();
+  this->backward_.clear();
+  this->dW_.resize(stages);
+  this->dB_.resize(stages);
+  for (int s = 0; s < stages; ++s) {
+    this->forward_.emplace_back(new SpscQueue<int>(m));
+    this->backward_.emplace_back(new SpscQueue<int>(m));
+    this->dW_[s].resize(nn.GetLayers() + 1);
+    this->dB_[s].resize(nn.GetLayers() + 1);
+    for (int i = this->first_[s]; i < this->first_[s + 1]; ++i) {
+      MatrixXf &dW = nn.GetWeightGradient(i);
+      MatrixXf &dB = nn.GetBiasGradient(i);
+      this->dW_[s][i].resize(dW.rows(), dW.cols());
+      this->dB_[s][i].resize(dB.rows(), dB.cols());
+      dW.setZero();
+      dB.setZero();
+    }
+  }
+  this->stats_.stages = stages;
+  this->stats_.micro_batches = m;
+  this->stats_.busy_seconds.assign(stages, 0.0);
+  vector<std::thread> threads;
+  for (int s = 0; s + 1 < stages; ++s) {
+    threads.emplace_back(&Pipeline::RunStage, this, s, std::ref(nn), schedule);
+  }
+  this->RunStage(stages - 1, nn, schedule);
+  for (auto &thread : threads) thread.join();
+  for (int k = 0; k < m; ++k) nn.GetTrainMetrics().Merge(this->ws_[k].metrics);
+  this->stats_.seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+  for (int s = 0; s < stages; ++s) {
+    this->stats_.utilization.push_back(
+        this->stats_.seconds > 0
+            ? this->stats_.busy_seconds[s] / this->stats_.seconds
+            : 0.0);
+  }
+  return this->stats_;
+}
+
+/// @brief 一段的计算（Computation of one stage）
+/// @param s 段号（stage number）
+/// @param nn 神经网络（neural network）
+/// @param schedule 调度方式（schedule）
+/// @remark 1F1B调度下第s段先做stages-s-1次正向传播，之后正向与反向交替，
+///         同时保存的微批量不超过段数。
+///         With the 1F1B schedule stage s first runs stages-s-1 forward
+///         passes, then alternates forward and backward, so no more
+///         micro-batches than stages are alive at once.
+void Pipeline::RunStage(int s, NeuralNetwork &nn, int schedule) {
+  int stages = this->GetStages();
+  int m = this->ws_.size();
+  int first = this->first_[s];
+  int last = this->first_[s + 1] - 1;
+  double &busy = this->stats_.busy_seconds[s];
+  auto forward = [&](int k) {
+    if (s > 0) k = this->forward_[s - 1]->PopWait();
+    auto begin = std::chrono::steady_clock::now();
+    Workspace &ws = this->ws_[k];
+    for (int i = first; i <= last; ++i) i = nn.StepForward(i, ws);
+    if (s + 1 == stages) this->stats_.loss += this->weight_[k] * ws.loss;
+    busy += std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                          begin)
+                .count();
+    if (s + 1 < stages) this->forward_[s]->PushWait(k);
+  };
+  auto backward = [&](int k) {
+    if (s + 1 < stages) k = this->backward_[s]->PopWait();
+    auto begin = std::chrono::steady_clock::now();
+    Workspace &ws = this->ws_[k];
+    vector<MatrixXf> &dW = this->dW_[s];
+    vector<MatrixXf> &dB = this->dB_[s];
+    for (int i = last; i >= first; --i) {
+      int f = nn.StepBackward(i, ws, dW, dB);
+      for (int j = f; j <= i; ++j) {
+        if (dW[j].size() > 0) {
+          nn.GetWeightGradient(j).noalias() += this->weight_[k] * dW[j];
+          nn.GetBiasGradient(j).noalias() += this->weight_[k] * dB[j];
+        }
+        // 这一层的输出已经用完（the output of this layer is no longer needed）
+        if (j < nn.GetLayers()) {
+          ws.O[j].resize(0, 0);
+          ws.dO[j].resize(0, 0);
+        }
+      }
+      i = f;
+    }
+    busy += std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                          begin)
+                .count();
+    if (s > 0) this->backward_[s - 1]->PushWait(k);
+  };
+  int warmup = schedule == kPipelineGPipe ? m : std::min(m, stages - s - 1);
+  int f = 0;
+  int b = 0;
+  for (; f < warmup; ++f) forward(f);
+  while (f < m) {
+    forward(f++);
+    backward(b++);
+  }
+  while (b < m) backward(b++);
+}
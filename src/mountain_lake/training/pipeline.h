@@ -0,0 +1,87 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_TRAINING_PIPELINE_H_
+#define MOUNTAIN_LAKE_TRAINING_PIPELINE_H_
+
+#include <mountain_lake/neural_network/neural_network.h>
+#include <mountain_lake/parallel/spsc_queue.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+/// @brief 流水线调度方式（pipeline schedules）
+enum PipelineSchedule {
+  // 先让全部微批量正向传播，再全部反向传播（every micro-batch forward, then
+  // every micro-batch backward）
+  kPipelineGPipe = 0,
+  // 预热后每做一次正向就做一次反向（one forward, one backward after the
+  // warmup）
+  kPipeline1F1B = 1,
+};
+
+/// @brief 流水线训练一步的统计（statistics of one pipelined step）
+struct PipelineStats {
+  int stages = 0;
+  int micro_batches = 0;
+  float loss = 0.0f;     // 小批量的平均误差（mean loss of the mini-batch）
+  double seconds = 0.0;  // 这一步的总用时（wall time of the step）
+  // 每段计算所用的时间，不包括等待（compute time of each stage, waiting
+  // excluded）
+  vector<double> busy_seconds;
+  // 每段的利用率，即计算时间与总用时之比（utilization of each stage, compute
+  // time over wall time）
+  vector<double> utilization;
+};
+
+/// @brief 按层切分的流水线并行训练（layer-pipelined parallel training）
+/// @remark 连续的几层组成一段，每段在自己的线程上计算。小批量被切成微批量，
+///         按GPipe或1F1B的顺序流过各段，段之间只通过无锁的单生产者单消费者
+///         队列传递微批量的编号，层输出放在每个微批量自己的工作区中。每段只
+///         写自己的层的梯度，所以累加梯度不需要加锁。得到的梯度与整个小批量
+///         一起计算的相同。
+///         Consecutive layers form a stage and every stage runs on its own
+///         thread. The mini-batch is cut into micro-batches that flow through
+///         the stages in GPipe or 1F1B order, and the stages only pass
+///         micro-batch numbers through lock-free single-producer
+///         single-consumer queues, the layer outputs live in the workspace of
+///         each micro-batch. Every stage only writes the gradients of its own
+///         layers, so accumulating them needs no lock. The resulting
+///         gradients are the same as those of the whole mini-batch.
+class Pipeline {
+ public:
+  Pipeline(){};
+  ~Pipeline(){};
+  string Partition(NeuralNetwork& nn, int stages);
+  PipelineStats Gradient(NeuralNetwork& nn, const vector<int>& indices,
+                         int micro_batches, int schedule);
+  inline int GetStages() { return (int)this->first_.size() - 1; }
+  inline int GetFirstLayer(int stage) { return this->first_[stage]; }
+  static double LayerCost(NeuralNetwork& nn, int i);
+
+ private:
+  void RunStage(int s, NeuralNetwork& nn, int schedule);
+
+  // 每段的第一层，最后一个元素为层数加1（first layer of every stage, the
+  // last element is the number of layers plus 1）
+  vector<int> first_;
+  vector<Workspace> ws_;   // 每个微批量的工作区（workspace of each micro-batch）
+  vector<float> weight_;   // 每个微批量在小批量中的比例（share of each
+                           // micro-batch in the mini-batch）
+  // 第s段到第s+1段的正向队列与反向队列（forward and backward queues between
+  // stage s and stage s+1）
+  vector<std::unique_ptr<SpscQueue<int>>> forward_;
+  vector<std::unique_ptr<SpscQueue<int>>> backward_;
+  // 每段自己的梯度缓冲区（gradient buffers of each stage）
+  vector<vector<MatrixXf>> dW_;
+  vector<vector<MatrixXf>> dB_;
+  PipelineStats stats_;
+};
+
+#endif  // MOUNTAIN_LAKE_TRAINING_PIPELINE_H_
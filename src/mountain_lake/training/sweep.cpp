@@ -0,0 +1,78 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "sweep.h"
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+
+/// @brief 训练一组配置（Train a set of configurations）
+/// @param configs 配置文件，每个都包含neural_network与training表
+///        （configuration files, each with a neural_network and a training
+///        table）
+/// @param raw_data 原始数据，所有模型只读共享（raw data, shared read-only by
+///        every model）
+/// @param threads 同时训练的模型数（number of models trained at once）
+/// @param results 每个配置一项，顺序与configs相同（one entry per
+///        configuration in the order of configs）
+/// @return 错误信息（error message）
+/// @remark 某个配置初始化失败时只记录在它的结果中，不影响其他配置。
+///         A configuration that fails to initialize only has the error
+///         recorded in its result and does not affect the others.
+string Sweep::Run(const vector<string> &configs, const RawData &raw_data,
+                  int threads, vector<SweepResult> &results) {
+  if (threads <= 0) return "The number of sweep threads must be positive.";
+  int n = configs.size();
+  results.assign(n, SweepResult());
+  vector<std::unique_ptr<NeuralNetwork>> networks(n);
+  vector<std::unique_ptr<Trainer>> trainers(n);
+  for (int k = 0; k < n; ++k) {
+    results[k].config = configs[k];
+    networks[k].reset(new NeuralNetwork());
+    trainers[k].reset(new Trainer());
+    string err = networks[k]->InitShared(configs[k], raw_data);
+    if (err.empty()) err = trainers[k]->Init(configs[k]);
+    results[k].error = err;
+  }
+  // 每个线程依次取下一个配置（every thread takes the next configuration in
+  // turn）
+  std::atomic<int> next(0);
+  auto run = [&] {
+    for (int k = next++; k < n; k = next++) {
+      if (!results[k].error.empty()) continue;
+      results[k].result = trainers[k]->Train(*networks[k], results[k].csv);
+      vector<TrainMetrics> &epochs = trainers[k]->GetEpochMetrics();
+      if (!epochs.empty()) results[k].metrics = epochs.back();
+      // 训练完立即释放层输出与梯度（free the layer outputs and gradients
+      // right after training）
+      networks[k].reset();
+    }
+  };
+  vector<std::thread> workers;
+  for (int t = 1; t < std::min(threads, n); ++t) workers.emplace_back(run);
+  run();
+  for (auto &worker : workers) worker.join();
+  return "";
+}
+
+/// @brief 把搜索结果格式化为CSV表，每个配置一行（Format the sweep results as
+///        a CSV table, one row per configuration）
+/// @param results 搜索结果（sweep results）
+/// @return CSV表（CSV table）
+string FormatSweepResults(const vector<SweepResult> &results) {
+  string csv =
+      "config,best_accuracy,best_step,steps,seconds,train_loss,"
+      "train_accuracy,error\n";
+  for (const SweepResult &r : results) {
+    csv += r.config + "," + std::to_string(r.result.best_accuracy) + "," +
+           std::to_string(r.result.best_step) + "," +
+           std::to_string(r.result.steps) + "," +
+           std::to_string(r.result.seconds) + "," +
+           std::to_string(r.metrics.Loss()) + "," +
+           std::to_string(r.metrics.Accuracy()) + "," + r.error + "\n";
+  }
+  return csv;
+}
@@ -0,0 +1,49 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_TRAINING_SWEEP_H_
+#define MOUNTAIN_LAKE_TRAINING_SWEEP_H_
+
+#include <mountain_lake/training/trainer.h>
+
+/// @brief 超参数搜索中一个配置的结果（result of one configuration in a
+///        hyperparameter sweep）
+struct SweepResult {
+  string config;         // 配置文件（configuration file）
+  string error;          // 错误信息，为空时训练成功（error message, empty
+                         // when training succeeded）
+  TrainResult result;    // 训练结果（training result）
+  TrainMetrics metrics;  // 最后一轮的训练指标（training metrics of the last
+                         // epoch）
+  string csv;            // 评估记录（evaluation log）
+};
+
+/// @brief 在同一份数据上同时训练多个配置（Train several configurations on
+///        one copy of the data at the same time）
+/// @remark 所有神经网络通过InitShared共享调用者的原始数据，内存只随权重与
+///         层输出增加，不随模型数复制训练数据。神经网络按顺序在调用线程上
+///         初始化，所以配置中的thread_pool表在训练开始之前生效，以最后一个
+///         为准。之后threads个线程依次取下一个配置，用Trainer按配置中的
+///         training表训练，层内的并行计算仍然交给全局线程池。
+///         Every network shares the caller's raw data through InitShared, so
+///         memory only grows with the weights and layer outputs instead of
+///         copying the training data once per model. The networks are
+///         initialized in order on the calling thread, so the thread_pool
+///         tables of the configurations take effect before training starts
+///         and the last one wins. Then threads threads each take the next
+///         configuration and train it with a Trainer following its training
+///         table, the parallel work inside layers still goes to the global
+///         thread pool.
+class Sweep {
+ public:
+  Sweep(){};
+  ~Sweep(){};
+  static string Run(const vector<string>& configs, const RawData& raw_data,
+                    int threads, vector<SweepResult>& results);
+};
+
+string FormatSweepResults(const vector<SweepResult>& results);
+
+#endif  // MOUNTAIN_LAKE_TRAINING_SWEEP_H_
@@ -0,0 +1,299 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include "trainer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <random>
+
+/// @brief 读取训练配置（Read the training configuration）
+/// @param config_file 配置文件名称（Configuration file name）
+/// @return 错误信息（error message）
+string Trainer::Init(string config_file) {
+  unordered_map<string, string> conf;
+  string err = ReadSTOML(config_file, conf);
+  if (!err.empty()) {
+    return err;
+  }
+  return this->ReadConfig(conf);
+}
+
+/// @brief 从配置信息中读取training表（Read the training table）
+/// @param conf 配置信息（configuration information）
+/// @return 错误信息（error message）
+/// @remark 没有设置的项使用默认值。
+///         Items that are not set keep their default values.
+string Trainer::ReadConfig(unordered_map<string, string> &conf) {
+  this->config_ = TrainConfig();
+  TrainConfig &c = this->config_;
+  string err;
+  err = ReadConfigValue(conf, "training.epochs", c.epochs);
+  if (!err.empty()) return err;
+  err = ReadConfigValue(conf, "training.batch_size", c.batch_size);
+  if (!err.empty()) return err;
+  err = ReadConfigValue(conf, "training.learning_rate", c.learning_rate);
+  if (!err.empty()) return err;
+  string schedule = conf["training.schedule"];
+  if (schedule == "step") {
+    c.schedule = kScheduleStep;
+  } else if (schedule == "cosine") {
+    c.schedule = kScheduleCosine;
+  } else if (!schedule.empty() && schedule != "constant") {
+    return "Unknown learning rate schedule \"" + schedule +
+           "\", use \"constant\", \"step\" or \"cosine\".";
+  }
+  err = ReadConfigValue(conf, "training.step_size", c.step_size);
+  if (!err.empty()) return err;
+  err = ReadConfigValue(conf, "training.gamma", c.gamma);
+  if (!err.empty()) return err;
+  err = ReadConfigValue(conf, "training.min_learning_rate",
+                        c.min_learning_rate);
+  if (!err.empty()) return err;
+  err = ReadConfigValue(conf, "training.warmup_steps", c.warmup_steps);
+  if (!err.empty()) return err;
+  err = ReadConfigValue(conf, "training.eval_every", c.eval_every);
+  if (!err.empty()) return err;
+  err = ReadConfigValue(conf, "training.eval_samples", c.eval_samples);
+  if (!err.empty()) return err;
+  err = ReadConfigValue(conf, "training.patience", c.patience);
+  if (!err.empty()) return err;
+  err = ReadConfigValue(conf, "training.min_delta", c.min_delta);
+  if (!err.empty()) return err;
+  err = ReadConfigValue(conf, "training.target_accuracy", c.target_accuracy);
+  if (!err.empty()) return err;
+  err = ReadConfigValue(conf, "training.seed", c.seed);
+  if (!err.empty()) return err;
+  c.async_eval = conf["training.async_eval"] == "true";
+  err = ReadConfigValue(conf, "training.hogwild_threads", c.hogwild_threads);
+  if (!err.empty()) return err;
+  err = ReadConfigValue(conf, "training.pipeline_stages", c.pipeline_stages);
+  if (!err.empty()) return err;
+  err = ReadConfigValue(conf, "training.micro_batches", c.micro_batches);
+  if (!err.empty()) return err;
+  string pipeline_schedule = conf["training.pipeline_schedule"];
+  if (pipeline_schedule == "gpipe") {
+    c.pipeline_schedule = kPipelineGPipe;
+  } else if (!pipeline_schedule.empty() && pipeline_schedule != "1f1b") {
+    return "Unknown pipeline schedule \"" + pipeline_schedule +
+           "\", use \"1f1b\" or \"gpipe\".";
+  }
+  if (c.pipeline_stages <= 0 || c.micro_batches <= 0) {
+    return "\"training.pipeline_stages\" and \"training.micro_batches\" "
+           "must be positive.";
+  }
+  if (c.hogwild_threads > 1 && c.pipeline_stages > 1) {
+    return "\"training.hogwild_threads\" and \"training.pipeline_stages\" "
+           "cannot both be greater than 1.";
+  }
+  if (c.epochs <= 0 || c.batch_size <= 0 || c.step_size <= 0) {
+    return "\"training.epochs\", \"training.batch_size\" and "
+           "\"training.step_size\" must be positive.";
+  }
+  return "";
+}
+
+/// @brief 计算某一步的学习率（Learning rate of a step）
+/// @param step 当前步数，从0开始（current step, starting from 0）
+/// @param total_steps 总步数（total number of steps）
+/// @return 学习率（learning rate）
+/// @remark 预热阶段学习率线性增加到设定值，之后按调度方式变化，
+///         调度从预热结束时开始计算。
+///         During warmup the learning rate rises linearly to the configured
+///         value, after that it follows the schedule, which starts counting
+///         at the end of the warmup.
+float Trainer::LearningRate(int step, int total_steps) {
+  TrainConfig &c = this->config_;
+  if (step < c.warmup_steps) {
+    return c.learning_rate * (step + 1) / c.warmup_steps;
+  }
+  int t = step - c.warmup_steps;
+  if (c.schedule == kScheduleStep) {
+    return c.learning_rate * std::pow(c.gamma, t / c.step_size);
+  }
+  if (c.schedule == kScheduleCosine) {
+    int n = std::max(1, total_steps - c.warmup_steps);
+    float r = std::min(1.0f, static_cast<float>(t) / n);
+    return c.min_learning_rate + 0.5f * (c.learning_rate - c.min_learning_rate) *
+                                     (1.0f + std::cos(M_PI * r));
+  }
+  return c.learning_rate;
+}
+
+/// @brief 训练神经网络（Train the neural network）
+/// @param nn 已经初始化的神经网络（initialized neural network）
+/// @param csv 每次评估追加一行“步数,轮数,学习率,准确率,秒数,训练误差,
+///        训练准确率”（one "step,epoch,lr,accuracy,seconds,train_loss,
+///        train_accuracy" line per evaluation）
+/// @return 训练结果（training result）
+/// @remark 有测试数据时在测试数据上评估，否则在训练数据上评估。评估样本在开始时
+///         抽取一次，之后每次评估都使用同一批样本，这样结果可以互相比较。
+///         结束时神经网络恢复为评估准确率最高的参数。
+///         训练误差与训练准确率在计算梯度时顺便累计，每轮的结果保存在
+///         GetEpochMetrics()中，不需要再对训练数据预测一遍。
+///         设置async_eval后，评估在后台线程中对权重快照进行，训练不等待评估，
+///         提前停止会在评估结果出来后的下一步生效。
+///         Evaluation uses the test data when there is any, otherwise the
+///         training data. The evaluation samples are drawn once at the start
+///         and reused by every evaluation, so the results are comparable.
+///         At the end the network is restored to the parameters with the
+///         best evaluated accuracy.
+///         The training loss and accuracy are gathered while the gradients
+///         are computed and every epoch's result is kept in
+///         GetEpochMetrics(), with no extra prediction pass over the training
+///         data.
+///         With async_eval, evaluation runs on weight snapshots on a
+///         background thread and training does not wait for it, early
+///         stopping takes effect at the step after the result arrives.
+TrainResult Trainer::Train(NeuralNetwork &nn, string &csv) {
+  TrainConfig &c = this->config_;
+  this->result_ = TrainResult();
+  this->has_best_ = false;
+  this->best_tracked_ = -1.0f;
+  this->bad_ = 0;
+  this->stop_ = false;
+  this->epoch_metrics_.clear();
+  const RawData &data = nn.GetTrainData();
+  int n = data.train_number;
+  if (n <= 0) return this->result_;
+  int steps_per_epoch = (n + c.batch_size - 1) / c.batch_size;
+  int total_steps = c.epochs * steps_per_epoch;
+  int eval_every = c.eval_every > 0 ? c.eval_every : steps_per_epoch;
+  std::mt19937 rng(c.seed);
+  vector<int> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  // 抽取固定的评估样本（Draw a fixed set of evaluation samples）
+  bool test = data.test_number > 0;
+  int eval_total = test ? data.test_number : n;
+  vector<int> eval_indices;
+  if (c.eval_samples > 0 && c.eval_samples < eval_total) {
+    eval_indices.resize(eval_total);
+    std::iota(eval_indices.begin(), eval_indices.end(), 0);
+    std::shuffle(eval_indices.begin(), eval_indices.end(), rng);
+    eval_indices.resize(c.eval_samples);
+  }
+  AsyncEvaluator evaluator;
+  if (c.async_eval) {
+    evaluator.Start(&nn, test, eval_indices, &csv,
+                    [this, &nn](const EvalReport &report, Parameters &params) {
+                      this->Record(report, &params, nn);
+                    });
+  }
+  EvalReport report;
+  vector<int> batch;
+  auto start = std::chrono::steady_clock::now();
+  // 评估当前权重（Evaluate the current weights）
+  auto evaluate = [&](int step, int epoch) {
+    report.step = step;
+    report.epoch = epoch;
+    report.train_loss = nn.GetTrainMetrics().Loss();
+    report.train_accuracy = nn.GetTrainMetrics().Accuracy();
+    report.seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    if (c.async_eval) {
+      evaluator.Submit(report);
+      return;
+    }
+    report.accuracy = nn.Evaluate(test, eval_indices);
+    report.seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    csv += FormatEvalReport(report);
+    this->Record(report, nullptr, nn);
+  };
+  int step = 0;
+  if (c.hogwild_threads > 1) {
+    // Hogwild模式下每轮的学习率不变，每轮结束时评估
+    // In Hogwild mode the learning rate is constant within an epoch and
+    // evaluation happens at the end of each epoch.
+    Hogwild hogwild;
+    for (int epoch = 0; epoch < c.epochs && !this->stop_; ++epoch) {
+      report.learning_rate = this->LearningRate(step, total_steps);
+      nn.SetLearningRate(report.learning_rate);
+      nn.ResetTrainMetrics();
+      step += hogwild
+                  .Train(nn, c.hogwild_threads, 1, c.batch_size,
+                         report.learning_rate, c.seed + epoch * 7919)
+                  .steps;
+      this->epoch_metrics_.push_back(nn.GetTrainMetrics());
+      evaluate(step, epoch);
+    }
+  } else {
+    // 流水线模式下由各段的线程一起计算一个小批量的梯度，不能切分时不使用
+    // 流水线
+    // In pipeline mode the stage threads compute the gradients of a
+    // mini-batch together, the pipeline is not used when the network cannot
+    // be partitioned.
+    Pipeline pipeline;
+    bool pipelined = c.pipeline_stages > 1 &&
+                     pipeline.Partition(nn, c.pipeline_stages).empty();
+    for (int epoch = 0; epoch < c.epochs && !this->stop_; ++epoch) {
+      std::shuffle(order.begin(), order.end(), rng);
+      nn.ResetTrainMetrics();
+      for (int b = 0; b < n && !this->stop_; b += c.batch_size) {
+        batch.assign(order.begin() + b,
+                     order.begin() + std::min(n, b + c.batch_size));
+        report.learning_rate = this->LearningRate(step, total_steps);
+        nn.SetLearningRate(report.learning_rate);
+        if (pipelined) {
+          this->pipeline_stats_ = pipeline.Gradient(
+              nn, batch, c.micro_batches, c.pipeline_schedule);
+        } else {
+          nn.Gradient(batch);
+        }
+        nn.Update();
+        ++step;
+        if (step % eval_every != 0 && step != total_steps) continue;
+        evaluate(step, epoch);
+      }
+      this->epoch_metrics_.push_back(nn.GetTrainMetrics());
+    }
+  }
+  evaluator.Stop();
+  if (this->has_best_) nn.LoadParameters(this->best_);
+  this->result_.steps = step;
+  this->result_.seconds = std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+  return this->result_;
+}
+
+/// @brief 记录一次评估的结果（Record the result of one evaluation）
+/// @param report 评估结果（evaluation result）
+/// @param snapshot 被评估的参数快照，为空指针时使用神经网络的当前参数
+///        （evaluated parameter snapshot, the current parameters of the network
+///        when it is a null pointer）
+/// @param nn 神经网络（neural network）
+void Trainer::Record(const EvalReport &report, Parameters *snapshot,
+                     NeuralNetwork &nn) {
+  TrainConfig &c = this->config_;
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  if (c.target_accuracy > 0 && this->result_.time_to_target < 0 &&
+      report.accuracy >= c.target_accuracy) {
+    this->result_.time_to_target = report.seconds;
+  }
+  if (!this->has_best_ || report.accuracy > this->result_.best_accuracy) {
+    this->result_.best_accuracy = report.accuracy;
+    this->result_.best_step = report.step;
+    if (snapshot != nullptr) {
+      this->best_ = *snapshot;
+    } else {
+      nn.SaveParameters(this->best_);
+    }
+    this->has_best_ = true;
+  }
+  // 只有提高超过min_delta才重置计数
+  // Only an improvement larger than min_delta resets the counter.
+  if (report.accuracy > this->best_tracked_ + c.min_delta) {
+    this->best_tracked_ = report.accuracy;
+    this->bad_ = 0;
+  } else if (c.patience > 0 && ++this->bad_ >= c.patience) {
+    this->result_.early_stopped = true;
+    this->stop_ = true;
+  }
+}
@@ -0,0 +1,125 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef MOUNTAIN_LAKE_TRAINING_TRAINER_H_
+#define MOUNTAIN_LAKE_TRAINING_TRAINER_H_
+
+#include <mountain_lake/neural_network/neural_network.h>
+#include <mountain_lake/training/async_evaluator.h>
+#include <mountain_lake/training/hogwild.h>
+#include <mountain_lake/training/pipeline.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+using std::string;
+using std::unordered_map;
+
+/// @brief 学习率调度方式（learning rate schedules）
+enum LRSchedule {
+  kScheduleConstant = 0,  // 固定学习率（constant learning rate）
+  kScheduleStep = 1,      // 每隔若干步乘以gamma（multiply by gamma every N steps）
+  kScheduleCosine = 2,    // 余弦退火（cosine annealing）
+};
+
+/// @brief 训练配置（training configuration）
+struct TrainConfig {
+  int epochs = 1;
+  int batch_size = 1;
+  float learning_rate = 0.1f;
+  int schedule = kScheduleConstant;
+  // 阶梯调度的间隔步数与衰减系数（interval and decay of the step schedule）
+  int step_size = 1000;
+  float gamma = 0.1f;
+  // 余弦调度的最终学习率（final learning rate of the cosine schedule）
+  float min_learning_rate = 0.0f;
+  // 线性预热的步数（steps of linear warmup）
+  int warmup_steps = 0;
+  // 每隔多少步评估一次，0表示只在每轮结束时评估
+  // Evaluate every this many steps, 0 evaluates at the end of each epoch.
+  int eval_every = 0;
+  // 评估时抽取的样本数，0表示使用全部样本
+  // Number of samples drawn for evaluation, 0 uses every sample.
+  int eval_samples = 0;
+  // 连续多少次评估没有提高就提前停止，0表示不提前停止
+  // Stop after this many evaluations without improvement, 0 never stops.
+  int patience = 0;
+  // 准确率至少提高多少才算提高（minimum improvement of the accuracy）
+  float min_delta = 0.0f;
+  // 目标准确率，0表示不统计达到目标的时间
+  // Target accuracy, 0 disables the time-to-target measurement.
+  float target_accuracy = 0.0f;
+  unsigned int seed = 0;
+  // 是否在后台线程中评估权重快照（evaluate weight snapshots on a background
+  // thread）
+  bool async_eval = false;
+  // 大于1时使用Hogwild多线程训练，每轮结束时评估
+  // Train with this many Hogwild threads when greater than 1, evaluating at
+  // the end of each epoch.
+  int hogwild_threads = 1;
+  // 大于1时把层切成这么多段流水线训练（train with the layers cut into this
+  // many pipeline stages when greater than 1）
+  int pipeline_stages = 1;
+  // 流水线中每个小批量切成的微批量数（micro-batches per mini-batch in the
+  // pipeline）
+  int micro_batches = 4;
+  int pipeline_schedule = kPipeline1F1B;
+};
+
+/// @brief 训练结果（training result）
+struct TrainResult {
+  float best_accuracy = 0.0f;
+  int best_step = 0;
+  int steps = 0;
+  bool early_stopped = false;
+  // 训练总用时，单位为秒（total training time in seconds）
+  double seconds = 0.0;
+  // 首次达到目标准确率的用时，未达到时为-1
+  // Time until the target accuracy was first reached, -1 if never reached.
+  double time_to_target = -1.0;
+};
+
+/// @brief 训练器类（trainer class）
+/// @remark 把小批量训练、学习率调度、定期评估、提前停止和最佳检查点放在一起，
+///         用户不需要再自己写训练循环。
+///         Puts mini-batch training, learning rate schedules, periodic
+///         evaluation, early stopping and the best checkpoint together, so
+///         users no longer need to write their own training loop.
+class Trainer {
+ public:
+  Trainer(){};
+  ~Trainer(){};
+  string Init(string config_file);
+  string ReadConfig(unordered_map<string, string>& conf);
+  float LearningRate(int step, int total_steps);
+  TrainResult Train(NeuralNetwork& nn, string& csv);
+  inline TrainConfig& GetConfig() { return this->config_; }
+  inline PipelineStats& GetPipelineStats() { return this->pipeline_stats_; }
+  inline vector<TrainMetrics>& GetEpochMetrics() {
+    return this->epoch_metrics_;
+  }
+
+ private:
+  void Record(const EvalReport& report, Parameters* snapshot,
+              NeuralNetwork& nn);
+
+  TrainConfig config_;  // 训练配置（training configuration）
+  TrainResult result_;  // 训练结果（training result）
+  PipelineStats pipeline_stats_;  // 最后一步的流水线统计（pipeline statistics
+                                  // of the last step）
+  // 每轮的训练指标（training metrics of every epoch）
+  vector<TrainMetrics> epoch_metrics_;
+  Parameters best_;     // 最佳检查点（best checkpoint）
+  bool has_best_ = false;
+  float best_tracked_ = -1.0f;  // 用于提前停止的最佳准确率（best accuracy
+                                // used for early stopping）
+  int bad_ = 0;  // 连续没有提高的评估次数（evaluations without improvement）
+  std::atomic<bool> stop_{false};  // 是否提前停止（whether to stop early）
+  std::mutex mutex_;               // 保护以上结果（guards the results above）
+};
+
+#endif  // MOUNTAIN_LAKE_TRAINING_TRAINER_H_
@@ -0,0 +1,77 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <gtest/gtest.h>
+#include <mountain_lake/kernels/fast_math.h>
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/// @brief 以固定步长遍历整个float范围，返回正规结果的最大相对误差
+/// @param fast 被测函数
+/// @param exact 双精度的精确函数
+static double MaxRelativeError(void (*fast)(const float *, float *, int),
+                               double (*exact)(double)) {
+  const int chunk = 4096;
+  std::vector<float> x(chunk);
+  std::vector<float> y(chunk);
+  double max_err = 0.0;
+  uint64_t bits = 0;
+  while (bits < (1ull << 32)) {
+    int n = 0;
+    for (; n < chunk && bits < (1ull << 32); ++n, bits += 1021) {
+      uint32_t b = static_cast<uint32_t>(bits);
+      memcpy(&x[n], &b, sizeof(float));
+    }
+    fast(x.data(), y.data(), n);
+    for (int i = 0; i < n; ++i) {
+      if (std::isnan(x[i])) {
+        EXPECT_TRUE(std::isnan(y[i]));
+        continue;
+      }
+      double ref = exact(x[i]);
+      if (std::fabs(ref) < FLT_MIN || std::fabs(ref) > FLT_MAX) continue;
+      double err = std::fabs((y[i] - ref) / ref);
+      if (err > max_err) max_err = err;
+    }
+  }
+  return max_err;
+}
+
+static double ExactExp(double x) { return std::exp(x); }
+static double ExactSigmoid(double x) { return 1.0 / (1.0 + std::exp(-x)); }
+static double ExactTanh(double x) { return std::tanh(x); }
+
+TEST(FastMathTests, Exp) {
+  ASSERT_LT(MaxRelativeError(FastExp, ExactExp), 1e-7);
+  float x[3] = {89.0f, -200.0f, 0.0f};
+  float y[3];
+  FastExp(x, y, 3);
+  ASSERT_TRUE(std::isinf(y[0]));
+  ASSERT_EQ(y[1], 0.0f);
+  ASSERT_EQ(y[2], 1.0f);
+}
+
+TEST(FastMathTests, Sigmoid) {
+  ASSERT_LT(MaxRelativeError(FastSigmoid, ExactSigmoid), 2e-7);
+  float x[2] = {-200.0f, 200.0f};
+  float y[2];
+  FastSigmoid(x, y, 2);
+  ASSERT_EQ(y[0], 0.0f);
+  ASSERT_EQ(y[1], 1.0f);
+}
+
+TEST(FastMathTests, Tanh) {
+  ASSERT_LT(MaxRelativeError(FastTanh, ExactTanh), 2e-7);
+  float x[3] = {-50.0f, 1e-30f, 50.0f};
+  float y[3];
+  FastTanh(x, y, 3);
+  ASSERT_EQ(y[0], -1.0f);
+  ASSERT_EQ(y[1], 1e-30f);
+  ASSERT_EQ(y[2], 1.0f);
+}
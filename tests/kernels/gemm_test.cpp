@@ -0,0 +1,100 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <gtest/gtest.h>
+#include <mountain_lake/kernels/gemm.h>
+#include <mountain_lake/parallel/thread_pool.h>
+
+/// @brief 各种形状与转置组合的结果与Eigen一致，包括不完整的块与多个k块
+TEST(GemmTests, Shapes) {
+  const int shapes[][3] = {{1, 1, 1},    {17, 5, 9},    {100, 10, 100},
+                           {33, 100, 784}, {784, 100, 37}, {100, 784, 100},
+                           {16, 6, 256},  {31, 16, 513}, {5, 300, 3},
+                           {1, 100, 784}, {7, 10, 100},  {4, 784, 100},
+                           {168, 5, 3}};
+  for (auto &s : shapes) {
+    int m = s[0];
+    int n = s[1];
+    int k = s[2];
+    for (int t = 0; t < 4; ++t) {
+      bool trans_a = t & 1;
+      bool trans_b = t & 2;
+      MatrixXf A = trans_a ? MatrixXf::Random(k, m) : MatrixXf::Random(m, k);
+      MatrixXf B = trans_b ? MatrixXf::Random(n, k) : MatrixXf::Random(k, n);
+      MatrixXf ref = (trans_a ? MatrixXf(A.transpose()) : A) *
+                     (trans_b ? MatrixXf(B.transpose()) : B);
+      MatrixXf C;
+      Gemm(A, trans_a, B, trans_b, C);
+      ASSERT_EQ(C.rows(), m);
+      ASSERT_EQ(C.cols(), n);
+      ASSERT_LT((C - ref).cwiseAbs().maxCoeff(), 1e-3 * std::sqrt(k))
+          << m << "x" << n << "x" << k << " trans " << t;
+      // 累加（accumulate）
+      Gemm(A, trans_a, B, trans_b, C, true);
+      ASSERT_LT((C - 2 * ref).cwiseAbs().maxCoeff(), 2e-3 * std::sqrt(k));
+    }
+  }
+}
+
+/// @brief 预先打包的右操作数与直接相乘的结果一致，k为0时结果为0
+TEST(GemmTests, Packed) {
+  MatrixXf W = MatrixXf::Random(300, 10);
+  PackedMatrix P;
+  PackMatrix(W, P);
+  ASSERT_EQ(P.rows, 300);
+  ASSERT_EQ(P.cols, 10);
+  ASSERT_EQ(P.data.size(), 300u * 12);
+  MatrixXf C;
+  // 包括按行计算的小批量（including the small batches computed row by row）
+  for (int m : {1, 5, 37}) {
+    MatrixXf X = MatrixXf::Random(m, 300);
+    Gemm(X, P, C);
+    ASSERT_LT((C - X * W).cwiseAbs().maxCoeff(), 1e-3) << m;
+  }
+  MatrixXf E(4, 0);
+  MatrixXf F(0, 3);
+  Gemm(E, false, F, false, C);
+  ASSERT_EQ(C.rows(), 4);
+  ASSERT_EQ(C.cols(), 3);
+  ASSERT_EQ(C.cwiseAbs().maxCoeff(), 0.0f);
+}
+
+/// @brief 多线程的结果与单线程完全相同
+TEST(GemmTests, Threads) {
+  MatrixXf A = MatrixXf::Random(100, 784);
+  MatrixXf B = MatrixXf::Random(784, 100);
+  ThreadPoolConfig config;
+  config.threads = 1;
+  ThreadPool::Global().Start(config);
+  MatrixXf C1;
+  Gemm(A, false, B, false, C1);
+  config.threads = 4;
+  ThreadPool::Global().Start(config);
+  MatrixXf C4;
+  Gemm(A, false, B, false, C4);
+  ThreadPool::Global().Start(ThreadPoolConfig());
+  ASSERT_EQ(C1, C4);
+}
+
+/// @brief 矩阵的一块与映射不复制也能直接相乘
+TEST(GemmTests, Views) {
+  MatrixXf X = MatrixXf::Random(50, 300);
+  MatrixXf W = MatrixXf::Random(120, 10);
+  MatrixXf C;
+  // 列距大于行数的块（a block whose column stride exceeds its rows）
+  Gemm(X.block(3, 10, 40, 100), false, W.topRows(100), false, C);
+  MatrixXf ref = X.block(3, 10, 40, 100) * W.topRows(100);
+  ASSERT_LT((C - ref).cwiseAbs().maxCoeff(), 1e-3);
+  MatrixXf Y = MatrixXf::Random(300, 50);
+  Gemm(Y.block(10, 5, 100, 40), true, W.topRows(100), false, C);
+  ref = Y.block(10, 5, 100, 40).transpose() * W.topRows(100);
+  ASSERT_LT((C - ref).cwiseAbs().maxCoeff(), 1e-3);
+  Eigen::Map<const MatrixXf> M(X.data(), 100, 150);
+  PackedMatrix P;
+  PackMatrix(M.leftCols(7), P);
+  Gemm(X.topRows(9).leftCols(100), P, C);
+  ref = X.topRows(9).leftCols(100) * M.leftCols(7);
+  ASSERT_LT((C - ref).cwiseAbs().maxCoeff(), 1e-3);
+}
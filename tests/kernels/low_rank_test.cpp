@@ -0,0 +1,53 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <gtest/gtest.h>
+#include <mountain_lake/kernels/low_rank.h>
+
+/// @brief 秩为5的矩阵被精确恢复，奇异向量正交
+TEST(LowRankTest, ExactRank) {
+  MatrixXf A = MatrixXf::Random(70, 5) * MatrixXf::Random(5, 40);
+  MatrixXf U, V;
+  VectorXf S;
+  TruncatedSvd(A, 5, U, S, V, 3, 0);
+  ASSERT_EQ(U.rows(), 70);
+  ASSERT_EQ(U.cols(), 5);
+  ASSERT_EQ(V.rows(), 40);
+  ASSERT_EQ(V.cols(), 5);
+  MatrixXf R = U * S.asDiagonal() * V.transpose();
+  ASSERT_LT((R - A).cwiseAbs().maxCoeff(), 1e-3);
+  ASSERT_LT((U.transpose() * U - MatrixXf::Identity(5, 5)).norm(), 1e-4);
+  ASSERT_LT((V.transpose() * V - MatrixXf::Identity(5, 5)).norm(), 1e-4);
+}
+
+/// @brief 奇异值快速衰减时，截断误差接近最优的截断奇异值分解
+TEST(LowRankTest, DecayingSpectrum) {
+  MatrixXf P = Eigen::HouseholderQR<MatrixXf>(MatrixXf::Random(120, 60))
+                   .householderQ() *
+               MatrixXf::Identity(120, 60);
+  MatrixXf Q = Eigen::HouseholderQR<MatrixXf>(MatrixXf::Random(80, 60))
+                   .householderQ() *
+               MatrixXf::Identity(80, 60);
+  VectorXf sigma(60);
+  for (int k = 0; k < 60; ++k) sigma(k) = std::pow(0.8f, k);
+  MatrixXf A = P * sigma.asDiagonal() * Q.transpose();
+  for (int rank : {1, 8, 20}) {
+    MatrixXf U, V;
+    VectorXf S;
+    TruncatedSvd(A, rank, U, S, V, 3, rank);
+    for (int k = 0; k < rank; ++k) ASSERT_NEAR(S(k), sigma(k), 1e-3);
+    float error = (A - U * S.asDiagonal() * V.transpose()).norm();
+    float best = sigma.tail(60 - rank).norm();
+    ASSERT_LT(error, best * 1.05f + 1e-5f) << "rank " << rank;
+  }
+  // 多取的列数达到矩阵的大小时结果是精确的（exact once the sampled columns
+  // reach the size of the matrix）
+  MatrixXf B = MatrixXf::Random(12, 9);
+  MatrixXf U, V;
+  VectorXf S;
+  TruncatedSvd(B, 9, U, S, V, 3, 0);
+  ASSERT_LT((B - U * S.asDiagonal() * V.transpose()).cwiseAbs().maxCoeff(),
+            1e-4);
+}
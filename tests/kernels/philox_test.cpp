@@ -0,0 +1,112 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <gtest/gtest.h>
+#include <mountain_lake/kernels/philox.h>
+#include <mountain_lake/parallel/thread_pool.h>
+
+#include <vector>
+
+/// @brief Random123的已知答案测试（Known-answer tests from Random123）
+TEST(PhiloxTest, KnownAnswer) {
+  uint32_t out[4];
+  uint32_t c0[4] = {0, 0, 0, 0};
+  uint32_t k0[2] = {0, 0};
+  Philox4x32(c0, k0, out);
+  ASSERT_EQ(out[0], 0x6627e8d5u);
+  ASSERT_EQ(out[1], 0xe169c58du);
+  ASSERT_EQ(out[2], 0xbc57ac4cu);
+  ASSERT_EQ(out[3], 0x9b00dbd8u);
+  uint32_t c1[4] = {0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu};
+  uint32_t k1[2] = {0xffffffffu, 0xffffffffu};
+  Philox4x32(c1, k1, out);
+  ASSERT_EQ(out[0], 0x408f276du);
+  ASSERT_EQ(out[1], 0x41c83b0eu);
+  ASSERT_EQ(out[2], 0xa20bc7c6u);
+  ASSERT_EQ(out[3], 0x6d5451fdu);
+  uint32_t c2[4] = {0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u};
+  uint32_t k2[2] = {0xa4093822u, 0x299f31d0u};
+  Philox4x32(c2, k2, out);
+  ASSERT_EQ(out[0], 0xd16cfe09u);
+  ASSERT_EQ(out[1], 0x94fdccebu);
+  ASSERT_EQ(out[2], 0x5001e420u);
+  ASSERT_EQ(out[3], 0x24126ea1u);
+}
+
+/// @brief 结果与线程数无关，统计量正确
+TEST(PhiloxTest, Normal) {
+  const int n = 100003;
+  std::vector<float> a(n);
+  std::vector<float> b(n);
+  ThreadPoolConfig config;
+  config.threads = 1;
+  ASSERT_EQ(ThreadPool::Global().Start(config), "");
+  PhiloxNormal(a.data(), n, 1.0f, 2.0f, 42, 3);
+  config.threads = 4;
+  ASSERT_EQ(ThreadPool::Global().Start(config), "");
+  PhiloxNormal(b.data(), n, 1.0f, 2.0f, 42, 3);
+  ASSERT_EQ(ThreadPool::Global().Start(ThreadPoolConfig()), "");
+  ASSERT_EQ(a, b);
+  double sum = 0.0;
+  double sum2 = 0.0;
+  for (float x : a) {
+    sum += x;
+    sum2 += x * x;
+  }
+  double mean = sum / n;
+  double var = sum2 / n - mean * mean;
+  ASSERT_NEAR(mean, 1.0, 0.03);
+  ASSERT_NEAR(var, 4.0, 0.08);
+  // 不同的流互不相同
+  PhiloxNormal(b.data(), n, 1.0f, 2.0f, 42, 4);
+  ASSERT_NE(a, b);
+  // 前缀与长度无关
+  std::vector<float> c(7);
+  PhiloxNormal(c.data(), 7, 1.0f, 2.0f, 42, 3);
+  for (int i = 0; i < 7; ++i) ASSERT_EQ(c[i], a[i]);
+}
+
+TEST(PhiloxTest, Uniform) {
+  const int n = 10000;
+  std::vector<float> a(n);
+  PhiloxUniform(a.data(), n, -1.0f, 1.0f, 7, 0);
+  double sum = 0.0;
+  for (float x : a) {
+    ASSERT_GE(x, -1.0f);
+    ASSERT_LE(x, 1.0f);
+    sum += x;
+  }
+  ASSERT_NEAR(sum / n, 0.0, 0.03);
+}
+
+/// @brief 按位打包的伯努利随机数与逐个计算的Philox结果一致，1的比例正确，
+///        最后一个字节多出的位为0
+TEST(PhiloxTest, Bernoulli) {
+  const long n = 100005;
+  std::vector<uint8_t> bits((n + 7) / 8);
+  PhiloxBernoulli(bits.data(), n, 0.3f, 11, 5);
+  uint32_t key[2] = {11, 0};
+  uint32_t out[4];
+  long ones = 0;
+  for (long e = 0; e < n; ++e) {
+    // 第g组第j个字节的第l位来自第8g+l块的第j个数
+    long g = e / 32;
+    int j = e % 32 / 8;
+    int l = e % 8;
+    uint32_t counter[4] = {static_cast<uint32_t>(g * 8 + l), 0, 5, 0};
+    Philox4x32(counter, key, out);
+    bool bit = (bits[e / 8] >> (e % 8)) & 1;
+    ASSERT_EQ(bit, out[j] < static_cast<uint32_t>(0.3 * 4294967296.0))
+        << "element " << e;
+    ones += bit;
+  }
+  ASSERT_NEAR(static_cast<double>(ones) / n, 0.3, 0.01);
+  ASSERT_EQ(bits.back() >> (n % 8), 0);
+  PhiloxBernoulli(bits.data(), n, 1.0f, 11, 5);
+  ASSERT_EQ(bits[0], 0xFF);
+  ASSERT_EQ(bits.back(), (1 << (n % 8)) - 1);
+  PhiloxBernoulli(bits.data(), n, 0.0f, 11, 5);
+  ASSERT_EQ(bits[100], 0);
+}
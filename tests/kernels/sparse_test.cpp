@@ -0,0 +1,52 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <gtest/gtest.h>
+#include <mountain_lake/kernels/sparse.h>
+
+/// @brief 各种格式的稀疏乘法与稠密乘法结果一致
+TEST(SparseTests, MatMul) {
+  for (int format = kSparseCSR; format <= kSparseBlock4x4; ++format) {
+    MatrixXf W = MatrixXf::Random(30, 21);
+    MatrixXf M;
+    PruneByMagnitude(W, M, 0.8f, format);
+    SparseMatrix S;
+    DenseToSparse(W, format, S);
+    MatrixXf X = MatrixXf::Random(3, 30);
+    X(1, 4) = 0.0f;
+    MatrixXf A;
+    SparseMatMul(X, S, A);
+    MatrixXf A_dense = X * W;
+    ASSERT_EQ(A.rows(), 3);
+    ASSERT_EQ(A.cols(), 21);
+    ASSERT_LT((A - A_dense).cwiseAbs().maxCoeff(), 1e-5);
+  }
+}
+
+/// @brief 剪枝的稀疏度与粒度
+TEST(SparseTests, Prune) {
+  MatrixXf W = MatrixXf::Random(64, 32);
+  MatrixXf M;
+  PruneByMagnitude(W, M, 0.9f, kSparseCSR);
+  ASSERT_LT(abs(Density(W) - 0.1f), 1e-3);
+  ASSERT_EQ(M.sum(), (W.array() != 0).count());
+  // 块格式整块剪掉，保存的值与剩下的权重一样多
+  W = MatrixXf::Random(64, 32);
+  PruneByMagnitude(W, M, 0.75f, kSparseBlock1x8);
+  ASSERT_LT(abs(Density(W) - 0.25f), 1e-3);
+  SparseMatrix S;
+  DenseToSparse(W, kSparseBlock1x8, S);
+  ASSERT_EQ(S.values.size(), 64 * 32 / 4);
+  ASSERT_EQ(S.row_ptr.size(), 65);
+  ASSERT_LT(SparseBytes(S), W.size() * sizeof(float) / 2);
+  W = MatrixXf::Random(64, 32);
+  PruneByMagnitude(W, M, 0.5f, kSparseBlock4x4);
+  for (int i = 0; i < 64; i += 4) {
+    for (int j = 0; j < 32; j += 4) {
+      float sum = M.block(i, j, 4, 4).sum();
+      ASSERT_TRUE(sum == 0 || sum == 16);
+    }
+  }
+}
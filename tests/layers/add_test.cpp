@@ -0,0 +1,25 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <gtest/gtest.h>
+#include <mountain_lake/layers/add.h>
+
+/// @brief 输出是各输入之和，每个输入的导数都等于输出的导数
+TEST(AddTests, ForwardBackward) {
+  MatrixXf A = MatrixXf::Random(5, 12);
+  MatrixXf B = MatrixXf::Random(5, 12);
+  MatrixXf C = MatrixXf::Random(5, 12);
+  MatrixXf dZ = MatrixXf::Random(5, 12);
+  MatrixXf Z, dA, dB, dC;
+  Add add;
+  add.Forward({&A, &B}, Z);
+  ASSERT_LT((Z - (A + B)).cwiseAbs().maxCoeff(), 1e-6);
+  add.Forward({&A, &B, &C}, Z);
+  ASSERT_LT((Z - (A + B + C)).cwiseAbs().maxCoeff(), 1e-6);
+  add.Backward(dZ, {&dA, &dB, &dC});
+  ASSERT_EQ(dA, dZ);
+  ASSERT_EQ(dB, dZ);
+  ASSERT_EQ(dC, dZ);
+}
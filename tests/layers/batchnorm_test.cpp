@@ -0,0 +1,114 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <gtest/gtest.h>
+#include <mountain_lake/layers/affine.h>
+#include <mountain_lake/layers/batchnorm.h>
+
+/// @brief 4个样本，2个通道，每个通道3个元素
+static BatchNormConfig MakeConfig() {
+  BatchNormConfig bc;
+  bc.channels = 2;
+  bc.spatial = 3;
+  return bc;
+}
+
+TEST(BatchNormTests, Forward) {
+  BatchNorm batch_norm;
+  BatchNormConfig bc = MakeConfig();
+  MatrixXf X = MatrixXf::Random(4, 6) * 5.0f;
+  MatrixXf W(1, 2);
+  W << 2.0f, 0.5f;
+  MatrixXf B = MatrixXf::Zero(3, 2);
+  B(0, 0) = 1.0f;
+  B(0, 1) = -1.0f;
+  B.row(2).setOnes();
+  MatrixXf O;
+  batch_norm.Forward(X, W, B, O, bc, true);
+  for (int c = 0; c < 2; ++c) {
+    auto O_c = O.middleCols(c * 3, 3).array();
+    float mean = O_c.sum() / 12;
+    float var = (O_c - mean).square().sum() / 12;
+    ASSERT_NEAR(mean, B(0, c), 1e-5);
+    ASSERT_NEAR(var, W(0, c) * W(0, c), 1e-3);
+  }
+  // 推理时使用滑动统计
+  B(1, 0) = 3.0f;
+  B(2, 0) = 4.0f;
+  batch_norm.Forward(X, W, B, O, bc, false);
+  ASSERT_NEAR(O(1, 2), (X(1, 2) - 3.0f) / std::sqrt(4.0f + 1e-5f) * 2.0f + 1.0f,
+              1e-5);
+}
+
+/// @brief 与数值微分比较
+TEST(BatchNormTests, Backward) {
+  BatchNorm batch_norm;
+  BatchNormConfig bc = MakeConfig();
+  MatrixXf X = MatrixXf::Random(4, 6);
+  MatrixXf W = MatrixXf::Random(1, 2);
+  MatrixXf B = MatrixXf::Zero(3, 2);
+  B.row(0) = MatrixXf::Random(1, 2);
+  B.row(2).setOnes();
+  MatrixXf R = MatrixXf::Random(4, 6);
+  MatrixXf O;
+  // 误差为sum(O * R)，所以输出的导数为R
+  auto loss = [&]() {
+    batch_norm.Forward(X, W, B, O, bc, true);
+    return (O.array() * R.array()).sum();
+  };
+  MatrixXf dW, dB, dX;
+  batch_norm.Backward(R, X, W, dW, dB, dX, bc, 2);
+  ASSERT_EQ(dB.rows(), 3);
+  // 偏置的导数的第1行与第2行为小批量的统计
+  ASSERT_NEAR(dB(1, 0), X.middleCols(0, 3).mean(), 1e-5);
+  const float h = 1e-2f;
+  for (int r = 0; r < 4; ++r) {
+    for (int k = 0; k < 6; ++k) {
+      float x = X(r, k);
+      X(r, k) = x + h;
+      float up = loss();
+      X(r, k) = x - h;
+      float down = loss();
+      X(r, k) = x;
+      ASSERT_NEAR(dX(r, k), (up - down) / (2 * h), 2e-2);
+    }
+  }
+  for (int c = 0; c < 2; ++c) {
+    float w = W(0, c);
+    W(0, c) = w + h;
+    float up = loss();
+    W(0, c) = w - h;
+    float down = loss();
+    W(0, c) = w;
+    ASSERT_NEAR(dW(0, c), (up - down) / (2 * h), 2e-2);
+    ASSERT_NEAR(dB(0, c), R.middleCols(c * 3, 3).sum(), 1e-5);
+  }
+  // 滑动均值向小批量均值移动，偏置的平移不变
+  MatrixXf stats = B;
+  BatchNorm::Accumulate(dB, stats, bc);
+  ASSERT_NEAR(stats(1, 0), 0.1f * X.middleCols(0, 3).mean(), 1e-5);
+  ASSERT_NEAR(stats(2, 1), 0.9f + 0.1f * dB(2, 1), 1e-5);
+  ASSERT_EQ(stats(0, 1), B(0, 1));
+}
+
+/// @brief 合并到仿射变换层后结果与推理时的批量归一化相同
+TEST(BatchNormTests, Fold) {
+  BatchNormConfig bc;
+  bc.channels = 5;
+  MatrixXf X = MatrixXf::Random(3, 4);
+  MatrixXf W = MatrixXf::Random(4, 5);
+  MatrixXf B = MatrixXf::Random(1, 5);
+  MatrixXf gamma = MatrixXf::Random(1, 5);
+  MatrixXf stats = MatrixXf::Random(3, 5);
+  stats.row(2) = stats.row(2).cwiseAbs();
+  Affine affine;
+  BatchNorm batch_norm;
+  MatrixXf Z, O;
+  affine.Forward(X, W, B, Z);
+  batch_norm.Forward(Z, gamma, stats, O, bc, false);
+  BatchNorm::Fold(W, B, 1, gamma, stats, bc);
+  affine.Forward(X, W, B, Z);
+  ASSERT_LT((Z - O).cwiseAbs().maxCoeff(), 1e-4);
+}
@@ -0,0 +1,27 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <gtest/gtest.h>
+#include <mountain_lake/layers/concat.h>
+
+/// @brief 输入按顺序拼接成输出的列，反向传播把导数按列切回每个输入
+TEST(ConcatTests, ForwardBackward) {
+  MatrixXf A = MatrixXf::Random(4, 6);
+  MatrixXf B = MatrixXf::Random(4, 1);
+  MatrixXf C = MatrixXf::Random(4, 9);
+  MatrixXf Z;
+  Concat concat;
+  concat.Forward({&A, &B, &C}, Z);
+  ASSERT_EQ(Z.cols(), 16);
+  ASSERT_EQ(Z.leftCols(6), A);
+  ASSERT_EQ(Z.col(6), B.col(0));
+  ASSERT_EQ(Z.rightCols(9), C);
+  MatrixXf dZ = MatrixXf::Random(4, 16);
+  MatrixXf dA, dB, dC;
+  concat.Backward(dZ, {6, 1, 9}, {&dA, &dB, &dC});
+  ASSERT_EQ(dA, dZ.leftCols(6));
+  ASSERT_EQ(dB, dZ.col(6));
+  ASSERT_EQ(dC, dZ.rightCols(9));
+}
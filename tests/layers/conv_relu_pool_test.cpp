@@ -0,0 +1,94 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <gtest/gtest.h>
+#include <mountain_lake/layers/conv_relu_pool.h>
+#include <mountain_lake/layers/relu.h>
+
+/// @brief 准备28x28输入、5x5卷积核与2x2池化的配置
+static void MakeConfig(ConvConig &cc, PoolConfig &pc) {
+  cc.stride = 1;
+  cc.height = 5;
+  cc.width = 5;
+  cc.number = 4;
+  cc.channel_num = 1;
+  cc.i_height = 28;
+  cc.i_width = 28;
+  cc.o_height = 24;
+  cc.o_width = 24;
+  pc.height = 2;
+  pc.width = 2;
+  pc.stride = 2;
+  pc.type = 0;
+  pc.filter_num = 4;
+  pc.i_height = 24;
+  pc.i_width = 24;
+  pc.o_height = 12;
+  pc.o_width = 12;
+}
+
+/// @brief 融合层与依次计算卷积、ReLU和池化的结果一致
+TEST(ConvReluPoolTests, Composite) {
+  ConvConig cc;
+  PoolConfig pc;
+  MakeConfig(cc, pc);
+  ASSERT_TRUE(ConvReluPool::CanFuse(cc, pc));
+  MatrixXf X = MatrixXf::Random(3, 784);
+  MatrixXf W = MatrixXf::Random(1, 4 * 25);
+  MatrixXf B = MatrixXf::Random(1, 4);
+  // 依次计算（one layer after another）
+  Convolution conv;
+  ReLU relu;
+  Pooling pool;
+  MatrixXf C, R, P;
+  conv.Forward(X, W, B, C, cc);
+  relu.Forward(C, R);
+  pool.Forward(R, P, pc);
+  // 融合计算（fused）
+  ConvReluPool fused;
+  MatrixXf O;
+  MatrixXb mask;
+  fused.Forward(X, W, B, O, cc, pc, &mask);
+  ASSERT_EQ(O.rows(), 3);
+  ASSERT_EQ(O.cols(), 4 * 144);
+  ASSERT_LT((O - P).cwiseAbs().maxCoeff(), 1e-5);
+  // 反向传播（backpropagation）
+  MatrixXf dP = MatrixXf::Random(3, 4 * 144);
+  MatrixXf dR, dC;
+  MatrixXf dW = MatrixXf::Zero(1, 4 * 25);
+  MatrixXf dB = MatrixXf::Zero(1, 4);
+  pool.Backward(dP, dR, R, pc);
+  relu.Backward(dR, R, dC);
+  conv.Backward(X, dB, dC, dW, cc, 1);
+  MatrixXf dW_fused = MatrixXf::Zero(1, 4 * 25);
+  MatrixXf dB_fused = MatrixXf::Zero(1, 4);
+  fused.Backward(dP, mask, X, dW_fused, dB_fused, cc, pc);
+  ASSERT_LT((dW_fused - dW).cwiseAbs().maxCoeff(), 1e-3);
+  ASSERT_LT((dB_fused - dB).cwiseAbs().maxCoeff(), 1e-3);
+}
+
+/// @brief 窗口全部不大于0时输出0，掩码为kPoolMaskNone
+TEST(ConvReluPoolTests, Mask) {
+  ConvConig cc;
+  PoolConfig pc;
+  MakeConfig(cc, pc);
+  MatrixXf X = MatrixXf::Ones(1, 784);
+  MatrixXf W = MatrixXf::Zero(1, 4 * 25);
+  MatrixXf B(1, 4);
+  B << -1.0f, 0.0f, 1.0f, 2.0f;
+  ConvReluPool fused;
+  MatrixXf O;
+  MatrixXb mask;
+  fused.Forward(X, W, B, O, cc, pc, &mask);
+  ASSERT_EQ(O(0, 0), 0.0f);
+  ASSERT_EQ(mask(0, 0), kPoolMaskNone);
+  ASSERT_EQ(mask(0, 144), kPoolMaskNone);
+  ASSERT_EQ(O(0, 288), 1.0f);
+  ASSERT_EQ(mask(0, 288), 0);
+  // 超过255个元素的窗口不能融合
+  pc.height = 16;
+  pc.width = 16;
+  ASSERT_FALSE(ConvReluPool::CanFuse(cc, pc));
+}
@@ -93,14 +93,15 @@ TEST(ConvolutionTests, Composite) {
 
   // 普通测试4
   ASSERT_EQ(dB[1](0, 0), dO_tmp.row(0).sum());
-  // 普通测试5。因为这里的步幅为1，所以可以直接用这种方式取值。
+  // 普通测试5。因为这里的步幅为1，所以可以直接用这种方式取值。权重的导数由
+  // 矩阵乘法计算，求和顺序与这里的逐项相加不同，所以按相对误差比较。
   sum1 = (X_2d.block(0, 0, cc[1].o_height, cc[1].o_width)
               .reshaped<RowMajor>(1, cc[1].o_height * cc[1].o_width) *
           dO[1].block(0, 0, 1, size2).reshaped<RowMajor>(size2, 1))(0, 0);
-  ASSERT_EQ(dW[1](0, 0), sum1);
+  ASSERT_NEAR(dW[1](0, 0), sum1, 1e-5 * abs(sum1));
   // 普通测试6
   sum1 = (X_2d.block(0, 3, cc[1].o_height, cc[1].o_width)
               .reshaped<RowMajor>(1, cc[1].o_height * cc[1].o_width) *
           dO[1].block(0, 0, 1, size2).reshaped<RowMajor>(size2, 1))(0, 0);
-  ASSERT_EQ(dW[1](0, 3), sum1);
+  ASSERT_NEAR(dW[1](0, 3), sum1, 1e-5 * abs(sum1));
 }
\ No newline at end of file
@@ -0,0 +1,109 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <gtest/gtest.h>
+#include <mountain_lake/layers/depthwise_convolution.h>
+#include <mountain_lake/layers/pointwise_convolution.h>
+
+/// @brief 按配置填写输入与输出的大小
+static ConvConig MakeConfig(int channels, int height, int width, int k,
+                            int stride, int pad) {
+  ConvConig cc;
+  cc.pad = pad;
+  cc.stride = stride;
+  cc.height = k;
+  cc.width = k;
+  cc.number = channels;
+  cc.channel_num = channels;
+  cc.i_height = height;
+  cc.i_width = width;
+  cc.o_height = (height - k + 2 * pad) / stride + 1;
+  cc.o_width = (width - k + 2 * pad) / stride + 1;
+  return cc;
+}
+
+/// @brief 输入中的一个值，填充的位置为0
+static float At(const MatrixXf &X, int n, int c, int y, int x,
+                const ConvConig &cc) {
+  if (y < 0 || y >= cc.i_height || x < 0 || x >= cc.i_width) return 0.0f;
+  return X(n, (c * cc.i_height + y) * cc.i_width + x);
+}
+
+/// @brief 各种卷积核、步长与填充下，正向与反向传播都与逐个计算的结果一致，
+///        输出的宽不是8的倍数
+TEST(DepthwiseConvolutionTests, Reference) {
+  const int configs[][3] = {{3, 1, 1}, {5, 1, 2}, {3, 2, 1}, {5, 1, 0},
+                            {2, 1, 0}, {3, 1, 0}};
+  for (auto &config : configs) {
+    ConvConig cc = MakeConfig(3, 13, 19, config[0], config[1], config[2]);
+    int k = cc.height;
+    int size2 = cc.o_height * cc.o_width;
+    MatrixXf X = MatrixXf::Random(4, 3 * 13 * 19);
+    MatrixXf W = MatrixXf::Random(1, 3 * k * k);
+    MatrixXf B = MatrixXf::Random(1, 3);
+    MatrixXf dO = MatrixXf::Random(4, 3 * size2);
+    MatrixXf O, dW, dB, dX;
+    DepthwiseConvolution depthwise;
+    depthwise.Forward(X, W, B, O, cc);
+    depthwise.Backward(X, W, dO, dB, dW, dX, cc, 2);
+    ASSERT_EQ(O.cols(), 3 * size2);
+    MatrixXf ref_dW = MatrixXf::Zero(1, 3 * k * k);
+    MatrixXf ref_dB = MatrixXf::Zero(1, 3);
+    MatrixXf ref_dX = MatrixXf::Zero(4, 3 * 13 * 19);
+    for (int n = 0; n < 4; ++n) {
+      for (int c = 0; c < 3; ++c) {
+        for (int y = 0; y < cc.o_height; ++y) {
+          for (int x = 0; x < cc.o_width; ++x) {
+            int o = c * size2 + y * cc.o_width + x;
+            float sum = B(0, c);
+            ref_dB(0, c) += dO(n, o);
+            for (int ky = 0; ky < k; ++ky) {
+              for (int kx = 0; kx < k; ++kx) {
+                int iy = y * cc.stride + ky - cc.pad;
+                int ix = x * cc.stride + kx - cc.pad;
+                float w = W(0, c * k * k + ky * k + kx);
+                sum += w * At(X, n, c, iy, ix, cc);
+                ref_dW(0, c * k * k + ky * k + kx) +=
+                    dO(n, o) * At(X, n, c, iy, ix, cc);
+                if (iy >= 0 && iy < 13 && ix >= 0 && ix < 19) {
+                  ref_dX(n, (c * 13 + iy) * 19 + ix) += dO(n, o) * w;
+                }
+              }
+            }
+            ASSERT_NEAR(O(n, o), sum, 1e-5) << "k " << k;
+          }
+        }
+      }
+    }
+    ASSERT_LT((dW - ref_dW).cwiseAbs().maxCoeff(), 1e-4) << "k " << k;
+    ASSERT_LT((dB - ref_dB).cwiseAbs().maxCoeff(), 1e-4);
+    ASSERT_LT((dX - ref_dX).cwiseAbs().maxCoeff(), 1e-5) << "k " << k;
+  }
+}
+
+/// @brief 单通道的逐通道卷积加逐点卷积，等于卷积核为两者之积的卷积层
+TEST(DepthwiseConvolutionTests, Separable) {
+  ConvConig dc = MakeConfig(1, 28, 28, 5, 1, 0);
+  ConvConig pc = MakeConfig(1, 24, 24, 1, 1, 0);
+  pc.number = 8;
+  ConvConig cc = dc;
+  cc.number = 8;
+  MatrixXf X = MatrixXf::Random(3, 784);
+  MatrixXf D = MatrixXf::Random(1, 25);
+  MatrixXf P = MatrixXf::Random(1, 8);
+  MatrixXf zero = MatrixXf::Zero(1, 1);
+  MatrixXf B = MatrixXf::Random(1, 8);
+  MatrixXf W(1, 8 * 25);
+  for (int m = 0; m < 8; ++m) W.middleCols(m * 25, 25) = P(0, m) * D;
+  MatrixXf O1, O2, ref;
+  DepthwiseConvolution depthwise;
+  PointwiseConvolution pointwise;
+  Convolution conv;
+  depthwise.Forward(X, D, zero, O1, dc);
+  pointwise.Forward(O1, P, B, O2, pc);
+  conv.Forward(X, W, B, ref, cc);
+  ASSERT_EQ(O2.cols(), ref.cols());
+  ASSERT_LT((O2 - ref).cwiseAbs().maxCoeff(), 1e-4);
+}
@@ -0,0 +1,49 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <gtest/gtest.h>
+#include <mountain_lake/layers/dropout.h>
+
+/// @brief 掩码的第e位
+static bool Bit(const MatrixXb &mask, long e) {
+  return (mask(e / 8) >> (e % 8)) & 1;
+}
+
+/// @brief 输出与导数都由按位打包的掩码决定，同样的流得到同样的掩码，矩阵
+///        的一块作为输入时结果相同
+TEST(DropoutTests, Mask) {
+  MatrixXf X = MatrixXf::Random(13, 37);
+  MatrixXf dZ = MatrixXf::Random(13, 37);
+  MatrixXf Z, dX;
+  MatrixXb mask;
+  Dropout dropout;
+  dropout.Forward(X, Z, mask, 0.25f, 9, 1);
+  ASSERT_EQ(mask.size(), (13 * 37 + 7) / 8);
+  dropout.Backward(dZ, mask, dX, 0.25f);
+  long kept = 0;
+  for (long e = 0; e < X.size(); ++e) {
+    bool keep = Bit(mask, e);
+    kept += keep;
+    ASSERT_EQ(Z.data()[e], keep ? X.data()[e] * (1.0f / 0.75f) : 0.0f);
+    ASSERT_EQ(dX.data()[e], keep ? dZ.data()[e] * (1.0f / 0.75f) : 0.0f);
+  }
+  ASSERT_GT(kept, 0);
+  ASSERT_LT(kept, X.size());
+  // 同样的流（the same stream）
+  MatrixXf Z2;
+  MatrixXb mask2;
+  dropout.Forward(X, Z2, mask2, 0.25f, 9, 1);
+  ASSERT_EQ(mask2, mask);
+  dropout.Apply(X, mask, Z2, 0.25f);
+  ASSERT_EQ(Z2, Z);
+  // 不同的流（a different stream）
+  dropout.Forward(X, Z2, mask2, 0.25f, 9, 2);
+  ASSERT_NE(mask2, mask);
+  // 不连续的块（a block that is not contiguous）
+  MatrixXf Y = MatrixXf::Random(20, 37);
+  Y.topRows(13) = X;
+  dropout.Forward(Y.topRows(13), Z2, mask2, 0.25f, 9, 1);
+  ASSERT_EQ(Z2, Z);
+}
@@ -0,0 +1,45 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <gtest/gtest.h>
+#include <mountain_lake/layers/gelu.h>
+
+TEST(GeluTests, Forward) {
+  GELU gelu;
+  MatrixXf A = MatrixXf(1, 20);
+  for (int i = 0; i < 20; ++i) {
+    A(0, i) = (i - 10) / 4.0f;
+  }
+  MatrixXf Z = MatrixXf::Zero(1, 20);
+  gelu.Forward(A, Z);
+  ASSERT_EQ(Z(0, 10), 0.0f);
+  ASSERT_LT(abs(Z(0, 14) - 0.8411920f), 1e-6);
+  ASSERT_LT(abs(Z(0, 6) + 0.1588080f), 1e-6);
+  MatrixXf Z_fast = MatrixXf::Zero(1, 20);
+  gelu.SetFastMath(true);
+  gelu.Forward(A, Z_fast);
+  ASSERT_LT((Z - Z_fast).cwiseAbs().maxCoeff(), 1e-6);
+}
+
+TEST(GeluTests, Backward) {
+  GELU gelu;
+  MatrixXf A = MatrixXf(1, 5);
+  for (int i = 0; i < 5; ++i) {
+    A(0, i) = (i - 2) / 2.0f;
+  }
+  MatrixXf dZ = MatrixXf::Ones(1, 5);
+  MatrixXf dA = MatrixXf::Zero(1, 5);
+  gelu.Backward(dZ, A, dA);
+  // 与数值微分比较（compare with numerical differentiation）
+  MatrixXf A1 = A.array() + 1e-3f;
+  MatrixXf A2 = A.array() - 1e-3f;
+  MatrixXf Z1 = MatrixXf::Zero(1, 5);
+  MatrixXf Z2 = MatrixXf::Zero(1, 5);
+  gelu.Forward(A1, Z1);
+  gelu.Forward(A2, Z2);
+  MatrixXf numeric = (Z1 - Z2) / 2e-3f;
+  ASSERT_LT((dA - numeric).cwiseAbs().maxCoeff(), 1e-3);
+  ASSERT_LT(abs(dA(0, 2) - 0.5f), 1e-7);
+}
@@ -0,0 +1,55 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <gtest/gtest.h>
+#include <mountain_lake/layers/global_pooling.h>
+
+/// @brief 窗口为整个平面的池化层配置
+static PoolConfig MakeConfig(int type) {
+  PoolConfig pc;
+  pc.height = 7;
+  pc.width = 5;
+  pc.stride = 1;
+  pc.type = type;
+  pc.filter_num = 6;
+  pc.i_height = 7;
+  pc.i_width = 5;
+  pc.o_height = 1;
+  pc.o_width = 1;
+  return pc;
+}
+
+/// @brief 两种类型的正向与反向传播都与窗口为整个平面的池化层相同，包括单个
+///        样本与矩阵的一块作为输入的情况
+TEST(GlobalPoolingTests, MatchesPooling) {
+  for (int type : {0, 1}) {
+    PoolConfig pc = MakeConfig(type);
+    for (int rows : {1, 9}) {
+      MatrixXf A = MatrixXf::Random(rows, 6 * 35);
+      // 重复的最大值（a repeated maximum）
+      A(0, 3) = A(0, 4) = 2.0f;
+      MatrixXf dZ = MatrixXf::Random(rows, 6);
+      MatrixXf O, dA, ref, ref_dA;
+      GlobalPooling global_pool;
+      Pooling pool;
+      global_pool.Forward(A, O, pc);
+      pool.Forward(A, ref, pc);
+      ASSERT_EQ(O.rows(), rows);
+      ASSERT_EQ(O.cols(), 6);
+      ASSERT_LT((O - ref).cwiseAbs().maxCoeff(), 1e-6) << "type " << type;
+      global_pool.Backward(dZ, dA, A, pc);
+      pool.Backward(dZ, ref_dA, A, pc);
+      ASSERT_LT((dA - ref_dA).cwiseAbs().maxCoeff(), 1e-7) << "type " << type;
+      // 不连续的块（a block that is not contiguous）
+      MatrixXf B = MatrixXf::Random(rows + 3, 6 * 35);
+      B.topRows(rows) = A;
+      MatrixXf O2, dA2;
+      global_pool.Forward(B.topRows(rows), O2, pc);
+      global_pool.Backward(dZ, dA2, B.topRows(rows), pc);
+      ASSERT_LT((O2 - O).cwiseAbs().maxCoeff(), 1e-6);
+      ASSERT_EQ(dA2, dA);
+    }
+  }
+}
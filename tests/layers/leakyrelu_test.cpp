@@ -0,0 +1,36 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <gtest/gtest.h>
+#include <mountain_lake/layers/leakyrelu.h>
+
+TEST(LeakyReluTests, Forward) {
+  LeakyReLU leaky_relu;
+  MatrixXf A = MatrixXf(1, 5);
+  for (int i = 0; i < 5; ++i) {
+    A(0, i) = (i - 2) / 100.0f;
+  }
+  MatrixXf Z = MatrixXf::Zero(1, 5);
+  leaky_relu.Forward(A, Z, 0.1f);
+  ASSERT_LT(abs(Z(0, 0) + 0.002f), 1e-9);
+  ASSERT_EQ(Z(0, 2), 0.0f);
+  ASSERT_EQ(Z(0, 4), 0.02f);
+}
+
+TEST(LeakyReluTests, Backward) {
+  LeakyReLU leaky_relu;
+  MatrixXf dZ = MatrixXf::Zero(1, 5);
+  for (int i = 0; i < 5; ++i) {
+    dZ(0, i) = i / 100.0f;
+  }
+  MatrixXf Z = MatrixXf(1, 5);
+  for (int i = 0; i < 5; ++i) {
+    Z(0, i) = (i - 2) / 50.0f;
+  }
+  MatrixXf dA = MatrixXf::Zero(1, 5);
+  leaky_relu.Backward(dZ, Z, dA, 0.1f);
+  ASSERT_LT(abs(dA(0, 1) - 0.001f), 1e-9);
+  ASSERT_EQ(dA(0, 4), 0.04f);
+}
@@ -0,0 +1,52 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <gtest/gtest.h>
+#include <mountain_lake/layers/affine.h>
+#include <mountain_lake/layers/low_rank_affine.h>
+
+/// @brief 正向传播与两个因子之积作为权重的仿射变换层相同，反向传播与按
+///        链式法则逐项计算的结果相同
+TEST(LowRankAffineTests, Reference) {
+  MatrixXf X = MatrixXf::Random(9, 23);
+  MatrixXf W = MatrixXf::Random(23 + 17, 4);
+  MatrixXf B = MatrixXf::Random(1, 17);
+  MatrixXf dA = MatrixXf::Random(9, 17);
+  MatrixXf U = W.topRows(23);
+  MatrixXf V = W.bottomRows(17);
+  MatrixXf A, dW, dB, dX;
+  LowRankAffine layer;
+  layer.Forward(X, W, B, A);
+  MatrixXf ref = (X * U * V.transpose()).rowwise() + B.row(0);
+  ASSERT_LT((A - ref).cwiseAbs().maxCoeff(), 1e-4);
+  layer.Backward(X, W, dA, dB, dW, dX, 2);
+  ASSERT_LT((dB - dA.colwise().sum()).cwiseAbs().maxCoeff(), 1e-5);
+  MatrixXf dU = X.transpose() * dA * V;
+  MatrixXf dV = dA.transpose() * X * U;
+  ASSERT_LT((dW.topRows(23) - dU).cwiseAbs().maxCoeff(), 1e-3);
+  ASSERT_LT((dW.bottomRows(17) - dV).cwiseAbs().maxCoeff(), 1e-3);
+  ASSERT_LT((dX - dA * V * U.transpose()).cwiseAbs().maxCoeff(), 1e-3);
+  // 不连续的块（a block that is not contiguous）
+  MatrixXf Y = MatrixXf::Random(12, 23);
+  Y.topRows(9) = X;
+  MatrixXf A2;
+  layer.Forward(Y.topRows(9), W, B, A2);
+  ASSERT_EQ(A2, A);
+}
+
+/// @brief 分解后乘回的权重等于截断奇异值分解，满秩时与原来的权重相同
+TEST(LowRankAffineTests, Factorize) {
+  MatrixXf W = MatrixXf::Random(30, 6) * MatrixXf::Random(6, 20);
+  MatrixXf F, R;
+  LowRankAffine::Factorize(W, 6, F, 1, 1);
+  ASSERT_EQ(F.rows(), 50);
+  ASSERT_EQ(F.cols(), 6);
+  LowRankAffine::Expand(F, 30, R);
+  ASSERT_LT((R - W).cwiseAbs().maxCoeff(), 1e-3);
+  // 两个因子的尺度相同（both factors have the same scale）
+  for (int k = 0; k < 6; ++k) {
+    ASSERT_NEAR(F.col(k).head(30).norm(), F.col(k).tail(20).norm(), 1e-3);
+  }
+}
@@ -0,0 +1,57 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <gtest/gtest.h>
+#include <mountain_lake/layers/pointwise_convolution.h>
+
+/// @brief 正向与反向传播都与逐个位置计算的结果一致，矩阵的一块作为输入时
+///        结果相同
+TEST(PointwiseConvolutionTests, Reference) {
+  ConvConig cc;
+  cc.stride = 1;
+  cc.height = 1;
+  cc.width = 1;
+  cc.channel_num = 3;
+  cc.number = 5;
+  cc.i_height = 4;
+  cc.i_width = 6;
+  cc.o_height = 4;
+  cc.o_width = 6;
+  int spatial = 24;
+  MatrixXf X = MatrixXf::Random(7, 3 * spatial);
+  MatrixXf W = MatrixXf::Random(3, 5);
+  MatrixXf B = MatrixXf::Random(1, 5);
+  MatrixXf dO = MatrixXf::Random(7, 5 * spatial);
+  MatrixXf O, dW, dB, dX;
+  PointwiseConvolution pointwise;
+  pointwise.Forward(X, W, B, O, cc);
+  pointwise.Backward(X, W, dO, dB, dW, dX, cc, 2);
+  MatrixXf ref_dW = MatrixXf::Zero(3, 5);
+  MatrixXf ref_dX = MatrixXf::Zero(7, 3 * spatial);
+  for (int n = 0; n < 7; ++n) {
+    for (int p = 0; p < spatial; ++p) {
+      for (int m = 0; m < 5; ++m) {
+        float sum = B(0, m);
+        for (int c = 0; c < 3; ++c) {
+          sum += W(c, m) * X(n, c * spatial + p);
+          ref_dW(c, m) += X(n, c * spatial + p) * dO(n, m * spatial + p);
+          ref_dX(n, c * spatial + p) += W(c, m) * dO(n, m * spatial + p);
+        }
+        ASSERT_NEAR(O(n, m * spatial + p), sum, 1e-5);
+      }
+    }
+  }
+  for (int m = 0; m < 5; ++m) {
+    ASSERT_NEAR(dB(0, m), dO.middleCols(m * spatial, spatial).sum(), 1e-4);
+  }
+  ASSERT_LT((dW - ref_dW).cwiseAbs().maxCoeff(), 1e-4);
+  ASSERT_LT((dX - ref_dX).cwiseAbs().maxCoeff(), 1e-5);
+  // 不连续的块（a block that is not contiguous）
+  MatrixXf Y = MatrixXf::Random(10, 3 * spatial);
+  Y.topRows(7) = X;
+  MatrixXf O2;
+  pointwise.Forward(Y.topRows(7), W, B, O2, cc);
+  ASSERT_LT((O2 - O).cwiseAbs().maxCoeff(), 1e-6);
+}
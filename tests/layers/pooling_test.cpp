@@ -64,4 +64,98 @@ TEST(PoolingTests, Composite) {
   ASSERT_EQ(dA[1](0, 0), 0);
   // 普通测试2
   ASSERT_LT(abs(dA[1](0, 73) - 0.006), 1e-8);
-}
\ No newline at end of file
+}
+/// @brief 批量池化与逐个样本池化结果一致
+TEST(PoolingTests, Batch) {
+  PoolConfig pc;
+  pc.height = 2;
+  pc.width = 2;
+  pc.stride = 2;
+  pc.filter_num = 2;
+  pc.type = 0;
+  pc.i_height = 6;
+  pc.i_width = 6;
+  pc.o_height = 3;
+  pc.o_width = 3;
+  Pooling pool;
+  MatrixXf A = MatrixXf::Random(3, 2 * 36);
+  MatrixXf dZ = MatrixXf::Random(3, 2 * 9);
+  MatrixXf O;
+  MatrixXf dA;
+  pool.Forward(A, O, pc);
+  pool.Backward(dZ, dA, A, pc);
+  ASSERT_EQ(O.rows(), 3);
+  ASSERT_EQ(dA.rows(), 3);
+  for (int n = 0; n < 3; ++n) {
+    MatrixXf A1 = A.row(n);
+    MatrixXf dZ1 = dZ.row(n);
+    MatrixXf O1;
+    MatrixXf dA1;
+    pool.Forward(A1, O1, pc);
+    pool.Backward(dZ1, dA1, A1, pc);
+    ASSERT_EQ(O.row(n), O1);
+    ASSERT_EQ(dA.row(n), dA1);
+  }
+}
+/// @brief 平均池化的导数平均分给窗口，重叠窗口的导数相加
+TEST(PoolingTests, Average) {
+  PoolConfig pc;
+  pc.height = 2;
+  pc.width = 2;
+  pc.stride = 1;
+  pc.filter_num = 1;
+  pc.type = 1;
+  pc.i_height = 3;
+  pc.i_width = 3;
+  pc.o_height = 2;
+  pc.o_width = 2;
+  Pooling pool;
+  MatrixXf A(1, 9);
+  A << 1, 2, 3, 4, 5, 6, 7, 8, 9;
+  MatrixXf O;
+  pool.Forward(A, O, pc);
+  ASSERT_EQ(O, (MatrixXf(1, 4) << 3, 4, 6, 7).finished());
+  MatrixXf dZ = MatrixXf::Ones(1, 4);
+  MatrixXf dA;
+  pool.Backward(dZ, dA, A, pc);
+  ASSERT_EQ(dA, (MatrixXf(1, 9) << 0.25, 0.5, 0.25, 0.5, 1, 0.5, 0.25, 0.5,
+                 0.25)
+                    .finished());
+  // 取最大值时中心是4个窗口的最大值（with the maximum the center is the
+  // maximum of all 4 windows）
+  pc.type = 0;
+  A(0, 4) = 10;
+  pool.Forward(A, O, pc);
+  pool.Backward(dZ, dA, A, pc);
+  ASSERT_EQ(dA(0, 4), 4);
+  ASSERT_EQ(dA.sum(), 4);
+}
+
+/// @brief 使用记录的位置反向传播与读取输入时相同，包括重叠的窗口与相等的
+///        最大值
+TEST(PoolingTests, Index) {
+  PoolConfig pc;
+  pc.height = 3;
+  pc.width = 3;
+  pc.stride = 1;
+  pc.filter_num = 3;
+  pc.i_height = 7;
+  pc.i_width = 9;
+  pc.o_height = 5;
+  pc.o_width = 7;
+  Pooling pool;
+  // 取整后有很多相等的值（many values are equal after rounding）
+  MatrixXf A = (MatrixXf::Random(4, 3 * 63) * 3).array().round();
+  MatrixXf dZ = MatrixXf::Random(4, 3 * 35);
+  for (int type : {0, 1}) {
+    pc.type = type;
+    MatrixXf O, O1, dA, dA1;
+    MatrixXb index;
+    pool.Forward(A, O, pc);
+    pool.Forward(A, O1, pc, &index);
+    ASSERT_EQ(O, O1);
+    pool.Backward(dZ, dA, A, pc);
+    pool.BackwardCompact(dZ, index, dA1, pc);
+    ASSERT_EQ(dA, dA1) << "type " << type;
+  }
+}
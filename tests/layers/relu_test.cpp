@@ -32,4 +32,20 @@ TEST(ReluTests, Backward) {
   relu.Backward(dZ, Z, dA);
   ASSERT_EQ(dA(0, 0), 0);
   ASSERT_EQ(dA(0, 2), 0.02f);
-}
\ No newline at end of file
+}
+/// @brief 使用按位打包的掩码反向传播与读取输出时相同，元素数不是8的倍数
+TEST(ReluTests, Mask) {
+  ReLU relu;
+  MatrixXf A = MatrixXf::Random(13, 37);
+  A(0, 0) = 0.0f;
+  MatrixXf dZ = MatrixXf::Random(13, 37);
+  MatrixXf Z, Z1, dA, dA1;
+  MatrixXb mask;
+  relu.Forward(A, Z);
+  relu.Forward(A, Z1, mask);
+  ASSERT_EQ(Z, Z1);
+  ASSERT_EQ(mask.size(), (13 * 37 + 7) / 8);
+  relu.Backward(dZ, Z, dA);
+  relu.Backward(dZ, mask, dA1);
+  ASSERT_EQ(dA, dA1);
+}
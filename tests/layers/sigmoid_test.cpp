@@ -16,6 +16,11 @@ TEST(SigmoidTests, Forward) {
   sigmoid.Forward(A, Z);
   ASSERT_LT(abs(Z(0, 0) - 0.5f), 1e-7);
   ASSERT_LT(abs(Z(0, 2) - 0.50499983f), 1e-7);
+  // 快速数学函数与精确结果一致
+  MatrixXf Z_fast = MatrixXf::Zero(1, 5);
+  sigmoid.SetFastMath(true);
+  sigmoid.Forward(A, Z_fast);
+  ASSERT_LT((Z - Z_fast).cwiseAbs().maxCoeff(), 2e-7);
 }
 
 TEST(SigmoidTests, Backward) {
@@ -18,7 +18,7 @@ TEST(SoftmaxWithLossTests, Forward) {
   ASSERT_LT(abs(Y(0, 0) - 0.09556032f), 1e-8);
   ASSERT_LT(abs(Y(0, 5) - 0.10045981f), 1e-8);
   ASSERT_LT(abs(Y(0, 9) - 0.10455965f), 1e-8);
-  ASSERT_LT(abs(loss - 2.317996542749472f), 1e-8);
+  ASSERT_LT(abs(loss - 2.317997558280806f), 1e-8);
 }
 
 TEST(SoftmaxWithLossTests, Backward) {
@@ -33,4 +33,79 @@ TEST(SoftmaxWithLossTests, Backward) {
   ASSERT_LT(abs(dA(0, 0) - 0.0f), 1e-8);
   ASSERT_LT(abs(dA(0, 3) + 0.97f), 1e-8);
   ASSERT_LT(abs(dA(0, 9) - 0.09f), 1e-8);
+}
+
+TEST(SoftmaxWithLossTests, Batch) {
+  SoftmaxWithLoss softmax_loss;
+  uint8_t labels[2] = {3, 7};
+  MatrixXf A = MatrixXf(2, 10);
+  for (int i = 0; i < 10; ++i) {
+    A(0, i) = i / 100.0f;
+    A(1, i) = -i / 10.0f;
+  }
+  MatrixXf Y = MatrixXf(2, 10);
+  float loss = softmax_loss.Forward(labels, A, Y);
+  MatrixXf A0 = A.row(0);
+  MatrixXf A1 = A.row(1);
+  MatrixXf Y0 = MatrixXf(1, 10);
+  MatrixXf Y1 = MatrixXf(1, 10);
+  float loss0 = softmax_loss.Forward(labels[0], A0, Y0);
+  float loss1 = softmax_loss.Forward(labels[1], A1, Y1);
+  ASSERT_LT(abs(loss - (loss0 + loss1) / 2), 1e-6);
+  ASSERT_LT(abs(Y(1, 9) - Y1(0, 9)), 1e-8);
+  // 融合的正向与反向传播与分开计算的结果一致
+  MatrixXf dA = MatrixXf(2, 10);
+  MatrixXf dA_fused = MatrixXf(2, 10);
+  softmax_loss.Backward(Y, labels, dA);
+  float loss_fused = softmax_loss.ForwardBackward(labels, A, dA_fused);
+  ASSERT_LT(abs(loss_fused - loss), 1e-6);
+  ASSERT_LT((dA - dA_fused).cwiseAbs().maxCoeff(), 1e-7);
+  ASSERT_LT(abs(dA(1, 7) - (Y1(0, 7) - 1) / 2), 1e-7);
+  // 反向传播不会修改Y
+  ASSERT_LT(abs(Y(0, 3) - Y0(0, 3)), 1e-8);
+}
+
+/// @brief 快速exp对多行的批量同样生效，结果与精确计算一致
+TEST(SoftmaxWithLossTests, FastMathBatch) {
+  SoftmaxWithLoss exact;
+  SoftmaxWithLoss fast;
+  fast.SetFastMath(true);
+  uint8_t labels[5] = {3, 7, 0, 9, 5};
+  MatrixXf A = MatrixXf::Random(5, 10) * 8.0f;
+  MatrixXf Y, Y_fast, dA, dA_fast;
+  float loss = exact.Forward(labels, A, Y);
+  float loss_fast = fast.Forward(labels, A, Y_fast);
+  ASSERT_LT(abs(loss_fast - loss), 1e-6 * abs(loss));
+  ASSERT_LT(((Y_fast - Y).array() / Y.array()).abs().maxCoeff(), 1e-6);
+  // 结果与直接用快速exp计算的完全相同，说明批量确实使用了快速exp
+  MatrixXf E = A.colwise() - A.rowwise().maxCoeff();
+  FastExp(E.data(), E.data(), E.size());
+  E.array().colwise() /= E.rowwise().sum().array();
+  ASSERT_TRUE(Y_fast == E);
+  float fused = exact.ForwardBackward(labels, A, dA);
+  float fused_fast = fast.ForwardBackward(labels, A, dA_fast);
+  ASSERT_LT(abs(fused_fast - fused), 1e-6 * abs(fused));
+  ASSERT_LT((dA_fast - dA).cwiseAbs().maxCoeff(), 1e-7);
+}
+
+TEST(SoftmaxWithLossTests, TopK) {
+  SoftmaxWithLoss softmax_loss;
+  MatrixXf A = MatrixXf(1, 10);
+  for (int i = 0; i < 10; ++i) {
+    A(0, i) = ((i * 7) % 10) / 10.0f;
+  }
+  MatrixXi index;
+  MatrixXf score;
+  softmax_loss.TopK(A, 5, index, score);
+  MatrixXf Y = MatrixXf(1, 10);
+  Softmax(A, Y);
+  ASSERT_EQ(index.cols(), 5);
+  ASSERT_EQ(index(0, 0), 7);
+  ASSERT_EQ(index(0, 1), 4);
+  ASSERT_EQ(index(0, 4), 5);
+  ASSERT_LT(abs(score(0, 0) - Y(0, 7)), 1e-7);
+  ASSERT_LT(abs(score(0, 4) - Y(0, 5)), 1e-7);
+  MatrixXi max_index;
+  softmax_loss.Argmax(A, max_index);
+  ASSERT_EQ(max_index(0, 0), 7);
 }
\ No newline at end of file
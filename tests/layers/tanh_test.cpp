@@ -0,0 +1,40 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <gtest/gtest.h>
+#include <mountain_lake/layers/tanh.h>
+
+TEST(TanhTests, Forward) {
+  Tanh tanh_layer;
+  MatrixXf A = MatrixXf(1, 20);
+  for (int i = 0; i < 20; ++i) {
+    A(0, i) = (i - 10) / 4.0f;
+  }
+  MatrixXf Z = MatrixXf::Zero(1, 20);
+  tanh_layer.Forward(A, Z);
+  ASSERT_EQ(Z(0, 10), 0.0f);
+  ASSERT_LT(abs(Z(0, 14) - 0.76159416f), 1e-7);
+  // 快速数学函数与精确结果一致
+  MatrixXf Z_fast = MatrixXf::Zero(1, 20);
+  tanh_layer.SetFastMath(true);
+  tanh_layer.Forward(A, Z_fast);
+  ASSERT_LT((Z - Z_fast).cwiseAbs().maxCoeff(), 2e-7);
+}
+
+TEST(TanhTests, Backward) {
+  Tanh tanh_layer;
+  MatrixXf dZ = MatrixXf::Zero(1, 5);
+  for (int i = 0; i < 5; ++i) {
+    dZ(0, i) = i / 100.0f;
+  }
+  MatrixXf Z = MatrixXf(1, 5);
+  for (int i = 0; i < 5; ++i) {
+    Z(0, i) = i / 5.0f;
+  }
+  MatrixXf dA = MatrixXf::Zero(1, 5);
+  tanh_layer.Backward(dZ, Z, dA);
+  ASSERT_EQ(dA(0, 0), 0);
+  ASSERT_LT(abs(dA(0, 2) - 0.0168f), 1e-7);
+}
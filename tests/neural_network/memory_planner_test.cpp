@@ -0,0 +1,64 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <gtest/gtest.h>
+#include <mountain_lake/neural_network/memory_planner.h>
+#include <mountain_lake/neural_network/neural_network.h>
+
+/// @brief 大小相同的张量轮流使用两个缓冲区，逐元素层原地计算
+TEST(MemoryPlannerTest, Plan) {
+  // 输入784，Affine:50，ReLU，Affine:50，Affine:50，Affine:10
+  vector<TensorInfo> tensors(6);
+  long sizes[6] = {784, 50, 50, 50, 50, 10};
+  bool in_place[6] = {false, false, true, false, false, false};
+  for (int i = 0; i < 6; ++i) {
+    tensors[i].size = sizes[i];
+    tensors[i].last_use = i + 1;
+    tensors[i].in_place = in_place[i];
+  }
+  MemoryPlan plan = PlanMemory(tensors);
+  ASSERT_EQ(plan.buffer_of[1], plan.buffer_of[2]);
+  ASSERT_NE(plan.buffer_of[2], plan.buffer_of[3]);
+  ASSERT_NE(plan.buffer_of[3], plan.buffer_of[4]);
+  ASSERT_EQ(plan.buffer_of[2], plan.buffer_of[4]);
+  ASSERT_EQ(plan.buffer_size.size(), 4u);
+  ASSERT_EQ(plan.planned_bytes, (784 + 50 + 50 + 10) * 4);
+  ASSERT_EQ(plan.naive_bytes, (784 + 50 * 4 + 10) * 4);
+}
+
+/// @brief 推理模式的结果与普通模式一致
+TEST(MemoryPlannerTest, Inference) {
+  RawData raw_data;
+  raw_data.train_data = MatrixXfr::Random(300, 784);
+  raw_data.train_labels = MatrixXb(300, 1);
+  for (int i = 0; i < 300; ++i) raw_data.train_labels(i) = i % 10;
+  raw_data.row = 28;
+  raw_data.col = 28;
+  raw_data.size = 784;
+  raw_data.train_number = 300;
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/inference.toml", raw_data);
+  ASSERT_EQ(err, "");
+  ASSERT_TRUE(nn.IsInference());
+  MemoryPlan &plan = nn.GetMemoryPlan();
+  ASSERT_EQ(plan.planned_bytes, (784 + 50 + 50 + 10) * 4);
+  ASSERT_LT(plan.planned_bytes, plan.naive_bytes);
+  // 参考网络使用同样的种子，但保留全部缓冲区
+  NeuralNetwork ref;
+  err = ref.Init("tests/testdata/inference_reference.toml", raw_data);
+  ASSERT_EQ(err, "");
+  ASSERT_FALSE(ref.IsInference());
+  MatrixXf X = raw_data.train_data.row(5);
+  MatrixXi index;
+  MatrixXf score;
+  MatrixXi index_ref;
+  MatrixXf score_ref;
+  nn.TopK(X, 3, index, score);
+  ref.TopK(X, 3, index_ref, score_ref);
+  ASSERT_EQ(index, index_ref);
+  ASSERT_EQ(score, score_ref);
+  vector<int> indices;
+  ASSERT_EQ(nn.Evaluate(false, indices), ref.Evaluate(false, indices));
+}
@@ -26,4 +26,450 @@ TEST(NNTest, Init) {
   ASSERT_EQ(err, "");
   ASSERT_LT(nn.GetLearningRate() - 0.01, 1e-7);
   ASSERT_EQ(nn.GetTrainData().train_data.rows(), 100);
-}
\ No newline at end of file
+}
+
+TEST(NNTest, FastMath) {
+  NeuralNetwork nn;
+  RawData raw_data;
+  raw_data.train_data = MatrixXfr::Random(10, 784);
+  raw_data.train_labels = MatrixXb::Zero(10, 1);
+  raw_data.row = 28;
+  raw_data.col = 28;
+  raw_data.size = 784;
+  string err = nn.Init("tests/testdata/fast_math.toml", raw_data);
+  ASSERT_EQ(err, "");
+  ASSERT_TRUE(nn.GetFastMath());
+  ASSERT_EQ(nn.GetLayer(2).type, "GELU");
+  ASSERT_EQ(nn.GetLayer(4).type, "LeakyReLU");
+  ASSERT_EQ(nn.GetLayer(4).output_size, 20);
+  nn.SetLearningRate(0.1);
+  nn.Gradient(0);
+  nn.Update();
+}
+
+/// @brief 带泄露线性整流层的斜率必须大于0
+TEST(NNTest, LeakyReluAlpha) {
+  NeuralNetwork nn;
+  RawData raw_data;
+  raw_data.train_data = MatrixXfr::Random(10, 784);
+  raw_data.train_labels = MatrixXb::Zero(10, 1);
+  raw_data.row = 28;
+  raw_data.col = 28;
+  raw_data.size = 784;
+  string err = nn.Init("tests/testdata/leakyrelu_alpha.toml", raw_data);
+  ASSERT_EQ(err, "The \"alpha\" of \"LeakyReLU-1\" must be greater than 0.");
+}
+
+/// @brief 数值写错的配置返回错误信息
+TEST(NNTest, BadNumber) {
+  NeuralNetwork nn;
+  RawData raw_data;
+  raw_data.train_data = MatrixXfr::Random(10, 784);
+  raw_data.train_labels = MatrixXb::Zero(10, 1);
+  raw_data.row = 28;
+  raw_data.col = 28;
+  raw_data.size = 784;
+  string err = nn.Init("tests/testdata/bad_number.toml", raw_data);
+  ASSERT_EQ(err, "\"LeakyReLU-1.alpha\" must be a number, got \"0.1x\".");
+}
+
+TEST(NNTest, Prune) {
+  NeuralNetwork nn;
+  RawData raw_data;
+  raw_data.train_data = MatrixXfr::Random(20, 784);
+  raw_data.train_labels = MatrixXb::Zero(20, 1);
+  raw_data.test_data = MatrixXfr::Random(5, 784);
+  raw_data.test_labels = MatrixXb::Zero(5, 1);
+  raw_data.row = 28;
+  raw_data.col = 28;
+  raw_data.size = 784;
+  raw_data.train_number = 20;
+  raw_data.test_number = 5;
+  string err = nn.Init("tests/testdata/pruning.toml", raw_data);
+  ASSERT_EQ(err, "");
+  ASSERT_TRUE(nn.GetPruneConfig().enabled);
+  nn.SetLearningRate(0.1);
+  // 逐步剪枝，结束后剪掉的权重保持为0
+  for (int i = 0; i < 20; ++i) {
+    nn.Gradient(i);
+    nn.Update();
+    if (i == 4) {
+      ASSERT_GT(nn.GetDensity(1), 0.1f);
+      ASSERT_LT(nn.GetDensity(1), 1.0f);
+    }
+  }
+  ASSERT_LT(abs(nn.GetDensity(1) - 0.1f), 0.02f);
+  // 输出只有10列时，1x8的块比较粗，密度会高于目标
+  ASSERT_LT(nn.GetDensity(3), 0.2f);
+  // 稀疏推理与稠密推理结果一致
+  MatrixXf X = raw_data.test_data.row(0);
+  MatrixXi index_dense;
+  MatrixXf score_dense;
+  nn.GetPruneConfig().density_threshold = 0.0f;
+  nn.BuildSparse();
+  ASSERT_FALSE(nn.IsSparse(1));
+  nn.TopK(X, 3, index_dense, score_dense);
+  nn.GetPruneConfig().density_threshold = 0.3f;
+  nn.BuildSparse();
+  ASSERT_TRUE(nn.IsSparse(1));
+  MatrixXi index;
+  MatrixXf score;
+  nn.TopK(X, 3, index, score);
+  ASSERT_EQ(index, index_dense);
+  ASSERT_LT((score - score_dense).cwiseAbs().maxCoeff(), 1e-5);
+}
+TEST(NNTest, Init_Weights) {
+  RawData raw_data;
+  raw_data.train_data = MatrixXfr::Random(10, 784);
+  raw_data.train_labels = MatrixXb::Zero(10, 1);
+  raw_data.row = 28;
+  raw_data.col = 28;
+  raw_data.size = 784;
+  NeuralNetwork nn1;
+  string err = nn1.Init("tests/testdata/init.toml", raw_data);
+  ASSERT_EQ(err, "");
+  // 同一个种子得到同样的权重
+  NeuralNetwork nn2;
+  err = nn2.Init("tests/testdata/init.toml", raw_data);
+  ASSERT_EQ(err, "");
+  ASSERT_EQ(nn1.GetWeights(1), nn2.GetWeights(1));
+  ASSERT_EQ(nn1.GetWeights(3), nn2.GetWeights(3));
+  // 第一层为He初始化，第三层为Xavier初始化
+  MatrixXf &W1 = nn1.GetWeights(1);
+  MatrixXf &W3 = nn1.GetWeights(3);
+  float std1 = std::sqrt(W1.array().square().mean());
+  float std3 = std::sqrt(W3.array().square().mean());
+  ASSERT_NEAR(std1, std::sqrt(2.0f / 784), 0.002f);
+  ASSERT_NEAR(std3, std::sqrt(2.0f / 60), 0.02f);
+}
+/// @brief 使用检查点时梯度与保留全部层输出时一致，但同时保存的层输出更少
+TEST(NNTest, Checkpointing) {
+  RawData raw_data;
+  raw_data.train_data = MatrixXfr::Random(20, 784);
+  raw_data.train_labels = MatrixXb(20, 1);
+  for (int i = 0; i < 20; ++i) raw_data.train_labels(i) = i % 10;
+  raw_data.row = 28;
+  raw_data.col = 28;
+  raw_data.size = 784;
+  raw_data.train_number = 20;
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/checkpoint.toml", raw_data);
+  ASSERT_EQ(err, "");
+  ASSERT_TRUE(nn.IsCheckpointing());
+  ASSERT_TRUE(nn.IsCheckpoint(3));
+  ASSERT_TRUE(nn.IsCheckpoint(4));
+  ASSERT_TRUE(nn.IsCheckpoint(6));
+  ASSERT_TRUE(nn.IsCheckpoint(8));
+  ASSERT_FALSE(nn.IsCheckpoint(1));
+  ASSERT_FALSE(nn.IsCheckpoint(5));
+  NeuralNetwork ref;
+  err = ref.Init("tests/testdata/checkpoint_reference.toml", raw_data);
+  ASSERT_EQ(err, "");
+  ASSERT_FALSE(ref.IsCheckpointing());
+  nn.SetLearningRate(0.1);
+  ref.SetLearningRate(0.1);
+  vector<int> batch = {0, 3, 5, 7, 11, 12, 18, 19};
+  for (int step = 0; step < 3; ++step) {
+    nn.Gradient(batch);
+    ref.Gradient(batch);
+    ASSERT_EQ(nn.GetLoss(), ref.GetLoss());
+    nn.Update();
+    ref.Update();
+  }
+  for (int i = 1; i < nn.GetLayers(); ++i) {
+    ASSERT_EQ(nn.GetWeights(i), ref.GetWeights(i));
+  }
+  // 前3层融合为一步，只有第5层从第4层重新计算，第7层从第6层重新计算
+  CheckpointStats &stats = nn.GetCheckpointStats();
+  ASSERT_EQ(stats.forward_layers, 8);
+  ASSERT_EQ(stats.recomputed_layers, 2);
+  ASSERT_LT(stats.peak_bytes, stats.full_bytes);
+}
+/// @brief 卷积、ReLU与池化层融合后梯度与分开计算时一致
+TEST(NNTest, FuseConvolution) {
+  RawData raw_data;
+  raw_data.train_data = MatrixXfr::Random(20, 784);
+  raw_data.train_labels = MatrixXb(20, 1);
+  for (int i = 0; i < 20; ++i) raw_data.train_labels(i) = i % 10;
+  raw_data.row = 28;
+  raw_data.col = 28;
+  raw_data.size = 784;
+  raw_data.train_number = 20;
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/checkpoint_reference.toml", raw_data);
+  ASSERT_EQ(err, "");
+  ASSERT_TRUE(nn.IsFused(1));
+  ASSERT_EQ(nn.Output(1).size(), 0);
+  NeuralNetwork ref;
+  err = ref.Init("tests/testdata/unfused.toml", raw_data);
+  ASSERT_EQ(err, "");
+  ASSERT_FALSE(ref.IsFused(1));
+  nn.SetLearningRate(0.1);
+  ref.SetLearningRate(0.1);
+  vector<int> batch = {1, 2, 4, 8, 9, 13, 16};
+  for (int step = 0; step < 3; ++step) {
+    nn.Gradient(batch);
+    ref.Gradient(batch);
+    ASSERT_NEAR(nn.GetLoss(), ref.GetLoss(), 1e-4);
+    nn.Update();
+    ref.Update();
+  }
+  for (int i = 1; i < nn.GetLayers(); ++i) {
+    if (nn.GetWeights(i).size() == 0) continue;
+    ASSERT_LT((nn.GetWeights(i) - ref.GetWeights(i)).cwiseAbs().maxCoeff(),
+              1e-4);
+  }
+  vector<int> indices;
+  ASSERT_EQ(nn.Evaluate(false, indices), ref.Evaluate(false, indices));
+}
+
+/// @brief 逐通道卷积与逐点卷积层的形状由前一层推断，梯度与数值微分一致
+TEST(NNTest, SeparableConvolution) {
+  RawData raw_data;
+  raw_data.train_data = MatrixXfr::Random(6, 784);
+  raw_data.train_labels = MatrixXb(6, 1);
+  for (int i = 0; i < 6; ++i) raw_data.train_labels(i) = i % 10;
+  raw_data.row = 28;
+  raw_data.col = 28;
+  raw_data.size = 784;
+  raw_data.train_number = 6;
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/separable.toml", raw_data);
+  ASSERT_EQ(err, "");
+  ASSERT_EQ(nn.GetLayer(3).output_size, 8 * 24 * 24);
+  ASSERT_EQ(nn.GetWeights(3).size(), 8 * 9);
+  ASSERT_EQ(nn.GetLayer(4).output_size, 16 * 24 * 24);
+  ASSERT_EQ(nn.GetWeights(4).rows(), 8);
+  ASSERT_EQ(nn.GetWeights(4).cols(), 16);
+  ASSERT_EQ(nn.GetLayer(6).output_size, 16 * 12 * 12);
+  nn.SetLearningRate(0.1f);
+  vector<int> batch = {0, 1, 2, 3, 4, 5};
+  nn.Gradient(batch);
+  MatrixXf dW3 = nn.GetWeightGradient(3);
+  MatrixXf dW4 = nn.GetWeightGradient(4);
+  const float eps = 1e-2f;
+  for (auto [layer, k] : {std::pair{3, 0}, {3, 40}, {4, 5}, {4, 100}}) {
+    float &w = nn.GetWeights(layer).data()[k];
+    float original = w;
+    w = original + eps;
+    nn.Gradient(batch);
+    float plus = nn.GetLoss();
+    w = original - eps;
+    nn.Gradient(batch);
+    float minus = nn.GetLoss();
+    w = original;
+    float numeric = (plus - minus) / (2 * eps);
+    float analytic = (layer == 3 ? dW3 : dW4).data()[k];
+    ASSERT_NEAR(numeric, analytic, 2e-3 + 0.02 * std::abs(analytic))
+        << "layer " << layer << " weight " << k;
+  }
+}
+
+/// @brief 全局平均池化层代替卷积层之后的大仿射变换层，导数与数值微分一致
+TEST(NNTest, GlobalPooling) {
+  RawData raw_data;
+  raw_data.train_data = MatrixXfr::Random(6, 784);
+  raw_data.train_labels = MatrixXb(6, 1);
+  for (int i = 0; i < 6; ++i) raw_data.train_labels(i) = i % 10;
+  raw_data.row = 28;
+  raw_data.col = 28;
+  raw_data.size = 784;
+  raw_data.train_number = 6;
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/global_pooling.toml", raw_data);
+  ASSERT_EQ(err, "");
+  ASSERT_EQ(nn.GetLayer(3).output_size, 8);
+  ASSERT_EQ(nn.GetLayer(3).output_height, 1);
+  ASSERT_EQ(nn.GetWeights(4).rows(), 8);
+  ASSERT_EQ(nn.GetWeights(4).cols(), 10);
+  nn.SetLearningRate(0.1f);
+  vector<int> batch = {0, 1, 2, 3, 4, 5};
+  nn.Gradient(batch);
+  MatrixXf dW1 = nn.GetWeightGradient(1);
+  const float eps = 1e-2f;
+  for (int k : {0, 7, 60, 199}) {
+    float &w = nn.GetWeights(1).data()[k];
+    float original = w;
+    w = original + eps;
+    nn.Gradient(batch);
+    float plus = nn.GetLoss();
+    w = original - eps;
+    nn.Gradient(batch);
+    float minus = nn.GetLoss();
+    w = original;
+    float numeric = (plus - minus) / (2 * eps);
+    ASSERT_NEAR(numeric, dW1.data()[k], 2e-3 + 0.02 * std::abs(dW1.data()[k]))
+        << "weight " << k;
+  }
+}
+
+/// @brief 丢弃层训练时按比例置0并缩放，预测时直接传递；使用检查点重新计算时
+///        掩码不变，结果与不使用检查点时相同
+TEST(NNTest, Dropout) {
+  RawData raw_data;
+  raw_data.train_data = MatrixXfr::Random(64, 784);
+  raw_data.train_labels = MatrixXb(64, 1);
+  for (int i = 0; i < 64; ++i) raw_data.train_labels(i) = i % 10;
+  raw_data.row = 28;
+  raw_data.col = 28;
+  raw_data.size = 784;
+  raw_data.train_number = 64;
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/dropout.toml", raw_data);
+  ASSERT_EQ(err, "");
+  ASSERT_FALSE(nn.IsCheckpoint(3));
+  NeuralNetwork ref;
+  err = ref.Init("tests/testdata/dropout_reference.toml", raw_data);
+  ASSERT_EQ(err, "");
+  nn.SetLearningRate(0.1f);
+  ref.SetLearningRate(0.1f);
+  vector<int> batch(64);
+  for (int i = 0; i < 64; ++i) batch[i] = i;
+  float first = 0.0f;
+  for (int step = 0; step < 3; ++step) {
+    nn.Gradient(batch);
+    ref.Gradient(batch);
+    ASSERT_EQ(nn.GetLoss(), ref.GetLoss());
+    ASSERT_EQ(nn.GetWeightGradient(1), ref.GetWeightGradient(1));
+    if (step == 0) first = ref.GetLoss();
+  }
+  // 每次正向传播的掩码不同（every forward pass has a different mask）
+  ASSERT_NE(ref.GetLoss(), first);
+  MatrixXf &A = ref.Output(2);
+  MatrixXf &D = ref.Output(3);
+  int dropped = 0;
+  for (long k = 0; k < D.size(); ++k) {
+    if (D.data()[k] == 0.0f) {
+      dropped += A.data()[k] != 0.0f;
+    } else {
+      ASSERT_NEAR(D.data()[k], A.data()[k] / 0.7f, 1e-5);
+    }
+  }
+  long positive = (A.array() != 0.0f).count();
+  ASSERT_NEAR(static_cast<float>(dropped) / positive, 0.3f, 0.05f);
+  ref.Predict();
+  ASSERT_EQ(ref.Output(3), ref.Output(2));
+}
+
+/// @brief 紧凑模式下梯度与保存全部层输出时完全相同，只有反向传播需要的层
+///        输出被保留
+TEST(NNTest, CompactActivations) {
+  RawData raw_data;
+  raw_data.train_data = MatrixXfr::Random(20, 784);
+  raw_data.train_labels = MatrixXb(20, 1);
+  for (int i = 0; i < 20; ++i) raw_data.train_labels(i) = i % 10;
+  raw_data.row = 28;
+  raw_data.col = 28;
+  raw_data.size = 784;
+  raw_data.train_number = 20;
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/compact.toml", raw_data);
+  ASSERT_EQ(err, "");
+  NeuralNetwork ref;
+  err = ref.Init("tests/testdata/unfused.toml", raw_data);
+  ASSERT_EQ(err, "");
+  nn.SetLearningRate(0.1f);
+  ref.SetLearningRate(0.1f);
+  vector<int> batch = {0, 3, 5, 7, 11, 12, 18, 19};
+  for (int step = 0; step < 3; ++step) {
+    nn.Gradient(batch);
+    ref.Gradient(batch);
+    ASSERT_EQ(nn.GetLoss(), ref.GetLoss());
+    for (int i = 1; i < nn.GetLayers(); ++i) {
+      ASSERT_EQ(nn.GetWeightGradient(i), ref.GetWeightGradient(i)) << i;
+    }
+    nn.Update();
+    ref.Update();
+  }
+  // 反向传播后只保留输入（only the input is kept after backpropagation）
+  for (int i = 1; i < nn.GetLayers(); ++i) ASSERT_EQ(nn.Output(i).size(), 0);
+  // 正向传播后卷积、ReLU、Affine-1与Affine-2的输出已释放，池化层、ReLU与
+  // Tanh的输出分别被Affine-1、Affine-2和Tanh自己读取
+  nn.Forward();
+  for (int i : {1, 2, 4, 6}) ASSERT_EQ(nn.Output(i).size(), 0) << i;
+  for (int i : {3, 5, 7, 8}) ASSERT_GT(nn.Output(i).size(), 0) << i;
+  CheckpointStats &stats = nn.GetCheckpointStats();
+  ASSERT_EQ(stats.forward_layers, 8);
+  ASSERT_LT(stats.peak_bytes, stats.full_bytes);
+  vector<int> indices;
+  ASSERT_EQ(nn.Evaluate(false, indices), ref.Evaluate(false, indices));
+}
+
+/// @brief 带分支与残差连接的网络：形状按读取的层推断，导数与数值微分一致，
+///        按层号逐步计算与按层级并行计算的梯度相同，推理模式下共享缓冲区后
+///        预测不变
+TEST(NNTest, Graph) {
+  RawData raw_data;
+  raw_data.train_data = MatrixXfr::Random(16, 784);
+  raw_data.train_labels = MatrixXb(16, 1);
+  for (int i = 0; i < 16; ++i) raw_data.train_labels(i) = i % 10;
+  raw_data.row = 28;
+  raw_data.col = 28;
+  raw_data.size = 784;
+  raw_data.train_number = 16;
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/graph.toml", raw_data);
+  ASSERT_EQ(err, "");
+  ASSERT_TRUE(nn.IsGraph());
+  ASSERT_EQ(nn.GetInputs(5), vector<int>({2}));
+  ASSERT_EQ(nn.GetInputs(9), vector<int>({8, 2}));
+  ASSERT_EQ(nn.GetLayer(7).output_size, 64);
+  ASSERT_EQ(nn.GetWeights(8).rows(), 64);
+  ASSERT_EQ(nn.GetLayer(9).output_size, 48);
+  nn.SetLearningRate(0.1f);
+  vector<int> batch = {0, 2, 3, 5, 8, 9, 12, 15};
+  // 按层号逐步计算（step by step in layer order）
+  Workspace ws;
+  nn.LoadBatch(batch, ws);
+  ws.dW.resize(nn.GetLayers() + 1);
+  ws.dB.resize(nn.GetLayers() + 1);
+  for (int i = 1; i <= nn.GetLayers(); ++i) {
+    MatrixXf &dW = nn.GetWeightGradient(i);
+    MatrixXf &dB = nn.GetBiasGradient(i);
+    ws.dW[i].resize(dW.rows(), dW.cols());
+    ws.dB[i].resize(dB.rows(), dB.cols());
+  }
+  for (int i = 1; i <= nn.GetLayers(); ++i) i = nn.StepForward(i, ws);
+  for (int i = nn.GetLayers(); i >= 1; --i) {
+    i = nn.StepBackward(i, ws, ws.dW, ws.dB);
+  }
+  nn.Gradient(batch);
+  ASSERT_EQ(nn.GetLoss(), ws.loss);
+  for (int i = 1; i < nn.GetLayers(); ++i) {
+    ASSERT_EQ(nn.GetWeightGradient(i), ws.dW[i]) << i;
+    ASSERT_EQ(nn.GetBiasGradient(i), ws.dB[i]) << i;
+  }
+  // ReLU-1被三层读取，Affine-1的导数是三条路径之和（ReLU-1 is read by three
+  // layers, so the derivative of Affine-1 sums three paths）
+  const float eps = 1e-2f;
+  for (auto [layer, k] : {std::pair{1, 0}, {1, 5000}, {3, 17}, {5, 300},
+                          {8, 1000}, {10, 40}}) {
+    float analytic = ws.dW[layer].data()[k];
+    float &w = nn.GetWeights(layer).data()[k];
+    float original = w;
+    w = original + eps;
+    nn.Gradient(batch);
+    float plus = nn.GetLoss();
+    w = original - eps;
+    nn.Gradient(batch);
+    float minus = nn.GetLoss();
+    w = original;
+    float numeric = (plus - minus) / (2 * eps);
+    ASSERT_NEAR(numeric, analytic, 2e-3 + 0.02 * std::abs(analytic))
+        << "layer " << layer << " weight " << k;
+  }
+  NeuralNetwork inference;
+  err = inference.Init("tests/testdata/graph_inference.toml", raw_data);
+  ASSERT_EQ(err, "");
+  Parameters params;
+  nn.SaveParameters(params);
+  inference.LoadParameters(params);
+  MemoryPlan &plan = inference.GetMemoryPlan();
+  ASSERT_LT(plan.planned_bytes, plan.naive_bytes);
+  // ReLU-1一直用到Add-1（ReLU-1 is kept until Add-1）
+  for (int i = 3; i <= 8; ++i) {
+    ASSERT_NE(plan.buffer_of[i], plan.buffer_of[2]) << i;
+  }
+  vector<int> indices;
+  ASSERT_EQ(inference.Evaluate(false, indices), nn.Evaluate(false, indices));
+}
@@ -0,0 +1,101 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <gtest/gtest.h>
+#include <mountain_lake/parallel/thread_pool.h>
+
+#include <atomic>
+#include <vector>
+
+/// @brief 每个下标恰好被处理一次
+TEST(ThreadPoolTest, ParallelFor) {
+  ThreadPool pool;
+  ThreadPoolConfig config;
+  config.threads = 4;
+  ASSERT_EQ(pool.Start(config), "");
+  ASSERT_EQ(pool.GetThreads(), 4);
+  std::vector<std::atomic<int>> hits(10007);
+  for (int round = 0; round < 20; ++round) {
+    pool.ParallelFor(0, hits.size(), 16, [&hits](long first, long last) {
+      for (long i = first; i < last; ++i) ++hits[i];
+    });
+  }
+  for (auto &h : hits) ASSERT_EQ(h, 20);
+  // 范围小于粒度时在调用者中直接执行
+  int calls = 0;
+  pool.ParallelFor(5, 9, 16, [&calls](long first, long last) {
+    ASSERT_EQ(first, 5);
+    ASSERT_EQ(last, 9);
+    ++calls;
+  });
+  ASSERT_EQ(calls, 1);
+  pool.ParallelFor(3, 3, 1, [&calls](long, long) { ++calls; });
+  ASSERT_EQ(calls, 1);
+}
+
+/// @brief 在任务中再次调用ParallelFor不会死锁
+TEST(ThreadPoolTest, Nested) {
+  ThreadPool pool;
+  ThreadPoolConfig config;
+  config.threads = 3;
+  ASSERT_EQ(pool.Start(config), "");
+  std::atomic<long> sum(0);
+  pool.ParallelFor(0, 16, 1, [&](long first, long last) {
+    for (long i = first; i < last; ++i) {
+      pool.ParallelFor(0, 100, 1, [&](long b, long e) {
+        for (long j = b; j < e; ++j) sum += i * 100 + j;
+      });
+    }
+  });
+  ASSERT_EQ(sum, 1600L * 1599 / 2);
+}
+
+/// @brief 保留的CPU与线程数
+TEST(ThreadPoolTest, Config) {
+  std::vector<int> cpus = ThreadPool::CpuOrder(true);
+  ASSERT_FALSE(cpus.empty());
+  ThreadPool pool;
+  ThreadPoolConfig config;
+  config.reserved = cpus.size() + 3;
+  ASSERT_EQ(pool.Start(config), "");
+  // 保留了全部CPU时只使用调用者自己（only the caller when every CPU is
+  // reserved）
+  ASSERT_EQ(pool.GetThreads(), 1);
+  config.reserved = -1;
+  ASSERT_NE(pool.Start(config), "");
+  config = ThreadPoolConfig();
+  config.threads = 2;
+  config.pin = true;
+  ASSERT_EQ(pool.Start(config), "");
+  ASSERT_EQ(pool.GetCpus().size(), 1u);
+  ASSERT_GE(pool.GetCpus()[0], 0);
+  std::atomic<int> count(0);
+  pool.ParallelFor(0, 1000, 1, [&count](long first, long last) {
+    count += last - first;
+  });
+  ASSERT_EQ(count, 1000);
+  pool.Stop();
+  ASSERT_EQ(pool.GetThreads(), 1);
+}
+
+/// @brief 第一次使用之后只接受相同的配置
+TEST(ThreadPoolTest, Configure) {
+  ThreadPool pool;
+  ThreadPoolConfig config;
+  config.threads = 2;
+  ASSERT_EQ(pool.Configure(config), "");
+  config.threads = 3;
+  ASSERT_EQ(pool.Configure(config), "");
+  ASSERT_EQ(pool.GetThreads(), 3);
+  std::atomic<int> count(0);
+  pool.ParallelFor(0, 100, 1, [&count](long first, long last) {
+    count += last - first;
+  });
+  ASSERT_EQ(count, 100);
+  ASSERT_EQ(pool.Configure(config), "");
+  config.threads = 2;
+  ASSERT_NE(pool.Configure(config), "");
+  ASSERT_EQ(pool.GetThreads(), 3);
+}
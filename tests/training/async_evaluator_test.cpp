@@ -0,0 +1,67 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <gtest/gtest.h>
+#include <mountain_lake/training/async_evaluator.h>
+#include <mountain_lake/training/trainer.h>
+
+#include "synthetic_data.h"
+
+TEST(AsyncEvaluatorTest, Snapshot) {
+  RawData raw_data = SyntheticData(200, 100);
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/trainer.toml", raw_data);
+  ASSERT_EQ(err, "");
+  nn.SetLearningRate(1.0f);
+  vector<int> batch = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+  vector<int> indices;
+  string csv;
+  vector<float> results;
+  AsyncEvaluator evaluator;
+  evaluator.Start(&nn, true, indices, &csv,
+                  [&results](const EvalReport &report, Parameters &) {
+                    results.push_back(report.accuracy);
+                  });
+  // 快照的结果与提交时同步评估的结果一致
+  for (int i = 0; i < 30; ++i) nn.Gradient(batch), nn.Update();
+  float expected = nn.Evaluate(true, indices);
+  EvalReport report;
+  report.step = 30;
+  evaluator.Submit(report);
+  // 评估时继续训练不影响快照
+  for (int i = 0; i < 30; ++i) nn.Gradient(batch), nn.Update();
+  evaluator.Wait();
+  ASSERT_EQ(evaluator.GetEvaluated(), 1);
+  ASSERT_EQ(results.size(), 1u);
+  ASSERT_FLOAT_EQ(results[0], expected);
+  ASSERT_EQ(csv.substr(0, 3), "30,");
+  // 连续提交时最后一个快照一定会被评估
+  for (int i = 0; i < 5; ++i) {
+    report.step = 31 + i;
+    evaluator.Submit(report);
+  }
+  evaluator.Stop();
+  ASSERT_EQ(evaluator.GetEvaluated() + evaluator.GetDropped(), 6);
+  ASSERT_EQ(csv.substr(csv.rfind('\n', csv.size() - 2) + 1, 3), "35,");
+}
+
+TEST(AsyncEvaluatorTest, Trainer) {
+  RawData raw_data = SyntheticData(200, 100);
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/trainer.toml", raw_data);
+  ASSERT_EQ(err, "");
+  Trainer trainer;
+  err = trainer.Init("tests/testdata/trainer.toml");
+  ASSERT_EQ(err, "");
+  trainer.GetConfig().async_eval = true;
+  string csv;
+  TrainResult result = trainer.Train(nn, csv);
+  ASSERT_GE(result.best_accuracy, 0.9f);
+  ASSERT_GE(result.time_to_target, 0.0);
+  ASSERT_FALSE(csv.empty());
+  // 恢复的是最佳快照（the best snapshot is restored）
+  vector<int> indices;
+  ASSERT_GE(nn.Evaluate(true, indices), 0.9f);
+}
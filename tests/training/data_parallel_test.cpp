@@ -0,0 +1,137 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <gtest/gtest.h>
+#include <mountain_lake/training/data_parallel.h>
+#include <unistd.h>
+
+#include "synthetic_data.h"
+
+/// @brief 每个测试用不同的名字，避免与同时运行的其他测试冲突
+static string UniqueName(const string &test) {
+  return "ml_" + test + "_" + std::to_string(getpid());
+}
+
+/// @brief 3个进程的Allreduce、Broadcast与Barrier，长度包括0、少于进程数与
+///        超过共享内存通道容量的情况
+static int CheckCollectives(int transport, const string &name, int rank) {
+  Communicator comm;
+  if (comm.Open(transport, name, rank, 3, 30.0) != "") return 1;
+  for (long n : {0L, 1L, 2L, 7L, 1000L, 300001L}) {
+    vector<float> data(n);
+    for (long k = 0; k < n; ++k) data[k] = (rank + 1) * (k % 7);
+    if (comm.Allreduce(data.data(), n) != "") return 2;
+    for (long k = 0; k < n; ++k) {
+      if (data[k] != 6 * (k % 7)) return 3;
+    }
+    for (long k = 0; k < n; ++k) data[k] = rank == 2 ? k : -1.0f;
+    if (comm.Broadcast(data.data(), n, 2) != "") return 4;
+    for (long k = 0; k < n; ++k) {
+      if (data[k] != k) return 5;
+    }
+  }
+  if (comm.Barrier() != "") return 6;
+  return 0;
+}
+
+/// @brief 两种传输方式的集合通信结果都正确，失败的进程会被报告
+TEST(DataParallelTest, Collectives) {
+  for (int transport : {kTransportShm, kTransportSocket}) {
+    string name = UniqueName("collectives" + std::to_string(transport));
+    string err = DataParallel::Launch(3, [&](int rank) {
+      return CheckCollectives(transport, name, rank);
+    });
+    ASSERT_EQ(err, "") << "transport " << transport;
+    Communicator::Unlink(transport, name, 3);
+  }
+  ASSERT_NE(DataParallel::Launch(2, [](int rank) { return rank; }), "");
+  Communicator comm;
+  ASSERT_NE(comm.Open(kTransportShm, "a/b", 0, 2), "");
+  ASSERT_NE(comm.Open(kTransportShm, "x", 2, 2), "");
+  // 单个进程不需要通信（a single process needs no communication）
+  ASSERT_EQ(comm.Open(kTransportShm, "x", 0, 1), "");
+  float x = 3.0f;
+  ASSERT_EQ(comm.Allreduce(&x, 1), "");
+  ASSERT_EQ(x, 3.0f);
+}
+
+/// @brief 分桶归约得到的梯度与所有进程的样本放在一个小批量中计算的相同，
+///        各进程的样本数可以不同
+TEST(DataParallelTest, Gradient) {
+  RawData raw_data = SyntheticData(30, 0);
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/pipeline.toml", raw_data);
+  ASSERT_EQ(err, "");
+  nn.SetLearningRate(0.1f);
+  // 进程r的第k个样本是全部数据的第r+3k个（sample k of process r is sample
+  // r+3k of the whole data）
+  const int counts[3] = {7, 6, 3};
+  vector<int> all;
+  for (int r = 0; r < 3; ++r) {
+    for (int k = 0; k < counts[r]; ++k) all.push_back(r + 3 * k);
+  }
+  nn.Gradient(all);
+  vector<MatrixXf> dW;
+  vector<MatrixXf> dB;
+  for (int i = 0; i <= nn.GetLayers(); ++i) {
+    dW.push_back(nn.GetWeightGradient(i));
+    dB.push_back(nn.GetBiasGradient(i));
+  }
+  float loss = nn.GetLoss();
+  string name = UniqueName("gradient");
+  err = DataParallel::Launch(3, [&](int rank) {
+    DataParallel::Shard(nn.GetOwnTrainData(), rank, 3);
+    if (nn.GetTrainData().train_number != 10) return 1;
+    Communicator comm;
+    if (comm.Open(kTransportShm, name, rank, 3, 30.0) != "") return 2;
+    DataParallel dp;
+    dp.SetBucketBytes(4096);
+    vector<int> batch;
+    for (int k = 0; k < counts[rank]; ++k) batch.push_back(k);
+    if (dp.Gradient(nn, comm, batch) != "") return 3;
+    if (dp.GetStats().buckets < 2) return 4;
+    if (std::abs(dp.GetStats().loss - loss) > 1e-5) return 5;
+    for (int i = 1; i < nn.GetLayers(); ++i) {
+      if (dW[i].size() == 0) continue;
+      if ((nn.GetWeightGradient(i) - dW[i]).cwiseAbs().maxCoeff() > 1e-5) {
+        return 6;
+      }
+      if ((nn.GetBiasGradient(i) - dB[i]).cwiseAbs().maxCoeff() > 1e-5) {
+        return 7;
+      }
+    }
+    return 0;
+  });
+  ASSERT_EQ(err, "");
+}
+
+/// @brief 3个进程通过套接字训练后权重完全相同，并且能够收敛
+TEST(DataParallelTest, Train) {
+  RawData raw_data = SyntheticData(400, 100);
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/config.toml", raw_data);
+  ASSERT_EQ(err, "");
+  string name = UniqueName("train");
+  err = DataParallel::Launch(3, [&](int rank) {
+    DataParallel::Shard(nn.GetOwnTrainData(), rank, 3);
+    Communicator comm;
+    if (comm.Open(kTransportSocket, name, rank, 3, 30.0) != "") return 1;
+    DataParallel dp;
+    dp.SetBucketBytes(8192);
+    if (dp.Train(nn, comm, 10, 4, 2.0f, 1) != "") return 2;
+    // 样本数为134、133、133，每轮34步
+    if (dp.GetStats().steps != 340) return 3;
+    if (dp.GetStats().samples != 4000) return 4;
+    for (int i = 1; i < nn.GetLayers(); ++i) {
+      MatrixXf W = nn.GetWeights(i);
+      if (comm.Broadcast(W.data(), W.size(), 0) != "") return 5;
+      if (W != nn.GetWeights(i)) return 6;
+    }
+    vector<int> indices;
+    if (nn.Evaluate(true, indices) < 0.9f) return 7;
+    return 0;
+  });
+  ASSERT_EQ(err, "");
+}
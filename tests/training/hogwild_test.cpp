@@ -0,0 +1,85 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <gtest/gtest.h>
+#include <mountain_lake/training/hogwild.h>
+#include <mountain_lake/training/trainer.h>
+
+#include "synthetic_data.h"
+
+/// @brief 工作区中的梯度与神经网络自身计算的梯度一致
+TEST(HogwildTest, Workspace) {
+  RawData raw_data = SyntheticData(20, 10);
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/config.toml", raw_data);
+  ASSERT_EQ(err, "");
+  vector<int> batch = {0, 3, 7};
+  Workspace ws;
+  nn.Gradient(batch, ws);
+  MatrixXf W1 = nn.GetWeights(1);
+  MatrixXf W3 = nn.GetWeights(3);
+  MatrixXf B3 = nn.GetBias(3);
+  nn.DropPackedWeights();
+  Hogwild::ApplyUpdate(nn, ws, 0.1f);
+  MatrixXf dW1 = (W1 - nn.GetWeights(1)) / 0.1f;
+  MatrixXf dW3 = (W3 - nn.GetWeights(3)) / 0.1f;
+  ASSERT_LT((dW1 - ws.dW[1]).cwiseAbs().maxCoeff(), 1e-4);
+  ASSERT_LT((dW3 - ws.dW[3]).cwiseAbs().maxCoeff(), 1e-4);
+  nn.GetWeights(1) = W1;
+  nn.GetWeights(3) = W3;
+  nn.GetBias(3) = B3;
+  nn.GetBias(1).setZero();
+  nn.SetLearningRate(0.1f);
+  nn.Gradient(batch);
+  ASSERT_FLOAT_EQ(nn.GetLoss(), ws.loss);
+}
+
+/// @brief Affine:50、Sigmoid、Affine:10结构下多线程Hogwild能够收敛
+TEST(HogwildTest, Convergence) {
+  RawData raw_data = SyntheticData(400, 100);
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/config.toml", raw_data);
+  ASSERT_EQ(err, "");
+  Hogwild hogwild;
+  HogwildStats stats = hogwild.Train(nn, 4, 10, 10, 2.0f, 1);
+  ASSERT_EQ(stats.samples, 4000);
+  ASSERT_EQ(stats.steps, 400);
+  ASSERT_GT(stats.samples_per_second, 0.0);
+  vector<int> indices;
+  ASSERT_GE(nn.Evaluate(true, indices), 0.9f);
+}
+
+TEST(HogwildTest, Trainer) {
+  RawData raw_data = SyntheticData(200, 100);
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/trainer.toml", raw_data);
+  ASSERT_EQ(err, "");
+  Trainer trainer;
+  err = trainer.Init("tests/testdata/trainer.toml");
+  ASSERT_EQ(err, "");
+  trainer.GetConfig().hogwild_threads = 2;
+  string csv;
+  TrainResult result = trainer.Train(nn, csv);
+  ASSERT_GE(result.best_accuracy, 0.9f);
+}
+
+/// @brief 批量归一化层的滑动统计只在训练结束后由调用线程写入
+TEST(HogwildTest, BatchNorm) {
+  RawData raw_data = SyntheticData(200, 100);
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/batchnorm.toml", raw_data);
+  ASSERT_EQ(err, "");
+  vector<int> batch = {0, 3, 7, 9};
+  Workspace ws;
+  nn.Gradient(batch, ws);
+  MatrixXf B2 = nn.GetBias(2);
+  nn.DropPackedWeights();
+  Hogwild::ApplyUpdate(nn, ws, 0.1f);
+  ASSERT_EQ(nn.GetBias(2).middleRows(1, 2), B2.middleRows(1, 2));
+  ASSERT_NE(ws.stats[2].row(1), B2.row(1));
+  Hogwild hogwild;
+  hogwild.Train(nn, 2, 1, 10, 0.5f, 1);
+  ASSERT_NE(nn.GetBias(2).row(1), B2.row(1));
+}
@@ -0,0 +1,95 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <gtest/gtest.h>
+#include <mountain_lake/training/low_rank_sweep.h>
+
+#include "synthetic_data.h"
+
+/// @brief 用小批量梯度下降训练若干轮（Train some epochs of mini-batch SGD）
+static void TrainEpochs(NeuralNetwork &nn, int epochs) {
+  int n = nn.GetTrainData().train_number;
+  for (int epoch = 0; epoch < epochs; ++epoch) {
+    for (int begin = 0; begin < n; begin += 10) {
+      vector<int> batch;
+      for (int k = begin; k < begin + 10 && k < n; ++k) batch.push_back(k);
+      nn.Gradient(batch);
+      nn.Update();
+    }
+  }
+}
+
+/// @brief 每个秩的报告按秩减少参数与计算量，结束后权重不变，秩足够时准确率
+///        不变
+TEST(LowRankSweepTest, Run) {
+  RawData raw_data = SyntheticData(200, 100);
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/config.toml", raw_data);
+  ASSERT_EQ(err, "");
+  nn.SetLearningRate(2.0f);
+  TrainEpochs(nn, 5);
+  MatrixXf W = nn.GetWeights(1);
+  vector<RankReport> reports;
+  err = LowRankSweep::Run(nn, 1, {1, 10, 40}, true, reports);
+  ASSERT_EQ(err, "");
+  ASSERT_EQ(reports.size(), 4);
+  ASSERT_EQ(reports[0].rank, 0);
+  ASSERT_EQ(reports[0].params, 784 * 50);
+  ASSERT_EQ(reports[2].params, 10 * (784 + 50));
+  ASSERT_EQ(reports[2].flops, 2 * 10 * (784 + 50));
+  ASSERT_GT(reports[0].seconds, 0.0);
+  ASSERT_GE(reports[0].accuracy, 0.9f);
+  ASSERT_GE(reports[3].accuracy, reports[0].accuracy - 0.02f);
+  ASSERT_EQ(nn.GetLayer(1).type, "Affine");
+  ASSERT_EQ(nn.GetWeights(1), W);
+  ASSERT_NE(LowRankSweep::Run(nn, 2, {4}, true, reports), "");
+  ASSERT_NE(LowRankSweep::Run(nn, 1, {50}, true, reports), "");
+  ASSERT_EQ(nn.GetWeights(1), W);
+}
+
+/// @brief 分解为很低的秩后再训练几轮，两个因子被微调，误差下降
+TEST(LowRankSweepTest, FineTune) {
+  RawData raw_data = SyntheticData(200, 100);
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/config.toml", raw_data);
+  ASSERT_EQ(err, "");
+  nn.SetLearningRate(2.0f);
+  TrainEpochs(nn, 5);
+  ASSERT_NE(nn.Factorize(2, 2), "");
+  ASSERT_EQ(nn.Factorize(1, 2), "");
+  ASSERT_EQ(nn.GetLayer(1).type, "LowRankAffine");
+  ASSERT_EQ(nn.GetWeights(1).rows(), 784 + 50);
+  ASSERT_EQ(nn.GetWeights(1).cols(), 2);
+  vector<int> all;
+  for (int i = 0; i < 200; ++i) all.push_back(i);
+  nn.Gradient(all);
+  float before = nn.GetLoss();
+  ASSERT_EQ(nn.GetWeightGradient(1).rows(), 784 + 50);
+  // 微调使用较小的学习率（fine-tuning uses a smaller learning rate）
+  nn.SetLearningRate(0.5f);
+  TrainEpochs(nn, 3);
+  nn.Gradient(all);
+  ASSERT_LT(nn.GetLoss(), before);
+  // 乘回稠密层后预测不变（predictions do not change once expanded back）
+  vector<int> indices;
+  float accuracy = nn.Evaluate(true, indices);
+  nn.Expand(1);
+  ASSERT_EQ(nn.GetLayer(1).type, "Affine");
+  ASSERT_NEAR(nn.Evaluate(true, indices), accuracy, 1e-6);
+}
+
+/// @brief 结构中直接使用低秩仿射变换层时可以从头训练
+TEST(LowRankSweepTest, Config) {
+  RawData raw_data = SyntheticData(200, 100);
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/low_rank.toml", raw_data);
+  ASSERT_EQ(err, "");
+  ASSERT_EQ(nn.GetWeights(1).rows(), 784 + 50);
+  ASSERT_EQ(nn.GetWeights(1).cols(), 8);
+  nn.SetLearningRate(1.0f);
+  TrainEpochs(nn, 10);
+  vector<int> indices;
+  ASSERT_GE(nn.Evaluate(true, indices), 0.9f);
+}
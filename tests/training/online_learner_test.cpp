@@ -0,0 +1,115 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <gtest/gtest.h>
+#include <mountain_lake/training/online_learner.h>
+
+#include "synthetic_data.h"
+
+/// @brief 不回放时，攒够一个批量的更新与用训练数据的小批量更新相同
+TEST(OnlineLearnerTest, Batch) {
+  RawData raw_data = SyntheticData(20, 10);
+  NeuralNetwork nn;
+  NeuralNetwork reference;
+  ASSERT_EQ(nn.Init("tests/testdata/config.toml", raw_data), "");
+  ASSERT_EQ(reference.Init("tests/testdata/config.toml", raw_data), "");
+  nn.SetLearningRate(0.1f);
+  reference.SetLearningRate(0.1f);
+  OnlineLearner learner;
+  OnlineConfig config;
+  config.batch_size = 3;
+  ASSERT_EQ(learner.Init(nn, config), "");
+  const float *x = raw_data.train_data.data();
+  ASSERT_FALSE(learner.Learn(x, raw_data.train_labels(0)));
+  ASSERT_FALSE(learner.Learn(x + 784, raw_data.train_labels(1)));
+  ASSERT_TRUE(learner.Learn(x + 2 * 784, raw_data.train_labels(2)));
+  reference.Gradient(vector<int>{0, 1, 2});
+  reference.Update();
+  ASSERT_NEAR(learner.GetStats().loss, reference.GetLoss(), 1e-6);
+  for (int i = 1; i < nn.GetLayers(); ++i) {
+    MatrixXf &W = reference.GetWeights(i);
+    if (W.size() == 0) continue;
+    ASSERT_LT((nn.GetWeights(i) - W).cwiseAbs().maxCoeff(), 1e-6);
+    ASSERT_LT((nn.GetBias(i) - reference.GetBias(i)).cwiseAbs().maxCoeff(),
+              1e-6);
+  }
+  // 不足一个批量的样本在Flush时更新（a partial batch is updated by Flush）
+  ASSERT_EQ(learner.Learn(raw_data.train_data.middleRows(3, 4),
+                          raw_data.train_labels.data() + 3),
+            1);
+  ASSERT_TRUE(learner.Flush());
+  ASSERT_FALSE(learner.Flush());
+  ASSERT_EQ(learner.Learn(raw_data.train_data.middleRows(7, 1),
+                          raw_data.train_labels.data() + 7),
+            0);
+  ASSERT_TRUE(learner.Flush());
+  ASSERT_EQ(learner.GetStats().updates, 4);
+  ASSERT_EQ(learner.GetStats().samples, 8);
+  ASSERT_EQ(learner.GetStats().replayed, 0);
+  config.replay_samples = 2;
+  ASSERT_NE(learner.Init(nn, config), "");
+  config.batch_size = 0;
+  ASSERT_NE(learner.Init(nn, config), "");
+}
+
+/// @brief 回放缓冲区不超过容量，第一次更新之后工作区不再重新分配
+TEST(OnlineLearnerTest, Replay) {
+  RawData raw_data = SyntheticData(40, 10);
+  NeuralNetwork nn;
+  ASSERT_EQ(nn.Init("tests/testdata/config.toml", raw_data), "");
+  OnlineLearner learner;
+  OnlineConfig config;
+  config.batch_size = 2;
+  config.replay_capacity = 8;
+  config.replay_samples = 3;
+  ASSERT_EQ(learner.Init(nn, config), "");
+  // 第一次更新时回放缓冲区为空（the replay buffer is empty at the first
+  // update）
+  learner.Learn(raw_data.train_data.topRows(2), raw_data.train_labels.data());
+  ASSERT_EQ(learner.GetStats().replayed, 0);
+  ASSERT_EQ(learner.GetReplaySize(), 2);
+  learner.Learn(raw_data.train_data.middleRows(2, 2),
+                raw_data.train_labels.data() + 2);
+  Workspace &ws = learner.GetWorkspace();
+  ASSERT_EQ(ws.O[0].rows(), 5);
+  vector<const float *> buffers;
+  for (int i = 0; i < nn.GetLayers(); ++i) buffers.push_back(ws.O[i].data());
+  for (int i = 1; i < nn.GetLayers(); ++i) buffers.push_back(ws.dW[i].data());
+  int updates = learner.Learn(raw_data.train_data.bottomRows(36),
+                              raw_data.train_labels.data() + 4);
+  ASSERT_EQ(updates, 18);
+  ASSERT_EQ(learner.GetReplaySize(), 8);
+  ASSERT_EQ(learner.GetStats().replayed, 3 * 19);
+  int k = 0;
+  for (int i = 0; i < nn.GetLayers(); ++i) {
+    ASSERT_EQ(ws.O[i].data(), buffers[k++]) << "layer " << i;
+  }
+  for (int i = 1; i < nn.GetLayers(); ++i) {
+    ASSERT_EQ(ws.dW[i].data(), buffers[k++]) << "layer " << i;
+  }
+}
+
+/// @brief 逐个样本的流式训练能够收敛
+TEST(OnlineLearnerTest, Convergence) {
+  RawData raw_data = SyntheticData(400, 100);
+  NeuralNetwork nn;
+  ASSERT_EQ(nn.Init("tests/testdata/config.toml", raw_data), "");
+  nn.SetLearningRate(0.5f);
+  OnlineLearner learner;
+  OnlineConfig config;
+  config.replay_capacity = 64;
+  config.replay_samples = 3;
+  config.seed = 5;
+  ASSERT_EQ(learner.Init(nn, config), "");
+  for (int epoch = 0; epoch < 3; ++epoch) {
+    for (int r = 0; r < raw_data.train_number; ++r) {
+      learner.Learn(raw_data.train_data.row(r).data(),
+                    raw_data.train_labels(r));
+    }
+  }
+  ASSERT_EQ(learner.GetStats().updates, 1200);
+  vector<int> indices;
+  ASSERT_GE(nn.Evaluate(true, indices), 0.9f);
+}
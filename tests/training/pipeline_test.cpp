@@ -0,0 +1,104 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <gtest/gtest.h>
+#include <mountain_lake/training/pipeline.h>
+#include <mountain_lake/training/trainer.h>
+
+#include "synthetic_data.h"
+
+/// @brief 比较流水线与整个小批量计算的梯度
+static void ExpectSameGradient(NeuralNetwork &nn, Pipeline &pipeline,
+                               const vector<int> &batch, int micro_batches,
+                               int schedule) {
+  nn.Gradient(batch);
+  vector<MatrixXf> dW;
+  vector<MatrixXf> dB;
+  for (int i = 0; i <= nn.GetLayers(); ++i) {
+    dW.push_back(nn.GetWeightGradient(i));
+    dB.push_back(nn.GetBiasGradient(i));
+  }
+  PipelineStats stats =
+      pipeline.Gradient(nn, batch, micro_batches, schedule);
+  ASSERT_NEAR(stats.loss, nn.GetLoss(), 1e-5);
+  ASSERT_EQ(stats.stages, pipeline.GetStages());
+  ASSERT_EQ((int)stats.utilization.size(), pipeline.GetStages());
+  for (double u : stats.utilization) {
+    ASSERT_GT(u, 0.0);
+    ASSERT_LE(u, 1.0);
+  }
+  for (int i = 1; i < nn.GetLayers(); ++i) {
+    if (dW[i].size() == 0) continue;
+    ASSERT_LT((nn.GetWeightGradient(i) - dW[i]).cwiseAbs().maxCoeff(), 1e-5);
+    ASSERT_LT((nn.GetBiasGradient(i) - dB[i]).cwiseAbs().maxCoeff(), 1e-5);
+  }
+}
+
+/// @brief 切分使各段计算量平衡，段数不超过步数
+TEST(PipelineTest, Partition) {
+  RawData raw_data = SyntheticData(20, 0);
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/pipeline.toml", raw_data);
+  ASSERT_EQ(err, "");
+  Pipeline pipeline;
+  ASSERT_NE(pipeline.Partition(nn, 0), "");
+  ASSERT_EQ(pipeline.Partition(nn, 2), "");
+  ASSERT_EQ(pipeline.GetStages(), 2);
+  // 第1层的计算量远大于其他层，单独成为一段
+  ASSERT_EQ(pipeline.GetFirstLayer(0), 1);
+  ASSERT_EQ(pipeline.GetFirstLayer(1), 2);
+  ASSERT_EQ(pipeline.GetFirstLayer(2), nn.GetLayers() + 1);
+  ASSERT_EQ(pipeline.Partition(nn, 100), "");
+  ASSERT_EQ(pipeline.GetStages(), nn.GetLayers());
+}
+
+/// @brief 两种调度得到的梯度都与整个小批量一起计算的相同
+TEST(PipelineTest, Gradient) {
+  RawData raw_data = SyntheticData(20, 0);
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/pipeline.toml", raw_data);
+  ASSERT_EQ(err, "");
+  nn.SetLearningRate(0.1f);
+  Pipeline pipeline;
+  ASSERT_EQ(pipeline.Partition(nn, 4), "");
+  vector<int> batch = {0, 2, 3, 5, 8, 9, 11, 13, 17, 19};
+  ExpectSameGradient(nn, pipeline, batch, 3, kPipeline1F1B);
+  ExpectSameGradient(nn, pipeline, batch, 4, kPipelineGPipe);
+  // 微批量多于样本时每个样本一个微批量
+  ExpectSameGradient(nn, pipeline, batch, 50, kPipeline1F1B);
+}
+
+/// @brief 融合的卷积层不会被切开
+TEST(PipelineTest, Fused) {
+  RawData raw_data = SyntheticData(20, 0);
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/checkpoint_reference.toml", raw_data);
+  ASSERT_EQ(err, "");
+  ASSERT_TRUE(nn.IsFused(1));
+  nn.SetLearningRate(0.1f);
+  Pipeline pipeline;
+  ASSERT_EQ(pipeline.Partition(nn, 3), "");
+  for (int s = 1; s < pipeline.GetStages(); ++s) {
+    ASSERT_GT(pipeline.GetFirstLayer(s), 3);
+  }
+  vector<int> batch = {1, 4, 6, 7, 10, 15};
+  ExpectSameGradient(nn, pipeline, batch, 3, kPipeline1F1B);
+}
+
+TEST(PipelineTest, Trainer) {
+  RawData raw_data = SyntheticData(200, 100);
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/pipeline.toml", raw_data);
+  ASSERT_EQ(err, "");
+  Trainer trainer;
+  err = trainer.Init("tests/testdata/pipeline.toml");
+  ASSERT_EQ(err, "");
+  ASSERT_EQ(trainer.GetConfig().pipeline_stages, 3);
+  string csv;
+  TrainResult result = trainer.Train(nn, csv);
+  ASSERT_GE(result.best_accuracy, 0.9f);
+  ASSERT_EQ(trainer.GetPipelineStats().stages, 3);
+  ASSERT_EQ(trainer.GetPipelineStats().micro_batches, 4);
+}
@@ -0,0 +1,68 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <gtest/gtest.h>
+#include <mountain_lake/training/sweep.h>
+
+#include <algorithm>
+
+#include "synthetic_data.h"
+
+/// @brief InitShared不复制原始数据，结果与复制数据时相同
+TEST(SweepTest, SharedData) {
+  RawData raw_data = SyntheticData(200, 100);
+  NeuralNetwork shared;
+  NeuralNetwork copied;
+  ASSERT_EQ(shared.InitShared("tests/testdata/config.toml", raw_data), "");
+  ASSERT_EQ(copied.Init("tests/testdata/config.toml", raw_data), "");
+  ASSERT_EQ(&shared.GetTrainData(), &raw_data);
+  ASSERT_NE(&copied.GetTrainData(), &raw_data);
+  vector<int> batch = {1, 5, 9};
+  shared.Gradient(batch);
+  copied.Gradient(batch);
+  ASSERT_FLOAT_EQ(shared.GetLoss(), copied.GetLoss());
+  vector<int> indices;
+  ASSERT_FLOAT_EQ(shared.Evaluate(true, indices),
+                  copied.Evaluate(true, indices));
+}
+
+/// @brief 同时训练的结果与逐个训练的相同，按配置的顺序返回，初始化失败的
+///        配置只记录错误
+TEST(SweepTest, Run) {
+  RawData raw_data = SyntheticData(200, 100);
+  vector<string> configs = {"tests/testdata/trainer.toml",
+                            "tests/testdata/sweep.toml",
+                            "tests/testdata/missing.toml",
+                            "tests/testdata/sweep.toml"};
+  vector<SweepResult> results;
+  ASSERT_EQ(Sweep::Run(configs, raw_data, 3, results), "");
+  ASSERT_EQ(results.size(), 4);
+  ASSERT_NE(results[2].error, "");
+  ASSERT_EQ(results[2].result.steps, 0);
+  for (int k : {0, 1, 3}) {
+    ASSERT_EQ(results[k].config, configs[k]);
+    ASSERT_EQ(results[k].error, "") << configs[k];
+    ASSERT_GE(results[k].result.best_accuracy, 0.9f) << configs[k];
+    ASSERT_GT(results[k].metrics.samples, 0);
+    ASSERT_FALSE(results[k].csv.empty());
+  }
+  ASSERT_EQ(results[1].result.steps, 100);
+  ASSERT_EQ(results[1].result.steps, results[3].result.steps);
+  ASSERT_FLOAT_EQ(results[1].result.best_accuracy,
+                  results[3].result.best_accuracy);
+  NeuralNetwork nn;
+  ASSERT_EQ(nn.Init("tests/testdata/sweep.toml", raw_data), "");
+  Trainer trainer;
+  ASSERT_EQ(trainer.Init("tests/testdata/sweep.toml"), "");
+  string csv;
+  TrainResult result = trainer.Train(nn, csv);
+  ASSERT_EQ(result.steps, results[1].result.steps);
+  ASSERT_FLOAT_EQ(result.best_accuracy, results[1].result.best_accuracy);
+  string table = FormatSweepResults(results);
+  ASSERT_EQ(std::count(table.begin(), table.end(), '\n'), 5);
+  ASSERT_EQ(table.find("config,best_accuracy"), 0);
+  vector<SweepResult> none;
+  ASSERT_NE(Sweep::Run(configs, raw_data, 0, none), "");
+}
@@ -0,0 +1,40 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#ifndef TESTS_TRAINING_SYNTHETIC_DATA_H_
+#define TESTS_TRAINING_SYNTHETIC_DATA_H_
+
+#include <mountain_lake/neural_network/neural_network.h>
+
+/// @brief 生成容易学习的28x28合成数据（Generate easy-to-learn 28x28 data）
+/// @param train_number 训练样本数（number of training samples）
+/// @param test_number 测试样本数（number of test samples）
+/// @return 原始数据（raw data）
+/// @remark 类别c的样本在第c*20到c*20+19个像素上加1，其余为小的噪声。
+///         Samples of class c get 1 added to pixels c*20 to c*20+19, the
+///         rest is small noise.
+inline RawData SyntheticData(int train_number, int test_number) {
+  RawData raw_data;
+  raw_data.row = 28;
+  raw_data.col = 28;
+  raw_data.size = 784;
+  raw_data.train_number = train_number;
+  raw_data.test_number = test_number;
+  raw_data.train_data = MatrixXfr::Random(train_number, 784) * 0.1f;
+  raw_data.train_labels = MatrixXb(train_number, 1);
+  raw_data.test_data = MatrixXfr::Random(test_number, 784) * 0.1f;
+  raw_data.test_labels = MatrixXb(test_number, 1);
+  for (int i = 0; i < train_number; ++i) {
+    raw_data.train_labels(i) = i % 10;
+    raw_data.train_data.block(i, (i % 10) * 20, 1, 20).array() += 1.0f;
+  }
+  for (int i = 0; i < test_number; ++i) {
+    raw_data.test_labels(i) = i % 10;
+    raw_data.test_data.block(i, (i % 10) * 20, 1, 20).array() += 1.0f;
+  }
+  return raw_data;
+}
+
+#endif  // TESTS_TRAINING_SYNTHETIC_DATA_H_
@@ -0,0 +1,176 @@
+// @copyright Copyright 2024 Willard Lu
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+#include <gtest/gtest.h>
+#include <mountain_lake/training/trainer.h>
+
+#include <algorithm>
+
+#include "synthetic_data.h"
+
+TEST(TrainerTest, ReadConfig) {
+  Trainer trainer;
+  string err = trainer.Init("tests/testdata/trainer.toml");
+  ASSERT_EQ(err, "");
+  TrainConfig &c = trainer.GetConfig();
+  ASSERT_EQ(c.epochs, 20);
+  ASSERT_EQ(c.batch_size, 10);
+  ASSERT_EQ(c.schedule, kScheduleCosine);
+  ASSERT_EQ(c.eval_samples, 50);
+  ASSERT_FLOAT_EQ(c.target_accuracy, 0.9f);
+  // 数值写错时返回错误信息
+  err = trainer.Init("tests/testdata/bad_number.toml");
+  ASSERT_EQ(err, "\"training.epochs\" must be an integer, got \"3O\".");
+  // Hogwild与流水线不能同时使用
+  err = trainer.Init("tests/testdata/hogwild_pipeline.toml");
+  ASSERT_EQ(err,
+            "\"training.hogwild_threads\" and \"training.pipeline_stages\" "
+            "cannot both be greater than 1.");
+}
+
+TEST(TrainerTest, LearningRate) {
+  Trainer trainer;
+  TrainConfig &c = trainer.GetConfig();
+  c.learning_rate = 1.0f;
+  c.warmup_steps = 4;
+  // 预热阶段线性增加
+  ASSERT_FLOAT_EQ(trainer.LearningRate(0, 100), 0.25f);
+  ASSERT_FLOAT_EQ(trainer.LearningRate(3, 100), 1.0f);
+  ASSERT_FLOAT_EQ(trainer.LearningRate(50, 100), 1.0f);
+  c.schedule = kScheduleStep;
+  c.step_size = 10;
+  c.gamma = 0.5f;
+  ASSERT_FLOAT_EQ(trainer.LearningRate(13, 100), 1.0f);
+  ASSERT_FLOAT_EQ(trainer.LearningRate(14, 100), 0.5f);
+  ASSERT_FLOAT_EQ(trainer.LearningRate(34, 100), 0.125f);
+  c.schedule = kScheduleCosine;
+  c.min_learning_rate = 0.1f;
+  ASSERT_FLOAT_EQ(trainer.LearningRate(4, 104), 1.0f);
+  ASSERT_NEAR(trainer.LearningRate(54, 104), 0.55f, 1e-6);
+  ASSERT_NEAR(trainer.LearningRate(104, 104), 0.1f, 1e-6);
+}
+
+TEST(TrainerTest, Train) {
+  RawData raw_data = SyntheticData(200, 100);
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/trainer.toml", raw_data);
+  ASSERT_EQ(err, "");
+  Trainer trainer;
+  err = trainer.Init("tests/testdata/trainer.toml");
+  ASSERT_EQ(err, "");
+  string csv;
+  TrainResult result = trainer.Train(nn, csv);
+  ASSERT_GT(result.steps, 0);
+  ASSERT_LE(result.steps, 400);
+  ASSERT_GE(result.best_accuracy, 0.9f);
+  ASSERT_GE(result.time_to_target, 0.0);
+  ASSERT_LE(result.time_to_target, result.seconds);
+  ASSERT_FALSE(csv.empty());
+  // 恢复的是最佳检查点（the best checkpoint is restored）
+  std::vector<int> indices;
+  ASSERT_GE(nn.Evaluate(true, indices), 0.9f);
+}
+
+TEST(TrainerTest, EarlyStopping) {
+  RawData raw_data = SyntheticData(200, 100);
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/trainer.toml", raw_data);
+  ASSERT_EQ(err, "");
+  Trainer trainer;
+  err = trainer.Init("tests/testdata/trainer.toml");
+  ASSERT_EQ(err, "");
+  // 学习率为0时准确率不会提高，在patience次评估后停止
+  trainer.GetConfig().learning_rate = 0.0f;
+  trainer.GetConfig().epochs = 50;
+  trainer.GetConfig().target_accuracy = 1.1f;
+  string csv;
+  TrainResult result = trainer.Train(nn, csv);
+  ASSERT_TRUE(result.early_stopped);
+  ASSERT_EQ(result.steps, 60);
+  ASSERT_LT(result.time_to_target, 0.0);
+}
+
+/// @brief 带批量归一化的网络可以用较大的学习率训练，推理时合并到仿射变换层
+TEST(TrainerTest, BatchNorm) {
+  RawData raw_data = SyntheticData(200, 100);
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/batchnorm.toml", raw_data);
+  ASSERT_EQ(err, "");
+  Trainer trainer;
+  err = trainer.Init("tests/testdata/batchnorm.toml");
+  ASSERT_EQ(err, "");
+  string csv;
+  TrainResult result = trainer.Train(nn, csv);
+  ASSERT_GE(result.best_accuracy, 0.9f);
+  // 滑动统计已经离开初始值
+  ASSERT_NE(nn.GetBias(2)(1, 0), 0.0f);
+  ASSERT_EQ(nn.GetBias(2).rows(), 3);
+  Parameters params;
+  nn.SaveParameters(params);
+  NeuralNetwork inference;
+  err = inference.Init("tests/testdata/batchnorm_inference.toml", raw_data);
+  ASSERT_EQ(err, "");
+  inference.LoadParameters(params);
+  ASSERT_TRUE(inference.IsFolded(2));
+  ASSERT_TRUE(inference.IsFolded(5));
+  ASSERT_FALSE(nn.IsFolded(2));
+  MatrixXf X = raw_data.test_data.topRows(5);
+  nn.Output(0) = X;
+  nn.Predict();
+  inference.Output(0) = X;
+  inference.Predict();
+  int last = nn.GetLayers() - 1;
+  ASSERT_LT((nn.Output(last) - inference.Output(last)).cwiseAbs().maxCoeff(),
+            1e-3);
+}
+
+/// @brief 训练指标由计算梯度时的正向传播累计，不需要再预测训练数据
+TEST(TrainerTest, TrainMetrics) {
+  RawData raw_data = SyntheticData(200, 100);
+  NeuralNetwork nn;
+  string err = nn.Init("tests/testdata/trainer.toml", raw_data);
+  ASSERT_EQ(err, "");
+  nn.SetLearningRate(0.1f);
+  std::vector<int> batch = {3, 1, 4, 1, 5};
+  nn.Gradient(batch);
+  TrainMetrics &metrics = nn.GetTrainMetrics();
+  ASSERT_EQ(metrics.samples, 5);
+  ASSERT_NEAR(metrics.Loss(), nn.GetLoss(), 1e-5);
+  long total = 0;
+  for (long k : metrics.class_samples) total += k;
+  ASSERT_EQ(total, 5);
+  // 工作区中累计的结果相同（the same result gathered in a workspace）
+  Workspace ws;
+  nn.Gradient(batch, ws);
+  ASSERT_EQ(ws.metrics.samples, 5);
+  ASSERT_EQ(ws.metrics.correct, metrics.correct);
+  ASSERT_NEAR(ws.metrics.Loss(), metrics.Loss(), 1e-5);
+  nn.ResetTrainMetrics();
+  ASSERT_EQ(nn.GetTrainMetrics().samples, 0);
+
+  Trainer trainer;
+  err = trainer.Init("tests/testdata/trainer.toml");
+  ASSERT_EQ(err, "");
+  trainer.GetConfig().patience = 0;
+  trainer.GetConfig().epochs = 5;
+  trainer.GetConfig().eval_every = 0;
+  string csv;
+  trainer.Train(nn, csv);
+  vector<TrainMetrics> &epochs = trainer.GetEpochMetrics();
+  ASSERT_EQ(epochs.size(), 5u);
+  for (TrainMetrics &m : epochs) ASSERT_EQ(m.samples, 200);
+  ASSERT_LT(epochs.back().Loss(), epochs.front().Loss());
+  ASSERT_GE(epochs.back().Accuracy(), 0.8f);
+  for (int c = 0; c < 10; ++c) {
+    ASSERT_GE(epochs.back().ClassAccuracy(c), 0.0f);
+    ASSERT_LE(epochs.back().ClassAccuracy(c), 1.0f);
+  }
+  // 每次评估的一行多了训练误差与训练准确率（each evaluation line also has
+  // the training loss and accuracy）
+  string line = csv.substr(csv.rfind('\n', csv.size() - 2) + 1);
+  ASSERT_EQ(std::count(line.begin(), line.end(), ','), 6);
+  ASSERT_NE(line.find(std::to_string(epochs.back().Accuracy())),
+            string::npos);
+}